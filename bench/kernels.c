@@ -0,0 +1,163 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "body.h"
+#include "collision.h"
+#include "list.h"
+#include "polygon.h"
+#include "vector.h"
+
+// Micro-benchmarks of the library's innermost functions.
+// Usage: bench_kernels [--json] [name prefix]
+
+#define MAX_BENCHMARKS 32
+
+const Vector STEP = {0.5, -0.25};
+const double ANGLE = 1e-3;
+const double DT = 1e-3;
+// The number of items in the list list_remove works on
+const size_t LIST_LENGTH = 100;
+
+void bench_vec_add(size_t iterations, void *aux) {
+  Vector v = VEC_ZERO;
+  for (size_t i = 0; i < iterations; i++) v = vec_add(v, STEP);
+  bench_consume(v.x);
+}
+
+void bench_vec_dot(size_t iterations, void *aux) {
+  double sum = 0;
+  for (size_t i = 0; i < iterations; i++) sum += vec_dot(STEP, (Vector) {i, 1});
+  bench_consume(sum);
+}
+
+void bench_vec_cross(size_t iterations, void *aux) {
+  double sum = 0;
+  for (size_t i = 0; i < iterations; i++) sum += vec_cross(STEP, (Vector) {i, 1});
+  bench_consume(sum);
+}
+
+void bench_vec_rotate(size_t iterations, void *aux) {
+  Vector v = STEP;
+  for (size_t i = 0; i < iterations; i++) v = vec_rotate(v, ANGLE);
+  bench_consume(v.x);
+}
+
+void bench_vec_magnitude(size_t iterations, void *aux) {
+  double sum = 0;
+  for (size_t i = 0; i < iterations; i++) sum += vec_magnitude((Vector) {i, 1});
+  bench_consume(sum);
+}
+
+void bench_polygon_area(size_t iterations, void *aux) {
+  double sum = 0;
+  for (size_t i = 0; i < iterations; i++) sum += polygon_area(aux);
+  bench_consume(sum);
+}
+
+void bench_polygon_centroid(size_t iterations, void *aux) {
+  double sum = 0;
+  for (size_t i = 0; i < iterations; i++) sum += polygon_centroid(aux).x;
+  bench_consume(sum);
+}
+
+void bench_polygon_rotate(size_t iterations, void *aux) {
+  for (size_t i = 0; i < iterations; i++) polygon_rotate(aux, ANGLE, VEC_ZERO);
+}
+
+// Two overlapping shapes, so every axis has to be tested
+typedef struct {
+  List *shape1;
+  List *shape2;
+} Shape_Pair;
+
+void bench_find_collision(size_t iterations, void *aux) {
+  Shape_Pair *pair = aux;
+  size_t collided = 0;
+  for (size_t i = 0; i < iterations; i++) {
+    collided += find_collision(pair->shape1, pair->shape2).collided;
+  }
+  bench_consume(collided);
+}
+
+// Grows a list from empty, then frees it
+void bench_list_add(size_t iterations, void *aux) {
+  List *list = list_init(1, NULL);
+  for (size_t i = 0; i < iterations; i++) list_add(list, aux);
+  bench_consume(list_size(list));
+  list_free(list);
+}
+
+// Removes the first of LIST_LENGTH items, which shifts the rest down,
+// then adds it back at the end
+void bench_list_remove(size_t iterations, void *aux) {
+  List *list = list_init(LIST_LENGTH, NULL);
+  for (size_t i = 0; i < LIST_LENGTH; i++) list_add(list, aux);
+  for (size_t i = 0; i < iterations; i++) list_add(list, list_remove(list, 0));
+  list_free(list);
+}
+
+void bench_body_tick(size_t iterations, void *aux) {
+  Body *body = aux;
+  for (size_t i = 0; i < iterations; i++) {
+    body_add_force(body, STEP);
+    body_tick(body, DT);
+  }
+  bench_consume(body_get_centroid(body).x);
+}
+
+typedef struct {
+  Bench_Result results[MAX_BENCHMARKS];
+  size_t count;
+} Results;
+
+void run(Results *results, const char *name, Bench_Func bench, void *aux) {
+  if (!bench_selected(name)) return;
+  assert(results->count < MAX_BENCHMARKS);
+  results->results[results->count++] = bench_run(name, bench, aux);
+}
+
+int main(int argc, char *argv[]) {
+  if (!bench_options(argc, argv)) return 1;
+  Results results = {.count = 0};
+
+  run(&results, "vec_add", bench_vec_add, NULL);
+  run(&results, "vec_dot", bench_vec_dot, NULL);
+  run(&results, "vec_cross", bench_vec_cross, NULL);
+  run(&results, "vec_rotate", bench_vec_rotate, NULL);
+  run(&results, "vec_magnitude", bench_vec_magnitude, NULL);
+
+  List *polygon = polygon_circle(VEC_ZERO, 1, 16);
+  run(&results, "polygon_area/16", bench_polygon_area, polygon);
+  run(&results, "polygon_centroid/16", bench_polygon_centroid, polygon);
+  run(&results, "polygon_rotate/16", bench_polygon_rotate, polygon);
+  list_free(polygon);
+
+  const size_t VERTEX_COUNTS[] = {4, 16, 64, 256};
+  const char *COLLISION_NAMES[] = {
+    "find_collision/4", "find_collision/16", "find_collision/64", "find_collision/256"
+  };
+  for (size_t i = 0; i < sizeof(VERTEX_COUNTS) / sizeof(*VERTEX_COUNTS); i++) {
+    Shape_Pair pair = {
+      polygon_circle(VEC_ZERO, 1, VERTEX_COUNTS[i]),
+      polygon_circle((Vector) {1.5, 0.5}, 1, VERTEX_COUNTS[i])
+    };
+    run(&results, COLLISION_NAMES[i], bench_find_collision, &pair);
+    list_free(pair.shape1);
+    list_free(pair.shape2);
+  }
+
+  run(&results, "list_add", bench_list_add, &results);
+  run(&results, "list_remove/100", bench_list_remove, &results);
+
+  Body *box = body_init(polygon_rectangle(VEC_ZERO, 1, 1), 1, (RGBColor) {0, 0, 0});
+  body_set_velocity(box, STEP);
+  run(&results, "body_tick/4", bench_body_tick, box);
+  body_free(box);
+  Body *disc = body_init(polygon_circle(VEC_ZERO, 1, 32), 1, (RGBColor) {0, 0, 0});
+  body_set_velocity(disc, STEP);
+  run(&results, "body_tick/32", bench_body_tick, disc);
+  body_free(disc);
+
+  bench_print_results(stdout, results.results, results.count);
+  return 0;
+}
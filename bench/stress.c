@@ -0,0 +1,381 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench_util.h"
+#include "forces.h"
+#include "headless.h"
+#include "polygon.h"
+#include "rng.h"
+#include "scene.h"
+#include "spring_network.h"
+
+// Macro-benchmarks of whole scenes, ticked headlessly at sizes from
+// 10 to 100,000 bodies. Each scene is built two or more ways, e.g. with
+// a collision force creator for every pair of bodies or with one group
+// collision found by the broadphase, to show where each stops scaling.
+// Every (scene, size) runs in its own process, so its peak RSS is its own.
+// Usage: bench_stress [--json] [name prefix]
+
+#define MAX_SIZES 5
+#define CIRCLE_POINTS 8
+
+const size_t SIZES[MAX_SIZES] = {10, 100, 1000, 10000, 100000};
+const double STRESS_DT = 1.0 / 120;
+// Each size ticks for at least this long, and at least MIN_TICKS times
+const double STRESS_TIME = 0.5;
+const size_t MIN_TICKS = 5;
+const size_t MAX_TICKS = 2000;
+const uint64_t STRESS_SEED = 46;
+const RGBColor STRESS_COLOR = {0, 0, 0};
+const double ELASTICITY = 0.5;
+const double G = 1;
+const double THETA = 0.5;
+const double SOFTENING = 0.1;
+
+typedef enum {
+  GROUND,
+  BOX,
+  BALL,
+  BRICK
+} Stress_Tag;
+
+// Like the demos' make_rectangle() and make_circle(),
+// which can't be linked in without SDL
+Body *make_rectangle(Vector center, double width, double height, double mass,
+    Stress_Tag tag) {
+  Body *body = body_init(polygon_rectangle(center, width, height), mass, STRESS_COLOR);
+  body_set_tag(body, tag);
+  return body;
+}
+
+Body *make_circle(Vector center, double radius, double mass, Stress_Tag tag) {
+  Body *body = body_init(polygon_circle(center, radius, CIRCLE_POINTS), mass,
+    STRESS_COLOR);
+  body_set_tag(body, tag);
+  return body;
+}
+
+// The side of the smallest square grid with n cells
+size_t grid_side(size_t n) {
+  return (size_t) ceil(sqrt(n));
+}
+
+// Adds a physics collision force creator for every pair of bodies
+// from index first on, and every such body with every body before it
+void add_pair_collisions(Scene *scene, size_t first) {
+  for (size_t i = first; i < scene_bodies(scene); i++) {
+    for (size_t j = 0; j < i; j++) {
+      create_physics_collision(scene, ELASTICITY, scene_get_body(scene, j),
+        scene_get_body(scene, i));
+    }
+  }
+}
+
+// n unit boxes in a loose grid, falling onto the ground
+void build_pile(Scene *scene, size_t n, Rng *rng) {
+  size_t side = grid_side(n);
+  scene_add_body(scene, make_rectangle((Vector) {side * 0.75, -1}, side * 2, 2,
+    INFINITY, GROUND));
+  for (size_t i = 0; i < n; i++) {
+    Vector center = {(i % side) * 1.5 + rng_double(rng, 0, 0.2),
+      (i / side) * 1.5 + 1};
+    scene_add_body(scene, make_rectangle(center, 1, 1, 1, BOX));
+  }
+  Uniform_Field gravity = {.acceleration = {0, -9.8}};
+  create_uniform_field(scene, gravity, TAG_MASK(BOX));
+}
+
+void build_pile_pairs(Scene *scene, size_t n, Rng *rng) {
+  build_pile(scene, n, rng);
+  add_pair_collisions(scene, 1);
+}
+
+void build_pile_broadphase(Scene *scene, size_t n, Rng *rng) {
+  build_pile(scene, n, rng);
+  create_group_physics_collision(scene, ELASTICITY, TAG_MASK(BOX),
+    TAG_MASK(BOX) | TAG_MASK(GROUND));
+}
+
+// A breakout-style grid of n fixed bricks, walled in, with a ball
+// for every 20 bricks bouncing around between them
+void build_bricks(Scene *scene, size_t n, Rng *rng) {
+  size_t side = grid_side(n);
+  double width = side * 3, height = side * 2;
+  scene_add_body(scene, make_rectangle((Vector) {width / 2, -1}, width + 4, 2,
+    INFINITY, GROUND));
+  scene_add_body(scene, make_rectangle((Vector) {width / 2, height + 1}, width + 4, 2,
+    INFINITY, GROUND));
+  scene_add_body(scene, make_rectangle((Vector) {-1, height / 2}, 2, height,
+    INFINITY, GROUND));
+  scene_add_body(scene, make_rectangle((Vector) {width + 1, height / 2}, 2, height,
+    INFINITY, GROUND));
+  for (size_t i = 0; i < n; i++) {
+    Vector center = {(i % side) * 3 + 1.5, (i / side) * 2 + 1.5};
+    scene_add_body(scene, make_rectangle(center, 2, 1, INFINITY, BRICK));
+  }
+  // The balls start in the gaps under the rows of bricks
+  size_t num_balls = n / 20 > 0 ? n / 20 : 1;
+  for (size_t i = 0; i < num_balls; i++) {
+    Vector center = {rng_double(rng, 0.5, width - 0.5),
+      rng_index(rng, side) * 2 + 0.5};
+    Body *ball = make_circle(center, 0.3, 1, BALL);
+    body_set_velocity(ball, vec_rotate((Vector) {10, 0}, rng_double(rng, 0, 2 * M_PI)));
+    scene_add_body(scene, ball);
+  }
+}
+
+void build_bricks_pairs(Scene *scene, size_t n, Rng *rng) {
+  build_bricks(scene, n, rng);
+  add_pair_collisions(scene, scene_bodies(scene) - (n / 20 > 0 ? n / 20 : 1));
+}
+
+void build_bricks_broadphase(Scene *scene, size_t n, Rng *rng) {
+  build_bricks(scene, n, rng);
+  create_group_physics_collision(scene, 1, TAG_MASK(BALL),
+    TAG_MASK(BALL) | TAG_MASK(BRICK) | TAG_MASK(GROUND));
+}
+
+// n small bodies spread over a disc, attracting each other
+List *build_cloud(Scene *scene, size_t n, Rng *rng) {
+  List *bodies = list_init(n, NULL);
+  double radius = sqrt(n);
+  for (size_t i = 0; i < n; i++) {
+    Vector center = vec_rotate((Vector) {radius * sqrt(rng_double(rng, 0, 1)), 0},
+      rng_double(rng, 0, 2 * M_PI));
+    Body *body = make_circle(center, 0.1, 1, BALL);
+    scene_add_body(scene, body);
+    list_add(bodies, body);
+  }
+  return bodies;
+}
+
+void build_gravity_pairs(Scene *scene, size_t n, Rng *rng) {
+  List *bodies = build_cloud(scene, n, rng);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < i; j++) {
+      create_newtonian_gravity(scene, G, list_get(bodies, j), list_get(bodies, i));
+    }
+  }
+  list_free(bodies);
+}
+
+void build_gravity_direct(Scene *scene, size_t n, Rng *rng) {
+  create_direct_gravity(scene, G, SOFTENING, build_cloud(scene, n, rng));
+}
+
+void build_gravity_quadtree(Scene *scene, size_t n, Rng *rng) {
+  create_nbody_gravity(scene, G, THETA, build_cloud(scene, n, rng));
+}
+
+// n bodies in a jittered square lattice, each joined by springs
+// to its neighbors to the right and above
+List *build_lattice(Scene *scene, size_t n, Rng *rng) {
+  size_t side = grid_side(n);
+  List *bodies = list_init(n, NULL);
+  for (size_t i = 0; i < n; i++) {
+    Vector center = {(i % side) + rng_double(rng, -0.1, 0.1),
+      (i / side) + rng_double(rng, -0.1, 0.1)};
+    Body *body = make_circle(center, 0.1, 1, BALL);
+    scene_add_body(scene, body);
+    list_add(bodies, body);
+  }
+  return bodies;
+}
+
+void build_springs_pairs(Scene *scene, size_t n, Rng *rng) {
+  List *bodies = build_lattice(scene, n, rng);
+  size_t side = grid_side(n);
+  for (size_t i = 0; i < n; i++) {
+    if ((i + 1) % side != 0 && i + 1 < n) {
+      create_spring(scene, 1, list_get(bodies, i), list_get(bodies, i + 1));
+    }
+    if (i + side < n) {
+      create_spring(scene, 1, list_get(bodies, i), list_get(bodies, i + side));
+    }
+  }
+  list_free(bodies);
+}
+
+void build_springs_network(Scene *scene, size_t n, Rng *rng) {
+  List *bodies = build_lattice(scene, n, rng);
+  size_t side = grid_side(n);
+  Spring *springs = malloc(sizeof(Spring) * 2 * n);
+  assert(springs != NULL);
+  size_t num_springs = 0;
+  for (size_t i = 0; i < n; i++) {
+    if ((i + 1) % side != 0 && i + 1 < n) {
+      springs[num_springs++] = (Spring) {i, i + 1, 1, 1, 0.1};
+    }
+    if (i + side < n) {
+      springs[num_springs++] = (Spring) {i, i + side, 1, 1, 0.1};
+    }
+  }
+  create_spring_network(scene, bodies, springs, num_springs, false);
+  free(springs);
+}
+
+typedef struct {
+  const char *name;
+  void (*build)(Scene *scene, size_t n, Rng *rng);
+  /** The largest size to run, past which it would take minutes per tick */
+  size_t max_size;
+} Stress_Scene;
+
+const Stress_Scene SCENES[] = {
+  {"pile/pairs", build_pile_pairs, 1000},
+  {"pile/broadphase", build_pile_broadphase, 100000},
+  {"bricks/pairs", build_bricks_pairs, 1000},
+  {"bricks/broadphase", build_bricks_broadphase, 100000},
+  {"gravity/pairs", build_gravity_pairs, 1000},
+  {"gravity/direct", build_gravity_direct, 10000},
+  {"gravity/quadtree", build_gravity_quadtree, 100000},
+  {"springs/pairs", build_springs_pairs, 100000},
+  {"springs/network", build_springs_network, 100000}
+};
+
+typedef struct {
+  const char *name;
+  size_t size;
+  size_t ticks;
+  double ticks_per_sec;
+  /** The median time per tick, in seconds */
+  double p50;
+  /** The 99th percentile time per tick, in seconds */
+  double p99;
+  double allocs_per_tick;
+  /** The most memory resident at once, in bytes */
+  long peak_rss;
+  bool failed;
+} Stress_Result;
+
+int double_compare(const void *a, const void *b) {
+  double d1 = *(const double *) a, d2 = *(const double *) b;
+  return d1 < d2 ? -1 : d1 > d2;
+}
+
+// The smallest time at least a fraction p of ticks took no longer than
+double percentile(double *sorted, size_t count, double p) {
+  size_t rank = (size_t) ceil(p * count);
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Builds and ticks one scene, after one untimed tick to warm up
+Stress_Result stress_run(const Stress_Scene *stress, size_t size) {
+  Rng rng = rng_init(STRESS_SEED);
+  Scene *scene = scene_init();
+  stress->build(scene, size, &rng);
+  scene_tick(scene, STRESS_DT);
+
+  double *times = malloc(sizeof(double) * MAX_TICKS);
+  assert(times != NULL);
+  size_t ticks = 0;
+  size_t allocs = bench_allocations();
+  double start = headless_wall_time();
+  double elapsed = 0;
+  while (ticks < MAX_TICKS && (ticks < MIN_TICKS || elapsed < STRESS_TIME)) {
+    double tick_start = headless_wall_time();
+    scene_tick(scene, STRESS_DT);
+    double now = headless_wall_time();
+    times[ticks++] = now - tick_start;
+    elapsed = now - start;
+  }
+  allocs = bench_allocations() - allocs;
+  scene_free(scene);
+
+  qsort(times, ticks, sizeof(double), double_compare);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  Stress_Result result = {
+    .name = stress->name,
+    .size = size,
+    .ticks = ticks,
+    .ticks_per_sec = ticks / elapsed,
+    .p50 = percentile(times, ticks, 0.5),
+    .p99 = percentile(times, ticks, 0.99),
+    .allocs_per_tick = (double) allocs / ticks,
+    // Linux reports kilobytes
+    .peak_rss = usage.ru_maxrss * 1024L,
+    .failed = false
+  };
+  free(times);
+  return result;
+}
+
+// Runs stress_run() in a child process, which sends back its result
+Stress_Result stress_run_isolated(const Stress_Scene *stress, size_t size) {
+  Stress_Result result = {.name = stress->name, .size = size, .failed = true};
+  int fds[2];
+  if (pipe(fds) != 0) return result;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) return result;
+  if (pid == 0) {
+    close(fds[0]);
+    Stress_Result child = stress_run(stress, size);
+    bool sent = write(fds[1], &child, sizeof(child)) == sizeof(child);
+    _exit(sent ? 0 : 1);
+  }
+  close(fds[1]);
+  Stress_Result received;
+  bool read_all = read(fds[0], &received, sizeof(received)) == sizeof(received);
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  if (read_all && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    result = received;
+    result.name = stress->name;
+  }
+  return result;
+}
+
+void print_result(Stress_Result result, bool json, bool first) {
+  if (json) {
+    fprintf(stdout, "%s\n  {\"name\": \"%s\", \"bodies\": %zu, ", first ? "" : ",",
+      result.name, result.size);
+    if (result.failed) {
+      fprintf(stdout, "\"failed\": true}");
+      return;
+    }
+    fprintf(stdout, "\"ticks\": %zu, \"ticks_per_sec\": %.6g, \"p50_ms\": %.6g, "
+      "\"p99_ms\": %.6g, \"allocs_per_tick\": %.6g, \"peak_rss_bytes\": %ld}",
+      result.ticks, result.ticks_per_sec, result.p50 * 1e3, result.p99 * 1e3,
+      result.allocs_per_tick, result.peak_rss);
+    return;
+  }
+
+  if (result.failed) {
+    fprintf(stdout, "%-20s %8zu failed\n", result.name, result.size);
+    return;
+  }
+  fprintf(stdout, "%-20s %8zu %10.1f %10.3f %10.3f %12.1f %10.1f\n", result.name,
+    result.size, result.ticks_per_sec, result.p50 * 1e3, result.p99 * 1e3,
+    result.allocs_per_tick, result.peak_rss / (1024.0 * 1024.0));
+}
+
+int main(int argc, char *argv[]) {
+  if (!bench_options(argc, argv)) return 1;
+  bool json = bench_json_output();
+  if (json) {
+    fprintf(stdout, "{\"scenes\": [");
+  } else {
+    fprintf(stdout, "%-20s %8s %10s %10s %10s %12s %10s\n", "scene", "bodies",
+      "ticks/s", "p50 ms", "p99 ms", "allocs/tick", "peak MiB");
+  }
+
+  bool first = true;
+  for (size_t s = 0; s < sizeof(SCENES) / sizeof(*SCENES); s++) {
+    if (!bench_selected(SCENES[s].name)) continue;
+    for (size_t i = 0; i < MAX_SIZES && SIZES[i] <= SCENES[s].max_size; i++) {
+      print_result(stress_run_isolated(&SCENES[s], SIZES[i]), json, first);
+      fflush(stdout);
+      first = false;
+    }
+  }
+
+  if (json) fprintf(stdout, "\n]}\n");
+  return 0;
+}
@@ -6,6 +6,8 @@
 #include "collision.h"
 #include "forces.h"
 #include "color.h"
+#include "stepper.h"
+#include "rng.h"
 #include <time.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL2_gfxPrimitives.h>
@@ -44,11 +46,26 @@ const Vector VEC_CENTER = {.x = 400, .y = 400};
 const Vector PLAYER_VELOCITY = {.x = 600, .y = 0};
 const double PLAYER_MASS = INFINITY;
 
+// Physics runs at a fixed 120 ticks per second regardless of frame rate
+const double PHYSICS_DT = 1.0 / 120;
+const size_t MAX_SUBSTEPS = 8;
+
+// Body tags, which choose the collisions between bodies
+typedef enum {
+    WALL,
+    BALL,
+    BRICK
+} BodyTag;
+
 const double COLOR_FACTOR = 1.6;
 const double COLOR_THRESHOLD = 0.7 * 3;
 
+// A fixed seed, so every game (and every replay of one) looks the same
+const uint64_t RANDOM_SEED = 61;
+Rng rng;
+
 double rand_double(double min, double max) {
-  return (double)(((double) rand() / RAND_MAX * (max - min)) + min);
+  return rng_double(&rng, min, max);
 }
 
 RGBColor rand_color(){
@@ -64,17 +81,26 @@ double new_color_capped(double c) {
     }
 }
 
-// body1 should be the ball; body2 should be a brick
-void brick_health_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-  RGBColor c = body_get_color(body2);
+// Fades a brick the ball has just hit, removing it once it is pale enough
+void damage_brick(Body *brick) {
+  RGBColor c = body_get_color(brick);
   RGBColor new_c = (RGBColor) {new_color_capped(c.r), new_color_capped(c.g), new_color_capped(c.b)};
   //printf("\nOld: %f %f %f\n", c.r, c.g, c.b);
-  body_set_color(body2, new_c);
+  body_set_color(brick, new_c);
   //printf("New: %f %f %f\n", new_c.r, new_c.g, new_c.b);
   if (new_c.r + new_c.g + new_c.b > COLOR_THRESHOLD) {
 
-    body_remove(body2);
+    body_remove(brick);
+  }
+}
+
+// Damages each brick once per hit, however many ticks the ball touches it for
+void handle_brick_hits(Scene *scene) {
+  for(size_t i = 0; i < scene_collision_events(scene); i++) {
+    Collision_Event event = scene_get_collision_event(scene, i);
+    if(event.phase == COLLISION_BEGIN) damage_brick(event.body2);
   }
+  scene_clear_collision_events(scene);
 }
 
 Body *make_rectangle(Vector center, double width, double height, double mass, RGBColor color) {
@@ -94,16 +120,13 @@ void make_all_rectangles(Scene *scene, Vector min_window, Vector max_window) {
     double white_space = width * WHITE_SPACE_FACTOR;
     //Vector center = {.x = white_space, .y = window_height - height};
     Vector center = {.x = width/2.0 + white_space, .y = window_height - height/2.0};
-    Body *ball = scene_get_body(scene, 1);
 
     for(size_t i = 0; i < ACTUAL_RECTANGLES; i++) {
       for(size_t j = 0; j < NUM_ROWS; j++) {
         Body *new_rectangle = make_rectangle(center, width, height, RECTANGLE_MASS, COLORS[i]);
 
+        body_set_tag(new_rectangle, BRICK);
         scene_add_body(scene, new_rectangle);
-        create_physics_collision(scene, 1.0, new_rectangle, ball);
-        create_collision(scene, ball, new_rectangle, brick_health_handler,
-          NULL, free);
         // (scene, ball, new_rectangle);
         //create_destructive_collision(scene, new_rectangle, ball);
 
@@ -117,7 +140,7 @@ void make_all_rectangles(Scene *scene, Vector min_window, Vector max_window) {
 
 List *list_rectangle(double width, double height) {
     size_t num_points = 4;
-    List *points = list_init(num_points, free);
+    List *points = list_init(num_points, allocator_free);
 
 
     Vector pt1 = (Vector) {width/2.0, height/2.0};
@@ -138,7 +161,7 @@ List *list_rectangle(double width, double height) {
 List *get_circle(double r, double angle1, double angle2) {
   double angle = angle1;
   size_t num_points = (size_t) ARC_DENSITY * r * (angle2 - angle1) / (2 * M_PI);
-  List *points = list_init(num_points, free);
+  List *points = list_init(num_points, allocator_free);
 
   for (size_t i = 0; i < num_points; i++) {
     Vector pt = (Vector) {r * cos(angle), r * sin(angle)};
@@ -162,12 +185,10 @@ void make_ball(Scene *scene, Vector min_window, Vector max_window) {
 
   Body *ball = body_init(ball_pts, BALL_MASS, rand_color());
   body_set_velocity(ball, BALL_INIT_VELOCITY);
-  Body *player = scene_get_body(scene, 0);
-
-
+  body_set_tag(ball, BALL);
+  // Fast enough to pass through a brick or wall in a tick
+  body_set_continuous(ball, true);
   scene_add_body(scene, ball);
-  create_physics_collision(scene, 1.0, player, ball);
-
 }
 
 void make_player(Scene *scene, Vector min_window, Vector max_window, double mass) {
@@ -177,6 +198,7 @@ void make_player(Scene *scene, Vector min_window, Vector max_window, double mass
   double width = window_width / (SEPARATOR_FACTOR);
   double height = window_height / 20.0;
   Body *player = make_rectangle(center, width, height, mass, rand_color());
+  body_set_tag(player, WALL);
   scene_add_body(scene, player);
 }
 
@@ -190,14 +212,20 @@ void make_all_barriers(Scene *scene, Vector min_window, Vector max_window, doubl
   Body *left = make_rectangle(left_center, 10, window_height, mass, rand_color());
   Body *right = make_rectangle(right_center, 10, window_height, mass, rand_color());
   Body *top = make_rectangle(top_center, window_width, 10, mass, rand_color());
+  body_set_tag(left, WALL);
+  body_set_tag(right, WALL);
+  body_set_tag(top, WALL);
   scene_add_body(scene, left);
   scene_add_body(scene, right);
   scene_add_body(scene, top);
+}
 
-  Body *ball = scene_get_body(scene, 1);
-  create_physics_collision(scene, 1.0, left, ball);
-  create_physics_collision(scene, 1.0, right, ball);
-  create_physics_collision(scene, 1.0, top, ball);
+// Bricks and walls join these collisions by their tag as they are made,
+// so they are registered once for the whole game
+void make_collisions(Scene *scene) {
+  create_group_physics_collision(scene, 1.0, TAG_MASK(BALL),
+    TAG_MASK(WALL) | TAG_MASK(BRICK));
+  scene_add_collision_events(scene, TAG_MASK(BALL), TAG_MASK(BRICK));
 }
 
 void prevent_player_off_screen(Scene *scene, Vector min_window, Vector max_window) {
@@ -258,6 +286,8 @@ void handler(char key, KeyEventType type, double held_time,
 
 
 int main(int argc, char* argv[]) {
+  if (!sdl_input_options(argc, argv)) return 1;
+  rng = rng_init(RANDOM_SEED);
   Vector min_window = {.x = 0, .y = 0};
   Vector max_window = {.x = WINDOW_WIDTH, WINDOW_HEIGHT};
   sdl_init(min_window, max_window);
@@ -269,18 +299,22 @@ int main(int argc, char* argv[]) {
   make_ball(scene, min_window, max_window);
   make_all_rectangles(scene, min_window, max_window);
   make_all_barriers(scene, min_window, max_window, INFINITY);
+  make_collisions(scene);
 
   Body *player = scene_get_body(scene, 0);
+  Stepper *stepper = stepper_init(PHYSICS_DT, MAX_SUBSTEPS);
   sdl_on_key(handler);
   while (!sdl_is_done(scene, player).b) {
     double dt = time_since_last_tick();
     timer += dt;
     respawn_ball(scene, min_window, max_window);
     prevent_player_off_screen(scene, min_window, max_window);
-    scene_tick(scene, dt);
-    sdl_render_scene(scene);
+    stepper_advance(stepper, scene, dt);
+    handle_brick_hits(scene);
+    sdl_render_scene_interpolated(scene, stepper_alpha(stepper));
   }
 
+  stepper_free(stepper);
   scene_free(scene);
   return 0;
 }
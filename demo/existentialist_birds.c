@@ -8,6 +8,9 @@
 #include "collision.h"
 #include "forces.h"
 #include "color.h"
+#include "stepper.h"
+#include "scene_image.h"
+#include "rng.h"
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
@@ -31,6 +34,10 @@ typedef enum {
     BLOCK
 } BodyType;
 
+// Bodies are tagged with their BodyType, except birds in flight,
+// which get this tag so gravity can treat them differently
+const size_t LAUNCHED_BIRD = BLOCK + 1;
+
 
 struct game_state {
   bool window_closed;
@@ -58,13 +65,18 @@ const RGBColor CLD_WHITE = {.r = (double)255 / 255, .g = (double)255 / 255, .b =
 
 List *list_of_works;
 Game_State *game_state;
+Force_Registry *force_registry;
+// The title screen and levels are drawn from a fixed seed,
+// so every game (and every replay of one) looks the same
+const uint64_t RANDOM_SEED = 24;
+Rng rng;
 
 
 
 
 
 double rand_double(double min, double max) {
-  return (double)(((double) rand() / RAND_MAX * (max - min)) + min);
+  return rng_double(&rng, min, max);
 }
 
 const double GROUND_LEVEL_PROPORTION = .1;
@@ -72,11 +84,17 @@ const double GROUND_HEIGHT = WINDOW_HEIGHT * GROUND_LEVEL_PROPORTION;
 const double BLOCK_MASS = 5.0; // formerly WOOD_MASS
 const double SLINGSHOT_SPACE_PROPORTION = .25;
 const double ARC_DENSITY = 1;
+// Physics runs at a fixed 120 ticks per second regardless of frame rate
+const double PHYSICS_DT = 1.0 / 120;
+const size_t MAX_SUBSTEPS = 8;
 
 
 
+// Bodies are tagged with their type when they are made, and bodies loaded
+// from a level image have no info, so the tag is the type
 BodyType get_type(Body *body) {
-    return *((BodyType *) body_get_info(body));
+    size_t tag = body_get_tag(body);
+    return tag == LAUNCHED_BIRD ? BIRD : tag;
 }
 
 Game_State *game_state_init() {
@@ -98,7 +116,7 @@ Game_State *game_state_init() {
 List *list_circle(double r, double angle1, double angle2) {
   double angle = angle1;
   size_t num_points = (size_t) ARC_DENSITY * r * (angle2 - angle1) / (2 * M_PI);
-  List *points = list_init(num_points, free);
+  List *points = list_init(num_points, allocator_free);
 
   for (size_t i = 0; i < num_points; i++) {
     Vector pt = (Vector) {r * cos(angle), r * sin(angle)};
@@ -117,6 +135,7 @@ Body *make_circle(Vector center, double r, double angle1, double angle2,
     *info_to_pass = info;
     Body *b = body_init_with_info_and_text(circle_pts, mass, color,
       info_to_pass, free, text);
+    body_set_tag(b, info);
     body_set_inertia(b, 2.0 / 5.0 * mass * r * r);
     return b;
 }
@@ -140,13 +159,14 @@ Body *make_triangle(Vector pt1, Vector pt2, Vector pt3, double mass,
   *info_to_pass = info;
   Body *b = body_init_with_info_and_text(tri, mass, color,
     info_to_pass, free, NULL);
+  body_set_tag(b, info);
   //body_set_inertia(b, 1.0 / 3.0 * mass * height * height);
   return b;
 }
 
 List *list_rectangle(double width, double height) {
     size_t num_points = 4;
-    List *points = list_init(num_points, free);
+    List *points = list_init(num_points, allocator_free);
 
     Vector pt1 = (Vector) {width/2.0, height/2.0};
     list_add(points, (void *)vec_init(pt1));
@@ -174,15 +194,14 @@ Body *make_rectangle(Vector center, double width, double height, double mass,
     *info_to_pass = info;
     Body *b = body_init_with_info_and_text(rectangle_points, mass, color,
       info_to_pass, free, NULL);
+    body_set_tag(b, info);
     body_set_inertia(b, 1.0 / 3.0 * mass * height * height);
     return b;
 }
 
 bool no_bird(Scene *scene) {
-  for(size_t i = 0; i < scene_bodies(scene); i++) {
-    if(get_type(scene_get_body(scene, i)) == BIRD) return false;
-  }
-  return true;
+  return scene_tagged_bodies(scene, BIRD) == 0
+    && scene_tagged_bodies(scene, LAUNCHED_BIRD) == 0;
 }
 
 void make_bird(Scene *scene, Vector center, double radius, double mass, RGBColor color){
@@ -191,19 +210,10 @@ void make_bird(Scene *scene, Vector center, double radius, double mass, RGBColor
       game_state->has_been_fired = false;
       game_state->release_point = (Vector) {145, 140};
       Body *bird = make_circle(center, radius, 0, 2*M_PI, mass, color, BIRD, "bird");
-
-      List *useless = list_init(1, NULL);
-      list_add(useless, bird);
+      // Launched birds are fast enough to pass through a block in a tick
+      body_set_continuous(bird, true);
 
       scene_add_body(scene, bird);
-      create_down(scene, GRAVITY, useless);
-      stop_at_ground(scene, bird, scene_get_body(scene, 1));
-      for(size_t i = 0; i < scene_bodies(scene); i++) {
-        Body *b = scene_get_body(scene, i);
-        if(get_type(b) != NONINTERACTIVE) {
-          create_physics_collision(scene, 1, bird, b);
-        }
-      }
     }
 }
 
@@ -211,20 +221,8 @@ void make_pig(Scene *scene, Vector center, double radius, double mass,
   RGBColor color){
     Body *pig = make_circle(center, radius, 0, 2*M_PI, mass, color, PIG, "pig");
     body_set_velocity(pig, (Vector) {0, 0});
-    List *useless = list_init(1, NULL);
-    list_add(useless, pig);
-
-    create_down(scene, GRAVITY, useless);
-    stop_at_ground(scene, pig, scene_get_body(scene, 1));
 
     scene_add_body(scene, pig);
-    for(size_t i = 0; i < scene_bodies(scene); i++) {
-      Body *curr_body = scene_get_body(scene, i);
-      if(get_type(curr_body) != NONINTERACTIVE) {
-        create_inelastic_collision(scene, pig, curr_body);
-        create_normal_force(scene, pig, curr_body, GRAVITY);
-      }
-    }
 }
 
 void make_cloud(Scene *scene, Vector center, double width, double height) {
@@ -236,11 +234,11 @@ void make_cloud(Scene *scene, Vector center, double width, double height) {
 }
 
 void cloud_wrap_around(Scene *scene, Vector min_window, Vector max_window) {
-  for(size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *curr_body = scene_get_body(scene, i);
+  for(size_t i = 0; i < scene_tagged_bodies(scene, NONINTERACTIVE); i++) {
+    Body *curr_body = scene_get_tagged_body(scene, NONINTERACTIVE, i);
     if(get_type(curr_body) == NONINTERACTIVE) {
       Vector centroid = body_get_centroid(curr_body);
-      Vector first_pt = *((Vector *)list_get(body_get_shape(curr_body), 0));
+      Vector first_pt = *((Vector *)list_get(body_peek_shape(curr_body), 0));
       double half_rect_width = fabs(centroid.x - first_pt.x);
       // off the left side of the screen, respawn on right
       if(centroid.x + half_rect_width <= min_window.x) {
@@ -282,9 +280,14 @@ void make_background(Scene *scene, Vector min_window, Vector max_window) {
     scene_add_body(scene, ground); //index 1
 }
 
+// The tags of the bodies that can be knocked about
+const size_t FALLING_TAGS[] = {PIG, BIRD, LAUNCHED_BIRD};
+const size_t NUM_FALLING_TAGS = sizeof(FALLING_TAGS) / sizeof(*FALLING_TAGS);
+
 void nothing_below_ground(Scene *scene, Vector min_window, Vector max_window) {
-  for(size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *curr_body = scene_get_body(scene, i);
+  for(size_t k = 0; k < NUM_FALLING_TAGS; k++)
+  for(size_t i = 0; i < scene_tagged_bodies(scene, FALLING_TAGS[k]); i++) {
+    Body *curr_body = scene_get_tagged_body(scene, FALLING_TAGS[k], i);
     int type = get_type(curr_body);
     if(type == PIG) {
       if(body_get_centroid(curr_body).y - PIG_RADIUS <= (min_window.y + GROUND_HEIGHT)) {
@@ -332,20 +335,11 @@ void make_tower(Scene *scene, double width, double height, Vector center){
   list_add(list_of_bodies, block5);
   list_add(list_of_bodies, block6);
 
-  create_down(scene, GRAVITY, list_of_bodies);
   for(size_t i = 0; i < 6; i++) {
     Body *block = list_get(list_of_bodies, i);
     scene_add_body(scene, block);
-    stop_at_ground(scene, block, scene_get_body(scene, 1));
-
-    for(size_t j = 0; j < scene_bodies(scene); j++) {
-      Body *curr = scene_get_body(scene, j);
-      if(get_type(curr) != NONINTERACTIVE) {
-        create_inelastic_collision(scene, block, curr);
-        create_normal_force(scene, block, curr, GRAVITY);
-      }
-    }
   }
+  list_free(list_of_bodies);
 }
 
 void make_towers_and_pigs(Scene *scene, int num_towers, double width,
@@ -450,12 +444,11 @@ bool point_offscreen(Vector v, Vector min_window, Vector max_window) {
 
 
 void move_bird_on_slingshot(Scene *scene, Vector release_point) {
-  Body *bird;
-  for(size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *curr_body = scene_get_body(scene, i);
-    // we want the latest bird on the slingshot
-    if(get_type(curr_body) == BIRD) bird = curr_body;
-  }
+  // we want the latest bird on the slingshot, which is the only bird
+  size_t tag = scene_tagged_bodies(scene, BIRD) > 0 ? BIRD : LAUNCHED_BIRD;
+  size_t num_birds = scene_tagged_bodies(scene, tag);
+  if(num_birds == 0) return;
+  Body *bird = scene_get_tagged_body(scene, tag, num_birds - 1);
   /*if(bird == NULL) {
     make_bird(scene, (Vector) {.x = 50, .y = GROUND_HEIGHT}, 10, 20, DIRT_BROWN);
     for(size_t i = 0; i < scene_bodies(scene); i++) {
@@ -479,18 +472,7 @@ void move_bird_on_slingshot(Scene *scene, Vector release_point) {
     } else {
       Vector leaving_velocity = calculate_bird_leaving_velocity(game_state->release_point);
       body_set_velocity(bird, leaving_velocity);
-
-      List *useless = list_init(1, NULL);
-      list_add(useless, bird);
-
-      create_down(scene, GRAVITY, useless);
-
-      for(size_t i = 0; i < scene_bodies(scene); i++) {
-        Body *curr_body = scene_get_body(scene, i);
-        if(get_type(curr_body) != NONINTERACTIVE) {
-          create_physics_collision(scene, 1, bird, curr_body);
-        }
-      }
+      body_set_tag(bird, LAUNCHED_BIRD);
       game_state->has_been_fired = true;
     }
 
@@ -500,12 +482,13 @@ void move_bird_on_slingshot(Scene *scene, Vector release_point) {
 
 void remove_pigs_and_birds(Scene *scene, Vector min_window, Vector max_window, double dt) {
   // remove pigs that are offscreen or touching the ground
-  for(size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *b = scene_get_body(scene, i);
+  for(size_t k = 0; k < NUM_FALLING_TAGS; k++)
+  for(size_t i = 0; i < scene_tagged_bodies(scene, FALLING_TAGS[k]); i++) {
+    Body *b = scene_get_tagged_body(scene, FALLING_TAGS[k], i);
     Vector center;
     double radius;
     if(get_type(b) == PIG || get_type(b) == BIRD) {
-      List *pig_pts = body_get_shape(b);
+      List *pig_pts = body_peek_shape(b);
       Vector *pt = list_get(pig_pts, 0);
       center = body_get_centroid(b);
       radius = vec_magnitude((Vector) {.x = center.x - (*pt).x,
@@ -561,8 +544,8 @@ void remove_pigs_and_birds(Scene *scene, Vector min_window, Vector max_window, d
 
 void check_if_level_over(Scene *scene) {
   int num_pigs_left = 0;
-  for(size_t i = 0; i < scene_bodies(scene); i++) {
-    Body *b = scene_get_body(scene, i);
+  for(size_t i = 0; i < scene_tagged_bodies(scene, PIG); i++) {
+    Body *b = scene_get_tagged_body(scene, PIG, i);
     if(get_type(b) == PIG) {
       num_pigs_left++;
       // if some pig is moving, the level is not done
@@ -709,7 +692,7 @@ void title_screen_wait(Scene *scene) {
   // get three random integers to pick works to display on the title screen
   List *three_rand_nums = list_init(1, NULL);
   for(int i = 0; i < 3; i++) {
-    int random = rand() % list_size(list_of_works);
+    int random = rng_index(&rng, list_size(list_of_works));
     if(num_in_lst(three_rand_nums, random)) i--; //try again
     else {
       int *to_add = malloc(sizeof(int));
@@ -739,26 +722,105 @@ bool respond_to_title_input(Scene *scene) {
   return true;
 }
 
-void make_level(Scene *scene, Vector min_window, Vector max_window) {
-  double num_towers = (int) rand_double(MIN_NUM_TOWERS, MAX_NUM_TOWERS);
+// Registers every collision between the kinds of bodies once per level;
+// bodies join in by their tag when they are added
+void make_collisions(Scene *scene) {
+  uint32_t movable = TAG_MASK(PIG) | TAG_MASK(BLOCK);
+  uint32_t birds = TAG_MASK(BIRD) | TAG_MASK(LAUNCHED_BIRD);
+  uint32_t ground = TAG_MASK(GROUND);
 
-  // you get one bird per tower
-  game_state->num_birds_remaining = num_towers;
+  // Holds resting pigs and blocks up against gravity until something hits them
+  create_group_inelastic_collision(scene, movable, movable | ground);
+  create_group_stop_at_ground(scene, movable | birds, ground);
+  create_group_physics_collision(scene, 1, TAG_MASK(BIRD), movable | ground);
+  create_group_physics_collision(scene, LAUNCHED_BIRD_ELASTICITY,
+    TAG_MASK(LAUNCHED_BIRD), movable | ground);
+}
 
+// Each level is saved as a scene image the first time it is built, so switching
+// levels just maps the image. Images are only cached if a levels directory
+// exists (`make levels` creates it); otherwise every level is built in place.
+const char *LEVEL_IMAGE_FORMAT = "levels/birds_%d_%016llx.img";
+
+// Bump whenever build_level() changes what it builds
+const uint32_t LEVEL_VERSION = 1;
+
+uint64_t fnv_mix(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  for(size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Hashes everything a level image depends on into its file name, so an image
+// from an older build or different settings is never found and gets rebuilt
+uint64_t level_stamp(int num_towers, Vector min_window, Vector max_window) {
+  uint32_t image_version = SCENE_IMAGE_VERSION;
+  const double settings[] = {BLOCK_WIDTH, BLOCK_HEIGHT, PIG_RADIUS, PIG_MASS,
+    GRAVITY, LAUNCHED_BIRD_GRAVITY, LAUNCHED_BIRD_ELASTICITY};
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  hash = fnv_mix(hash, &image_version, sizeof(image_version));
+  hash = fnv_mix(hash, &LEVEL_VERSION, sizeof(LEVEL_VERSION));
+  hash = fnv_mix(hash, &num_towers, sizeof(num_towers));
+  hash = fnv_mix(hash, &min_window, sizeof(min_window));
+  hash = fnv_mix(hash, &max_window, sizeof(max_window));
+  return fnv_mix(hash, settings, sizeof(settings));
+}
+
+// Builds everything in a level but the bird
+void build_level(Scene *scene, int num_towers, Vector min_window, Vector max_window) {
   make_background(scene, min_window, max_window);
+  Uniform_Field gravity = {.acceleration = {0, -GRAVITY}};
+  create_uniform_field(scene, gravity, TAG_MASK(PIG) | TAG_MASK(BIRD) | TAG_MASK(BLOCK));
+  Uniform_Field bird_gravity = {.acceleration = {0, -LAUNCHED_BIRD_GRAVITY}};
+  create_uniform_field(scene, bird_gravity, TAG_MASK(LAUNCHED_BIRD));
+  make_collisions(scene);
   make_slingshot(scene);
   make_clouds(scene, min_window, max_window);
   update_remaining_birds(scene);
 
   make_towers_and_pigs(scene, num_towers, BLOCK_WIDTH, BLOCK_HEIGHT, PIG_RADIUS,
     min_window, max_window);
+}
+
+// The image a level was loaded from is stored in image, or NULL if it was built
+Scene *make_level(Scene_Image **image, Vector min_window, Vector max_window) {
+  int num_towers = (int) rand_double(MIN_NUM_TOWERS, MAX_NUM_TOWERS);
+
+  // you get one bird per tower
+  game_state->num_birds_remaining = num_towers;
+
+  char path[64];
+  snprintf(path, sizeof(path), LEVEL_IMAGE_FORMAT, num_towers,
+    (unsigned long long) level_stamp(num_towers, min_window, max_window));
+  Scene *scene = NULL;
+  *image = scene_image_map(path);
+  if(*image != NULL) {
+    scene = scene_image_load(*image, force_registry);
+    if(scene == NULL) {
+      scene_image_unmap(*image);
+      *image = NULL;
+    }
+  }
+  if(scene == NULL) {
+    scene = scene_init();
+    build_level(scene, num_towers, min_window, max_window);
+    // Fails without a levels directory, so the level is just built again
+    scene_image_save(scene, path, force_registry);
+  }
   make_bird(scene, (Vector) {.x = 50, .y = 100}, BIRD_RADIUS, BIRD_MASS, DIRT_BROWN);
+  return scene;
 }
 
 
 
 int main(int argc, char* argv[]) {
+  if(!sdl_input_options(argc, argv)) return 1;
+  rng = rng_init(RANDOM_SEED);
   game_state = game_state_init();
+  force_registry = force_registry_init();
+  forces_register_types(force_registry);
 
   Vector min_window = {.x = 0, .y = 0};
   Vector max_window = {.x = WINDOW_WIDTH, WINDOW_HEIGHT};
@@ -770,13 +832,14 @@ int main(int argc, char* argv[]) {
   if(!respond_to_title_input(title_scene)) return 0;
   scene_free(title_scene);
   Scene *scene;
+  Scene_Image *level_image;
 
   // main loop: goes through iterations of level/interim screen
   while(1) {
-    scene = scene_init();
+    scene = make_level(&level_image, min_window, max_window);
     if(sdl_is_done(scene, scene_get_body(scene, 0)).b) break;
     bool want_out = false;
-    make_level(scene, min_window, max_window);
+    Stepper *stepper = stepper_init(PHYSICS_DT, MAX_SUBSTEPS);
 
 
     time_since_last_tick();
@@ -827,8 +890,8 @@ int main(int argc, char* argv[]) {
 
       //display_num_remaining_birds(scene, min_window, max_window);
 
-      scene_tick(scene, dt);
-      sdl_render_scene(scene);
+      stepper_advance(stepper, scene, dt);
+      sdl_render_scene_interpolated(scene, stepper_alpha(stepper));
 
       if(game_state->level_status == WON || game_state->level_status == LOST) {
         game_state->level_over_timer += dt;
@@ -840,6 +903,7 @@ int main(int argc, char* argv[]) {
       }
       done = sdl_is_done(scene, scene_get_body(scene, 3));
     }
+    stepper_free(stepper);
 
     if(game_state->window_closed) break;
 
@@ -885,8 +949,11 @@ int main(int argc, char* argv[]) {
       i--;
     }
     scene_free(scene);
+    if(level_image != NULL) scene_image_unmap(level_image);
     game_state->level_status = STILL_GOING;
   }
   scene_free(scene);
+  if(level_image != NULL) scene_image_unmap(level_image);
+  force_registry_free(force_registry);
   return 0;
 }
@@ -40,6 +40,10 @@ const double CLD_MASS = 30;
 
 
 const double GRAVITY = 100;
+// Birds in flight fall and bounce harder than everything else,
+// and the slingshot is tuned for their steep arcs
+const double LAUNCHED_BIRD_GRAVITY = 200;
+const double LAUNCHED_BIRD_ELASTICITY = 3;
 
 const SDL_Color BLK = {0, 0, 0};
 
@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "headless.h"
+
+const double DEFAULT_DT = 1e-3;
+const size_t DEFAULT_STEPS = 1000;
+
+// Usage: headless <scene file or snapshot> [dt] [steps] [snapshot to save]
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 5) {
+    fprintf(stderr, "Usage: %s <scene file or snapshot> [dt] [steps] [snapshot to save]\n",
+      argv[0]);
+    return 1;
+  }
+  double dt = argc > 2 ? strtod(argv[2], NULL) : DEFAULT_DT;
+  size_t steps = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_STEPS;
+  if (!(dt > 0)) {
+    fprintf(stderr, "dt must be positive\n");
+    return 1;
+  }
+
+  Scene *scene = headless_load_scene(argv[1]);
+  if (scene == NULL) return 1;
+
+  Headless_Stats stats = headless_run(scene, dt, steps);
+  headless_print_stats(stdout, stats);
+  bool saved = argc < 5 || headless_save_scene(scene, argv[4]);
+  scene_free(scene);
+  return saved ? 0 : 1;
+}
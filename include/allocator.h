@@ -0,0 +1,213 @@
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Where the engine's memory comes from.
+ *
+ * Every allocation the engine makes (lists, vectors, bodies, shapes,
+ * scenes and everything they own) goes through one engine-wide allocator,
+ * labelled with the file and line that made it. By default that is just
+ * malloc(), realloc() and free(); installing another one, e.g. the
+ * tracking allocator below, lets a program see where its memory goes.
+ *
+ * Anything the engine hands over for the caller to free (e.g. a shape
+ * from body_get_shape() or a buffer from scene_save_forces()) was allocated
+ * this way, so release it with allocator_free(). With the default
+ * allocator, free() is the same thing.
+ */
+
+/**
+ * A source of memory.
+ * Each function gets the call site (see ALLOC_SITE) and the aux value.
+ */
+typedef struct {
+    /** Allocates a block like malloc(), returning NULL if it can't */
+    void *(*allocate)(size_t size, const char *site, void *aux);
+    /** Resizes a block (or allocates one, from NULL) like realloc() */
+    void *(*reallocate)(void *block, size_t size, const char *site, void *aux);
+    /** Releases a block (or does nothing, for NULL) like free() */
+    void (*release)(void *block, void *aux);
+    void *aux;
+} Allocator;
+
+/**
+ * The allocator built on malloc(), realloc() and free().
+ */
+extern const Allocator ALLOCATOR_DEFAULT;
+
+#define ALLOC_STRINGIFY(x) #x
+#define ALLOC_LINE(line) ALLOC_STRINGIFY(line)
+/** The call site of an allocation, e.g. "library/list.c:15" */
+#define ALLOC_SITE __FILE__ ":" ALLOC_LINE(__LINE__)
+
+/** Allocates like malloc() from the engine allocator, labelled with the call site. */
+#define ENGINE_MALLOC(size) allocator_malloc(size, ALLOC_SITE)
+/** Allocates zeroed memory like calloc() from the engine allocator. */
+#define ENGINE_CALLOC(count, size) allocator_calloc(count, size, ALLOC_SITE)
+/** Resizes like realloc() with the engine allocator. */
+#define ENGINE_REALLOC(block, size) allocator_realloc(block, size, ALLOC_SITE)
+
+/**
+ * Installs the engine allocator.
+ * Memory must be released by the allocator that allocated it, so install
+ * one before making anything with the engine, and keep it installed until
+ * all of that has been freed.
+ *
+ * @param allocator the allocator; its functions must not be NULL
+ */
+void allocator_set(Allocator allocator);
+
+/**
+ * Gets the engine allocator.
+ *
+ * @return the allocator installed with allocator_set(), or ALLOCATOR_DEFAULT
+ */
+Allocator allocator_get(void);
+
+/**
+ * Allocates from the engine allocator; see ENGINE_MALLOC().
+ *
+ * @param size the number of bytes
+ * @param site where the allocation is made
+ * @return the block, or NULL if it couldn't be allocated
+ */
+void *allocator_malloc(size_t size, const char *site);
+
+/**
+ * Allocates zeroed memory from the engine allocator; see ENGINE_CALLOC().
+ *
+ * @param count the number of elements
+ * @param size the size of each element
+ * @param site where the allocation is made
+ * @return the block, or NULL if it couldn't be allocated
+ */
+void *allocator_calloc(size_t count, size_t size, const char *site);
+
+/**
+ * Resizes a block with the engine allocator; see ENGINE_REALLOC().
+ *
+ * @param block a block from the engine allocator, or NULL
+ * @param size the new number of bytes
+ * @param site where the allocation is made
+ * @return the resized block, or NULL if it couldn't be resized
+ */
+void *allocator_realloc(void *block, size_t size, const char *site);
+
+/**
+ * Releases a block to the engine allocator.
+ * Can be used as a FreeFunc, e.g. for a list of vectors from vec_init().
+ *
+ * @param block a block from the engine allocator, or NULL
+ */
+void allocator_free(void *block);
+
+/**
+ * An allocator that keeps count of the memory allocated through it,
+ * by call site, and of the blocks still live. Backed by malloc().
+ * It can be used from several threads at once.
+ */
+typedef struct tracker Tracker;
+
+/**
+ * The counts for one call site.
+ */
+typedef struct {
+    /** The file and line, e.g. "library/list.c:15" */
+    const char *site;
+    /** The calls that allocated or resized a block */
+    size_t calls;
+    /** The bytes they asked for in total */
+    size_t bytes;
+    /** The blocks from this site that haven't been released */
+    size_t live_blocks;
+    size_t live_bytes;
+} Alloc_Site;
+
+/**
+ * Allocates memory for a tracker with no allocations counted.
+ * Asserts that the required memory was allocated.
+ *
+ * @return the new tracker
+ */
+Tracker *tracker_init(void);
+
+/**
+ * Releases the memory allocated for a tracker.
+ * Blocks it allocated that are still live stay valid, but can only be
+ * released with free() (or ALLOCATOR_DEFAULT) from then on.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ */
+void tracker_free(Tracker *tracker);
+
+/**
+ * Gets an allocator that allocates through a tracker, for allocator_set().
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @return the allocator
+ */
+Allocator tracker_allocator(Tracker *tracker);
+
+/**
+ * Gets the number of call sites that have allocated through a tracker.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @return the number of sites
+ */
+size_t tracker_num_sites(Tracker *tracker);
+
+/**
+ * Gets the counts for a call site.
+ * Sites are numbered in the order they first allocated.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @param index the index of the site, less than tracker_num_sites()
+ * @return the counts
+ */
+Alloc_Site tracker_get_site(Tracker *tracker, size_t index);
+
+/**
+ * Gets the bytes allocated by a subsystem that haven't been released.
+ * A subsystem is a source file's name without its directory or extension,
+ * e.g. "scene" for library/scene.c.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @param subsystem the subsystem, or NULL to count every site
+ * @return the live bytes
+ */
+size_t tracker_live_bytes(Tracker *tracker, const char *subsystem);
+
+/**
+ * Gets the number of blocks allocated by a subsystem that haven't been released.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @param subsystem the subsystem, or NULL to count every site
+ * @return the live blocks
+ */
+size_t tracker_live_blocks(Tracker *tracker, const char *subsystem);
+
+/**
+ * Writes a table of the calls and bytes at each call site, busiest first,
+ * followed by the live bytes of each subsystem.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @param out the stream to write to
+ */
+void tracker_report(Tracker *tracker, FILE *out);
+
+/**
+ * Writes each call site with blocks that haven't been released, if any.
+ * Live blocks aren't tied to the scene that allocated them, so this is an
+ * at-exit report: call it once every scene and everything else made with
+ * the engine has been freed, when any blocks still live are leaks.
+ *
+ * @param tracker a tracker returned from tracker_init()
+ * @param out the stream to write to
+ * @return the number of blocks still live
+ */
+size_t tracker_report_leaks(Tracker *tracker, FILE *out);
+
+#endif // #ifndef __ALLOCATOR_H__
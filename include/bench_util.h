@@ -0,0 +1,105 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Common functions for the benchmarks in bench/.
+ *
+ * A benchmark is a function that does some operation a given number of
+ * times. bench_run() calls it with more and more iterations until a run
+ * takes long enough to time accurately, then reports that run.
+ *
+ * The benchmarks are linked with malloc(), calloc() and realloc() wrapped
+ * (see BENCH_WRAP in the Makefile), so every allocation is counted.
+ */
+
+/**
+ * A benchmark: does its operation a number of times.
+ *
+ * @param iterations the number of times to do it
+ * @param aux the auxiliary value passed to bench_run()
+ */
+typedef void (*Bench_Func)(size_t iterations, void *aux);
+
+/**
+ * The measurements from one benchmark.
+ */
+typedef struct {
+    const char *name;
+    /** The number of operations in the timed run */
+    size_t iterations;
+    /** The wall-clock time per operation, in nanoseconds */
+    double ns_per_op;
+    /** The malloc(), calloc() and realloc() calls per operation */
+    double allocs_per_op;
+    /** The operations per second */
+    double ops_per_sec;
+} Bench_Result;
+
+/**
+ * Times a benchmark, doubling its iterations from 1 until a run takes
+ * at least a tenth of a second. The shorter runs double as a warm-up.
+ *
+ * @param name the benchmark's name, which must outlive the result
+ * @param run the benchmark
+ * @param aux an auxiliary value to pass to run
+ * @return the measurements from the last run
+ */
+Bench_Result bench_run(const char *name, Bench_Func run, void *aux);
+
+/**
+ * Counts the allocations made since the program started.
+ *
+ * @return the number of calls to malloc(), calloc() and realloc()
+ */
+size_t bench_allocations(void);
+
+/**
+ * Parses the options shared by every benchmark program:
+ * "--json" to write results as JSON, and a name prefix that
+ * selects which benchmarks to run.
+ *
+ * @param argc the number of command-line arguments, as passed to main()
+ * @param argv the command-line arguments
+ * @return whether the arguments were valid; if not, a usage message is printed
+ */
+bool bench_options(int argc, char *argv[]);
+
+/**
+ * Whether the options passed to bench_options() select a benchmark.
+ *
+ * @param name the benchmark's name
+ * @return whether to run it
+ */
+bool bench_selected(const char *name);
+
+/**
+ * Whether "--json" was passed to bench_options(), for benchmark programs
+ * that write their own kinds of results.
+ *
+ * @return whether to write results as JSON
+ */
+bool bench_json_output(void);
+
+/**
+ * Writes results as an aligned table, or as a JSON object whose
+ * "benchmarks" array has one object per result if "--json" was given.
+ *
+ * @param out the stream to write to
+ * @param results the results to write
+ * @param num_results the number of results
+ */
+void bench_print_results(FILE *out, Bench_Result *results, size_t num_results);
+
+/**
+ * Stores a value where the compiler can't tell it is never read,
+ * so the work that computed it isn't optimized away.
+ *
+ * @param value the value
+ */
+void bench_consume(double value);
+
+#endif // #ifndef __BENCH_UTIL_H__
@@ -2,6 +2,7 @@
 #define __BODY_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "color.h"
 #include "list.h"
@@ -15,9 +16,15 @@
  */
 typedef struct body Body;
 
+/** The number of distinct tags a body can have; see body_set_tag() */
+#define NUM_TAGS 32
+/** A mask selecting the bodies with a given tag */
+#define TAG_MASK(tag) ((uint32_t) 1 << (tag))
+/** A mask selecting every body, whatever its tag */
+#define ALL_TAGS UINT32_MAX
+
 bool body_get_stop(Body *body);
 void body_set_stop(Body *body, bool b);
-void body_set_unmoved(Body *body, bool b);
 void body_set_inertia(Body *body, double in);
 void body_set_shape(Body *body, List *shape);
 
@@ -53,12 +60,36 @@ void body_free(Body *body);
 /**
  * Gets the current shape of a body.
  * Returns a newly allocated vector list, which must be list_free()d.
+ * Its vertices are freed with allocator_free().
  *
  * @param body a pointer to a body returned from body_init()
  * @return the polygon describing the body's current position
  */
 List *body_get_shape(Body *body);
 
+/**
+ * Gets a body's current shape without copying it.
+ * The list belongs to the body and changes as the body moves,
+ * so it must not be modified or freed.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's own vertex list
+ */
+List *body_peek_shape(Body *body);
+
+/**
+ * Gets how a body's shape splits into triangles (see polygon_triangulate()),
+ * e.g. for drawing. Moving and rotating a body doesn't change this,
+ * so it is only worked out the first time, and again after body_set_shape().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param count where to store the number of triangles,
+ *   which is 0 if the shape has fewer than 3 vertices
+ * @return 3 indices into body_peek_shape() per triangle,
+ *   which belong to the body and must not be modified or freed
+ */
+const size_t *body_get_triangles(Body *body, size_t *count);
+
 /**
  * Gets the current center of mass of a body.
  * While this could be calculated with polygon_centroid(), that becomes too slow
@@ -70,6 +101,96 @@ List *body_get_shape(Body *body);
  */
 Vector body_get_centroid(Body *body);
 
+/**
+ * Gets the center of mass of a body at the start of its last tick.
+ * Teleporting the body with body_set_centroid() moves this point as well,
+ * so only motion from body_tick() is reflected in the difference.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's center of mass before the last tick
+ */
+Vector body_get_previous_centroid(Body *body);
+
+/**
+ * Gets the total angle a body has rotated through since it was created.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's orientation in radians. Positive is counterclockwise.
+ */
+double body_get_angle(Body *body);
+
+/**
+ * Gets a body's orientation at the start of its last tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's orientation before the last tick, in radians
+ */
+double body_get_previous_angle(Body *body);
+
+/**
+ * Everything about where a body is and how it's moving,
+ * including where its last tick started.
+ */
+typedef struct {
+    Vector centroid;
+    Vector previous_centroid;
+    Vector velocity;
+    /** In radians; see body_get_angle() */
+    double angle;
+    double previous_angle;
+    /** Half the rate of change of angle, as body_tick() integrates it */
+    double angular_velocity;
+} Body_Kinematics;
+
+/**
+ * Gets a body's position and motion, e.g. to save it.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's kinematic state
+ */
+Body_Kinematics body_get_kinematics(Body *body);
+
+/**
+ * Restores a body's position and motion as given by body_get_kinematics().
+ * The shape is left where it is, so it should already be
+ * where the kinematics put it.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param kinematics the state to restore
+ */
+void body_set_kinematics(Body *body, Body_Kinematics kinematics);
+
+/**
+ * Gets a body's moment of inertia, as set by body_set_inertia().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the moment of inertia, or 0 if the body doesn't rotate
+ */
+double body_get_inertia(Body *body);
+
+/**
+ * Gets the shape of a body blended between its previous and current
+ * position and orientation, for rendering between ticks.
+ * Returns a newly allocated vector list, which must be list_free()d.
+ * Its vertices are freed with allocator_free().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param alpha how far to blend: 0 is the previous transform, 1 the current one
+ * @return the polygon describing the body's interpolated position
+ */
+List *body_get_interpolated_shape(Body *body, double alpha);
+
+/**
+ * Moves a body back to part of the way through its last tick,
+ * as given by body_get_interpolated_shape(), leaving its velocity alone.
+ * The previous transform isn't changed.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param alpha how far through the last tick to move it:
+ *   0 is the previous transform, 1 the current one
+ */
+void body_rewind(Body *body, double alpha);
+
 /**
  * Gets the current velocity of a body.
  *
@@ -164,6 +285,129 @@ void body_add_impulse(Body *body, Vector impulse);
  */
 void body_tick(Body *body, double dt);
 
+/**
+ * Gets the force accumulated on a body so far this tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the sum of the forces passed to body_add_force() since the last reset
+ */
+Vector body_get_force(Body *body);
+
+/**
+ * Gets the impulse accumulated on a body so far this tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the sum of the impulses passed to body_add_impulse() since the last reset
+ */
+Vector body_get_impulse(Body *body);
+
+/**
+ * Discards the forces, impulses and torque accumulated on a body.
+ * body_tick() does this itself.
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_reset_forces(Body *body);
+
+/**
+ * Moves a body and sets its velocity as part of integrating a tick.
+ * Unlike body_set_centroid(), this leaves the previous transform alone,
+ * so the move is interpolated like any other motion during a tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param centroid the body's new center of mass
+ * @param velocity the body's new velocity
+ */
+void body_set_state(Body *body, Vector centroid, Vector velocity);
+
+/**
+ * Records a body's current transform as its previous one
+ * (see body_get_previous_centroid()).
+ * body_tick() does this itself; integrators that don't use body_tick()
+ * call it at the start of each tick.
+ *
+ * @param body a pointer to a body returned from body_init()
+ */
+void body_begin_tick(Body *body);
+
+/**
+ * Gets the tag a body was given with body_set_tag().
+ * Bodies start with tag 0.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return the body's tag, less than NUM_TAGS
+ */
+size_t body_get_tag(Body *body);
+
+/**
+ * Sorts a body into one of NUM_TAGS groups, such as "bird" or "debris",
+ * so that group-wide forces can select it with a mask of TAG_MASK()s.
+ * A body in a scene is refiled under its new tag right away;
+ * see scene_tagged_bodies().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param tag the body's new tag; asserts it is less than NUM_TAGS
+ */
+void body_set_tag(Body *body, size_t tag);
+
+/**
+ * Records where a scene's tag index files a body, so body_set_tag()
+ * can refile it. Only the scene filing the body should call this.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param scene the scene filing the body, or NULL once none does
+ * @param index the body's index among the scene's bodies with its tag
+ */
+void body_set_filing(Body *body, void *scene, size_t index);
+
+/**
+ * @param body a pointer to a body returned from body_init()
+ * @return the index last given to body_set_filing()
+ */
+size_t body_get_filing_index(Body *body);
+
+/**
+ * Gets the tags a body can collide with; see body_set_collision_mask().
+ * Bodies start able to collide with every tag.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return a mask of TAG_MASK()s
+ */
+uint32_t body_get_collision_mask(Body *body);
+
+/**
+ * Restricts which bodies a body can collide with under the scene's collision
+ * table (see scene_add_collision_response()). Two bodies are only tested
+ * for collision if each one's tag is in the other's mask.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param mask the TAG_MASK()s of the tags to collide with, or ALL_TAGS
+ */
+void body_set_collision_mask(Body *body, uint32_t mask);
+
+/**
+ * Gets whether a body uses continuous collision detection;
+ * see body_set_continuous().
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @return whether the body's path through each tick is checked for collisions
+ */
+bool body_get_continuous(Body *body);
+
+/**
+ * Chooses whether a body uses continuous collision detection.
+ * The scene's collision table normally only sees bodies that overlap
+ * at the start of a tick, so a fast body can pass through a thin one
+ * without ever overlapping it. A continuous body's whole path through
+ * the tick is checked against the bodies it can collide with,
+ * which costs more, so it's best kept to small, fast bodies.
+ * Bodies start without it.
+ *
+ * @param body a pointer to a body returned from body_init()
+ * @param continuous whether to check the body's path for collisions
+ */
+void body_set_continuous(Body *body, bool continuous);
+
 /**
  * Marks a body for removal--future calls to body_is_removed() will return true.
  * Does not free the body.
@@ -0,0 +1,118 @@
+#ifndef __BROADPHASE_H__
+#define __BROADPHASE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "polygon.h"
+
+/**
+ * Finds the pairs of boxes that might be colliding, so only those pairs
+ * need an exact (narrowphase) test.
+ * Uses sweep and prune: boxes are sorted by their left edge and each is
+ * only compared with the boxes starting before its right edge.
+ * The order is kept between updates, so when boxes move a little per tick
+ * re-sorting it is close to linear.
+ *
+ * Each box has a category (usually a single TAG_MASK()) and a mask of the
+ * categories it collides with. Two boxes only pair up if each one's
+ * category is in the other's mask; boxes with an empty mask are skipped
+ * without being sorted at all.
+ */
+typedef struct broadphase Broadphase;
+
+/**
+ * Two boxes that overlap, by the indices they were given to broadphase_set().
+ */
+typedef struct {
+    /** The smaller index */
+    size_t first;
+    /** The larger index */
+    size_t second;
+} Index_Pair;
+
+/**
+ * A function called on each box a query finds.
+ * @param index the box's index, as given to broadphase_set()
+ * @param aux the auxiliary value passed to the query
+ */
+typedef void (*Box_Visitor)(size_t index, void *aux);
+
+/**
+ * Allocates an empty broadphase.
+ *
+ * @return the new broadphase
+ */
+Broadphase *broadphase_init(void);
+
+/**
+ * Releases a broadphase.
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ */
+void broadphase_free(Broadphase *broadphase);
+
+/**
+ * Sets the number of boxes, each of which must then be given with
+ * broadphase_set() before calling broadphase_find_pairs().
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ * @param n the number of boxes
+ */
+void broadphase_resize(Broadphase *broadphase, size_t n);
+
+/**
+ * Sets one of the boxes.
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ * @param index the box's index, less than the size given to broadphase_resize()
+ * @param box the box's extent
+ * @param category the categories the box belongs to
+ * @param mask the categories the box collides with
+ */
+void broadphase_set(Broadphase *broadphase, size_t index, AABB box,
+    uint32_t category, uint32_t mask);
+
+/**
+ * Finds every pair of overlapping boxes that accept each other.
+ * Pairs are reported in an order that depends only on the boxes,
+ * not on earlier calls.
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ * @return the number of pairs found; see broadphase_get_pair()
+ */
+size_t broadphase_find_pairs(Broadphase *broadphase);
+
+/**
+ * Sorts the boxes given since the last update, so they can be queried
+ * with broadphase_query_box(). broadphase_find_pairs() does this itself.
+ * Boxes several times wider than average are set aside and tested by
+ * every query, so one wide box doesn't widen the search for the rest.
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ */
+void broadphase_update(Broadphase *broadphase);
+
+/**
+ * Finds every box that overlaps a given box and is in one of
+ * a set of categories, as of the last broadphase_update().
+ * Boxes with an empty mask are never found.
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ * @param box the region to search
+ * @param categories the categories of boxes to find
+ * @param visitor a function to call with each box found
+ * @param aux an auxiliary value to pass to the visitor
+ */
+void broadphase_query_box(Broadphase *broadphase, AABB box, uint32_t categories,
+    Box_Visitor visitor, void *aux);
+
+/**
+ * Gets one of the pairs found by the last broadphase_find_pairs().
+ *
+ * @param broadphase a pointer returned from broadphase_init()
+ * @param index the index of the pair
+ * @return the pair of box indices
+ */
+Index_Pair broadphase_get_pair(Broadphase *broadphase, size_t index);
+
+#endif // #ifndef __BROADPHASE_H__
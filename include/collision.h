@@ -21,6 +21,8 @@ typedef struct {
      * If collided is false, this value is undefined.
      */
     Vector axis;
+    /** If the shapes are colliding, how far they overlap along the axis */
+    double depth;
 } CollisionInfo;
 
 /**
@@ -36,4 +38,36 @@ typedef struct {
  */
 CollisionInfo find_collision(List *shape1, List *shape2);
 
+/**
+ * Computes how far apart two convex polygons are along whichever of their
+ * edge normals separates them the most.
+ * This is never more than the actual distance between the shapes,
+ * so either shape can safely move that far towards the other
+ * without passing through it.
+ *
+ * @param shape1 the first shape
+ * @param shape2 the second shape
+ * @param axis where to store the edge normal used,
+ *   a unit vector pointing from shape1 towards shape2
+ * @return the separation along the axis, or a negative number
+ *   if the shapes overlap
+ */
+double find_separation(List *shape1, List *shape2, Vector *axis);
+
+/**
+ * Finds where a ray first enters a convex polygon.
+ * A ray starting inside the polygon doesn't hit it.
+ *
+ * @param shape the polygon, with its vertices going either way around
+ * @param origin where the ray starts
+ * @param direction the unit vector the ray points along
+ * @param max_distance how far the ray goes
+ * @param distance where to store how far along the ray it enters the shape
+ * @param normal where to store the unit normal of the edge it enters through,
+ *   pointing out of the shape
+ * @return whether the ray hits the shape within max_distance
+ */
+bool find_ray_intersection(List *shape, Vector origin, Vector direction,
+    double max_distance, double *distance, Vector *normal);
+
 #endif // #ifndef __COLLISION_H__
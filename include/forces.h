@@ -2,6 +2,7 @@
 #define __FORCES_H__
 
 #include "scene.h"
+#include "snapshot.h"
 
 #define DIST_TOO_SMALL .1
 #define FORCE 5
@@ -11,6 +12,9 @@ typedef struct two_bodies Two_Bodies;
 typedef struct one_body One_Body;
 typedef struct one_body_two_constants One_Body_T;
 typedef struct n_bodies N_Bodies;
+typedef struct nbody_gravity NBody_Gravity;
+typedef struct direct_gravity Direct_Gravity;
+typedef struct field_aux Field_Aux;
 
 Two_Bodies *two_bodies_init(Body *body1, Body *body2, double constant);
 One_Body *one_body_init(Body *body, double constant);
@@ -21,6 +25,8 @@ void one_body_free(One_Body *one_body);
 void n_bodies_free(N_Bodies *n_bodies);
 
 void create_gravity_force(Two_Bodies *two);
+void create_nbody_gravity_force(NBody_Gravity *gravity);
+void create_direct_gravity_force(Direct_Gravity *gravity);
 void stop_at_ground(Scene *scene, Body *body, Body *ground);
 
 /**
@@ -36,6 +42,60 @@ void stop_at_ground(Scene *scene, Body *body, Body *ground);
  */
 void create_newtonian_gravity(Scene *scene, double G, Body *body1, Body *body2);
 
+/**
+ * Adds Newtonian gravity between every pair of bodies in a list,
+ * approximated with a Barnes-Hut quadtree rebuilt on every tick.
+ * This costs O(n log n) per tick instead of the O(n^2) of calling
+ * create_newtonian_gravity() on every pair.
+ * Bodies removed from the scene leave the group, and bodies added to
+ * the list later join it; see scene_add_group_force_creator().
+ *
+ * @param scene the scene containing the bodies
+ * @param G the gravitational proportionality constant
+ * @param theta the opening angle; see quadtree_field().
+ *   0 computes every pair exactly, larger values are faster but less accurate.
+ * @param bodies the bodies to attract to each other; each must have finite mass.
+ *   The scene takes ownership of this list, which should not own the bodies.
+ */
+void create_nbody_gravity(Scene *scene, double G, double theta, List *bodies);
+
+/**
+ * Adds Newtonian gravity between every pair of bodies in a list,
+ * summed directly over every pair in a single force creator.
+ * Cheaper than create_nbody_gravity() for up to a few thousand bodies,
+ * and far cheaper than calling create_newtonian_gravity() on every pair.
+ *
+ * Uses Plummer softening: the force between bodies r apart is
+ * G m1 m2 r / (r^2 + softening^2)^(3/2), which stays finite as r goes to 0
+ * instead of being cut off at DIST_TOO_SMALL.
+ * Its bodies come and go as with create_nbody_gravity().
+ *
+ * @param scene the scene containing the bodies
+ * @param G the gravitational proportionality constant
+ * @param softening the Plummer softening length; must be positive
+ * @param bodies the bodies to attract to each other; each must have finite mass.
+ *   The scene takes ownership of this list, which should not own the bodies.
+ */
+void create_direct_gravity(Scene *scene, double G, double softening, List *bodies);
+
+/**
+ * Computes the softened gravitational field at each of a set of point masses
+ * due to all of them: field_i = sum over j of m_j d / (|d|^2 + softening^2)^(3/2),
+ * where d = position_j - position_i. A point exerts no field on itself.
+ * The inputs are separate arrays of each coordinate so the inner loop
+ * can be vectorized.
+ *
+ * @param n the number of points
+ * @param x the x-coordinate of each point
+ * @param y the y-coordinate of each point
+ * @param mass the mass of each point
+ * @param softening the Plummer softening length; must be positive
+ * @param field_x where to store the x-component of the field at each point
+ * @param field_y where to store the y-component of the field at each point
+ */
+void gravity_direct_sum(size_t n, const double *x, const double *y,
+    const double *mass, double softening, double *field_x, double *field_y);
+
 /**
  * Adds a Hooke's-Law spring force between two bodies in a scene.
  * See https://en.wikipedia.org/wiki/Hooke%27s_law.
@@ -64,49 +124,62 @@ void create_spring_force(Two_Bodies *two_body);
 void create_drag_force(One_Body *one_body);
 
 void create_down(Scene *scene, double g, List *l);
-// void create_down_force(One_Body *b);
-void create_down_force(N_Bodies *n_bodies);
 
 /**
-* A function called when a collision occurs.
-* @param body1 the first body passed to create_collision()
-* @param body2 the second body passed to create_collision()
-* @param axis a unit vector pointing from body1 towards body2
-*   that defines the direction the two bodies are colliding in
-* @param aux the auxiliary value passed to create_collision()
-*/
-typedef void (*CollisionHandler)
-   (Body *body1, Body *body2, Vector axis, void *aux);
+ * A force acting alike on every body in a group, such as gravity near the
+ * ground, air resistance or wind. The force on a body of mass m moving at v is
+ *   m acceleration - linear_drag (v - wind) - quadratic_drag |v - wind| (v - wind)
+ */
+typedef struct {
+    /** The acceleration every body feels, whatever its mass */
+    Vector acceleration;
+    /** Drag proportional to a body's speed through the air */
+    double linear_drag;
+    /** Drag proportional to the square of a body's speed through the air */
+    double quadratic_drag;
+    /** The velocity of the air that drag pushes bodies towards */
+    Vector wind;
+} Uniform_Field;
 
 /**
-  * Adds a ForceCreator to a scene that calls a given CollisionHandler
-  * each time two bodies collide.
+ * Applies a uniform field to every finite-mass body in a scene whose tag
+ * (see body_set_tag()) is in a mask, using a single force creator.
+ * Bodies join the field by being added to the scene with a matching tag,
+ * so unlike create_down() nothing needs to be registered per body.
+ *
+ * @param scene the scene to apply the field in
+ * @param field the force to apply
+ * @param tag_mask the TAG_MASK()s of the tags to apply it to, or ALL_TAGS
+ */
+void create_uniform_field(Scene *scene, Uniform_Field field, uint32_t tag_mask);
+// void create_down_force(One_Body *b);
+void create_down_force(N_Bodies *n_bodies);
+void create_uniform_field_force(Field_Aux *aux);
+
+/**
+  * Adds a ForceCreator to a scene that reports two bodies to the scene's
+  * collision solver each time they touch, with a given response.
   * This generalizes create_destructive_collision() from last week,
   * allowing different things to happen when bodies collide.
-  * The handler is passed the bodies, the collision axis, and an auxiliary value.
-  * It should only be called once while the bodies are still colliding.
+  * See scene_add_collision(); the response is applied while the bodies
+  * are still colliding, once per tick.
   *
   * @param scene the scene containing the bodies
   * @param body1 the first body
   * @param body2 the second body
-  * @param handler a function to call whenever the bodies collide
-  * @param aux an auxiliary value to pass to the handler
-  * @param freer if non-NULL, a function to call in order to free aux
+  * @param response what to do whenever the bodies collide
 */
 void create_collision(
     Scene *scene,
     Body *body1,
     Body *body2,
-    CollisionHandler handler,
-    void *aux,
-    FreeFunc freer
+    Collision_Response response
 );
 
 /**
  * Adds a ForceCreator to a scene that destroys two bodies when they collide.
- * The bodies should be destroyed by calling body_remove().
- * This should be represented as an on-collision callback
- * registered with create_collision().
+ * The bodies are destroyed by calling body_remove().
+ * This is a COLLISION_DESTRUCTIVE response registered with create_collision().
  *
  * @param scene the scene containing the bodies
  * @param body1 the first body
@@ -117,13 +190,12 @@ void create_destructive_collision(Scene *scene, Body *body1, Body *body2);
 /**
  * Adds a ForceCreator to a scene that applies impulses
  * to resolve collisions between two bodies in the scene.
- * This should be represented as an on-collision callback
- * registered with create_collision().
+ * This is a COLLISION_PHYSICS response registered with create_collision().
  *
- * You may remember from project01 that you should avoid applying impulses
- * multiple times while the bodies are still colliding.
- * You should also have a special case that allows either body1 or body2
- * to have mass INFINITY, as this is useful for simulating walls.
+ * Impulses only ever push the bodies apart, so they aren't applied again
+ * while the bodies are still overlapping but already separating.
+ * Either body1 or body2 may have mass INFINITY, as this is useful
+ * for simulating walls.
  *
  * @param scene the scene containing the bodies
  * @param elasticity the "coefficient of restitution" of the collision;
@@ -135,8 +207,62 @@ void create_physics_collision(
     Scene *scene, double elasticity, Body *body1, Body *body2
 );
 
+/**
+ * Gives every body with a tag in mask1 touching a body with a tag in mask2
+ * a collision response, however many such bodies the scene has.
+ * See scene_add_collision_response(); unlike create_collision(), this
+ * registers a single table entry rather than one force creator per pair,
+ * and bodies join in by having a matching tag.
+ *
+ * @param scene the scene containing the bodies
+ * @param mask1 the TAG_MASK()s of the tags given the response as body1
+ * @param mask2 the TAG_MASK()s of the tags given the response as body2
+ * @param response what to do whenever two such bodies collide
+ */
+void create_group_collision(Scene *scene, uint32_t mask1, uint32_t mask2,
+    Collision_Response response);
+
+/**
+ * The group forms of create_destructive_collision(),
+ * create_physics_collision(), create_inelastic_collision()
+ * and stop_at_ground(), acting on every pair of
+ * bodies with one tag in mask1 and the other in mask2.
+ * See create_group_collision().
+ */
+void create_group_destructive_collision(Scene *scene, uint32_t mask1, uint32_t mask2);
+void create_group_physics_collision(Scene *scene, double elasticity,
+    uint32_t mask1, uint32_t mask2);
+void create_group_inelastic_collision(Scene *scene, uint32_t mask1, uint32_t mask2);
+void create_group_stop_at_ground(Scene *scene, uint32_t mask1, uint32_t mask2);
+
 void create_semidestructive_collision(Scene *scene, Body *body1, Body *body2);
 void create_inelastic_collision(Scene *scene, Body *body1, Body *body2);
-void create_normal_force(Scene *scene, Body *body1, Body *body2, double g);
+
+/**
+ * The IDs forces_register_types() saves the built-in force creators
+ * under. Applications registering their own should start from FORCE_TYPE_USER.
+ */
+typedef enum {
+    FORCE_TYPE_NEWTONIAN_GRAVITY = 1,
+    FORCE_TYPE_NBODY_GRAVITY,
+    FORCE_TYPE_DIRECT_GRAVITY,
+    FORCE_TYPE_SPRING,
+    FORCE_TYPE_DRAG,
+    FORCE_TYPE_DOWN,
+    FORCE_TYPE_UNIFORM_FIELD,
+    /** The force creator behind create_collision() and friends */
+    FORCE_TYPE_PAIR_COLLISION,
+    FORCE_TYPE_SPRING_NETWORK,
+    FORCE_TYPE_USER = 1024
+} Force_Type_ID;
+
+/**
+ * Registers every force creator this library adds,
+ * including create_spring_network()'s, so scenes built from them can be
+ * saved with scene_save().
+ *
+ * @param registry a pointer returned from force_registry_init()
+ */
+void forces_register_types(Force_Registry *registry);
 
 #endif // #ifndef __FORCES_H__
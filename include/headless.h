@@ -0,0 +1,115 @@
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "scene.h"
+
+/**
+ * Drives scenes without a window, renderer, or fonts,
+ * so simulations can run on machines with no display and without SDL.
+ *
+ * Scenes are built from a plain-text description, one command per line.
+ * Blank lines and lines starting with '#' are ignored.
+ * Bodies are numbered from 0 in the order they are declared,
+ * and force lines refer to bodies by those numbers.
+ * Masses may be "inf" to create immovable bodies.
+ *
+ *   rect <cx> <cy> <width> <height> <mass> [<vx> <vy>]
+ *   circle <cx> <cy> <radius> <mass> [<vx> <vy>]
+ *   gravity <G> <body1> <body2>
+ *   nbody <G> <theta>   (Barnes-Hut gravity between every body declared so far)
+ *   direct <G> <softening>   (direct-sum gravity between every body so far)
+ *   spring <k> <body1> <body2>
+ *   drag <gamma> <body>
+ *   down <g> <body>
+ *   field <ax> <ay> <linear_drag> <quadratic_drag> [<wind_x> <wind_y>]
+ *     (a uniform field acting on every body, whenever it was declared)
+ *   collision <elasticity> <body1> <body2>
+ *   destructive <body1> <body2>
+ *   tag <tag> <body>   (see body_set_tag(); bodies start with tag 0)
+ *   collide <elasticity> <tag1> <tag2>
+ *     (collisions between every pair of bodies with those tags, whenever
+ *     they were declared)
+ *   continuous <body>   (see body_set_continuous())
+ *   integrator default|symplectic|verlet|rk4|adaptive
+ *   adaptive <min_dt> <max_dt> <tolerance>
+ */
+
+/**
+ * Timing results from a headless run.
+ */
+typedef struct {
+    /** The number of calls made to scene_tick() */
+    size_t steps;
+    /** The simulated time passed to each scene_tick() */
+    double dt;
+    /** The wall-clock time spent inside scene_tick(), in seconds */
+    double wall_seconds;
+    /** The average wall-clock time per tick, in nanoseconds */
+    double ns_per_tick;
+    /** The number of bodies left in the scene after the run */
+    size_t bodies;
+    /**
+     * The number of steps the integrator took; more than steps
+     * when the adaptive integrator split ticks up
+     */
+    size_t integrator_steps;
+} Headless_Stats;
+
+/**
+ * Builds a scene from a description read from a stream.
+ * Prints the offending line number to stderr if the description is invalid.
+ *
+ * @param file the stream containing the scene description
+ * @return the new scene, or NULL if the description could not be parsed
+ */
+Scene *headless_parse_scene(FILE *file);
+
+/**
+ * Builds a scene from a description file, or loads a snapshot
+ * written by headless_save_scene().
+ *
+ * @param path the path to the scene description or snapshot
+ * @return the new scene, or NULL if the file could not be opened or parsed
+ */
+Scene *headless_load_scene(const char *path);
+
+/**
+ * Saves a scene as a snapshot (see scene_save()), so a run can be
+ * resumed or forked from where it stopped.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param path the path to write the snapshot to
+ * @return whether the snapshot was written
+ */
+bool headless_save_scene(Scene *scene, const char *path);
+
+/**
+ * Ticks a scene a fixed number of times at a fixed timestep,
+ * measuring the wall-clock time taken.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param dt the time to pass to each scene_tick(), in seconds
+ * @param steps the number of ticks to run
+ * @return the timing of the run
+ */
+Headless_Stats headless_run(Scene *scene, double dt, size_t steps);
+
+/**
+ * Writes the results of a headless run as a single human-readable line.
+ *
+ * @param out the stream to write to
+ * @param stats the results returned by headless_run()
+ */
+void headless_print_stats(FILE *out, Headless_Stats stats);
+
+/**
+ * Gets a monotonic wall-clock timestamp.
+ * Only differences between timestamps are meaningful.
+ *
+ * @return the current time in seconds
+ */
+double headless_wall_time(void);
+
+#endif // #ifndef __HEADLESS_H__
@@ -0,0 +1,118 @@
+#ifndef __INPUT_LOG_H__
+#define __INPUT_LOG_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Recordings of the input a demo received, so a game can be replayed
+ * exactly, e.g. without a display as a benchmark (see sdl_replay_input()).
+ *
+ * A log is plain text, one entry per line, after a "input-log 1" header:
+ *
+ *   dt <seconds>   (what one call to time_since_last_tick() returned)
+ *   key <frame> <key> pressed|released <held_time>
+ *   pointer <frame> <x> <y>   (the mouse position sdl_is_done() returned)
+ *   quit <frame>
+ *
+ * A frame is one call to sdl_is_done(), counted from 0, and entries are
+ * in the order they happened. Frames with no entries had no input,
+ * which is most of them, so they aren't written.
+ * Times are written with enough digits to read back exactly.
+ */
+typedef struct input_log Input_Log;
+
+/** The kinds of input an entry can hold */
+typedef enum {
+    INPUT_KEY,
+    INPUT_POINTER,
+    INPUT_QUIT
+} Input_Type;
+
+/**
+ * One piece of input handled during a frame.
+ */
+typedef struct {
+    Input_Type type;
+    /** For keys, the character passed to the key handler */
+    char key;
+    /** For keys, whether the key was released rather than pressed */
+    bool released;
+    /** For keys, the held time passed to the key handler */
+    double held_time;
+    /** For pointers, the coordinates sdl_is_done() returned */
+    int x;
+    int y;
+} Input_Event;
+
+/**
+ * Starts a log in a file.
+ *
+ * @param file the file to record to
+ */
+void input_log_write_header(FILE *file);
+
+/**
+ * Appends the time a frame took to a log.
+ *
+ * @param file the file being recorded to
+ * @param dt the seconds returned by time_since_last_tick()
+ */
+void input_log_write_dt(FILE *file, double dt);
+
+/**
+ * Appends a piece of input to a log.
+ *
+ * @param file the file being recorded to
+ * @param frame the index of the sdl_is_done() call that handled it
+ * @param event the input
+ */
+void input_log_write_event(FILE *file, size_t frame, Input_Event event);
+
+/**
+ * Reads a whole log for replaying.
+ * Prints the offending line number to stderr if the log is invalid.
+ *
+ * @param file the log, as written by the input_log_write_*() functions
+ * @return the log, or NULL if it couldn't be parsed
+ */
+Input_Log *input_log_read(FILE *file);
+
+/**
+ * Releases a log returned from input_log_read().
+ *
+ * @param log the log
+ */
+void input_log_free(Input_Log *log);
+
+/**
+ * Replays the next time a frame took.
+ *
+ * @param log a log returned from input_log_read()
+ * @param dt where to store the time
+ * @return false if every recorded time has been replayed
+ */
+bool input_log_next_dt(Input_Log *log, double *dt);
+
+/**
+ * Replays the next piece of input handled during a frame.
+ * Frames must be asked about in order; any input left over
+ * from frames before the one asked about is skipped.
+ *
+ * @param log a log returned from input_log_read()
+ * @param frame the index of the current sdl_is_done() call
+ * @param event where to store the input
+ * @return false if there is no more input for this frame
+ */
+bool input_log_next_event(Input_Log *log, size_t frame, Input_Event *event);
+
+/**
+ * Checks whether everything in a log has been replayed.
+ *
+ * @param log a log returned from input_log_read()
+ * @return true once every time and piece of input has been replayed
+ */
+bool input_log_finished(Input_Log *log);
+
+#endif // #ifndef __INPUT_LOG_H__
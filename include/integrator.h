@@ -0,0 +1,147 @@
+#ifndef __INTEGRATOR_H__
+#define __INTEGRATOR_H__
+
+#include <stddef.h>
+
+typedef struct scene Scene;
+typedef struct body Body;
+
+/**
+ * The schemes a scene can use to advance its bodies over a tick.
+ *
+ * INTEGRATOR_DEFAULT ticks every body with body_tick(), which includes the
+ * rotation behavior the demos rely on.
+ * The others integrate the translation of every finite-mass body from the
+ * forces its force creators produce, ignoring torques.
+ * Velocity Verlet evaluates the force creators twice per tick, RK4 four times
+ * and the adaptive scheme at least seven times, so they are meant for scenes
+ * made mostly of forces (gravity, springs, drag): collisions are only
+ * solved once per tick, against the forces at its start.
+ */
+typedef enum {
+    /** body_tick() on every body */
+    INTEGRATOR_DEFAULT,
+    /** v += a dt, then x += v dt; first order, but conserves energy well */
+    INTEGRATOR_SYMPLECTIC_EULER,
+    /** Second order and symplectic; two force evaluations per tick */
+    INTEGRATOR_VELOCITY_VERLET,
+    /** Classic fourth-order Runge-Kutta; four force evaluations per tick */
+    INTEGRATOR_RK4,
+    /**
+     * Dormand-Prince 5(4): splits each tick into as many steps as needed
+     * to keep the estimated local error within the configured tolerance.
+     * See integrator_set_adaptive_config().
+     */
+    INTEGRATOR_ADAPTIVE_RK45
+} Integrator;
+
+/**
+ * Bounds for INTEGRATOR_ADAPTIVE_RK45.
+ */
+typedef struct {
+    /**
+     * The smallest step to take. A step this small is accepted
+     * even if its error estimate exceeds the tolerance.
+     */
+    double min_dt;
+    /** The largest step to take, even if the error estimate allows more */
+    double max_dt;
+    /**
+     * The largest local error to allow per step
+     * in any component of any body's position or velocity
+     */
+    double tolerance;
+} Adaptive_Config;
+
+/**
+ * What INTEGRATOR_ADAPTIVE_RK45 did during the most recent tick.
+ */
+typedef struct {
+    /** The number of steps accepted during the last tick */
+    size_t steps;
+    /** The number of steps retried with a smaller dt during the last tick */
+    size_t rejected;
+    /** The number of steps accepted since the integrator state was created */
+    size_t total_steps;
+    /** The smallest step accepted during the last tick */
+    double smallest_dt;
+    /** The step size the next tick will try first */
+    double next_dt;
+} Adaptive_Stats;
+
+/**
+ * Per-scene integrator storage: reusable per-body buffers, so ticking doesn't
+ * allocate once the scene stops growing, plus the adaptive scheme's settings.
+ */
+typedef struct integrator_state Integrator_State;
+
+/**
+ * Allocates empty integrator storage.
+ * The adaptive scheme starts with min_dt = 1e-9, max_dt = 1e-2
+ * and tolerance = 1e-6.
+ *
+ * @return the new storage
+ */
+Integrator_State *integrator_state_init(void);
+
+/**
+ * Releases integrator storage.
+ *
+ * @param state a pointer returned from integrator_state_init()
+ */
+void integrator_state_free(Integrator_State *state);
+
+/**
+ * Sets the bounds INTEGRATOR_ADAPTIVE_RK45 steps within.
+ * Asserts that 0 < min_dt <= max_dt and that the tolerance is positive.
+ *
+ * @param state a pointer returned from integrator_state_init()
+ * @param config the new bounds
+ */
+void integrator_set_adaptive_config(Integrator_State *state, Adaptive_Config config);
+
+/**
+ * Gets the bounds INTEGRATOR_ADAPTIVE_RK45 steps within.
+ *
+ * @param state a pointer returned from integrator_state_init()
+ * @return the bounds passed to integrator_set_adaptive_config()
+ */
+Adaptive_Config integrator_get_adaptive_config(Integrator_State *state);
+
+/**
+ * Reports the steps INTEGRATOR_ADAPTIVE_RK45 took.
+ *
+ * @param state a pointer returned from integrator_state_init()
+ * @return the statistics from the most recent adaptive tick
+ */
+Adaptive_Stats integrator_get_adaptive_stats(Integrator_State *state);
+
+/**
+ * Advances every body in a scene by one tick.
+ * Expects the force creators to have already been run once for this tick,
+ * so the forces and impulses accumulated on each body are those at the
+ * start of the tick. Resets every body's accumulated forces and impulses.
+ *
+ * @param integrator the scheme to integrate with
+ * @param scene the scene whose bodies to advance
+ * @param dt the length of the tick, in seconds
+ * @param state storage returned from integrator_state_init()
+ */
+void integrator_step(Integrator integrator, Scene *scene, double dt,
+    Integrator_State *state);
+
+/**
+ * Advances a single body over the rest of a tick, e.g. after it has been
+ * moved back to an impact, using the forces and impulses accumulated on it.
+ * INTEGRATOR_DEFAULT uses body_tick(); the others take one symplectic Euler
+ * step, as they would with no other body to evaluate forces against.
+ * The body's previous transform is left alone.
+ * Resets the body's accumulated forces and impulses.
+ *
+ * @param integrator the scheme the body's scene integrates with
+ * @param body the body to advance
+ * @param dt the time left in the tick, in seconds
+ */
+void integrator_step_body(Integrator integrator, Body *body, double dt);
+
+#endif // #ifndef __INTEGRATOR_H__
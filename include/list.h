@@ -8,7 +8,7 @@
 
 /**
  * A function that can be called on list elements to release their resources.
- * Examples: free, body_free
+ * Examples: allocator_free, body_free
  */
 typedef void (*FreeFunc)(void *data);
 
@@ -4,6 +4,16 @@
 #include "list.h"
 #include "vector.h"
 
+/**
+ * An axis-aligned bounding box.
+ */
+typedef struct {
+    /** The corner with the smallest coordinates */
+    Vector min;
+    /** The corner with the largest coordinates */
+    Vector max;
+} AABB;
+
 /**
  * Computes the area of a polygon.
  * See https://en.wikipedia.org/wiki/Shoelace_formula#Statement.
@@ -46,4 +56,70 @@ void polygon_translate(List *polygon, Vector translation);
  */
 void polygon_rotate(List *polygon, double angle, Vector point);
 
+/**
+ * Allocates an axis-aligned rectangle as a counterclockwise vertex list.
+ * The returned list owns its vertices and must be list_free()d.
+ *
+ * @param center the centroid of the rectangle
+ * @param width the extent of the rectangle along the x-axis
+ * @param height the extent of the rectangle along the y-axis
+ * @return the vertices of the rectangle
+ */
+List *polygon_rectangle(Vector center, double width, double height);
+
+/**
+ * Allocates a regular polygon approximating a circle,
+ * as a counterclockwise vertex list.
+ * The returned list owns its vertices and must be list_free()d.
+ *
+ * @param center the center of the circle
+ * @param radius the distance from the center to each vertex
+ * @param num_points the number of vertices; must be at least 3
+ * @return the vertices of the polygon
+ */
+List *polygon_circle(Vector center, double radius, size_t num_points);
+
+/**
+ * Computes the smallest axis-aligned box containing a polygon.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ * @return the polygon's bounding box
+ */
+AABB polygon_bounds(List *polygon);
+
+/**
+ * Returns whether a point lies inside a convex polygon or on its boundary.
+ * The vertices may go either way around.
+ *
+ * @param polygon the list of vertices that make up the polygon
+ * @param point the point to test
+ * @return whether the polygon contains the point
+ */
+bool polygon_contains(List *polygon, Vector point);
+
+/**
+ * Splits a simple polygon into triangles, e.g. for drawing.
+ * Convex polygons are fanned out from their first vertex;
+ * other polygons are split by ear clipping. Never allocates.
+ * The vertices may go either way around.
+ *
+ * @param polygon the list of vertices that make up the polygon;
+ *   there must be at least 3
+ * @param triangles where to store the triangles, as 3 indices into the
+ *   polygon each; must have room for 3 * (list_size(polygon) - 2)
+ * @param scratch room for list_size(polygon) indices, for ear clipping to
+ *   work in; its contents afterwards are meaningless
+ * @return the number of triangles, which is list_size(polygon) - 2
+ */
+size_t polygon_triangulate(List *polygon, size_t *triangles, size_t *scratch);
+
+/**
+ * Returns whether two axis-aligned boxes overlap, including touching edges.
+ *
+ * @param box1 the first box
+ * @param box2 the second box
+ * @return whether the boxes share any point
+ */
+bool aabb_overlap(AABB box1, AABB box2);
+
 #endif // #ifndef __POLYGON_H__
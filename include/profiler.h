@@ -0,0 +1,189 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "scene.h"
+
+/**
+ * Timers around each phase of scene_tick() and of rendering, for finding
+ * where a frame's time goes.
+ *
+ * The engine is instrumented with the PROFILE_*() macros below, which
+ * only do anything when it is built with "make PROFILE=1" (which defines
+ * PROFILE); otherwise they compile to nothing. Even then nothing is
+ * recorded until profiler_start() is called.
+ *
+ * Records go into two fixed-size ring buffers: one span per phase run,
+ * and one summary per tick. The thread ticking the scene is the only
+ * writer, and one other thread at a time may read, without locks.
+ * A full buffer drops new records (see profiler_dropped()), so read
+ * them often enough, or make the buffers big enough for the whole run.
+ */
+
+/**
+ * The parts of a tick, and rendering.
+ * Phases nest: a tick contains the rest, and the force creators of
+ * multi-stage integrators run inside PHASE_INTEGRATION.
+ */
+typedef enum {
+    /** The whole of scene_tick() */
+    PHASE_TICK,
+    /** Running the force creators (see scene_apply_forces()) */
+    PHASE_FORCES,
+    /** The force creators of one ForceCreator function, within PHASE_FORCES */
+    PHASE_FORCE_TYPE,
+    /** Finding touching bodies and solving their collisions */
+    PHASE_COLLISIONS,
+    /** Applying the command buffer at the tick's sync points */
+    PHASE_COMMANDS,
+    /** Freeing removed bodies and their force creators */
+    PHASE_REMOVAL,
+    /** Moving the bodies with the scene's integrator */
+    PHASE_INTEGRATION,
+    /** Continuous collision detection for fast bodies */
+    PHASE_IMPACTS,
+    /** Turning contacts into collision events and calling tick listeners */
+    PHASE_EVENTS,
+    /** Drawing a scene (see sdl_render_scene()) */
+    PHASE_RENDER,
+    NUM_PHASES
+} Profile_Phase;
+
+/**
+ * One run of a phase.
+ */
+typedef struct {
+    Profile_Phase phase;
+    /** For PHASE_FORCE_TYPE, the function whose force creators ran */
+    ForceCreator creator;
+    /** For PHASE_FORCE_TYPE, how many of its force creators ran */
+    size_t calls;
+    /** The number of ticks finished before this span started */
+    size_t tick;
+    /** When the phase started, in seconds (see headless_wall_time()) */
+    double start;
+    /** How long it took, in seconds */
+    double duration;
+} Profile_Span;
+
+/**
+ * A summary of one tick.
+ */
+typedef struct {
+    /** The number of ticks finished before this one */
+    size_t tick;
+    double start;
+    double duration;
+    /** The time spent in each phase, summed over its runs in the tick */
+    double phase_time[NUM_PHASES];
+    /** The pairs of shapes tested for overlap by find_collision() */
+    size_t narrowphase_tests;
+    /** The calls to malloc(), calloc() and realloc(), on any thread */
+    size_t allocations;
+} Profile_Tick;
+
+#ifdef PROFILE
+/** Starts timing a phase on this thread. */
+#define PROFILE_BEGIN(phase) profiler_begin(phase)
+/** Stops timing the phase most recently begun, which must be this one. */
+#define PROFILE_END(phase) profiler_end(phase)
+/** Stops timing a PHASE_FORCE_TYPE span, counting it towards its function. */
+#define PROFILE_END_FORCE(creator) profiler_end_force(creator)
+/** Counts narrowphase tests towards the current tick. */
+#define PROFILE_NARROWPHASE() profiler_count_narrowphase()
+#else
+#define PROFILE_BEGIN(phase) ((void) 0)
+#define PROFILE_END(phase) ((void) 0)
+#define PROFILE_END_FORCE(creator) ((void) 0)
+#define PROFILE_NARROWPHASE() ((void) 0)
+#endif
+
+/**
+ * Starts recording, with empty buffers of the given sizes.
+ * Asserts that the profiler isn't already recording.
+ *
+ * @param span_capacity the most spans the buffer can hold before they are read
+ * @param tick_capacity the most tick summaries it can hold
+ */
+void profiler_start(size_t span_capacity, size_t tick_capacity);
+
+/**
+ * Stops recording and frees the buffers, with anything still in them.
+ * Must not be called while a phase is being timed.
+ */
+void profiler_stop(void);
+
+/**
+ * Whether the profiler is recording.
+ *
+ * @return whether profiler_start() has been called without profiler_stop()
+ */
+bool profiler_recording(void);
+
+/**
+ * Takes the oldest span out of the buffer.
+ *
+ * @param span where to store it
+ * @return whether there was one to take
+ */
+bool profiler_read_span(Profile_Span *span);
+
+/**
+ * Takes the oldest tick summary out of the buffer.
+ *
+ * @param tick where to store it
+ * @return whether there was one to take
+ */
+bool profiler_read_tick(Profile_Tick *tick);
+
+/**
+ * Counts the records dropped because a buffer was full.
+ *
+ * @return the spans and tick summaries dropped since profiler_start()
+ */
+size_t profiler_dropped(void);
+
+/**
+ * Takes everything out of the buffers and writes it in the Chrome trace
+ * event format, for chrome://tracing or https://ui.perfetto.dev.
+ * Spans become complete events (ph "X"), with force creator functions
+ * named by address (resolve them with addr2line), and each tick's counts
+ * become counter events (ph "C").
+ *
+ * @param out the stream to write to
+ */
+void profiler_write_chrome_trace(FILE *out);
+
+/**
+ * Starts timing a phase; see PROFILE_BEGIN().
+ * Does nothing unless recording.
+ *
+ * @param phase the phase
+ */
+void profiler_begin(Profile_Phase phase);
+
+/**
+ * Stops timing a phase; see PROFILE_END().
+ * Does nothing unless recording.
+ *
+ * @param phase the phase, which must be the one most recently begun
+ */
+void profiler_end(Profile_Phase phase);
+
+/**
+ * Stops timing a PHASE_FORCE_TYPE span; see PROFILE_END_FORCE().
+ * The time is added to its function's total for the enclosing PHASE_FORCES,
+ * which records one span per function when it ends.
+ *
+ * @param creator the force creator function that just ran
+ */
+void profiler_end_force(ForceCreator creator);
+
+/**
+ * Counts a narrowphase test; see PROFILE_NARROWPHASE().
+ */
+void profiler_count_narrowphase(void);
+
+#endif // #ifndef __PROFILER_H__
@@ -0,0 +1,74 @@
+#ifndef __QUADTREE_H__
+#define __QUADTREE_H__
+
+#include <stddef.h>
+#include "vector.h"
+
+/**
+ * A Barnes-Hut quadtree over a set of point masses.
+ * Each node stores the total mass and center of mass of the points inside it,
+ * so the gravitational field of a distant cluster can be approximated by
+ * a single point mass. Building the tree is O(n log n) for evenly spread
+ * points, as is querying the field at every point.
+ *
+ * A tree keeps its nodes between builds, so rebuilding it every tick
+ * only allocates when the tree needs more nodes than it has ever had.
+ */
+typedef struct quadtree Quadtree;
+
+/**
+ * Allocates an empty quadtree.
+ *
+ * @return the new quadtree
+ */
+Quadtree *quadtree_init(void);
+
+/**
+ * Releases a quadtree.
+ *
+ * @param tree a pointer returned from quadtree_init()
+ */
+void quadtree_free(Quadtree *tree);
+
+/**
+ * Rebuilds a quadtree around a set of point masses, replacing its contents.
+ * The tree refers to the arrays rather than copying them,
+ * so they must not change until the tree is next rebuilt.
+ *
+ * @param tree a pointer returned from quadtree_init()
+ * @param positions the position of each point
+ * @param masses the mass of each point; each must be finite
+ * @param n the number of points
+ */
+void quadtree_build(Quadtree *tree, const Vector *positions, const double *masses,
+    size_t n);
+
+/**
+ * Gets the number of nodes in a quadtree.
+ *
+ * @param tree a pointer returned from quadtree_init()
+ * @return the number of nodes used by the last quadtree_build()
+ */
+size_t quadtree_nodes(Quadtree *tree);
+
+/**
+ * Computes the gravitational field at one of the points a tree was built from,
+ * due to every other point: the sum of m_j (x_j - x_i) / |x_j - x_i|^3.
+ * Multiply by G and the point's mass to get the force on it.
+ *
+ * A node is approximated by its center of mass when its width divided by
+ * its distance from the point is less than theta, unless the node contains
+ * the point. theta = 0 sums every pair exactly; 0.5 is a common compromise
+ * between speed and accuracy.
+ *
+ * @param tree a pointer to a quadtree built with quadtree_build()
+ * @param index the index of the point to compute the field at
+ * @param theta the opening angle
+ * @param min_distance masses closer than this to the point are ignored,
+ *   since the field blows up as the distance goes to 0
+ * @return the field at the point
+ */
+Vector quadtree_field(Quadtree *tree, size_t index, double theta,
+    double min_distance);
+
+#endif // #ifndef __QUADTREE_H__
@@ -0,0 +1,109 @@
+#ifndef __RECORDER_H__
+#define __RECORDER_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "scene.h"
+
+/**
+ * Recording where every body in a scene is after each tick, for analysing
+ * runs offline, and reading the recordings back.
+ *
+ * A recording is a header followed by chunks of frames, one frame per tick.
+ * Positions and angles are rounded to multiples of a quantum, and most
+ * frames store only how far each body moved, in quanta, since the frame
+ * before, as variable-length integers. Keyframes store where each body is;
+ * every chunk starts with one, and so does every frame where the number
+ * of bodies changed. Bodies are identified by their index in the scene.
+ *
+ * Encoding happens during the tick, but chunks are written to the file
+ * by a background thread, so the simulation never waits on the disk.
+ * Numbers are written little-endian, whatever the machine.
+ */
+typedef struct recorder Recorder;
+
+/**
+ * How precisely to record, and how often to write.
+ */
+typedef struct {
+    /** The distance positions are rounded to a multiple of */
+    double position_quantum;
+    /** The angle, in radians, angles are rounded to a multiple of */
+    double angle_quantum;
+    /** The most frames between keyframes */
+    size_t keyframe_interval;
+    /** How many bytes of frames to gather before passing them to the writer */
+    size_t chunk_size;
+} Recorder_Config;
+
+/**
+ * Starts recording a scene after each of its ticks (see scene_add_tick_listener()).
+ * Asserts that the quanta, interval and chunk size are positive.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param file the file to record to, opened for binary writing;
+ *   the recorder writes to it from its own thread until it is freed
+ * @param config the precision and chunking
+ * @return the new recorder
+ */
+Recorder *recorder_init(Scene *scene, FILE *file, Recorder_Config config);
+
+/**
+ * Stops recording, waits for everything recorded to reach the file,
+ * and releases the recorder. The file is flushed but not closed.
+ * This must happen before the scene is freed.
+ *
+ * @param recorder a pointer returned from recorder_init()
+ * @return whether every frame was written
+ */
+bool recorder_free(Recorder *recorder);
+
+/**
+ * Reads recordings written by a Recorder, a frame at a time.
+ */
+typedef struct trajectory Trajectory;
+
+/**
+ * Where every body was after one tick.
+ */
+typedef struct {
+    /** The number of ticks recorded before this one */
+    size_t tick;
+    /** The sum of the dts of the ticks up to and including this one */
+    double time;
+    /** The number of bodies in the scene */
+    size_t num_bodies;
+    /** Each body's centroid, rounded to the position quantum */
+    Vector *positions;
+    /** Each body's angle, rounded to the angle quantum */
+    double *angles;
+} Trajectory_Frame;
+
+/**
+ * Starts reading a recording.
+ *
+ * @param file the recording, opened for binary reading
+ * @return the new reader, or NULL if the file doesn't start with
+ *   a recording header of this version
+ */
+Trajectory *trajectory_open(FILE *file);
+
+/**
+ * Reads the next frame of a recording.
+ *
+ * @param trajectory a pointer returned from trajectory_open()
+ * @param frame where to store the frame; its arrays belong to the reader
+ *   and are only valid until the next call
+ * @return true if a frame was read, or false at the end of the recording
+ *   or if the rest of it is corrupt
+ */
+bool trajectory_next_frame(Trajectory *trajectory, Trajectory_Frame *frame);
+
+/**
+ * Releases a reader. The file is not closed.
+ *
+ * @param trajectory a pointer returned from trajectory_open()
+ */
+void trajectory_close(Trajectory *trajectory);
+
+#endif // #ifndef __RECORDER_H__
@@ -0,0 +1,55 @@
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A seeded pseudo-random number generator.
+ * Unlike rand(), every generator has its own state and produces the same
+ * sequence from the same seed on every machine and C library, so a game
+ * seeded with a fixed value (or one saved with a replay) plays out the same.
+ * Generators are small values, copied and stored like Vectors.
+ */
+typedef struct {
+    uint64_t state;
+} Rng;
+
+/**
+ * Starts a generator.
+ *
+ * @param seed the seed; any value, including 0, is fine
+ * @return the generator
+ */
+Rng rng_init(uint64_t seed);
+
+/**
+ * Generates a uniformly distributed 64-bit integer.
+ *
+ * @param rng the generator, which is advanced
+ * @return the integer
+ */
+uint64_t rng_next(Rng *rng);
+
+/**
+ * Generates a number uniformly distributed in [min, max).
+ *
+ * @param rng the generator, which is advanced
+ * @param min the smallest value that can be generated
+ * @param max the bound above every value that can be generated
+ * @return the number
+ */
+double rng_double(Rng *rng, double min, double max);
+
+/**
+ * Generates an index uniformly distributed in [0, n), without the bias
+ * towards small values of rng_next() % n.
+ * Asserts that n is positive.
+ *
+ * @param rng the generator, which is advanced
+ * @param n the number of possible indices
+ * @return the index
+ */
+size_t rng_index(Rng *rng, size_t n);
+
+#endif // #ifndef __RNG_H__
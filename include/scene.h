@@ -2,8 +2,12 @@
 #define __SCENE_H__
 
 #include <stdbool.h>
+#include "allocator.h"
 #include "body.h"
+#include "collision.h"
+#include "integrator.h"
 #include "list.h"
+#include "polygon.h"
 
 /**
  * A collection of bodies and force creators.
@@ -21,10 +25,47 @@ typedef struct instance_force Instance_Force;
  */
 typedef void (*ForceCreator)(void *aux);
 
+/**
+ * What the scene does to two bodies it finds touching.
+ * Responses are data rather than callbacks, so the tick's solver applies
+ * them itself; anything else that should happen when bodies touch
+ * reacts to collision events after the tick (see scene_add_collision_events()).
+ */
+typedef enum {
+    /**
+     * Pushes the bodies apart along the collision axis, bouncing them off
+     * each other with the response's elasticity. Bodies resting on each
+     * other are held up. Hard hits set the bodies spinning.
+     */
+    COLLISION_PHYSICS,
+    /** Like COLLISION_PHYSICS with no bounce, and without the spin */
+    COLLISION_INELASTIC,
+    /** Stops body1 where it is for good; see body_set_stop() */
+    COLLISION_STOP,
+    /** Removes both bodies */
+    COLLISION_DESTRUCTIVE,
+    /** Removes body2 */
+    COLLISION_SEMIDESTRUCTIVE
+} Collision_Response_Type;
+
+/**
+ * A collision response and its parameters.
+ */
+typedef struct {
+    Collision_Response_Type type;
+    /**
+     * For COLLISION_PHYSICS, the "coefficient of restitution";
+     * 0 is a perfectly inelastic collision and 1 is a perfectly elastic one
+     */
+    double elasticity;
+} Collision_Response;
+
 /**
  * Allocates memory for an empty scene.
  * Makes a reasonable guess of the number of bodies to allocate space for.
  * Asserts that the required memory is successfully allocated.
+ * Memory comes from the engine allocator, so to count a scene's allocations
+ * install a tracker with allocator_set() before making it.
  *
  * @return the new scene
  */
@@ -58,8 +99,45 @@ size_t scene_bodies(Scene *scene);
  */
 Body *scene_get_body(Scene *scene, size_t index);
 
+/**
+ * Counts the bodies in a scene with a given tag (see body_set_tag()),
+ * without looking at any other bodies.
+ * Bodies are filed by tag when they are added, and refiled as soon as
+ * they are retagged, so force creators should not retag bodies.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param tag the tag to look up, less than NUM_TAGS
+ * @return the number of bodies filed under the tag
+ */
+size_t scene_tagged_bodies(Scene *scene, size_t tag);
+
+/**
+ * Moves a body in a scene from the list of bodies with its old tag to the
+ * list with its current one. body_set_tag() calls this itself.
+ *
+ * @param scene the scene filing the body
+ * @param body a body in the scene, whose tag has just changed
+ * @param old_tag the tag it was filed under
+ */
+void scene_refile_body(Scene *scene, Body *body, size_t old_tag);
+
+/**
+ * Gets one of the bodies in a scene with a given tag.
+ * Bodies are added to the end of their tag's list, and a body leaving
+ * the list is replaced by the last one, so the order is otherwise arbitrary.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param tag the tag to look up, less than NUM_TAGS
+ * @param index the index of the body among those with the tag,
+ *   less than scene_tagged_bodies()
+ * @return a pointer to the body
+ */
+Body *scene_get_tagged_body(Scene *scene, size_t tag, size_t index);
+
 /**
  * Adds a body to a scene.
+ * Called from a force creator while the scene is ticking,
+ * the body joins at the tick's next sync point (see scene_tick()).
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param body a pointer to the body to add to the scene
@@ -77,8 +155,25 @@ void scene_add_body(Scene *scene, Body *body);
  */
 void scene_remove_body(Scene *scene, size_t index);
 
+/**
+ * Removes and frees the body at a given index from a scene.
+ * While the scene is ticking, this only marks the body for removal.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index the index of the body in the scene (starting at 0)
+ */
 void scene_free_body(Scene *scene, size_t index);
 
+/**
+ * Replaces the body at a given index, without freeing the old one.
+ * While the scene is ticking, the replacement waits for the next sync point
+ * and then replaces the same body wherever it has moved to
+ * (or is added, if that body was freed in the meantime).
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index the index of the body in the scene (starting at 0)
+ * @param b the body to put in its place
+ */
 void scene_set_body(Scene *scene, size_t index, Body *b);
 
 /**
@@ -95,6 +190,8 @@ void scene_add_force_creator(
  * The auxiliary value is passed to the force creator each time it is called.
  * The force creator is registered with a list of bodies it applies to,
  * so it can be removed when any one of the bodies is removed.
+ * Force creators and collision table entries added while the scene is ticking
+ * take effect from the tick's next sync point.
  *
  * @param scene a pointer to a scene returned from scene_init()
  * @param forcer a force creator function
@@ -108,13 +205,392 @@ void scene_add_bodies_force_creator(
     Scene *scene, ForceCreator forcer, void *aux, List *bodies, FreeFunc freer
 );
 
+/**
+ * Adds a force creator acting on a group of bodies that outlives any one
+ * of them, like gravity between particles. Unlike
+ * scene_add_bodies_force_creator(), removing a body from the scene
+ * takes it out of the group instead of removing the force creator,
+ * before the body is freed. Bodies can be added to the group at any time,
+ * so the force creator should not assume its size stays the same.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param forcer a force creator function
+ * @param aux an auxiliary value to pass to forcer when it is called
+ * @param group the list of bodies the force creator acts on.
+ *   The scene takes ownership of this list, which should not own the bodies.
+ * @param freer if non-NULL, a function to call in order to free aux
+ */
+void scene_add_group_force_creator(
+    Scene *scene, ForceCreator forcer, void *aux, List *group, FreeFunc freer
+);
+
+/**
+ * Gets the number of force creators in a scene.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the number of force creators, in the order they were added
+ */
+size_t scene_force_creators(Scene *scene);
+
+/**
+ * Gets one of the force creators in a scene.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index the index of the force creator, less than scene_force_creators()
+ * @param aux where to store the auxiliary value it is called with
+ * @return the force creator function
+ */
+ForceCreator scene_get_force_creator(Scene *scene, size_t index, void **aux);
+
+/**
+ * Adds a collision response between two groups of bodies, chosen by tag
+ * (see body_set_tag()). On every scene_tick(), after the force creators run,
+ * each pair of touching bodies where one has a tag in mask1 and the other
+ * a tag in mask2 is given the response, body1 being the one from mask1.
+ * Bodies can opt out of collisions with some tags with
+ * body_set_collision_mask().
+ *
+ * Candidate pairs come from a broadphase over the bodies' bounding boxes,
+ * which only considers the tags some entry pairs up,
+ * so this costs far less than one create_collision() per pair of bodies.
+ * The touching pairs are gathered first and then solved together,
+ * so no response sees another half-applied. The table entry
+ * stays for the life of the scene.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param mask1 the TAG_MASK()s of the first group's tags
+ * @param mask2 the TAG_MASK()s of the second group's tags
+ * @param response what to do whenever two such bodies are touching
+ */
+void scene_add_collision_response(Scene *scene, uint32_t mask1, uint32_t mask2,
+    Collision_Response response);
+
+/**
+ * Gets the number of entries in a scene's collision table: the responses
+ * from scene_add_collision_response() and the filters from
+ * scene_add_collision_events(), in the order they were added.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the number of entries
+ */
+size_t scene_collision_entries(Scene *scene);
+
+/**
+ * Gets one of the entries in a scene's collision table.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index the index of the entry, less than scene_collision_entries()
+ * @param mask1 where to store the first group's TAG_MASK()s
+ * @param mask2 where to store the second group's TAG_MASK()s
+ * @param response where to store the entry's response, if it has one
+ * @return whether the entry is a response, rather than an event filter
+ */
+bool scene_get_collision_entry(Scene *scene, size_t index,
+    uint32_t *mask1, uint32_t *mask2, Collision_Response *response);
+
+/**
+ * Reports that two bodies are touching, for the scene to respond to along
+ * with the pairs its collision table finds. Meant for force creators that
+ * test a pair of bodies themselves, like create_collision()'s. Only the
+ * tick's first pass over the force creators counts, so pairs reported
+ * again while a multi-stage integrator re-evaluates forces are ignored.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param body1 the first body
+ * @param body2 the second body
+ * @param info how they overlap, as find_collision() found for their shapes
+ * @param response what to do about it
+ */
+void scene_add_collision(Scene *scene, Body *body1, Body *body2, CollisionInfo info,
+    Collision_Response response);
+
+/**
+ * How a pair of bodies' contact changed over a tick.
+ */
+typedef enum {
+    /** The bodies started touching */
+    COLLISION_BEGIN,
+    /** The bodies were touching last tick too */
+    COLLISION_PERSIST,
+    /** The bodies touched last tick but not this one */
+    COLLISION_END
+} Collision_Phase;
+
+/**
+ * A change in the contact between two bodies, reported by scene_tick().
+ */
+typedef struct {
+    Collision_Phase phase;
+    /** The body with a tag in the first mask given to scene_add_collision_events() */
+    Body *body1;
+    /** The body with a tag in the second mask */
+    Body *body2;
+    /** A unit vector pointing from body1 towards body2, as last seen touching */
+    Vector axis;
+} Collision_Event;
+
+/**
+ * Asks the scene to report when bodies in two groups, chosen by tag,
+ * begin touching, keep touching, and stop touching.
+ * Each scene_tick() compares the pairs touching with the last tick's
+ * and queues an event for every pair that began, persisted or ended,
+ * which the application reads after the tick and then clears.
+ * Nothing is called while the tick is solving, so reacting to an event
+ * (say, removing or recoloring a body) never disturbs the rest of the tick.
+ *
+ * A pair covered by more than one such call is reported once,
+ * ordered by the first call. Events never mention a body once it has been
+ * freed: a pair that ends because one of its bodies was removed has no
+ * end event, and any queued events about that body are dropped.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param mask1 the TAG_MASK()s of the first group's tags
+ * @param mask2 the TAG_MASK()s of the second group's tags
+ */
+void scene_add_collision_events(Scene *scene, uint32_t mask1, uint32_t mask2);
+
+/**
+ * Counts the collision events queued since the last
+ * scene_clear_collision_events(), across however many ticks.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the number of events queued
+ */
+size_t scene_collision_events(Scene *scene);
+
+/**
+ * Gets one of the queued collision events, oldest first.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param index the index of the event, less than scene_collision_events()
+ * @return the event
+ */
+Collision_Event scene_get_collision_event(Scene *scene, size_t index);
+
+/**
+ * Empties the collision event queue once the application has read it.
+ * Events pile up until this is called, so a scene with event filters
+ * should have it called after every batch of ticks.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+void scene_clear_collision_events(Scene *scene);
+
+/**
+ * Where a ray cast with scene_raycast() enters a body.
+ */
+typedef struct {
+    /** The body hit */
+    Body *body;
+    /** The point where the ray enters the body */
+    Vector point;
+    /** The unit normal of the body's edge at that point, pointing outwards */
+    Vector normal;
+    /** How far along the ray the point is */
+    double distance;
+} Raycast_Hit;
+
+/*
+ * The queries below find bodies by position without checking every body.
+ * They search an index of the bodies' bounding boxes that is brought up to
+ * date on the first query after a tick or a change to the scene's bodies,
+ * working out again only the boxes of the bodies that moved. So a body
+ * moved directly (e.g. with body_set_centroid()) is found at its new
+ * position only after the next tick. Bodies marked for removal are
+ * never found. None of them allocate memory after the first query, and
+ * each only finds bodies whose tag (see body_set_tag()) is in tag_mask.
+ */
+
+/**
+ * Finds the first body a ray hits. Rays starting inside a body ignore it.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param origin where the ray starts
+ * @param direction the direction the ray points in; need not be a unit vector
+ * @param max_distance how far the ray goes; may be INFINITY
+ * @param tag_mask the TAG_MASK()s of the bodies to find, or ALL_TAGS
+ * @param hit where to store the nearest hit, if there is one
+ * @return whether the ray hit any body
+ */
+bool scene_raycast(Scene *scene, Vector origin, Vector direction,
+    double max_distance, uint32_t tag_mask, Raycast_Hit *hit);
+
+/**
+ * Finds every body a ray hits, nearest first.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param origin where the ray starts
+ * @param direction the direction the ray points in; need not be a unit vector
+ * @param max_distance how far the ray goes; may be INFINITY
+ * @param tag_mask the TAG_MASK()s of the bodies to find, or ALL_TAGS
+ * @param hits where to store the nearest hits
+ * @param max_hits the most hits to store
+ * @return the number of bodies the ray hit, which may be more than max_hits
+ */
+size_t scene_raycast_all(Scene *scene, Vector origin, Vector direction,
+    double max_distance, uint32_t tag_mask, Raycast_Hit *hits, size_t max_hits);
+
+/**
+ * Finds the bodies containing a point.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param point the point to look under
+ * @param tag_mask the TAG_MASK()s of the bodies to find, or ALL_TAGS
+ * @param bodies where to store the bodies found, in no particular order
+ * @param max_bodies the most bodies to store
+ * @return the number of bodies found, which may be more than max_bodies
+ */
+size_t scene_query_point(Scene *scene, Vector point, uint32_t tag_mask,
+    Body **bodies, size_t max_bodies);
+
+/**
+ * Finds the bodies whose bounding boxes overlap a box.
+ * This is cheaper than scene_query_shape() but includes
+ * bodies that only come near the box.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param box the region to search
+ * @param tag_mask the TAG_MASK()s of the bodies to find, or ALL_TAGS
+ * @param bodies where to store the bodies found, in no particular order
+ * @param max_bodies the most bodies to store
+ * @return the number of bodies found, which may be more than max_bodies
+ */
+size_t scene_query_box(Scene *scene, AABB box, uint32_t tag_mask,
+    Body **bodies, size_t max_bodies);
+
+/**
+ * Finds the bodies that overlap a convex polygon, as find_collision() tests.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param shape the polygon to search under; not modified
+ * @param tag_mask the TAG_MASK()s of the bodies to find, or ALL_TAGS
+ * @param bodies where to store the bodies found, in no particular order
+ * @param max_bodies the most bodies to store
+ * @return the number of bodies found, which may be more than max_bodies
+ */
+size_t scene_query_shape(Scene *scene, List *shape, uint32_t tag_mask,
+    Body **bodies, size_t max_bodies);
+
+/**
+ * Chooses how a scene advances its bodies in scene_tick().
+ * Scenes start with INTEGRATOR_DEFAULT.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param integrator the integration scheme to use from now on
+ */
+void scene_set_integrator(Scene *scene, Integrator integrator);
+
+/**
+ * Gets the integration scheme a scene uses.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the integrator passed to scene_set_integrator()
+ */
+Integrator scene_get_integrator(Scene *scene);
+
+/**
+ * Sets the step-size bounds and error tolerance
+ * a scene uses with INTEGRATOR_ADAPTIVE_RK45.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param config the bounds to step within; see Adaptive_Config
+ */
+void scene_set_adaptive_config(Scene *scene, Adaptive_Config config);
+
+/**
+ * Gets the settings of a scene's adaptive integrator.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the settings given to scene_set_adaptive_config(), or the defaults
+ */
+Adaptive_Config scene_get_adaptive_config(Scene *scene);
+
+/**
+ * Reports how many steps INTEGRATOR_ADAPTIVE_RK45 split the last tick into.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the adaptive integrator's statistics for the most recent tick
+ */
+Adaptive_Stats scene_get_adaptive_stats(Scene *scene);
+
+/**
+ * Gets the length of the tick in progress, for force creators that
+ * depend on the timestep (such as implicit springs).
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @return the dt passed to the current or most recent scene_tick(),
+ *   or 0 before the first tick
+ */
+double scene_get_tick_dt(Scene *scene);
+
+/**
+ * A function called at the end of every scene_tick(), once removed bodies
+ * are gone and deferred changes have been applied, e.g. to record the scene.
+ *
+ * @param scene the scene that was ticked
+ * @param aux the auxiliary value passed to scene_add_tick_listener()
+ */
+typedef void (*TickListener)(Scene *scene, void *aux);
+
+/**
+ * Adds a function to call at the end of every tick, after those added before it.
+ * The scene doesn't own the auxiliary value.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param listener the function to call
+ * @param aux an auxiliary value to pass to it
+ */
+void scene_add_tick_listener(Scene *scene, TickListener listener, void *aux);
+
+/**
+ * Stops calling a function added by scene_add_tick_listener().
+ * Listeners can't be removed while they are being called.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param listener the function
+ * @param aux the auxiliary value it was added with
+ */
+void scene_remove_tick_listener(Scene *scene, TickListener listener, void *aux);
+
+/**
+ * Runs every force creator in a scene once, in the order they were added.
+ * Forces accumulate on the bodies until they are next ticked.
+ * scene_tick() calls this itself; multi-stage integrators call it again
+ * to evaluate forces at intermediate states.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ */
+void scene_apply_forces(Scene *scene);
+
 /**
  * Executes a tick of a given scene over a small time interval.
- * This requires executing all the force creators
- * and then ticking each body (see body_tick()).
+ * This requires executing all the force creators, solving the collisions
+ * they and the collision table find, and then ticking each body
+ * (see body_tick()).
  * If any bodies are marked for removal, they should be removed from the scene
  * and freed, along with any force creators acting on them.
  *
+ * Collisions are solved in two phases. Finding them only gathers the
+ * touching pairs and their responses; the solver then applies impulses
+ * straight to the bodies' velocities, a few passes over every pair so that
+ * stacked bodies settle together, aiming each pair at the velocity the
+ * forces on it would give it by the end of the tick. So resting contact
+ * holds without the bodies' forces being switched off.
+ *
+ * Bodies, force creators and collision table entries added (or bodies
+ * replaced) by force creators during the tick are held in a command
+ * buffer, so nothing the tick is iterating over changes under it.
+ * The buffer is applied, in order, at two sync points: once the force
+ * creators have run and collisions are solved, before removed bodies are freed,
+ * and at the end of the tick for anything asked for while integrating.
+ * Tick listeners (see scene_add_tick_listener()) are called last.
+ *
+ * Ticks are deterministic: bodies, colliding pairs, impacts and events are
+ * visited in orders that depend only on body indices and the order things
+ * were added, never on where bodies were allocated. So two scenes built
+ * the same way tick to bit-identical states in the same binary
+ * (build with "make DETERMINISTIC=1" to also rule out compiler differences).
+ *
  * @param scene a pointer to a scene returned from scene_init()
  * @param dt the time elapsed since the last tick, in seconds
  */
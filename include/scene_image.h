@@ -0,0 +1,72 @@
+#ifndef __SCENE_IMAGE_H__
+#define __SCENE_IMAGE_H__
+
+#include <stdbool.h>
+#include "scene.h"
+#include "snapshot.h"
+
+/**
+ * Scene images: a level saved in the layout it is used in, so loading it
+ * maps the file into memory instead of parsing it and allocating every vertex.
+ *
+ * An image holds no pointers. After a header come a table of bodies, one flat
+ * array of every body's vertices, the force creators and collision table
+ * (encoded as by scene_save_forces()), and the bodies' text.
+ * Bodies refer to their vertices and text by offset.
+ *
+ * The file is mapped copy-on-write, and a loaded scene's bodies use the mapped
+ * vertices and text in place, so moving them never changes the file.
+ * That memory belongs to the image, so an image can be loaded only once,
+ * and must stay mapped until the scene it was loaded into is freed.
+ * Bodies' info is not saved.
+ *
+ * Images are written in the machine's own byte order and struct layout,
+ * so they are a cache for the machine that wrote them; use scene_save()
+ * for files that move between machines.
+ */
+typedef struct scene_image Scene_Image;
+
+/** The format version scene_image_save() writes; scene_image_map() rejects any other */
+#define SCENE_IMAGE_VERSION 2
+
+/**
+ * Writes a scene as an image.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param path the file to write
+ * @param registry the registry covering every force creator in the scene
+ * @return whether the image was written: false if the file couldn't be
+ *   written or some force isn't registered
+ */
+bool scene_image_save(Scene *scene, const char *path, Force_Registry *registry);
+
+/**
+ * Maps an image written by scene_image_save() into memory.
+ * Only the header is read; the rest is paged in as the image is used.
+ *
+ * @param path the file to map
+ * @return the mapped image, or NULL if the file couldn't be mapped
+ *   or isn't an image of this version that fits in the file
+ */
+Scene_Image *scene_image_map(const char *path);
+
+/**
+ * Builds a scene from a mapped image.
+ * Each body takes a few small allocations, however many vertices it has.
+ * Asserts that the image hasn't been loaded before.
+ *
+ * @param image a pointer returned from scene_image_map()
+ * @param registry a registry with the IDs used when saving
+ * @return the new scene, or NULL if the image is corrupt
+ *   or names an unregistered ID
+ */
+Scene *scene_image_load(Scene_Image *image, Force_Registry *registry);
+
+/**
+ * Unmaps an image. Any scene loaded from it must already have been freed.
+ *
+ * @param image a pointer returned from scene_image_map()
+ */
+void scene_image_unmap(Scene_Image *image);
+
+#endif // #ifndef __SCENE_IMAGE_H__
@@ -89,6 +89,10 @@ void sdl_clear(void);
 
 /**
  * Draws a polygon from the given list of vertices and a color.
+ * Polygons are split into triangles (see polygon_triangulate()) and
+ * batched up, then all drawn in one call by sdl_show(), underneath any
+ * text drawn in the same frame.
+ * A list of fewer than 3 vertices draws nothing.
  *
  * @param points the list of vertices of the polygon
  * @param color the color used to fill in the polygon
@@ -103,14 +107,25 @@ void sdl_show(void);
 
 /**
  * Draws all bodies in a scene.
- * This internally calls sdl_clear(), sdl_draw_polygon(), and sdl_show(),
- * so those functions should not be called directly.
+ * This internally calls sdl_clear() and sdl_show() and draws each body
+ * as sdl_draw_polygon() would, so those functions should not be called
+ * directly. The bodies' shapes are drawn in a single call, then their text.
  *
  * @param scene the scene to draw
  * @param textures and dstrects to get the messages and their locations to draw
  */
 void sdl_render_scene(Scene *scene);
 
+/**
+ * Draws all bodies in a scene, blended between their previous and current
+ * transforms (see body_get_interpolated_shape()).
+ * Pass stepper_alpha() to render smoothly between fixed-timestep ticks.
+ *
+ * @param scene the scene to draw
+ * @param alpha how far to blend: 0 is the previous transform, 1 the current one
+ */
+void sdl_render_scene_interpolated(Scene *scene, double alpha);
+
 /**
  * Registers a function to be called every time a key is pressed.
  * Overwrites any existing handler.
@@ -140,17 +155,88 @@ void sdl_render_scene(Scene *scene);
 void sdl_on_key(KeyHandler handler);
 
 /**
- * Gets the amount of time that has passed since the last time
+ * Gets the amount of wall-clock time that has passed since the last time
  * this function was called, in seconds.
  *
  * @return the number of seconds that have elapsed
  */
 double time_since_last_tick(void);
 
+/**
+ * Records the input every frame handles, and the time each frame took,
+ * to an input log (see input_log.h), so the run can be replayed.
+ * Must be called before sdl_init().
+ *
+ * @param path the file to record to; it is finished when the program exits
+ * @return whether the file could be opened
+ */
+bool sdl_record_input(const char *path);
+
+/**
+ * Replays a log written by sdl_record_input(): sdl_is_done() hands out the
+ * recorded input instead of polling SDL's events, and time_since_last_tick()
+ * returns the recorded times, so a fixed-timestep game runs exactly as it did.
+ * sdl_is_done() reports the window closed at the end of the recording,
+ * and prints how long the replay took to stderr.
+ * Must be called before sdl_init().
+ *
+ * @param path the log to replay
+ * @param headless if true, no window is opened and nothing is drawn,
+ *   so the replay needs no display and times just the game
+ * @return whether the log could be read
+ */
+bool sdl_replay_input(const char *path, bool headless);
+
+/**
+ * Starts the tick profiler (see profiler.h), and writes what it recorded
+ * as a Chrome trace when the program exits. Only a build made with
+ * "make PROFILE=1" records anything.
+ *
+ * @param path the file to write the trace to
+ * @return whether the file could be opened
+ */
+bool sdl_profile(const char *path);
+
+/**
+ * Sets up recording or replaying from a demo's command line:
+ * --record <log>, or --replay <log> with an optional --headless,
+ * and --profile <trace> to call sdl_profile().
+ * Prints a usage message if the options are invalid.
+ *
+ * @param argc the number of arguments passed to main()
+ * @param argv the arguments passed to main()
+ * @return false if the options are invalid or the log couldn't be opened
+ */
+bool sdl_input_options(int argc, char *argv[]);
+
+/**
+ * Draws black text in the default size; see sdl_draw_permanent_text().
+ *
+ * @param txt the text
+ * @param centroid where to center it, in window coordinates
+ */
 void sdl_draw_text(char *txt, Vector centroid);
 
+/**
+ * Draws text centered on a point.
+ * Each font size is opened once, and the last few hundred strings drawn
+ * are kept as textures, so drawing the same text every frame is a single copy.
+ * The copies are made by sdl_show(), in order, on top of every polygon
+ * drawn in the frame.
+ * Does nothing for NULL or empty text, or if the font can't be opened.
+ *
+ * @param txt the text
+ * @param ptsize the font size, in points
+ * @param color the color of the text
+ * @param centroid where to center it, in window coordinates
+ */
 void sdl_draw_permanent_text(char *txt, int ptsize, SDL_Color color, Vector centroid);
 
+/**
+ * Frees a scene, along with the fonts and text textures, and shuts SDL down.
+ *
+ * @param scene the scene to free
+ */
 void sdl_clean_up(Scene *scene);
 
 void update_message_positions(List *textures, List *dstrects, Vector centroid);
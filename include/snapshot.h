@@ -0,0 +1,299 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "scene.h"
+
+/**
+ * Saving a scene to a compact binary file and loading it back, so a long
+ * simulation can be checkpointed, or a scenario forked from a mid-run state.
+ *
+ * A snapshot holds every body's shape, mass, color, tag and kinematics
+ * (see body_get_kinematics()), the scene's integrator settings, its force
+ * creators and its collision table. Function pointers and auxiliary values
+ * can't be written as they are, so each force creator
+ * is written as the ID it was registered under in a Force_Registry,
+ * followed by whatever parameters its saver writes. Collision responses
+ * are plain data and are written as they are. Bodies are written
+ * as their indices in the scene.
+ *
+ * Bodies' info and text are not saved, nor is anything the tick carries
+ * over from one tick to the next, like collision contacts.
+ * Numbers are written little-endian, whatever the machine.
+ */
+typedef struct snapshot Snapshot;
+
+/** The format version scene_save() writes; scene_load() rejects any other */
+#define SNAPSHOT_VERSION 2
+
+/**
+ * Writes the parameters in a force creator's
+ * auxiliary value, using the snapshot_write_*() functions.
+ *
+ * @param aux the auxiliary value
+ * @param snapshot the snapshot being written
+ */
+typedef void (*Force_Saver)(void *aux, Snapshot *snapshot);
+
+/**
+ * Reads back what a Force_Saver wrote, using the snapshot_read_*() functions,
+ * and builds an auxiliary value from it.
+ *
+ * @param snapshot the snapshot being read
+ * @param scene the scene being loaded, whose bodies have all been added
+ * @param bodies where to store the list of bodies
+ *   to pass to scene_add_bodies_force_creator()
+ * @return the new auxiliary value; if the snapshot failed while it was read,
+ *   it and the list of bodies are freed instead of being added to the scene
+ */
+typedef void *(*Force_Loader)(Snapshot *snapshot, Scene *scene, List **bodies);
+
+/**
+ * How to save and load one kind of force creator.
+ */
+typedef struct {
+    /** The ID written in its place; nonzero, and unique in its registry */
+    uint32_t id;
+    /** The force creator function */
+    ForceCreator creator;
+    /** Writes the auxiliary value's parameters, or NULL if there are none */
+    Force_Saver save;
+    /** Rebuilds the auxiliary value, or NULL if it is always NULL */
+    Force_Loader load;
+    /** The freer to register a loaded auxiliary value with, or NULL */
+    FreeFunc freer;
+    /**
+     * Whether the list of bodies load() stores is the group of a
+     * scene_add_group_force_creator() force creator
+     */
+    bool group;
+} Force_Type;
+
+/**
+ * A table of the force creators that can be saved.
+ */
+typedef struct force_registry Force_Registry;
+
+/**
+ * Allocates an empty registry.
+ * See forces_register_types() for the built-in forces.
+ *
+ * @return the new registry
+ */
+Force_Registry *force_registry_init(void);
+
+/**
+ * Releases a registry.
+ *
+ * @param registry a pointer returned from force_registry_init()
+ */
+void force_registry_free(Force_Registry *registry);
+
+/**
+ * Registers a kind of force creator.
+ * Asserts that its ID isn't taken and that it has a function.
+ *
+ * @param registry a pointer returned from force_registry_init()
+ * @param type the function, its ID, and how to save its auxiliary value
+ */
+void force_registry_add(Force_Registry *registry, Force_Type type);
+
+/**
+ * Writes a scene to a file.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param file the file to write to, opened for binary writing
+ * @param registry the registry covering every force creator in the scene
+ * @return whether the scene was written: false if the file couldn't be
+ *   written or some force isn't registered
+ */
+bool scene_save(Scene *scene, FILE *file, Force_Registry *registry);
+
+/**
+ * Reads a scene written by scene_save().
+ * The whole file is read into memory first, then parsed in a single pass
+ * that allocates each body and force once, at its final size.
+ *
+ * @param file the file to read from, opened for binary reading
+ * @param registry a registry with the IDs used when saving
+ * @return the new scene, or NULL if the file isn't a snapshot of this
+ *   version, is cut short, or names an unregistered ID
+ */
+Scene *scene_load(FILE *file, Force_Registry *registry);
+
+/**
+ * Encodes just a scene's force creators and collision table, as scene_save()
+ * does, for formats that store the bodies their own way (see scene_image.h).
+ * Bodies are referred to by their indices in the scene.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param registry the registry covering every force in the scene
+ * @param size where to store the number of bytes written
+ * @return a new buffer the caller must free,
+ *   or NULL if some force isn't registered
+ */
+void *scene_save_forces(Scene *scene, Force_Registry *registry, size_t *size);
+
+/**
+ * Adds the force creators and collision table encoded by scene_save_forces()
+ * to a scene, which must already hold the same bodies in the same order.
+ * Some forces may have been added when this fails.
+ *
+ * @param scene a pointer to a scene returned from scene_init()
+ * @param data the encoded forces, which are only read
+ * @param size the number of bytes of data
+ * @param registry a registry with the IDs used when saving
+ * @return whether every force was read, with no bytes left over
+ */
+bool scene_load_forces(Scene *scene, const void *data, size_t size,
+    Force_Registry *registry);
+
+/**
+ * Writes an integer into a snapshot.
+ *
+ * @param snapshot the snapshot being written
+ * @param value the value to write
+ */
+void snapshot_write_u32(Snapshot *snapshot, uint32_t value);
+
+/**
+ * Writes a floating-point number into a snapshot, exactly.
+ *
+ * @param snapshot the snapshot being written
+ * @param value the value to write
+ */
+void snapshot_write_double(Snapshot *snapshot, double value);
+
+/**
+ * Writes a vector into a snapshot.
+ *
+ * @param snapshot the snapshot being written
+ * @param value the value to write
+ */
+void snapshot_write_vector(Snapshot *snapshot, Vector value);
+
+/**
+ * Writes a reference to a body into a snapshot.
+ * Marks the snapshot as failed if the body isn't in the scene.
+ *
+ * @param snapshot the snapshot being written
+ * @param body a body in the scene being saved, or NULL
+ */
+void snapshot_write_body(Snapshot *snapshot, Body *body);
+
+/**
+ * Writes a list of bodies into a snapshot, as with snapshot_write_body().
+ *
+ * @param snapshot the snapshot being written
+ * @param bodies a list of bodies in the scene being saved
+ */
+void snapshot_write_body_list(Snapshot *snapshot, List *bodies);
+
+/**
+ * Writes a collision response into a snapshot, for force creators
+ * that report collisions (see scene_add_collision()).
+ *
+ * @param snapshot the snapshot being written
+ * @param response the response
+ */
+void snapshot_write_response(Snapshot *snapshot, Collision_Response response);
+
+/**
+ * Reads an integer written by snapshot_write_u32().
+ * Past the end of the snapshot, marks it as failed and returns 0.
+ *
+ * @param snapshot the snapshot being read
+ * @return the value
+ */
+uint32_t snapshot_read_u32(Snapshot *snapshot);
+
+/**
+ * Reads an integer written by snapshot_write_u32() that should be an index
+ * into something with a given number of elements. Marks the snapshot as
+ * failed if it isn't, e.g. because the snapshot is corrupt.
+ *
+ * @param snapshot the snapshot being read
+ * @param limit the number of elements
+ * @return the index, or 0 if it isn't less than limit
+ */
+uint32_t snapshot_read_index(Snapshot *snapshot, uint32_t limit);
+
+/**
+ * Reads an integer written by snapshot_write_u32() that counts the items
+ * that follow it, checking there's room left for that many.
+ * Marks the snapshot as failed if there isn't.
+ *
+ * @param snapshot the snapshot being read
+ * @param item_size the fewest bytes each item takes
+ * @return the count, or 0 if there isn't room
+ */
+uint32_t snapshot_read_count(Snapshot *snapshot, size_t item_size);
+
+/**
+ * Reads a number written by snapshot_write_double().
+ * Past the end of the snapshot, marks it as failed and returns 0.
+ *
+ * @param snapshot the snapshot being read
+ * @return the value
+ */
+double snapshot_read_double(Snapshot *snapshot);
+
+/**
+ * Reads a vector written by snapshot_write_vector().
+ *
+ * @param snapshot the snapshot being read
+ * @return the value
+ */
+Vector snapshot_read_vector(Snapshot *snapshot);
+
+/**
+ * Reads a body reference written by snapshot_write_body().
+ * Marks the snapshot as failed if there is no such body.
+ *
+ * @param snapshot the snapshot being read
+ * @return the body in the scene being loaded, or NULL
+ */
+Body *snapshot_read_body(Snapshot *snapshot);
+
+/**
+ * Reads a body reference written by snapshot_write_body() that can't be NULL,
+ * e.g. one of the bodies a force acts on.
+ * Marks the snapshot as failed if there is no such body or it was NULL.
+ *
+ * @param snapshot the snapshot being read
+ * @return the body in the scene being loaded, or NULL if it failed
+ */
+Body *snapshot_read_required_body(Snapshot *snapshot);
+
+/**
+ * Reads a list written by snapshot_write_body_list(),
+ * whose bodies are read as with snapshot_read_required_body().
+ *
+ * @param snapshot the snapshot being read
+ * @return a new list of bodies in the scene being loaded,
+ *   which doesn't own them
+ */
+List *snapshot_read_body_list(Snapshot *snapshot);
+
+/**
+ * Marks a snapshot as failed, for a Force_Loader that reads a value
+ * its force can't take, e.g. because the snapshot is corrupt.
+ * The loader must still return an auxiliary value its freer can free;
+ * it is freed without being added to the scene.
+ *
+ * @param snapshot the snapshot being read
+ */
+void snapshot_fail(Snapshot *snapshot);
+
+/**
+ * Reads a response written by snapshot_write_response().
+ * Marks the snapshot as failed if it isn't a known kind of response.
+ *
+ * @param snapshot the snapshot being read
+ * @return the response
+ */
+Collision_Response snapshot_read_response(Snapshot *snapshot);
+
+#endif // #ifndef __SNAPSHOT_H__
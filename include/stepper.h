@@ -0,0 +1,73 @@
+#ifndef __STEPPER_H__
+#define __STEPPER_H__
+
+#include <stddef.h>
+#include "scene.h"
+
+/**
+ * Advances a scene in fixed-size ticks, however long each frame takes.
+ * Frame time is added to an accumulator, and the scene is ticked once for
+ * every whole timestep in it. The leftover fraction of a timestep is exposed
+ * as an interpolation factor so the renderer can draw bodies between
+ * their previous and current positions.
+ */
+typedef struct stepper Stepper;
+
+/**
+ * Allocates a fixed-timestep driver.
+ * Asserts that the timestep is positive and at least one substep is allowed.
+ *
+ * @param dt the timestep passed to every scene_tick(), in seconds
+ * @param max_substeps the most ticks to run in one call to stepper_advance().
+ *   Time beyond this is dropped, so a slow frame can't make the next one slower.
+ * @return the new stepper, with an empty accumulator
+ */
+Stepper *stepper_init(double dt, size_t max_substeps);
+
+/**
+ * Releases the memory allocated for a stepper.
+ *
+ * @param stepper a pointer to a stepper returned from stepper_init()
+ */
+void stepper_free(Stepper *stepper);
+
+/**
+ * Adds a frame's worth of wall-clock time to the accumulator
+ * and ticks the scene once for every whole timestep it now holds,
+ * up to the stepper's substep limit.
+ *
+ * @param stepper a pointer to a stepper returned from stepper_init()
+ * @param scene the scene to tick
+ * @param frame_time the wall-clock time since the last frame, in seconds
+ * @return the number of times scene_tick() was called
+ */
+size_t stepper_advance(Stepper *stepper, Scene *scene, double frame_time);
+
+/**
+ * Gets how far the accumulator is into the next timestep.
+ * Rendering bodies this far between their previous and current positions
+ * (see body_get_interpolated_shape()) hides the difference between
+ * the frame rate and the tick rate.
+ *
+ * @param stepper a pointer to a stepper returned from stepper_init()
+ * @return the interpolation factor, in [0, 1)
+ */
+double stepper_alpha(Stepper *stepper);
+
+/**
+ * Gets the fixed timestep of a stepper.
+ *
+ * @param stepper a pointer to a stepper returned from stepper_init()
+ * @return the dt passed to stepper_init()
+ */
+double stepper_dt(Stepper *stepper);
+
+/**
+ * Gets the total number of ticks a stepper has run.
+ *
+ * @param stepper a pointer to a stepper returned from stepper_init()
+ * @return the sum of the return values of stepper_advance()
+ */
+size_t stepper_ticks(Stepper *stepper);
+
+#endif // #ifndef __STEPPER_H__
@@ -22,6 +22,13 @@ extern const Vector VEC_ZERO;
 
 Vector vec_unit(Vector v);
 
+/**
+ * Allocates a copy of a vector, e.g. for a polygon's vertex list.
+ * Release it with allocator_free().
+ *
+ * @param v the vector
+ * @return the copy
+ */
 Vector *vec_init(Vector v);
 /**
  * Returns the angle the vector is pointing in relative to the x-axis.
@@ -0,0 +1,379 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allocator.h"
+
+// The live blocks and sites are kept in open-addressing hash tables
+// whose capacities are powers of 2, grown before they are half full
+#define TABLE_INITIAL_CAPACITY 64
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+void *default_allocate(size_t size, const char *site, void *aux) {
+  return malloc(size);
+}
+
+void *default_reallocate(void *block, size_t size, const char *site, void *aux) {
+  return realloc(block, size);
+}
+
+void default_release(void *block, void *aux) {
+  free(block);
+}
+
+const Allocator ALLOCATOR_DEFAULT = {
+  default_allocate, default_reallocate, default_release, NULL
+};
+
+Allocator engine_allocator = {
+  default_allocate, default_reallocate, default_release, NULL
+};
+
+void allocator_set(Allocator allocator) {
+  assert(allocator.allocate != NULL);
+  assert(allocator.reallocate != NULL);
+  assert(allocator.release != NULL);
+  engine_allocator = allocator;
+}
+
+Allocator allocator_get(void) {
+  return engine_allocator;
+}
+
+void *allocator_malloc(size_t size, const char *site) {
+  return engine_allocator.allocate(size, site, engine_allocator.aux);
+}
+
+void *allocator_calloc(size_t count, size_t size, const char *site) {
+  if (count > 0 && size > SIZE_MAX / count) return NULL;
+  void *block = engine_allocator.allocate(count * size, site, engine_allocator.aux);
+  if (block != NULL) memset(block, 0, count * size);
+  return block;
+}
+
+void *allocator_realloc(void *block, size_t size, const char *site) {
+  return engine_allocator.reallocate(block, size, site, engine_allocator.aux);
+}
+
+void allocator_free(void *block) {
+  engine_allocator.release(block, engine_allocator.aux);
+}
+
+typedef struct {
+  void *block;
+  size_t size;
+  size_t site;
+} Live_Block;
+
+struct tracker {
+  pthread_mutex_t lock;
+  Alloc_Site *sites;
+  size_t num_sites;
+  size_t sites_capacity;
+  // Indices into sites, plus 1 so that 0 marks an empty slot
+  size_t *site_slots;
+  size_t site_slots_capacity;
+  Live_Block *blocks;
+  size_t num_blocks;
+  size_t blocks_capacity;
+};
+
+size_t hash_pointer(const void *pointer, size_t capacity) {
+  return (size_t) (((uint64_t) (uintptr_t) pointer * HASH_MULTIPLIER) >> 32)
+    & (capacity - 1);
+}
+
+void tracker_grow_site_slots(Tracker *tracker) {
+  size_t capacity = tracker->site_slots_capacity * 2;
+  size_t *slots = calloc(capacity, sizeof(size_t));
+  assert(slots != NULL);
+  for (size_t i = 0; i < tracker->num_sites; i++) {
+    size_t slot = hash_pointer(tracker->sites[i].site, capacity);
+    while (slots[slot] != 0) slot = (slot + 1) & (capacity - 1);
+    slots[slot] = i + 1;
+  }
+  free(tracker->site_slots);
+  tracker->site_slots = slots;
+  tracker->site_slots_capacity = capacity;
+}
+
+// Finds a site's index, adding it if it hasn't allocated before
+size_t tracker_site(Tracker *tracker, const char *site) {
+  size_t mask = tracker->site_slots_capacity - 1;
+  size_t slot = hash_pointer(site, tracker->site_slots_capacity);
+  while (tracker->site_slots[slot] != 0) {
+    size_t index = tracker->site_slots[slot] - 1;
+    if (tracker->sites[index].site == site) return index;
+    slot = (slot + 1) & mask;
+  }
+
+  if (tracker->num_sites == tracker->sites_capacity) {
+    tracker->sites_capacity *= 2;
+    tracker->sites = realloc(tracker->sites, sizeof(Alloc_Site) * tracker->sites_capacity);
+    assert(tracker->sites != NULL);
+  }
+  size_t index = tracker->num_sites++;
+  tracker->sites[index] = (Alloc_Site) {site, 0, 0, 0, 0};
+  tracker->site_slots[slot] = index + 1;
+  if (tracker->num_sites * 2 > tracker->site_slots_capacity) {
+    tracker_grow_site_slots(tracker);
+  }
+  return index;
+}
+
+void tracker_insert_block(Tracker *tracker, Live_Block live) {
+  size_t mask = tracker->blocks_capacity - 1;
+  size_t slot = hash_pointer(live.block, tracker->blocks_capacity);
+  while (tracker->blocks[slot].block != NULL) slot = (slot + 1) & mask;
+  tracker->blocks[slot] = live;
+}
+
+void tracker_grow_blocks(Tracker *tracker) {
+  Live_Block *old = tracker->blocks;
+  size_t old_capacity = tracker->blocks_capacity;
+  tracker->blocks_capacity *= 2;
+  tracker->blocks = calloc(tracker->blocks_capacity, sizeof(Live_Block));
+  assert(tracker->blocks != NULL);
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].block != NULL) tracker_insert_block(tracker, old[i]);
+  }
+  free(old);
+}
+
+void tracker_add_block(Tracker *tracker, void *block, size_t size, size_t site) {
+  if ((tracker->num_blocks + 1) * 2 > tracker->blocks_capacity) {
+    tracker_grow_blocks(tracker);
+  }
+  tracker_insert_block(tracker, (Live_Block) {block, size, site});
+  tracker->num_blocks++;
+  tracker->sites[site].live_blocks++;
+  tracker->sites[site].live_bytes += size;
+}
+
+// Stops tracking a block, storing its entry and returning whether it was
+// being tracked (it isn't if it was allocated before the tracker was
+// installed). Later blocks in its run are shifted back so that lookups
+// never stop early at the emptied slot.
+bool tracker_remove_block(Tracker *tracker, void *block, Live_Block *removed) {
+  size_t mask = tracker->blocks_capacity - 1;
+  size_t slot = hash_pointer(block, tracker->blocks_capacity);
+  while (tracker->blocks[slot].block != block) {
+    if (tracker->blocks[slot].block == NULL) return false;
+    slot = (slot + 1) & mask;
+  }
+  Live_Block live = tracker->blocks[slot];
+  if (removed != NULL) *removed = live;
+  tracker->sites[live.site].live_blocks--;
+  tracker->sites[live.site].live_bytes -= live.size;
+  tracker->num_blocks--;
+
+  size_t empty = slot;
+  for (size_t next = (slot + 1) & mask; tracker->blocks[next].block != NULL;
+      next = (next + 1) & mask) {
+    size_t home = hash_pointer(tracker->blocks[next].block, tracker->blocks_capacity);
+    // Move the block back if its home slot isn't between the gap and it
+    if (((next - home) & mask) >= ((next - empty) & mask)) {
+      tracker->blocks[empty] = tracker->blocks[next];
+      empty = next;
+    }
+  }
+  tracker->blocks[empty].block = NULL;
+  return true;
+}
+
+void tracker_count(Tracker *tracker, size_t site, size_t size) {
+  tracker->sites[site].calls++;
+  tracker->sites[site].bytes += size;
+}
+
+void *tracker_allocate(size_t size, const char *site, void *aux) {
+  Tracker *tracker = aux;
+  void *block = malloc(size);
+  pthread_mutex_lock(&tracker->lock);
+  size_t index = tracker_site(tracker, site);
+  tracker_count(tracker, index, size);
+  if (block != NULL) tracker_add_block(tracker, block, size, index);
+  pthread_mutex_unlock(&tracker->lock);
+  return block;
+}
+
+void *tracker_reallocate(void *block, size_t size, const char *site, void *aux) {
+  Tracker *tracker = aux;
+  pthread_mutex_lock(&tracker->lock);
+  size_t index = tracker_site(tracker, site);
+  tracker_count(tracker, index, size);
+  Live_Block old;
+  bool tracked = block != NULL && tracker_remove_block(tracker, block, &old);
+  void *resized = realloc(block, size);
+  if (resized != NULL) {
+    tracker_add_block(tracker, resized, size, index);
+  } else if (tracked && size > 0) {
+    // realloc() failed and left the block as it was
+    tracker_add_block(tracker, block, old.size, old.site);
+  }
+  pthread_mutex_unlock(&tracker->lock);
+  return resized;
+}
+
+void tracker_release(void *block, void *aux) {
+  Tracker *tracker = aux;
+  if (block == NULL) return;
+  pthread_mutex_lock(&tracker->lock);
+  tracker_remove_block(tracker, block, NULL);
+  pthread_mutex_unlock(&tracker->lock);
+  free(block);
+}
+
+Tracker *tracker_init(void) {
+  Tracker *tracker = malloc(sizeof(Tracker));
+  assert(tracker != NULL);
+  pthread_mutex_init(&tracker->lock, NULL);
+  tracker->num_sites = 0;
+  tracker->sites_capacity = TABLE_INITIAL_CAPACITY / 2;
+  tracker->sites = malloc(sizeof(Alloc_Site) * tracker->sites_capacity);
+  assert(tracker->sites != NULL);
+  tracker->site_slots_capacity = TABLE_INITIAL_CAPACITY;
+  tracker->site_slots = calloc(tracker->site_slots_capacity, sizeof(size_t));
+  assert(tracker->site_slots != NULL);
+  tracker->num_blocks = 0;
+  tracker->blocks_capacity = TABLE_INITIAL_CAPACITY;
+  tracker->blocks = calloc(tracker->blocks_capacity, sizeof(Live_Block));
+  assert(tracker->blocks != NULL);
+  return tracker;
+}
+
+void tracker_free(Tracker *tracker) {
+  pthread_mutex_destroy(&tracker->lock);
+  free(tracker->sites);
+  free(tracker->site_slots);
+  free(tracker->blocks);
+  free(tracker);
+}
+
+Allocator tracker_allocator(Tracker *tracker) {
+  return (Allocator) {
+    tracker_allocate, tracker_reallocate, tracker_release, tracker
+  };
+}
+
+size_t tracker_num_sites(Tracker *tracker) {
+  pthread_mutex_lock(&tracker->lock);
+  size_t num_sites = tracker->num_sites;
+  pthread_mutex_unlock(&tracker->lock);
+  return num_sites;
+}
+
+Alloc_Site tracker_get_site(Tracker *tracker, size_t index) {
+  pthread_mutex_lock(&tracker->lock);
+  assert(index < tracker->num_sites);
+  Alloc_Site site = tracker->sites[index];
+  pthread_mutex_unlock(&tracker->lock);
+  return site;
+}
+
+// Finds the subsystem in a site, i.e. "scene" in "library/scene.c:172",
+// storing its length
+const char *site_subsystem(const char *site, size_t *length) {
+  const char *start = strrchr(site, '/');
+  start = start == NULL ? site : start + 1;
+  const char *end = strrchr(start, ':');
+  if (end == NULL) end = start + strlen(start);
+  const char *dot = start;
+  while (dot < end && *dot != '.') dot++;
+  *length = dot - start;
+  return start;
+}
+
+bool site_in_subsystem(const char *site, const char *subsystem) {
+  if (subsystem == NULL) return true;
+  size_t length;
+  const char *name = site_subsystem(site, &length);
+  return strlen(subsystem) == length && strncmp(name, subsystem, length) == 0;
+}
+
+size_t tracker_live_bytes(Tracker *tracker, const char *subsystem) {
+  pthread_mutex_lock(&tracker->lock);
+  size_t bytes = 0;
+  for (size_t i = 0; i < tracker->num_sites; i++) {
+    if (site_in_subsystem(tracker->sites[i].site, subsystem)) {
+      bytes += tracker->sites[i].live_bytes;
+    }
+  }
+  pthread_mutex_unlock(&tracker->lock);
+  return bytes;
+}
+
+size_t tracker_live_blocks(Tracker *tracker, const char *subsystem) {
+  pthread_mutex_lock(&tracker->lock);
+  size_t blocks = 0;
+  for (size_t i = 0; i < tracker->num_sites; i++) {
+    if (site_in_subsystem(tracker->sites[i].site, subsystem)) {
+      blocks += tracker->sites[i].live_blocks;
+    }
+  }
+  pthread_mutex_unlock(&tracker->lock);
+  return blocks;
+}
+
+int compare_site_bytes(const void *a, const void *b) {
+  const Alloc_Site *site1 = a, *site2 = b;
+  if (site1->bytes != site2->bytes) return site1->bytes < site2->bytes ? 1 : -1;
+  return strcmp(site1->site, site2->site);
+}
+
+void tracker_report(Tracker *tracker, FILE *out) {
+  pthread_mutex_lock(&tracker->lock);
+  size_t num_sites = tracker->num_sites;
+  Alloc_Site *sites = malloc(sizeof(Alloc_Site) * (num_sites > 0 ? num_sites : 1));
+  assert(sites != NULL);
+  memcpy(sites, tracker->sites, sizeof(Alloc_Site) * num_sites);
+  pthread_mutex_unlock(&tracker->lock);
+
+  qsort(sites, num_sites, sizeof(Alloc_Site), compare_site_bytes);
+  fprintf(out, "%-32s %12s %14s %14s\n", "site", "calls", "bytes", "live bytes");
+  for (size_t i = 0; i < num_sites; i++) {
+    fprintf(out, "%-32s %12zu %14zu %14zu\n", sites[i].site, sites[i].calls,
+      sites[i].bytes, sites[i].live_bytes);
+  }
+
+  fprintf(out, "\n%-32s %14s %12s\n", "subsystem", "live bytes", "live blocks");
+  for (size_t i = 0; i < num_sites; i++) {
+    size_t length;
+    const char *name = site_subsystem(sites[i].site, &length);
+    // Each subsystem is listed once, at its first site
+    bool listed = false;
+    for (size_t j = 0; j < i && !listed; j++) {
+      size_t other_length;
+      const char *other = site_subsystem(sites[j].site, &other_length);
+      listed = other_length == length && strncmp(other, name, length) == 0;
+    }
+    if (listed) continue;
+    size_t live_bytes = 0, live_blocks = 0;
+    for (size_t j = i; j < num_sites; j++) {
+      size_t other_length;
+      const char *other = site_subsystem(sites[j].site, &other_length);
+      if (other_length == length && strncmp(other, name, length) == 0) {
+        live_bytes += sites[j].live_bytes;
+        live_blocks += sites[j].live_blocks;
+      }
+    }
+    fprintf(out, "%-32.*s %14zu %12zu\n", (int) length, name, live_bytes, live_blocks);
+  }
+  free(sites);
+}
+
+size_t tracker_report_leaks(Tracker *tracker, FILE *out) {
+  pthread_mutex_lock(&tracker->lock);
+  size_t leaked = 0;
+  for (size_t i = 0; i < tracker->num_sites; i++) {
+    Alloc_Site site = tracker->sites[i];
+    if (site.live_blocks == 0) continue;
+    fprintf(out, "leak: %zu bytes in %zu blocks allocated at %s\n",
+      site.live_bytes, site.live_blocks, site.site);
+    leaked += site.live_blocks;
+  }
+  pthread_mutex_unlock(&tracker->lock);
+  return leaked;
+}
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "headless.h"
+
+#define NS_PER_S 1e9
+
+const double BENCH_MIN_TIME = 0.1;
+
+size_t bench_allocs = 0;
+bool bench_json = false;
+const char *bench_prefix = "";
+volatile double bench_sink;
+
+// The real allocator, which the linker's --wrap renames
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  bench_allocs++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  bench_allocs++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  bench_allocs++;
+  return __real_realloc(pointer, size);
+}
+
+size_t bench_allocations(void) {
+  return bench_allocs;
+}
+
+void bench_consume(double value) {
+  bench_sink = value;
+}
+
+Bench_Result bench_run(const char *name, Bench_Func run, void *aux) {
+  size_t iterations = 1;
+  while (true) {
+    size_t allocs = bench_allocs;
+    double start = headless_wall_time();
+    run(iterations, aux);
+    double elapsed = headless_wall_time() - start;
+    allocs = bench_allocs - allocs;
+    if (elapsed >= BENCH_MIN_TIME) {
+      return (Bench_Result) {
+        .name = name,
+        .iterations = iterations,
+        .ns_per_op = elapsed * NS_PER_S / iterations,
+        .allocs_per_op = (double) allocs / iterations,
+        .ops_per_sec = iterations / elapsed
+      };
+    }
+    iterations *= 2;
+  }
+}
+
+bool bench_options(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      bench_json = true;
+    } else if (argv[i][0] != '-' && bench_prefix[0] == '\0') {
+      bench_prefix = argv[i];
+    } else {
+      fprintf(stderr, "Usage: %s [--json] [name prefix]\n", argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool bench_json_output(void) {
+  return bench_json;
+}
+
+bool bench_selected(const char *name) {
+  return strncmp(name, bench_prefix, strlen(bench_prefix)) == 0;
+}
+
+void bench_print_results(FILE *out, Bench_Result *results, size_t num_results) {
+  if (bench_json) {
+    fprintf(out, "{\"benchmarks\": [");
+    for (size_t i = 0; i < num_results; i++) {
+      Bench_Result result = results[i];
+      fprintf(out, "%s\n  {\"name\": \"%s\", \"iterations\": %zu, "
+        "\"ns_per_op\": %.6g, \"allocs_per_op\": %.6g, \"ops_per_sec\": %.6g}",
+        i > 0 ? "," : "", result.name, result.iterations, result.ns_per_op,
+        result.allocs_per_op, result.ops_per_sec);
+    }
+    fprintf(out, "\n]}\n");
+    return;
+  }
+
+  fprintf(out, "%-24s %12s %12s %14s\n", "benchmark", "ns/op", "allocs/op", "ops/s");
+  for (size_t i = 0; i < num_results; i++) {
+    Bench_Result result = results[i];
+    fprintf(out, "%-24s %12.1f %12.2f %14.0f\n", result.name, result.ns_per_op,
+      result.allocs_per_op, result.ops_per_sec);
+  }
+}
@@ -1,6 +1,8 @@
 #include "body.h"
+#include "allocator.h"
 #include "list.h"
 #include "polygon.h"
+#include "scene.h"
 #include <math.h>
 #include <assert.h>
 #include "vector.h"
@@ -12,6 +14,9 @@ struct body {
   double mass;
   RGBColor color;
   Vector centroid;
+  Vector prev_centroid;
+  double angle;
+  double prev_angle;
   Vector velocity;
   double ang_vel;
   double inertia;
@@ -21,23 +26,25 @@ struct body {
   void *info;
   FreeFunc info_freer;
   bool is_removed;
-  bool just_collided;
   char *text;
-  bool colliding;
-  bool unmoved;
   bool stop;
+  size_t tag;
+  // The scene whose tag index files the body, if any, and where
+  Scene *scene;
+  size_t filing_index;
+  uint32_t collision_mask;
+  bool continuous;
+  // How the shape splits into triangles, worked out when first asked for
+  size_t *triangles;
+  size_t num_triangles;
 };
 
-void body_set_unmoved(Body *body, bool b) {
-  body->unmoved = b;
-}
-
 void body_set_mass(Body *body, double mass) {
   body->mass = mass;
 }
 
 Body *body_init(List *shape, double mass, RGBColor color) {
-  Body *body = (Body *) malloc(sizeof(Body));
+  Body *body = (Body *) ENGINE_MALLOC(sizeof(Body));
   assert(body != NULL);
   assert(mass > 0);
   body->shape = shape;
@@ -45,6 +52,9 @@ Body *body_init(List *shape, double mass, RGBColor color) {
   body->inertia = 0;
   body->color = color;
   body->centroid = polygon_centroid(body->shape);
+  body->prev_centroid = body->centroid;
+  body->angle = 0;
+  body->prev_angle = 0;
 
   // Setting to VEC_ZERO is an arbitrary choice.
   body->velocity = VEC_ZERO;
@@ -52,12 +62,16 @@ Body *body_init(List *shape, double mass, RGBColor color) {
   body->force = VEC_ZERO;
   body->impulse = VEC_ZERO;
   body->is_removed = false;
-  body->colliding = false;
-  body->unmoved = false;
   body->info = NULL;
-  body->just_collided = false;
   body->stop = false;
   body->text = NULL;
+  body->tag = 0;
+  body->scene = NULL;
+  body->filing_index = 0;
+  body->collision_mask = ALL_TAGS;
+  body->continuous = false;
+  body->triangles = NULL;
+  body->num_triangles = 0;
   return body;
 }
 
@@ -81,18 +95,38 @@ Body *body_init_with_info_and_text(List *shape, double mass, RGBColor color,
 
 void body_free(Body *body) {
   list_free(body->shape);
+  allocator_free(body->triangles);
   if (body->info != NULL) {
       body->info_freer(body->info);
   }
-  free(body);
+  allocator_free(body);
 }
 
 void body_set_inertia(Body *body, double in) {
   body->inertia = in;
 }
 
+List *body_peek_shape(Body *body) {
+  return body->shape;
+}
+
+const size_t *body_get_triangles(Body *body, size_t *count) {
+  size_t n = list_size(body->shape);
+  if (body->triangles == NULL && n >= 3) {
+    // Moving the body rotates and translates the shape as a whole,
+    // which doesn't change how it splits up. The end of the array is
+    // only room for polygon_triangulate() to work in.
+    body->triangles = ENGINE_MALLOC(sizeof(size_t) * (3 * (n - 2) + n));
+    assert(body->triangles != NULL);
+    body->num_triangles = polygon_triangulate(body->shape, body->triangles,
+      body->triangles + 3 * (n - 2));
+  }
+  *count = body->num_triangles;
+  return body->triangles;
+}
+
 List *body_get_shape(Body *body) {
-  List *new_shape = list_init(list_capacity(body->shape), list_freer(body->shape));
+  List *new_shape = list_init(list_capacity(body->shape), allocator_free);
 
   for (size_t i = 0; i < list_size(body->shape); i++) {
     Vector old_vec = *(Vector *) list_get(body->shape, i);
@@ -125,14 +159,82 @@ void body_translate(Body *body, Vector v) {
 
 void body_set_shape(Body *body, List *shape) {
   body->shape = shape;
+  allocator_free(body->triangles);
+  body->triangles = NULL;
+  body->num_triangles = 0;
 }
 
-void body_set_centroid(Body *body, Vector x) {
-  Vector translation = vec_subtract(x, polygon_centroid(body_get_shape(body)));
+// Moves the body without touching its previous position, for use while ticking.
+void body_move_centroid(Body *body, Vector x) {
+  Vector translation = vec_subtract(x, polygon_centroid(body->shape));
   body_translate(body, translation);
   body->centroid = x;
 }
 
+void body_set_centroid(Body *body, Vector x) {
+  // Teleports shouldn't be interpolated, so the previous position moves too.
+  body->prev_centroid = vec_add(body->prev_centroid,
+    vec_subtract(x, body->centroid));
+  body_move_centroid(body, x);
+}
+
+Vector body_get_previous_centroid(Body *body) {
+  return body->prev_centroid;
+}
+
+double body_get_angle(Body *body) {
+  return body->angle;
+}
+
+double body_get_previous_angle(Body *body) {
+  return body->prev_angle;
+}
+
+Body_Kinematics body_get_kinematics(Body *body) {
+  return (Body_Kinematics) {
+    .centroid = body->centroid,
+    .previous_centroid = body->prev_centroid,
+    .velocity = body->velocity,
+    .angle = body->angle,
+    .previous_angle = body->prev_angle,
+    .angular_velocity = body->ang_vel
+  };
+}
+
+void body_set_kinematics(Body *body, Body_Kinematics kinematics) {
+  body->centroid = kinematics.centroid;
+  body->prev_centroid = kinematics.previous_centroid;
+  body->velocity = kinematics.velocity;
+  body->angle = kinematics.angle;
+  body->prev_angle = kinematics.previous_angle;
+  body->ang_vel = kinematics.angular_velocity;
+}
+
+double body_get_inertia(Body *body) {
+  return body->inertia;
+}
+
+List *body_get_interpolated_shape(Body *body, double alpha) {
+  List *shape = body_get_shape(body);
+  // Both offsets are (alpha - 1) of the way back along the last tick's motion
+  double rotation = (alpha - 1) * (body->angle - body->prev_angle);
+  Vector translation = vec_multiply(alpha - 1,
+    vec_subtract(body->centroid, body->prev_centroid));
+  if (rotation != 0) polygon_rotate(shape, rotation, body->centroid);
+  polygon_translate(shape, translation);
+  return shape;
+}
+
+void body_rewind(Body *body, double alpha) {
+  double rotation = (alpha - 1) * (body->angle - body->prev_angle);
+  Vector translation = vec_multiply(alpha - 1,
+    vec_subtract(body->centroid, body->prev_centroid));
+  if (rotation != 0) polygon_rotate(body->shape, rotation, body->centroid);
+  polygon_translate(body->shape, translation);
+  body->centroid = vec_add(body->centroid, translation);
+  body->angle += rotation;
+}
+
 void body_set_velocity(Body *body, Vector v) {
   body->velocity = v;
 }
@@ -141,6 +243,8 @@ void body_set_rotation(Body *body, double angle) {
   Vector cur_vel = body->velocity;
   double rotation_angle = angle - vec_get_angle(cur_vel); //ensures absolute, not relative, angles
   polygon_rotate(body->shape, rotation_angle, body_get_centroid(body));
+  body->angle += rotation_angle;
+  body->prev_angle += rotation_angle;
 }
 
 void body_add_force(Body *body, Vector force) {
@@ -156,7 +260,7 @@ void body_add_torque(Body *body, double torque) {
 }
 
 Vector lowest_point(Body *body) {
-  List *polygon = body_get_shape(body);
+  List *polygon = body->shape;
   Vector lowest = VEC_ZERO;
 
   size_t size = list_size(polygon);
@@ -169,7 +273,7 @@ Vector lowest_point(Body *body) {
 }
 
 bool horizontal(Body *body) {
-  List *polygon = body_get_shape(body);
+  List *polygon = body->shape;
   size_t size = list_size(polygon);
   Vector centroid = body_get_centroid(body);
 
@@ -194,19 +298,37 @@ bool horizontal(Body *body) {
   return false;
 }
 
+Vector body_get_force(Body *body) {
+  return body->force;
+}
+
+Vector body_get_impulse(Body *body) {
+  return body->impulse;
+}
+
+void body_reset_forces(Body *body) {
+  body->force = VEC_ZERO;
+  body->impulse = VEC_ZERO;
+  body->torque = 0;
+}
+
+void body_set_state(Body *body, Vector centroid, Vector velocity) {
+  body_move_centroid(body, centroid);
+  body->velocity = velocity;
+}
+
+void body_begin_tick(Body *body) {
+  body->prev_centroid = body->centroid;
+  body->prev_angle = body->angle;
+}
+
 void body_tick(Body *body, double dt) {
+  body_begin_tick(body);
 
   if (horizontal(body) == true) body->ang_vel = 0;
-  if (vec_magnitude(body->velocity) > 0 || vec_magnitude(body->impulse) > 0) body->unmoved = false;
-  if (vec_magnitude(body->impulse) == 0) body->colliding = false;
-
-  //if (body->unmoved == true) printf("%s in body tick\n", body_get_text(body));
 
-  if (body->stop == false && body->unmoved == false) {
+  if (body->stop == false) {
     // change in momentum and velocity
-    if (vec_magnitude(body->impulse) > 0 && body->colliding == false) body->colliding = true;
-    else body->impulse = VEC_ZERO;
-
     Vector dp = vec_add(body->impulse, vec_multiply(dt, body->force));
     Vector dv = vec_multiply(1.0 / body->mass, dp); // change in velocity
     Vector new_velocity = vec_add(body->velocity, dv);
@@ -216,18 +338,17 @@ void body_tick(Body *body, double dt) {
     if (body->inertia != 0.0) {
       body->ang_vel = body->ang_vel + body->torque * dt;
       polygon_rotate(body->shape, 2 * body->ang_vel * dt, lowest_point(body));
+      body->angle += 2 * body->ang_vel * dt;
     }
 
     Vector translation = vec_multiply(dt, body->velocity);
     Vector new_centroid = vec_add(body->centroid, translation);
-    body_set_centroid(body, new_centroid);
+    body_move_centroid(body, new_centroid);
 
     body->force = VEC_ZERO;
     body->impulse = VEC_ZERO;
     body->torque = 0;
   }
-
-  body->unmoved = false;
 }
 
 void body_remove(Body *body) {
@@ -252,3 +373,41 @@ void body_set_text(Body *body, char *text) {
 char *body_get_text(Body *body) {
   return body->text;
 }
+
+size_t body_get_tag(Body *body) {
+  return body->tag;
+}
+
+void body_set_tag(Body *body, size_t tag) {
+  assert(tag < NUM_TAGS);
+  size_t old_tag = body->tag;
+  body->tag = tag;
+  if (body->scene != NULL && tag != old_tag) {
+    scene_refile_body(body->scene, body, old_tag);
+  }
+}
+
+void body_set_filing(Body *body, void *scene, size_t index) {
+  body->scene = scene;
+  body->filing_index = index;
+}
+
+size_t body_get_filing_index(Body *body) {
+  return body->filing_index;
+}
+
+uint32_t body_get_collision_mask(Body *body) {
+  return body->collision_mask;
+}
+
+void body_set_collision_mask(Body *body, uint32_t mask) {
+  body->collision_mask = mask;
+}
+
+bool body_get_continuous(Body *body) {
+  return body->continuous;
+}
+
+void body_set_continuous(Body *body, bool continuous) {
+  body->continuous = continuous;
+}
@@ -0,0 +1,261 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <math.h>
+#include "broadphase.h"
+#include "allocator.h"
+
+// How many times wider than the average sorted box a box has to be
+// for queries to test it separately
+#define WIDE_BOX_FACTOR 4
+
+typedef struct {
+  AABB box;
+  uint32_t category;
+  uint32_t mask;
+  // Whether queries find it through the wide list rather than the order
+  bool wide;
+} Entry;
+
+typedef struct {
+  double min_x;
+  size_t index;
+} Sort_Key;
+
+struct broadphase {
+  Entry *entries;
+  size_t num_entries;
+  size_t entries_capacity;
+  // Indices of the entries with a nonempty mask, sorted by left edge
+  size_t *order;
+  size_t num_ordered;
+  size_t order_capacity;
+  // Scratch space for sorting from scratch
+  Sort_Key *keys;
+  // The widest sorted box that isn't wide, which bounds how far left
+  // of a query the other boxes overlapping it can start
+  double max_width;
+  // Indices of the sorted boxes too wide to bound the search with,
+  // which every query tests
+  size_t *wide;
+  size_t num_wide;
+  size_t wide_capacity;
+  Index_Pair *pairs;
+  size_t num_pairs;
+  size_t pairs_capacity;
+};
+
+Broadphase *broadphase_init(void) {
+  Broadphase *broadphase = ENGINE_MALLOC(sizeof(Broadphase));
+  assert(broadphase != NULL);
+  broadphase->entries = NULL;
+  broadphase->num_entries = 0;
+  broadphase->entries_capacity = 0;
+  broadphase->order = NULL;
+  broadphase->num_ordered = 0;
+  broadphase->order_capacity = 0;
+  broadphase->keys = NULL;
+  broadphase->max_width = 0;
+  broadphase->wide = NULL;
+  broadphase->num_wide = 0;
+  broadphase->wide_capacity = 0;
+  broadphase->pairs = NULL;
+  broadphase->num_pairs = 0;
+  broadphase->pairs_capacity = 0;
+  return broadphase;
+}
+
+void broadphase_free(Broadphase *broadphase) {
+  allocator_free(broadphase->entries);
+  allocator_free(broadphase->order);
+  allocator_free(broadphase->keys);
+  allocator_free(broadphase->wide);
+  allocator_free(broadphase->pairs);
+  allocator_free(broadphase);
+}
+
+size_t grown_capacity(size_t capacity, size_t needed) {
+  if (capacity == 0) capacity = INITIAL_CAPACITY;
+  while (capacity < needed) capacity *= GROW_FACTOR;
+  return capacity;
+}
+
+void broadphase_resize(Broadphase *broadphase, size_t n) {
+  if (n > broadphase->entries_capacity) {
+    broadphase->entries_capacity = grown_capacity(broadphase->entries_capacity, n);
+    broadphase->entries = ENGINE_REALLOC(broadphase->entries,
+      sizeof(Entry) * broadphase->entries_capacity);
+    assert(broadphase->entries != NULL);
+  }
+  broadphase->num_entries = n;
+}
+
+void broadphase_set(Broadphase *broadphase, size_t index, AABB box,
+  uint32_t category, uint32_t mask) {
+    assert(index < broadphase->num_entries);
+    broadphase->entries[index] = (Entry) {box, category, mask, false};
+}
+
+// Whether entry a belongs before entry b: by left edge, then by index
+// so the order never depends on the previous one
+bool sorts_before(Broadphase *broadphase, size_t a, size_t b) {
+  double a_min = broadphase->entries[a].box.min.x;
+  double b_min = broadphase->entries[b].box.min.x;
+  return a_min < b_min || (a_min == b_min && a < b);
+}
+
+int sort_key_compare(const void *a, const void *b) {
+  const Sort_Key *key1 = a;
+  const Sort_Key *key2 = b;
+  if (key1->min_x != key2->min_x) return key1->min_x < key2->min_x ? -1 : 1;
+  return key1->index < key2->index ? -1 : key1->index > key2->index;
+}
+
+// Sorts the entries with nonempty masks from scratch
+void broadphase_full_sort(Broadphase *broadphase, size_t active) {
+  if (active > broadphase->order_capacity) {
+    broadphase->order_capacity = grown_capacity(broadphase->order_capacity, active);
+    broadphase->order = ENGINE_REALLOC(broadphase->order,
+      sizeof(size_t) * broadphase->order_capacity);
+    broadphase->keys = ENGINE_REALLOC(broadphase->keys,
+      sizeof(Sort_Key) * broadphase->order_capacity);
+    assert(broadphase->order != NULL && broadphase->keys != NULL);
+  }
+  size_t k = 0;
+  for (size_t i = 0; i < broadphase->num_entries; i++) {
+    if (broadphase->entries[i].mask != 0) {
+      broadphase->keys[k++] = (Sort_Key) {broadphase->entries[i].box.min.x, i};
+    }
+  }
+  qsort(broadphase->keys, active, sizeof(Sort_Key), sort_key_compare);
+  for (k = 0; k < active; k++) {
+    broadphase->order[k] = broadphase->keys[k].index;
+  }
+  broadphase->num_ordered = active;
+}
+
+// Reuses last update's order if it still lists the same entries,
+// since insertion sort is nearly linear on an almost-sorted order.
+// Otherwise (say, a body was added or removed) sorts from scratch.
+void broadphase_update(Broadphase *broadphase) {
+  size_t active = 0;
+  for (size_t i = 0; i < broadphase->num_entries; i++) {
+    if (broadphase->entries[i].mask != 0) active++;
+  }
+  bool reuse = active == broadphase->num_ordered;
+  for (size_t k = 0; reuse && k < broadphase->num_ordered; k++) {
+    size_t i = broadphase->order[k];
+    reuse = i < broadphase->num_entries && broadphase->entries[i].mask != 0;
+  }
+  if (reuse) {
+    size_t *order = broadphase->order;
+    for (size_t k = 1; k < broadphase->num_ordered; k++) {
+      size_t current = order[k];
+      size_t j = k;
+      while (j > 0 && sorts_before(broadphase, current, order[j - 1])) {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = current;
+    }
+  } else {
+    broadphase_full_sort(broadphase, active);
+  }
+
+  // A few wide boxes (say, the ground) would make every query start
+  // far to the left, so they're set aside and tested by every query
+  double total_width = 0;
+  for (size_t k = 0; k < broadphase->num_ordered; k++) {
+    AABB box = broadphase->entries[broadphase->order[k]].box;
+    total_width += box.max.x - box.min.x;
+  }
+  double wide_width = broadphase->num_ordered > 0
+    ? WIDE_BOX_FACTOR * total_width / broadphase->num_ordered
+    : 0;
+  broadphase->max_width = 0;
+  broadphase->num_wide = 0;
+  for (size_t k = 0; k < broadphase->num_ordered; k++) {
+    Entry *entry = &broadphase->entries[broadphase->order[k]];
+    double width = entry->box.max.x - entry->box.min.x;
+    entry->wide = width > wide_width;
+    if (!entry->wide) {
+      broadphase->max_width = fmax(broadphase->max_width, width);
+      continue;
+    }
+    if (broadphase->num_wide == broadphase->wide_capacity) {
+      broadphase->wide_capacity = grown_capacity(broadphase->wide_capacity,
+        broadphase->num_wide + 1);
+      broadphase->wide = ENGINE_REALLOC(broadphase->wide,
+        sizeof(size_t) * broadphase->wide_capacity);
+      assert(broadphase->wide != NULL);
+    }
+    broadphase->wide[broadphase->num_wide++] = broadphase->order[k];
+  }
+}
+
+void broadphase_add_pair(Broadphase *broadphase, size_t a, size_t b) {
+  if (broadphase->num_pairs == broadphase->pairs_capacity) {
+    broadphase->pairs_capacity = grown_capacity(broadphase->pairs_capacity,
+      broadphase->num_pairs + 1);
+    broadphase->pairs = ENGINE_REALLOC(broadphase->pairs,
+      sizeof(Index_Pair) * broadphase->pairs_capacity);
+    assert(broadphase->pairs != NULL);
+  }
+  broadphase->pairs[broadphase->num_pairs++] = a < b
+    ? (Index_Pair) {a, b}
+    : (Index_Pair) {b, a};
+}
+
+size_t broadphase_find_pairs(Broadphase *broadphase) {
+  broadphase_update(broadphase);
+  broadphase->num_pairs = 0;
+  for (size_t k = 0; k < broadphase->num_ordered; k++) {
+    Entry *a = &broadphase->entries[broadphase->order[k]];
+    for (size_t l = k + 1; l < broadphase->num_ordered; l++) {
+      Entry *b = &broadphase->entries[broadphase->order[l]];
+      // Every later box starts even further right
+      if (b->box.min.x > a->box.max.x) break;
+      if ((a->category & b->mask) && (b->category & a->mask)
+        && aabb_overlap(a->box, b->box)) {
+          broadphase_add_pair(broadphase, broadphase->order[k], broadphase->order[l]);
+      }
+    }
+  }
+  return broadphase->num_pairs;
+}
+
+Index_Pair broadphase_get_pair(Broadphase *broadphase, size_t index) {
+  assert(index < broadphase->num_pairs);
+  return broadphase->pairs[index];
+}
+
+void broadphase_query_box(Broadphase *broadphase, AABB box, uint32_t categories,
+  Box_Visitor visitor, void *aux) {
+    // Binary search for the first box that could reach the query
+    double leftmost = box.min.x - broadphase->max_width;
+    size_t low = 0;
+    size_t high = broadphase->num_ordered;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (broadphase->entries[broadphase->order[middle]].box.min.x < leftmost) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    for (size_t k = low; k < broadphase->num_ordered; k++) {
+      Entry *entry = &broadphase->entries[broadphase->order[k]];
+      if (entry->box.min.x > box.max.x) break;
+      if (!entry->wide && (entry->category & categories)
+        && aabb_overlap(entry->box, box)) {
+          visitor(broadphase->order[k], aux);
+      }
+    }
+
+    for (size_t k = 0; k < broadphase->num_wide; k++) {
+      Entry *entry = &broadphase->entries[broadphase->wide[k]];
+      if ((entry->category & categories) && aabb_overlap(entry->box, box)) {
+        visitor(broadphase->wide[k], aux);
+      }
+    }
+}
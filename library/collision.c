@@ -1,5 +1,6 @@
 #include "collision.h"
 #include "vector.h"
+#include "polygon.h"
 #include <math.h>
 #include <assert.h>
 #include <stdio.h>
@@ -57,11 +58,77 @@ CollisionInfo find_collision(List *shape1, List *shape2) {
     if (overlap < 0) return (CollisionInfo) {false, VEC_ZERO};
     else if (overlap < min_overlap) {
       min_overlap = overlap;
-      min_overlap_axis = perpendicular;
+      // Points the axis the way shape2 lies from shape1
+      bool behind = proj2.x + proj2.y < proj1.x + proj1.y;
+      min_overlap_axis = behind ? vec_negate(perpendicular) : perpendicular;
     }
   }
   //printf("ooo a collision\n");
   //printf("%f, %f\n", vec_unit(min_overlap_axis).x, vec_unit(min_overlap_axis).y);
-  return (CollisionInfo) {true, min_overlap_axis};
+  return (CollisionInfo) {true, min_overlap_axis, min_overlap};
 
 }
+
+double find_separation(List *shape1, List *shape2, Vector *axis) {
+  size_t size1 = list_size(shape1);
+  size_t size2 = list_size(shape2);
+  double max_separation = -INFINITY;
+
+  for (size_t i = 0; i < size1 + size2; i++) {
+    List *shape = i < size1 ? shape1 : shape2;
+    size_t index = i < size1 ? i : i - size1;
+    Vector cur = *(Vector *) list_get(shape, index);
+    Vector next = *(Vector *) list_get(shape, (index + 1) % list_size(shape));
+
+    Vector edge = vec_subtract(next, cur);
+    Vector perpendicular = vec_unit((Vector) {edge.y, -edge.x});
+    Vector proj1 = project_min_max(shape1, perpendicular);
+    Vector proj2 = project_min_max(shape2, perpendicular);
+    // shape2 past shape1 along the normal, or shape1 past shape2
+    double ahead = proj2.x - proj1.y;
+    double behind = proj1.x - proj2.y;
+    double separation = fmax(ahead, behind);
+    if (separation > max_separation) {
+      max_separation = separation;
+      *axis = ahead >= behind ? perpendicular : vec_negate(perpendicular);
+    }
+  }
+  return max_separation;
+}
+
+bool find_ray_intersection(List *shape, Vector origin, Vector direction,
+  double max_distance, double *distance, Vector *normal) {
+    // Clips the ray to the inner side of each edge in turn (Cyrus-Beck)
+    double side = polygon_area(shape) >= 0 ? 1 : -1;
+    double enter = 0;
+    double leave = max_distance;
+    Vector enter_normal = VEC_ZERO;
+    size_t size = list_size(shape);
+    for (size_t i = 0; i < size; i++) {
+      Vector cur = *(Vector *) list_get(shape, i);
+      Vector next = *(Vector *) list_get(shape, (i + 1) % size);
+      Vector edge = vec_subtract(next, cur);
+      Vector outward = vec_multiply(side, (Vector) {edge.y, -edge.x});
+      // How far inside the edge the origin is, and how fast the ray leaves
+      double inside = vec_dot(outward, vec_subtract(cur, origin));
+      double leaving = vec_dot(outward, direction);
+      if (leaving == 0) {
+        if (inside < 0) return false;
+        continue;
+      }
+      double t = inside / leaving;
+      if (leaving < 0 && t > enter) {
+        enter = t;
+        enter_normal = outward;
+      } else if (leaving > 0 && t < leave) {
+        leave = t;
+      }
+      if (enter > leave) return false;
+    }
+
+    // No edge was crossed on the way in, so the ray started inside
+    if (vec_equal(enter_normal, VEC_ZERO)) return false;
+    *distance = enter;
+    *normal = vec_unit(enter_normal);
+    return true;
+}
@@ -1,16 +1,23 @@
 #include "forces.h"
+#include "allocator.h"
 #include "collision.h"
+#include "profiler.h"
+#include "quadtree.h"
+#include "snapshot.h"
+#include "spring_network.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
 
-const double ERROR = 10;
+// How many source bodies gravity_direct_sum() keeps in cache at once
+#define GRAVITY_TILE 256
 
 struct collision_type {
-  Two_Bodies *two_body;
-  void *aux;
-  CollisionHandler handler;
+  Scene *scene;
+  Body *body1;
+  Body *body2;
+  Collision_Response response;
 };
 
 struct two_bodies {
@@ -30,6 +37,38 @@ struct n_bodies {
     double constant;
 };
 
+struct nbody_gravity {
+  List *bodies;
+  double G;
+  double theta;
+  Quadtree *tree;
+  // Snapshots of the bodies' state that the tree is built from,
+  // with room for capacity bodies
+  Vector *positions;
+  double *masses;
+  size_t capacity;
+};
+
+struct direct_gravity {
+  List *bodies;
+  double G;
+  double softening;
+  // Each body's coordinates, mass and field, one array per component,
+  // with room for capacity bodies
+  double *x;
+  double *y;
+  double *mass;
+  double *field_x;
+  double *field_y;
+  size_t capacity;
+};
+
+struct field_aux {
+  Scene *scene;
+  Uniform_Field field;
+  uint32_t tag_mask;
+};
+
 // Used in force creation methods below to avoid code duplication.
 List *two_bodies_list_init(Body *b1, Body *b2) {
     List *l = list_init(2, NULL);
@@ -38,17 +77,19 @@ List *two_bodies_list_init(Body *b1, Body *b2) {
     return l;
 }
 
-CollisionType *collision_type_init(Two_Bodies *two_body, CollisionHandler h, void *aux) {
-  CollisionType *c_type = (CollisionType *) malloc(sizeof(CollisionType));
+CollisionType *collision_type_init(Scene *scene, Body *body1, Body *body2,
+    Collision_Response response) {
+  CollisionType *c_type = (CollisionType *) ENGINE_MALLOC(sizeof(CollisionType));
   assert(c_type != NULL);
-  c_type->two_body = two_body;
-  c_type->handler = h;
-  c_type->aux = aux;
+  c_type->scene = scene;
+  c_type->body1 = body1;
+  c_type->body2 = body2;
+  c_type->response = response;
   return c_type;
 }
 
 N_Bodies *n_bodies_init(List *l, double constant) {
-    N_Bodies *n_bodies = (N_Bodies *)malloc(sizeof(N_Bodies));
+    N_Bodies *n_bodies = (N_Bodies *)ENGINE_MALLOC(sizeof(N_Bodies));
     assert(n_bodies != NULL);
     n_bodies->bodies = l;
     n_bodies->constant = constant;
@@ -56,7 +97,7 @@ N_Bodies *n_bodies_init(List *l, double constant) {
 }
 
 Two_Bodies *two_bodies_init(Body *body1, Body *body2, double constant) {
-  Two_Bodies *two_bodies = (Two_Bodies *)malloc(sizeof(Two_Bodies));
+  Two_Bodies *two_bodies = (Two_Bodies *)ENGINE_MALLOC(sizeof(Two_Bodies));
   assert(two_bodies != NULL);
   two_bodies->body1 = body1;
   two_bodies->body2 = body2;
@@ -65,7 +106,7 @@ Two_Bodies *two_bodies_init(Body *body1, Body *body2, double constant) {
 }
 
 One_Body *one_body_init(Body *body, double constant) {
-  One_Body *one_body = (One_Body *)malloc(sizeof(One_Body));
+  One_Body *one_body = (One_Body *)ENGINE_MALLOC(sizeof(One_Body));
   assert(one_body != NULL);
   one_body->body = body;
   one_body->constant = constant;
@@ -104,7 +145,8 @@ Vector get_difference(Two_Bodies *two_body) {
 }
 
 double dist_squared(Two_Bodies *two_body) {
-  return pow(vec_magnitude(get_difference(two_body)), 2);
+  Vector diff = get_difference(two_body);
+  return vec_dot(diff, diff);
 }
 
 void apply_force(Two_Bodies *two_body, double force_magnitude) {
@@ -125,7 +167,7 @@ void create_newtonian_gravity(Scene *scene, double G, Body *body1, Body *body2)
   Two_Bodies *aux = two_bodies_init(body1, body2, G);
   List *l = two_bodies_list_init(body1, body2);
   scene_add_bodies_force_creator(scene, (ForceCreator) create_gravity_force,
-  (void *) aux, l, (FreeFunc) free);
+  (void *) aux, l, allocator_free);
 }
 
 void create_gravity_force(Two_Bodies *two_body) {
@@ -138,11 +180,168 @@ void create_gravity_force(Two_Bodies *two_body) {
   apply_force(two_body, force);
 }
 
+NBody_Gravity *nbody_gravity_init(List *bodies, double G, double theta) {
+  NBody_Gravity *gravity = (NBody_Gravity *) ENGINE_MALLOC(sizeof(NBody_Gravity));
+  assert(gravity != NULL);
+  gravity->bodies = bodies;
+  gravity->G = G;
+  gravity->theta = theta;
+  gravity->tree = quadtree_init();
+  gravity->positions = NULL;
+  gravity->masses = NULL;
+  gravity->capacity = 0;
+  return gravity;
+}
+
+// Frees everything but the body list, which belongs to the scene
+void nbody_gravity_free(NBody_Gravity *gravity) {
+  quadtree_free(gravity->tree);
+  allocator_free(gravity->positions);
+  allocator_free(gravity->masses);
+  allocator_free(gravity);
+}
+
+void create_nbody_gravity(Scene *scene, double G, double theta, List *bodies) {
+  assert(theta >= 0);
+  NBody_Gravity *aux = nbody_gravity_init(bodies, G, theta);
+  scene_add_group_force_creator(scene, (ForceCreator) create_nbody_gravity_force,
+    (void *) aux, bodies, (FreeFunc) nbody_gravity_free);
+}
+
+void create_nbody_gravity_force(NBody_Gravity *gravity) {
+  // The group may have grown since the last tick
+  size_t n = list_size(gravity->bodies);
+  if (n > gravity->capacity) {
+    while (gravity->capacity < n) {
+      gravity->capacity = gravity->capacity > 0
+        ? gravity->capacity * GROW_FACTOR
+        : INITIAL_CAPACITY;
+    }
+    gravity->positions = ENGINE_REALLOC(gravity->positions,
+      sizeof(Vector) * gravity->capacity);
+    gravity->masses = ENGINE_REALLOC(gravity->masses, sizeof(double) * gravity->capacity);
+    assert(gravity->positions != NULL && gravity->masses != NULL);
+  }
+  for (size_t i = 0; i < n; i++) {
+    Body *body = list_get(gravity->bodies, i);
+    gravity->positions[i] = body_get_centroid(body);
+    gravity->masses[i] = body_get_mass(body);
+  }
+  quadtree_build(gravity->tree, gravity->positions, gravity->masses, n);
+
+  for (size_t i = 0; i < n; i++) {
+    Vector field = quadtree_field(gravity->tree, i, gravity->theta, DIST_TOO_SMALL);
+    body_add_force(list_get(gravity->bodies, i),
+      vec_multiply(gravity->G * gravity->masses[i], field));
+  }
+}
+
+double *direct_gravity_array(double *array, size_t n) {
+  array = ENGINE_REALLOC(array, sizeof(double) * n);
+  assert(array != NULL);
+  return array;
+}
+
+Direct_Gravity *direct_gravity_init(List *bodies, double G, double softening) {
+  Direct_Gravity *gravity = (Direct_Gravity *) ENGINE_MALLOC(sizeof(Direct_Gravity));
+  assert(gravity != NULL);
+  gravity->bodies = bodies;
+  gravity->G = G;
+  gravity->softening = softening;
+  gravity->x = NULL;
+  gravity->y = NULL;
+  gravity->mass = NULL;
+  gravity->field_x = NULL;
+  gravity->field_y = NULL;
+  gravity->capacity = 0;
+  return gravity;
+}
+
+// Frees everything but the body list, which belongs to the scene
+void direct_gravity_free(Direct_Gravity *gravity) {
+  allocator_free(gravity->x);
+  allocator_free(gravity->y);
+  allocator_free(gravity->mass);
+  allocator_free(gravity->field_x);
+  allocator_free(gravity->field_y);
+  allocator_free(gravity);
+}
+
+void create_direct_gravity(Scene *scene, double G, double softening, List *bodies) {
+  assert(softening > 0);
+  Direct_Gravity *aux = direct_gravity_init(bodies, G, softening);
+  scene_add_group_force_creator(scene, (ForceCreator) create_direct_gravity_force,
+    (void *) aux, bodies, (FreeFunc) direct_gravity_free);
+}
+
+void gravity_direct_sum(size_t n, const double *x, const double *y,
+  const double *mass, double softening, double *field_x, double *field_y) {
+    assert(softening > 0);
+    double softening_squared = softening * softening;
+    for (size_t i = 0; i < n; i++) {
+      field_x[i] = 0;
+      field_y[i] = 0;
+    }
+
+    // Sweep every body past one tile of sources at a time, so the tile stays
+    // in cache. The inner loop has no branches: softening makes each body's
+    // pull on itself exactly zero instead of a division by zero.
+    for (size_t tile = 0; tile < n; tile += GRAVITY_TILE) {
+      size_t tile_end = tile + GRAVITY_TILE < n ? tile + GRAVITY_TILE : n;
+      for (size_t i = 0; i < n; i++) {
+        double xi = x[i], yi = y[i];
+        double sum_x = 0, sum_y = 0;
+        for (size_t j = tile; j < tile_end; j++) {
+          double dx = x[j] - xi;
+          double dy = y[j] - yi;
+          double r_squared = dx * dx + dy * dy + softening_squared;
+          double inv_r = 1 / sqrt(r_squared);
+          double strength = mass[j] * inv_r * inv_r * inv_r;
+          sum_x += strength * dx;
+          sum_y += strength * dy;
+        }
+        field_x[i] += sum_x;
+        field_y[i] += sum_y;
+      }
+    }
+}
+
+void create_direct_gravity_force(Direct_Gravity *gravity) {
+  // The group may have grown since the last tick
+  size_t n = list_size(gravity->bodies);
+  if (n > gravity->capacity) {
+    while (gravity->capacity < n) {
+      gravity->capacity = gravity->capacity > 0
+        ? gravity->capacity * GROW_FACTOR
+        : INITIAL_CAPACITY;
+    }
+    gravity->x = direct_gravity_array(gravity->x, gravity->capacity);
+    gravity->y = direct_gravity_array(gravity->y, gravity->capacity);
+    gravity->mass = direct_gravity_array(gravity->mass, gravity->capacity);
+    gravity->field_x = direct_gravity_array(gravity->field_x, gravity->capacity);
+    gravity->field_y = direct_gravity_array(gravity->field_y, gravity->capacity);
+  }
+  for (size_t i = 0; i < n; i++) {
+    Body *body = list_get(gravity->bodies, i);
+    Vector centroid = body_get_centroid(body);
+    gravity->x[i] = centroid.x;
+    gravity->y[i] = centroid.y;
+    gravity->mass[i] = body_get_mass(body);
+  }
+  gravity_direct_sum(n, gravity->x, gravity->y, gravity->mass, gravity->softening,
+    gravity->field_x, gravity->field_y);
+  for (size_t i = 0; i < n; i++) {
+    double scale = gravity->G * gravity->mass[i];
+    body_add_force(list_get(gravity->bodies, i),
+      (Vector) {scale * gravity->field_x[i], scale * gravity->field_y[i]});
+  }
+}
+
 void create_spring(Scene *scene, double k, Body *body1, Body *body2) {
   Two_Bodies *aux = two_bodies_init(body1, body2, k);
   List *l = two_bodies_list_init(body1, body2);
   scene_add_bodies_force_creator(scene, (ForceCreator) create_spring_force,
-  (void *) aux, l, (FreeFunc) free);
+  (void *) aux, l, allocator_free);
 }
 
 
@@ -156,7 +355,7 @@ void create_drag(Scene *scene, double gamma, Body *body) {
   List *l = list_init(1, NULL);
   list_add(l, body);
   scene_add_bodies_force_creator(scene, (ForceCreator) create_drag_force,
-    (void *) aux, l, (FreeFunc) free);
+    (void *) aux, l, allocator_free);
 }
 
 void create_drag_force(One_Body *one_body) {
@@ -167,7 +366,7 @@ void create_drag_force(One_Body *one_body) {
 void create_down(Scene *scene, double g, List *l) {
     N_Bodies *aux = n_bodies_init(l, g);
     scene_add_bodies_force_creator(scene, (ForceCreator) create_down_force,
-        (void *) aux, l, (FreeFunc) free);
+        (void *) aux, l, allocator_free);
 }
 
 void create_down_force(N_Bodies *nb) {
@@ -178,138 +377,231 @@ void create_down_force(N_Bodies *nb) {
   }
 }
 
-void destructive_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-  body_remove(body1);
-  body_remove(body2);
+void create_uniform_field(Scene *scene, Uniform_Field field, uint32_t tag_mask) {
+  Field_Aux *aux = (Field_Aux *) ENGINE_MALLOC(sizeof(Field_Aux));
+  assert(aux != NULL);
+  aux->scene = scene;
+  aux->field = field;
+  aux->tag_mask = tag_mask;
+  // The field finds its bodies by tag each tick, so it depends on none of them
+  scene_add_bodies_force_creator(scene, (ForceCreator) create_uniform_field_force,
+    (void *) aux, list_init(INITIAL_CAPACITY, NULL), allocator_free);
+}
+
+void create_uniform_field_force(Field_Aux *aux) {
+  Uniform_Field field = aux->field;
+  bool has_drag = field.linear_drag != 0 || field.quadratic_drag != 0;
+  // Only visit the bodies filed under the field's tags
+  for (size_t tag = 0; tag < NUM_TAGS; tag++) {
+    if (!(TAG_MASK(tag) & aux->tag_mask)) continue;
+    size_t n = scene_tagged_bodies(aux->scene, tag);
+    for (size_t i = 0; i < n; i++) {
+      Body *body = scene_get_tagged_body(aux->scene, tag, i);
+      double mass = body_get_mass(body);
+      if (mass == INFINITY) continue;
+      Vector force = vec_multiply(mass, field.acceleration);
+      if (has_drag) {
+        Vector air_velocity = vec_subtract(body_get_velocity(body), field.wind);
+        double drag = field.linear_drag
+          + field.quadratic_drag * vec_magnitude(air_velocity);
+        force = vec_subtract(force, vec_multiply(drag, air_velocity));
+      }
+      body_add_force(body, force);
+    }
+  }
+}
+
+void force_creator(void *aux) {
+  CollisionType *c = (CollisionType *) aux;
+  PROFILE_NARROWPHASE();
+  CollisionInfo info = find_collision(body_peek_shape(c->body1), body_peek_shape(c->body2));
+
+  if (info.collided == true) {
+    scene_add_collision(c->scene, c->body1, c->body2, info, c->response);
+  }
+}
+
+void create_collision(Scene *scene, Body *body1, Body *body2,
+    Collision_Response response) {
+      CollisionType *c = collision_type_init(scene, body1, body2, response);
+      List *bodies = two_bodies_list_init(body1, body2);
+      scene_add_bodies_force_creator(scene, (ForceCreator) force_creator, c,
+      bodies, allocator_free);
+}
+
+void create_destructive_collision(Scene *scene, Body *body1, Body *body2){
+  create_collision(scene, body1, body2, (Collision_Response) {COLLISION_DESTRUCTIVE});
 }
 
-void semidestructive_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-    body_remove(body2);
+void create_semidestructive_collision(Scene *scene, Body *body1, Body *body2){
+    create_collision(scene, body1, body2,
+                    (Collision_Response) {COLLISION_SEMIDESTRUCTIVE});
 }
 
-void physics_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-  double u1 = vec_dot(body_get_velocity(body1), axis);
-  double u2 = vec_dot(body_get_velocity(body2), axis);
-  double m1 = body_get_mass(body1);
-  double m2 = body_get_mass(body2);
-  double reduced_mass;
-  if (m1 == INFINITY) reduced_mass = m2;
-  else if (m2 == INFINITY) reduced_mass = m1;
-  else reduced_mass = m1 * m2 / (m1 + m2);
+void create_physics_collision(Scene *scene, double elasticity, Body *body1,
+  Body *body2) {
+    create_collision(scene, body1, body2,
+                    (Collision_Response) {COLLISION_PHYSICS, elasticity});
+ }
 
-  Two_Bodies *two_body = (Two_Bodies *) aux;
-  double cr = two_body->constant; // coefficient of restitution
+ void create_inelastic_collision(Scene *scene, Body *body1, Body *body2) {
+     create_collision(scene, body1, body2, (Collision_Response) {COLLISION_INELASTIC});
+}
 
-  double impulse = reduced_mass * (1 + cr) * (u2 - u1);
-  body_add_impulse(body1, vec_multiply(impulse, axis));
-  body_add_impulse(body2, vec_multiply(-impulse, axis));
+void stop_at_ground(Scene *scene, Body *body, Body *ground) {
+  create_collision(scene, body, ground, (Collision_Response) {COLLISION_STOP});
+}
 
+void create_group_collision(Scene *scene, uint32_t mask1, uint32_t mask2,
+  Collision_Response response) {
+    scene_add_collision_response(scene, mask1, mask2, response);
+}
 
-  if (impulse > ERROR) {
-    // printf("%f \n", impulse);
-    if (m1 != INFINITY) body_add_torque(body1, impulse);
-    if (m2 != INFINITY) body_add_torque(body2, -impulse);
-  }
+void create_group_destructive_collision(Scene *scene, uint32_t mask1, uint32_t mask2) {
+  create_group_collision(scene, mask1, mask2, (Collision_Response) {COLLISION_DESTRUCTIVE});
 }
 
-void inelastic_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-  double m1 = body_get_mass(body1);
-  double m2 = body_get_mass(body2);
+void create_group_physics_collision(Scene *scene, double elasticity,
+  uint32_t mask1, uint32_t mask2) {
+    create_group_collision(scene, mask1, mask2,
+      (Collision_Response) {COLLISION_PHYSICS, elasticity});
+}
 
-  if (m1 != INFINITY && m2 != INFINITY) {
-    Vector v1 = body_get_velocity(body1);
-    Vector v2 = body_get_velocity(body2);
+void create_group_inelastic_collision(Scene *scene, uint32_t mask1, uint32_t mask2) {
+  create_group_collision(scene, mask1, mask2, (Collision_Response) {COLLISION_INELASTIC});
+}
 
-    Vector tot_mom = vec_add(vec_multiply(m1, v1), vec_multiply(m2, v2));
-    Vector tot_vel = vec_multiply(1 / (m1 + m2), tot_mom);
+void create_group_stop_at_ground(Scene *scene, uint32_t mask1, uint32_t mask2) {
+  create_group_collision(scene, mask1, mask2, (Collision_Response) {COLLISION_STOP});
+}
 
-    if (vec_magnitude(v1) > ERROR || vec_magnitude(v2) > ERROR) {
-      body_set_velocity(body1, tot_vel);
-      body_set_velocity(body2, tot_vel);
-    }
-  }
-  else {
-    body_set_velocity(body1, VEC_ZERO);
-    body_set_velocity(body2, VEC_ZERO);
-  }
+// Saving and loading each force's auxiliary value; see forces_register_types()
+
+void two_bodies_save(Two_Bodies *two_bodies, Snapshot *snapshot) {
+  snapshot_write_body(snapshot, two_bodies->body1);
+  snapshot_write_body(snapshot, two_bodies->body2);
+  snapshot_write_double(snapshot, two_bodies->constant);
 }
 
-void normal_force_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-  // Switches body1 and body2 to ensure body1 is on top
-  if (body_get_centroid(body1).y > body_get_centroid(body2).y) {
-    Body *temp = body1;
-    body1 = body2;
-    body2 = temp;
-  }
+Two_Bodies *two_bodies_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  Body *body1 = snapshot_read_required_body(snapshot);
+  Body *body2 = snapshot_read_required_body(snapshot);
+  double constant = snapshot_read_double(snapshot);
+  *bodies = two_bodies_list_init(body1, body2);
+  return two_bodies_init(body1, body2, constant);
+}
 
-  if (body_get_mass(body1) == INFINITY) {
-    Body *temp = body1;
-    body1 = body2;
-    body2 = temp;
-  }
+void one_body_save(One_Body *one_body, Snapshot *snapshot) {
+  snapshot_write_body(snapshot, one_body->body);
+  snapshot_write_double(snapshot, one_body->constant);
+}
 
-  body_set_unmoved(body1, true);
+One_Body *one_body_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  Body *body = snapshot_read_required_body(snapshot);
+  *bodies = list_init(1, NULL);
+  list_add(*bodies, body);
+  return one_body_init(body, snapshot_read_double(snapshot));
 }
 
-void stop_ground_handler(Body *body1, Body *body2, Vector axis, void *aux) {
-  body_set_stop(body1, true);
+void n_bodies_save(N_Bodies *n_bodies, Snapshot *snapshot) {
+  snapshot_write_body_list(snapshot, n_bodies->bodies);
+  snapshot_write_double(snapshot, n_bodies->constant);
 }
 
-void force_creator(void *aux) {
-  CollisionType *c = (CollisionType *) aux;
-  Two_Bodies *two_body = c->two_body;
-  Body *body1 = two_body->body1;
-  Body *body2 = two_body->body2;
-  void *aux_pass = c->aux;
-  CollisionHandler handler = c->handler;
-  CollisionInfo info = find_collision(body_get_shape(body1), body_get_shape(body2));
+N_Bodies *n_bodies_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  *bodies = snapshot_read_body_list(snapshot);
+  return n_bodies_init(*bodies, snapshot_read_double(snapshot));
+}
 
-  if (info.collided == true) {
-    handler(body1, body2, info.axis, aux_pass);
-  }
+void nbody_gravity_save(NBody_Gravity *gravity, Snapshot *snapshot) {
+  snapshot_write_body_list(snapshot, gravity->bodies);
+  snapshot_write_double(snapshot, gravity->G);
+  snapshot_write_double(snapshot, gravity->theta);
 }
 
-void create_collision(Scene *scene, Body *body1, Body *body2,
-    CollisionHandler handler, void *aux, FreeFunc freer) {
-      Two_Bodies *two_body = two_bodies_init(body1, body2, 0);
-      CollisionType *c = collision_type_init(two_body, handler, aux);
-      List *bodies = two_bodies_list_init(body1, body2);
-      scene_add_bodies_force_creator(scene, (ForceCreator) force_creator, c,
-      bodies, freer);
+NBody_Gravity *nbody_gravity_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  *bodies = snapshot_read_body_list(snapshot);
+  double G = snapshot_read_double(snapshot);
+  double theta = snapshot_read_double(snapshot);
+  // create_nbody_gravity() would have refused it
+  if (!(theta >= 0)) snapshot_fail(snapshot);
+  return nbody_gravity_init(*bodies, G, theta);
 }
 
-void create_destructive_collision(Scene *scene, Body *body1, Body *body2){
-  Two_Bodies *two_body = two_bodies_init(body1, body2, 0);
-  create_collision(scene, body1, body2, (CollisionHandler) destructive_handler,
-                  two_body, (FreeFunc) free);
+void direct_gravity_save(Direct_Gravity *gravity, Snapshot *snapshot) {
+  snapshot_write_body_list(snapshot, gravity->bodies);
+  snapshot_write_double(snapshot, gravity->G);
+  snapshot_write_double(snapshot, gravity->softening);
 }
 
-void create_semidestructive_collision(Scene *scene, Body *body1, Body *body2){
-    Two_Bodies *two_body = two_bodies_init(body1, body2, 0);
-    create_collision(scene, body1, body2, (CollisionHandler) semidestructive_handler,
-                    two_body, (FreeFunc) free);
+Direct_Gravity *direct_gravity_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  *bodies = snapshot_read_body_list(snapshot);
+  double G = snapshot_read_double(snapshot);
+  double softening = snapshot_read_double(snapshot);
+  // create_direct_gravity() would have refused it
+  if (!(softening > 0)) snapshot_fail(snapshot);
+  return direct_gravity_init(*bodies, G, softening);
 }
 
-void create_physics_collision(Scene *scene, double elasticity, Body *body1,
-  Body *body2) {
-    Two_Bodies *two_body = two_bodies_init(body1, body2, elasticity);
-    create_collision(scene, body1, body2, (CollisionHandler) physics_handler,
-                    two_body, (FreeFunc) free);
- }
+void field_aux_save(Field_Aux *aux, Snapshot *snapshot) {
+  snapshot_write_vector(snapshot, aux->field.acceleration);
+  snapshot_write_double(snapshot, aux->field.linear_drag);
+  snapshot_write_double(snapshot, aux->field.quadratic_drag);
+  snapshot_write_vector(snapshot, aux->field.wind);
+  snapshot_write_u32(snapshot, aux->tag_mask);
+}
 
- void create_inelastic_collision(Scene *scene, Body *body1, Body *body2) {
-     create_collision(scene, body1, body2, (CollisionHandler) inelastic_handler,
-                     NULL, (FreeFunc) free);
+Field_Aux *field_aux_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  Field_Aux *aux = (Field_Aux *) ENGINE_MALLOC(sizeof(Field_Aux));
+  assert(aux != NULL);
+  aux->scene = scene;
+  aux->field.acceleration = snapshot_read_vector(snapshot);
+  aux->field.linear_drag = snapshot_read_double(snapshot);
+  aux->field.quadratic_drag = snapshot_read_double(snapshot);
+  aux->field.wind = snapshot_read_vector(snapshot);
+  aux->tag_mask = snapshot_read_u32(snapshot);
+  *bodies = list_init(INITIAL_CAPACITY, NULL);
+  return aux;
 }
 
-void create_normal_force(Scene *scene, Body *body1, Body *body2, double g) {
-  Two_Bodies *two_body = two_bodies_init(body1, body2, g);
-  create_collision(scene, body1, body2, (CollisionHandler) normal_force_handler,
-                  two_body, (FreeFunc) free);
+void collision_type_save(CollisionType *c, Snapshot *snapshot) {
+  snapshot_write_body(snapshot, c->body1);
+  snapshot_write_body(snapshot, c->body2);
+  snapshot_write_response(snapshot, c->response);
 }
 
-void stop_at_ground(Scene *scene, Body *body, Body *ground) {
-  Two_Bodies *two_body = two_bodies_init(body, ground, 0);
-  create_collision(scene, body, ground, (CollisionHandler) stop_ground_handler,
-                  two_body, (FreeFunc) free);
+CollisionType *collision_type_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  Body *body1 = snapshot_read_required_body(snapshot);
+  Body *body2 = snapshot_read_required_body(snapshot);
+  Collision_Response response = snapshot_read_response(snapshot);
+  *bodies = two_bodies_list_init(body1, body2);
+  return collision_type_init(scene, body1, body2, response);
+}
+
+void forces_register_types(Force_Registry *registry) {
+  Force_Type force_types[] = {
+    {FORCE_TYPE_NEWTONIAN_GRAVITY, (ForceCreator) create_gravity_force,
+      (Force_Saver) two_bodies_save, (Force_Loader) two_bodies_load, allocator_free},
+    {FORCE_TYPE_NBODY_GRAVITY, (ForceCreator) create_nbody_gravity_force,
+      (Force_Saver) nbody_gravity_save, (Force_Loader) nbody_gravity_load,
+      (FreeFunc) nbody_gravity_free, true},
+    {FORCE_TYPE_DIRECT_GRAVITY, (ForceCreator) create_direct_gravity_force,
+      (Force_Saver) direct_gravity_save, (Force_Loader) direct_gravity_load,
+      (FreeFunc) direct_gravity_free, true},
+    {FORCE_TYPE_SPRING, (ForceCreator) create_spring_force,
+      (Force_Saver) two_bodies_save, (Force_Loader) two_bodies_load, allocator_free},
+    {FORCE_TYPE_DRAG, (ForceCreator) create_drag_force,
+      (Force_Saver) one_body_save, (Force_Loader) one_body_load, allocator_free},
+    {FORCE_TYPE_DOWN, (ForceCreator) create_down_force,
+      (Force_Saver) n_bodies_save, (Force_Loader) n_bodies_load, allocator_free},
+    {FORCE_TYPE_UNIFORM_FIELD, (ForceCreator) create_uniform_field_force,
+      (Force_Saver) field_aux_save, (Force_Loader) field_aux_load, allocator_free},
+    {FORCE_TYPE_PAIR_COLLISION, (ForceCreator) force_creator,
+      (Force_Saver) collision_type_save, (Force_Loader) collision_type_load,
+      allocator_free}
+  };
+  for (size_t i = 0; i < sizeof(force_types) / sizeof(force_types[0]); i++) {
+    force_registry_add(registry, force_types[i]);
+  }
+  spring_network_register_type(registry);
 }
@@ -0,0 +1,367 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "headless.h"
+#include "forces.h"
+#include "polygon.h"
+#include "snapshot.h"
+
+#define LINE_LENGTH 256
+#define CIRCLE_POINTS 16
+#define NS_PER_S 1e9
+
+const RGBColor HEADLESS_COLOR = {0, 0, 0};
+
+double headless_wall_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / NS_PER_S;
+}
+
+// Looks up a body declared earlier in the description.
+// Indices are read as doubles, so check they are whole before converting.
+Body *described_body(Scene *scene, double index, size_t line) {
+  if (!(index >= 0 && index == floor(index))) {
+    fprintf(stderr, "line %zu: body index %g is not a whole number\n", line, index);
+    return NULL;
+  }
+  if (index >= scene_bodies(scene)) {
+    fprintf(stderr, "line %zu: no body %g has been declared\n", line, index);
+    return NULL;
+  }
+  return scene_get_body(scene, (size_t) index);
+}
+
+Body *parse_body(char *command, double *args, int count, size_t line) {
+  bool is_rect = strcmp(command, "rect") == 0;
+  int shape_args = is_rect ? 5 : 4;
+  if (count != shape_args && count != shape_args + 2) {
+    fprintf(stderr, "line %zu: %s takes %d or %d numbers\n", line, command,
+      shape_args, shape_args + 2);
+    return NULL;
+  }
+  double mass = args[shape_args - 1];
+  if (!(mass > 0)) {
+    fprintf(stderr, "line %zu: mass must be positive\n", line);
+    return NULL;
+  }
+
+  Vector center = {args[0], args[1]};
+  List *shape = is_rect
+    ? polygon_rectangle(center, args[2], args[3])
+    : polygon_circle(center, args[2], CIRCLE_POINTS);
+  Body *body = body_init(shape, mass, HEADLESS_COLOR);
+  if (count == shape_args + 2) {
+    body_set_velocity(body, (Vector) {args[shape_args], args[shape_args + 1]});
+  }
+  return body;
+}
+
+// Returns whether the force command was valid.
+bool parse_force(Scene *scene, char *command, double *args, int count,
+  size_t line) {
+    bool one_body = strcmp(command, "drag") == 0 || strcmp(command, "down") == 0;
+    bool no_constant = strcmp(command, "destructive") == 0;
+    int expected = (no_constant ? 0 : 1) + (one_body ? 1 : 2);
+    if (count != expected) {
+      fprintf(stderr, "line %zu: %s takes %d numbers\n", line, command, expected);
+      return false;
+    }
+
+    double constant = no_constant ? 0 : args[0];
+    double *indices = no_constant ? args : args + 1;
+    Body *body1 = described_body(scene, indices[0], line);
+    Body *body2 = one_body ? body1 : described_body(scene, indices[1], line);
+    if (body1 == NULL || body2 == NULL) return false;
+
+    if (strcmp(command, "gravity") == 0) {
+      create_newtonian_gravity(scene, constant, body1, body2);
+    } else if (strcmp(command, "spring") == 0) {
+      create_spring(scene, constant, body1, body2);
+    } else if (strcmp(command, "drag") == 0) {
+      create_drag(scene, constant, body1);
+    } else if (strcmp(command, "down") == 0) {
+      List *bodies = list_init(1, NULL);
+      list_add(bodies, body1);
+      create_down(scene, constant, bodies);
+    } else if (strcmp(command, "collision") == 0) {
+      create_physics_collision(scene, constant, body1, body2);
+    } else {
+      create_destructive_collision(scene, body1, body2);
+    }
+    return true;
+}
+
+// Returns whether the integrator name was recognized.
+bool parse_integrator(Scene *scene, char *rest, size_t line) {
+  const char *names[] = {"default", "symplectic", "verlet", "rk4", "adaptive"};
+  const Integrator integrators[] = {INTEGRATOR_DEFAULT,
+    INTEGRATOR_SYMPLECTIC_EULER, INTEGRATOR_VELOCITY_VERLET, INTEGRATOR_RK4,
+    INTEGRATOR_ADAPTIVE_RK45};
+  char name[LINE_LENGTH];
+  if (sscanf(rest, "%s", name) == 1) {
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+      if (strcmp(name, names[i]) == 0) {
+        scene_set_integrator(scene, integrators[i]);
+        return true;
+      }
+    }
+  }
+  fprintf(stderr,
+    "line %zu: integrator must be default, symplectic, verlet, rk4 or adaptive\n",
+    line);
+  return false;
+}
+
+// Adds Barnes-Hut (nbody) or direct-sum (direct) gravity between every body
+// declared so far. Returns whether the command was valid.
+bool parse_group_gravity(Scene *scene, char *command, double *args, int count,
+  size_t line) {
+    bool barnes_hut = strcmp(command, "nbody") == 0;
+    if (count != 2) {
+      fprintf(stderr, "line %zu: %s takes 2 numbers\n", line, command);
+      return false;
+    }
+    if (barnes_hut ? !(args[1] >= 0) : !(args[1] > 0)) {
+      fprintf(stderr, "line %zu: %s must be %s\n", line,
+        barnes_hut ? "theta" : "softening",
+        barnes_hut ? "non-negative" : "positive");
+      return false;
+    }
+    size_t n = scene_bodies(scene);
+    List *bodies = list_init(n > 0 ? n : 1, NULL);
+    for (size_t i = 0; i < n; i++) {
+      Body *body = scene_get_body(scene, i);
+      if (body_get_mass(body) == INFINITY) {
+        fprintf(stderr, "line %zu: %s bodies must have finite mass\n", line, command);
+        list_free(bodies);
+        return false;
+      }
+      list_add(bodies, body);
+    }
+    if (barnes_hut) {
+      create_nbody_gravity(scene, args[0], args[1], bodies);
+    } else {
+      create_direct_gravity(scene, args[0], args[1], bodies);
+    }
+    return true;
+}
+
+// Adds a uniform field acting on every body. Returns whether it was valid.
+bool parse_field(Scene *scene, double *args, int count, size_t line) {
+  if (count != 4 && count != 6) {
+    fprintf(stderr, "line %zu: field takes 4 or 6 numbers\n", line);
+    return false;
+  }
+  Uniform_Field field = {
+    .acceleration = {args[0], args[1]},
+    .linear_drag = args[2],
+    .quadratic_drag = args[3],
+    .wind = count == 6 ? (Vector) {args[4], args[5]} : VEC_ZERO
+  };
+  create_uniform_field(scene, field, ALL_TAGS);
+  return true;
+}
+
+// Whether a number read from a description is a valid tag
+bool valid_tag(double tag) {
+  return tag >= 0 && tag < NUM_TAGS && tag == floor(tag);
+}
+
+// Tags a body declared earlier. Returns whether the command was valid.
+bool parse_tag(Scene *scene, double *args, int count, size_t line) {
+  if (count != 2) {
+    fprintf(stderr, "line %zu: tag takes 2 numbers\n", line);
+    return false;
+  }
+  if (!valid_tag(args[0])) {
+    fprintf(stderr, "line %zu: tags go from 0 to %d\n", line, NUM_TAGS - 1);
+    return false;
+  }
+  Body *body = described_body(scene, args[1], line);
+  if (body == NULL) return false;
+  body_set_tag(body, (size_t) args[0]);
+  return true;
+}
+
+// Turns on continuous collision detection for a body declared earlier.
+// Returns whether the command was valid.
+bool parse_continuous(Scene *scene, double *args, int count, size_t line) {
+  if (count != 1) {
+    fprintf(stderr, "line %zu: continuous takes 1 number\n", line);
+    return false;
+  }
+  Body *body = described_body(scene, args[0], line);
+  if (body == NULL) return false;
+  body_set_continuous(body, true);
+  return true;
+}
+
+// Adds physics collisions between every pair of bodies with two tags.
+// Returns whether the command was valid.
+bool parse_collide(Scene *scene, double *args, int count, size_t line) {
+  if (count != 3) {
+    fprintf(stderr, "line %zu: collide takes 3 numbers\n", line);
+    return false;
+  }
+  if (!valid_tag(args[1]) || !valid_tag(args[2])) {
+    fprintf(stderr, "line %zu: tags go from 0 to %d\n", line, NUM_TAGS - 1);
+    return false;
+  }
+  create_group_physics_collision(scene, args[0],
+    TAG_MASK((size_t) args[1]), TAG_MASK((size_t) args[2]));
+  return true;
+}
+
+// Returns whether the adaptive step bounds were valid.
+bool parse_adaptive(Scene *scene, double *args, int count, size_t line) {
+  if (count != 3) {
+    fprintf(stderr, "line %zu: adaptive takes 3 numbers\n", line);
+    return false;
+  }
+  Adaptive_Config config = {args[0], args[1], args[2]};
+  if (!(config.min_dt > 0 && config.min_dt <= config.max_dt && config.tolerance > 0)) {
+    fprintf(stderr, "line %zu: adaptive needs 0 < min_dt <= max_dt and tolerance > 0\n",
+      line);
+    return false;
+  }
+  scene_set_adaptive_config(scene, config);
+  return true;
+}
+
+Scene *headless_parse_scene(FILE *file) {
+  Scene *scene = scene_init();
+  char buffer[LINE_LENGTH];
+  size_t line = 0;
+
+  while (fgets(buffer, sizeof(buffer), file) != NULL) {
+    line++;
+    char command[LINE_LENGTH];
+    int offset;
+    if (sscanf(buffer, "%s%n", command, &offset) != 1 || command[0] == '#') {
+      continue;
+    }
+
+    char *rest = buffer + offset;
+    if (strcmp(command, "integrator") == 0) {
+      if (parse_integrator(scene, rest, line)) continue;
+      scene_free(scene);
+      return NULL;
+    }
+
+    // Every other command takes at most 7 numeric arguments
+    double args[8];
+    int count = 0;
+    int consumed;
+    while (count < 8 && sscanf(rest, "%lf%n", &args[count], &consumed) == 1) {
+      rest += consumed;
+      count++;
+    }
+
+    bool ok;
+    if (strcmp(command, "rect") == 0 || strcmp(command, "circle") == 0) {
+      Body *body = parse_body(command, args, count, line);
+      ok = body != NULL;
+      if (ok) scene_add_body(scene, body);
+    } else if (strcmp(command, "gravity") == 0 || strcmp(command, "spring") == 0
+      || strcmp(command, "drag") == 0 || strcmp(command, "down") == 0
+      || strcmp(command, "collision") == 0
+      || strcmp(command, "destructive") == 0) {
+      ok = parse_force(scene, command, args, count, line);
+    } else if (strcmp(command, "nbody") == 0 || strcmp(command, "direct") == 0) {
+      ok = parse_group_gravity(scene, command, args, count, line);
+    } else if (strcmp(command, "field") == 0) {
+      ok = parse_field(scene, args, count, line);
+    } else if (strcmp(command, "adaptive") == 0) {
+      ok = parse_adaptive(scene, args, count, line);
+    } else if (strcmp(command, "tag") == 0) {
+      ok = parse_tag(scene, args, count, line);
+    } else if (strcmp(command, "collide") == 0) {
+      ok = parse_collide(scene, args, count, line);
+    } else if (strcmp(command, "continuous") == 0) {
+      ok = parse_continuous(scene, args, count, line);
+    } else {
+      fprintf(stderr, "line %zu: unknown command \"%s\"\n", line, command);
+      ok = false;
+    }
+
+    if (!ok) {
+      scene_free(scene);
+      return NULL;
+    }
+  }
+  return scene;
+}
+
+Scene *headless_load_scene(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "Couldn't open file %s\n", path);
+    return NULL;
+  }
+  // Snapshots start with their magic number; descriptions are text
+  char magic[4] = {0};
+  bool is_snapshot = fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+    && memcmp(magic, "SCNE", sizeof(magic)) == 0;
+  rewind(file);
+  Scene *scene;
+  if (is_snapshot) {
+    Force_Registry *registry = force_registry_init();
+    forces_register_types(registry);
+    scene = scene_load(file, registry);
+    force_registry_free(registry);
+    if (scene == NULL) fprintf(stderr, "Invalid snapshot %s\n", path);
+  } else {
+    scene = headless_parse_scene(file);
+  }
+  fclose(file);
+  return scene;
+}
+
+bool headless_save_scene(Scene *scene, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Couldn't open file %s\n", path);
+    return false;
+  }
+  Force_Registry *registry = force_registry_init();
+  forces_register_types(registry);
+  bool saved = scene_save(scene, file, registry);
+  force_registry_free(registry);
+  saved = fclose(file) == 0 && saved;
+  if (!saved) fprintf(stderr, "Couldn't save the scene to %s\n", path);
+  return saved;
+}
+
+Headless_Stats headless_run(Scene *scene, double dt, size_t steps) {
+  assert(dt > 0);
+  size_t start_steps = scene_get_adaptive_stats(scene).total_steps;
+  double start = headless_wall_time();
+  for (size_t i = 0; i < steps; i++) {
+    scene_tick(scene, dt);
+  }
+  double elapsed = headless_wall_time() - start;
+
+  return (Headless_Stats) {
+    .steps = steps,
+    .dt = dt,
+    .wall_seconds = elapsed,
+    .ns_per_tick = steps > 0 ? elapsed * NS_PER_S / steps : 0,
+    .bodies = scene_bodies(scene),
+    .integrator_steps = scene_get_integrator(scene) == INTEGRATOR_ADAPTIVE_RK45
+      ? scene_get_adaptive_stats(scene).total_steps - start_steps
+      : steps
+  };
+}
+
+void headless_print_stats(FILE *out, Headless_Stats stats) {
+  fprintf(out, "%zu steps of dt=%g: %.6f s wall, %.1f ns/tick, %zu bodies",
+    stats.steps, stats.dt, stats.wall_seconds, stats.ns_per_tick, stats.bodies);
+  if (stats.integrator_steps != stats.steps) {
+    fprintf(out, ", %zu integrator steps", stats.integrator_steps);
+  }
+  fprintf(out, "\n");
+}
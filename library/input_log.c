@@ -0,0 +1,168 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "input_log.h"
+#include "allocator.h"
+#include "list.h"
+
+#define LINE_LENGTH 256
+#define INPUT_LOG_VERSION 1
+
+// A piece of input, and the frame it belongs to
+typedef struct {
+  size_t frame;
+  Input_Event event;
+} Logged_Event;
+
+struct input_log {
+  double *dts;
+  size_t num_dts;
+  size_t dts_capacity;
+  size_t next_dt;
+  Logged_Event *events;
+  size_t num_events;
+  size_t events_capacity;
+  size_t next_event;
+};
+
+void input_log_write_header(FILE *file) {
+  fprintf(file, "input-log %d\n", INPUT_LOG_VERSION);
+}
+
+void input_log_write_dt(FILE *file, double dt) {
+  fprintf(file, "dt %.17g\n", dt);
+}
+
+void input_log_write_event(FILE *file, size_t frame, Input_Event event) {
+  switch (event.type) {
+    case INPUT_KEY:
+      fprintf(file, "key %zu %d %s %.17g\n", frame, event.key,
+        event.released ? "released" : "pressed", event.held_time);
+      break;
+    case INPUT_POINTER:
+      fprintf(file, "pointer %zu %d %d\n", frame, event.x, event.y);
+      break;
+    case INPUT_QUIT:
+      fprintf(file, "quit %zu\n", frame);
+      break;
+  }
+}
+
+void input_log_add_dt(Input_Log *log, double dt) {
+  if (log->num_dts == log->dts_capacity) {
+    log->dts_capacity = log->dts_capacity > 0
+      ? log->dts_capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    log->dts = ENGINE_REALLOC(log->dts, sizeof(double) * log->dts_capacity);
+    assert(log->dts != NULL);
+  }
+  log->dts[log->num_dts++] = dt;
+}
+
+void input_log_add_event(Input_Log *log, size_t frame, Input_Event event) {
+  if (log->num_events == log->events_capacity) {
+    log->events_capacity = log->events_capacity > 0
+      ? log->events_capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    log->events = ENGINE_REALLOC(log->events, sizeof(Logged_Event) * log->events_capacity);
+    assert(log->events != NULL);
+  }
+  log->events[log->num_events++] = (Logged_Event) {frame, event};
+}
+
+// Parses one entry, returning false if it is invalid
+bool input_log_parse(Input_Log *log, char *buffer) {
+  char command[LINE_LENGTH];
+  int offset;
+  if (sscanf(buffer, "%s%n", command, &offset) != 1) return false;
+  char *rest = buffer + offset;
+  char extra[LINE_LENGTH];
+  size_t frame;
+  Input_Event event = {.type = INPUT_QUIT};
+  if (strcmp(command, "dt") == 0) {
+    double dt;
+    if (sscanf(rest, "%lf %s", &dt, extra) != 1 || !(dt >= 0)) return false;
+    input_log_add_dt(log, dt);
+    return true;
+  } else if (strcmp(command, "key") == 0) {
+    int key;
+    char action[LINE_LENGTH];
+    if (sscanf(rest, "%zu %d %s %lf %s", &frame, &key, action, &event.held_time, extra) != 4
+      || key <= 0 || key > 127) {
+        return false;
+    }
+    if (strcmp(action, "pressed") != 0 && strcmp(action, "released") != 0) return false;
+    event.type = INPUT_KEY;
+    event.key = key;
+    event.released = strcmp(action, "released") == 0;
+  } else if (strcmp(command, "pointer") == 0) {
+    if (sscanf(rest, "%zu %d %d %s", &frame, &event.x, &event.y, extra) != 3) return false;
+    event.type = INPUT_POINTER;
+  } else if (strcmp(command, "quit") == 0) {
+    if (sscanf(rest, "%zu %s", &frame, extra) != 1) return false;
+  } else {
+    return false;
+  }
+  if (log->num_events > 0 && frame < log->events[log->num_events - 1].frame) return false;
+  input_log_add_event(log, frame, event);
+  return true;
+}
+
+Input_Log *input_log_read(FILE *file) {
+  char buffer[LINE_LENGTH];
+  int version;
+  if (fgets(buffer, sizeof(buffer), file) == NULL
+    || sscanf(buffer, "input-log %d", &version) != 1 || version != INPUT_LOG_VERSION) {
+      fprintf(stderr, "line 1: not an input log of version %d\n", INPUT_LOG_VERSION);
+      return NULL;
+  }
+
+  Input_Log *log = ENGINE_MALLOC(sizeof(Input_Log));
+  assert(log != NULL);
+  log->dts = NULL;
+  log->num_dts = 0;
+  log->dts_capacity = 0;
+  log->next_dt = 0;
+  log->events = NULL;
+  log->num_events = 0;
+  log->events_capacity = 0;
+  log->next_event = 0;
+  size_t line = 1;
+  while (fgets(buffer, sizeof(buffer), file) != NULL) {
+    line++;
+    if (!input_log_parse(log, buffer)) {
+      fprintf(stderr, "line %zu: invalid input log entry\n", line);
+      input_log_free(log);
+      return NULL;
+    }
+  }
+  return log;
+}
+
+void input_log_free(Input_Log *log) {
+  allocator_free(log->dts);
+  allocator_free(log->events);
+  allocator_free(log);
+}
+
+bool input_log_next_dt(Input_Log *log, double *dt) {
+  if (log->next_dt == log->num_dts) return false;
+  *dt = log->dts[log->next_dt++];
+  return true;
+}
+
+bool input_log_next_event(Input_Log *log, size_t frame, Input_Event *event) {
+  while (log->next_event < log->num_events
+    && log->events[log->next_event].frame < frame) {
+      log->next_event++;
+  }
+  if (log->next_event == log->num_events || log->events[log->next_event].frame > frame) {
+    return false;
+  }
+  *event = log->events[log->next_event++].event;
+  return true;
+}
+
+bool input_log_finished(Input_Log *log) {
+  return log->next_dt == log->num_dts && log->next_event == log->num_events;
+}
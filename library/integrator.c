@@ -0,0 +1,395 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "integrator.h"
+#include "allocator.h"
+#include "scene.h"
+
+// Dormand-Prince 5(4) tableau: stage i is evaluated STAGE_TIME[i] of the way
+// through a step, at the state reached using STAGE_COEFF[i]
+#define STAGES 7
+const double STAGE_TIME[STAGES] = {0, 1.0 / 5, 3.0 / 10, 4.0 / 5, 8.0 / 9, 1, 1};
+const double STAGE_COEFF[STAGES][STAGES - 1] = {
+  {0},
+  {1.0 / 5},
+  {3.0 / 40, 9.0 / 40},
+  {44.0 / 45, -56.0 / 15, 32.0 / 9},
+  {19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729},
+  {9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656},
+  // The fifth-order solution, so the last stage's forces start the next step
+  {35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84}
+};
+// Difference between the fifth- and fourth-order weights
+const double ERROR_WEIGHT[STAGES] = {71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920,
+  -17253.0 / 339200, 22.0 / 525, -1.0 / 40};
+
+// Step-size control: never grow or shrink by more than these factors at once,
+// and aim a little below the tolerance so fewer steps are rejected
+const double SAFETY = 0.9;
+const double MIN_SHRINK = 0.2;
+const double MAX_GROWTH = 5;
+const Adaptive_Config DEFAULT_ADAPTIVE_CONFIG = {1e-9, 1e-2, 1e-6};
+
+struct integrator_state {
+  size_t capacity;
+  Vector *x0; // positions at the start of the tick
+  Vector *v0; // velocities at the start of the tick
+  Vector *dx; // weighted sum of the position derivatives so far
+  Vector *dv; // weighted sum of the velocity derivatives so far
+  Vector *kx[STAGES]; // position derivatives at each adaptive stage
+  Vector *kv[STAGES]; // velocity derivatives at each adaptive stage
+  Adaptive_Config config;
+  Adaptive_Stats stats;
+};
+
+Integrator_State *integrator_state_init(void) {
+  Integrator_State *state = ENGINE_MALLOC(sizeof(Integrator_State));
+  assert(state != NULL);
+  state->capacity = 0;
+  state->x0 = NULL;
+  state->v0 = NULL;
+  state->dx = NULL;
+  state->dv = NULL;
+  for (size_t s = 0; s < STAGES; s++) {
+    state->kx[s] = NULL;
+    state->kv[s] = NULL;
+  }
+  state->config = DEFAULT_ADAPTIVE_CONFIG;
+  state->stats = (Adaptive_Stats) {0, 0, 0, 0, DEFAULT_ADAPTIVE_CONFIG.max_dt};
+  return state;
+}
+
+void integrator_state_free(Integrator_State *state) {
+  allocator_free(state->x0);
+  allocator_free(state->v0);
+  allocator_free(state->dx);
+  allocator_free(state->dv);
+  for (size_t s = 0; s < STAGES; s++) {
+    allocator_free(state->kx[s]);
+    allocator_free(state->kv[s]);
+  }
+  allocator_free(state);
+}
+
+Vector *reserve_vectors(Vector *vectors, size_t capacity) {
+  vectors = ENGINE_REALLOC(vectors, sizeof(Vector) * capacity);
+  assert(vectors != NULL);
+  return vectors;
+}
+
+void state_reserve(Integrator_State *state, size_t n) {
+  if (n <= state->capacity) return;
+  size_t capacity = state->capacity > 0 ? state->capacity : INITIAL_CAPACITY;
+  while (capacity < n) capacity *= GROW_FACTOR;
+  state->x0 = reserve_vectors(state->x0, capacity);
+  state->v0 = reserve_vectors(state->v0, capacity);
+  state->dx = reserve_vectors(state->dx, capacity);
+  state->dv = reserve_vectors(state->dv, capacity);
+  for (size_t s = 0; s < STAGES; s++) {
+    state->kx[s] = reserve_vectors(state->kx[s], capacity);
+    state->kv[s] = reserve_vectors(state->kv[s], capacity);
+  }
+  state->capacity = capacity;
+}
+
+double clamp(double value, double min, double max) {
+  return fmin(fmax(value, min), max);
+}
+
+void integrator_set_adaptive_config(Integrator_State *state, Adaptive_Config config) {
+  assert(config.min_dt > 0);
+  assert(config.min_dt <= config.max_dt);
+  assert(config.tolerance > 0);
+  state->config = config;
+  state->stats.next_dt = clamp(state->stats.next_dt, config.min_dt, config.max_dt);
+}
+
+Adaptive_Config integrator_get_adaptive_config(Integrator_State *state) {
+  return state->config;
+}
+
+Adaptive_Stats integrator_get_adaptive_stats(Integrator_State *state) {
+  return state->stats;
+}
+
+// Stopped bodies hold still under every integrator, and infinite-mass bodies
+// aren't accelerated; see end_step() for how they move.
+bool integrates(Body *body) {
+  return body_get_mass(body) != INFINITY && !body_get_stop(body);
+}
+
+Vector acceleration(Body *body) {
+  return vec_multiply(1.0 / body_get_mass(body), body_get_force(body));
+}
+
+// Re-runs the force creators with every body at its current state.
+void evaluate_forces(Scene *scene) {
+  size_t n = scene_bodies(scene);
+  for (size_t i = 0; i < n; i++) {
+    body_reset_forces(scene_get_body(scene, i));
+  }
+  scene_apply_forces(scene);
+}
+
+// Records the start of the tick and folds impulses into the velocity,
+// since they are instantaneous and shouldn't be integrated.
+void begin_step(Scene *scene, Integrator_State *state) {
+  size_t n = scene_bodies(scene);
+  state_reserve(state, n);
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    body_begin_tick(body);
+    state->x0[i] = body_get_centroid(body);
+    state->v0[i] = body_get_velocity(body);
+    if (integrates(body)) {
+      state->v0[i] = vec_add(state->v0[i],
+        vec_multiply(1.0 / body_get_mass(body), body_get_impulse(body)));
+    }
+  }
+}
+
+// Moves infinite-mass bodies at constant velocity, as body_tick() does,
+// and clears the forces left over from the last evaluation.
+void end_step(Scene *scene, double dt, Integrator_State *state) {
+  size_t n = scene_bodies(scene);
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    if (body_get_mass(body) == INFINITY && !body_get_stop(body)) {
+      body_set_state(body, vec_add(state->x0[i], vec_multiply(dt, state->v0[i])),
+        state->v0[i]);
+    }
+    body_reset_forces(body);
+  }
+}
+
+void symplectic_euler_step(Scene *scene, double dt, Integrator_State *state) {
+  begin_step(scene, state);
+  size_t n = scene_bodies(scene);
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    if (!integrates(body)) continue;
+    Vector v = vec_add(state->v0[i], vec_multiply(dt, acceleration(body)));
+    body_set_state(body, vec_add(state->x0[i], vec_multiply(dt, v)), v);
+  }
+  end_step(scene, dt, state);
+}
+
+void velocity_verlet_step(Scene *scene, double dt, Integrator_State *state) {
+  begin_step(scene, state);
+  size_t n = scene_bodies(scene);
+
+  // Drift to the end of the tick, carrying the half-kicked velocity
+  // so velocity-dependent forces see a reasonable estimate.
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    if (!integrates(body)) continue;
+    Vector half_dv = vec_multiply(dt / 2, acceleration(body));
+    Vector v_half = vec_add(state->v0[i], half_dv);
+    body_set_state(body, vec_add(state->x0[i], vec_multiply(dt, v_half)), v_half);
+  }
+
+  // Kick with the forces at the new positions
+  evaluate_forces(scene);
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    if (!integrates(body)) continue;
+    Vector v = vec_add(body_get_velocity(body),
+      vec_multiply(dt / 2, acceleration(body)));
+    body_set_velocity(body, v);
+  }
+  end_step(scene, dt, state);
+}
+
+void rk4_step(Scene *scene, double dt, Integrator_State *state) {
+  begin_step(scene, state);
+  size_t n = scene_bodies(scene);
+  // How far along the tick each stage is evaluated, and its weight
+  const double stage_offset[] = {0.5, 0.5, 1.0};
+  const double stage_weight[] = {1, 2, 2, 1};
+
+  // Stage 1 uses the forces already accumulated at the start of the tick
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    state->dx[i] = state->v0[i];
+    state->dv[i] = integrates(body) ? acceleration(body) : VEC_ZERO;
+  }
+
+  for (size_t stage = 0; stage < 3; stage++) {
+    // Move every body to this stage's estimate, using the derivatives from
+    // the previous stage: the state a body was evaluated at, and its forces
+    for (size_t i = 0; i < n; i++) {
+      Body *body = scene_get_body(scene, i);
+      if (!integrates(body)) continue;
+      Vector prev_kx = stage == 0 ? state->v0[i] : body_get_velocity(body);
+      Vector prev_kv = stage == 0 ? state->dv[i] : acceleration(body);
+      double h = stage_offset[stage] * dt;
+      body_set_state(body,
+        vec_add(state->x0[i], vec_multiply(h, prev_kx)),
+        vec_add(state->v0[i], vec_multiply(h, prev_kv)));
+    }
+    evaluate_forces(scene);
+    for (size_t i = 0; i < n; i++) {
+      Body *body = scene_get_body(scene, i);
+      if (!integrates(body)) continue;
+      double w = stage_weight[stage + 1];
+      state->dx[i] = vec_add(state->dx[i], vec_multiply(w, body_get_velocity(body)));
+      state->dv[i] = vec_add(state->dv[i], vec_multiply(w, acceleration(body)));
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    if (!integrates(body)) continue;
+    body_set_state(body,
+      vec_add(state->x0[i], vec_multiply(dt / 6, state->dx[i])),
+      vec_add(state->v0[i], vec_multiply(dt / 6, state->dv[i])));
+  }
+  end_step(scene, dt, state);
+}
+
+// Records the derivatives of every body at its current state as a stage.
+// Infinite-mass bodies drift along with the rest; stopped bodies hold still.
+void record_stage(Scene *scene, Integrator_State *state, size_t stage) {
+  size_t n = scene_bodies(scene);
+  for (size_t i = 0; i < n; i++) {
+    Body *body = scene_get_body(scene, i);
+    bool moves = !body_get_stop(body);
+    state->kx[stage][i] = moves ? body_get_velocity(body) : VEC_ZERO;
+    state->kv[stage][i] = integrates(body) ? acceleration(body) : VEC_ZERO;
+  }
+}
+
+// Attempts a step of length h from x0/v0, leaving every body at the
+// fifth-order solution, and returns the largest error estimate over the tolerance
+double dormand_prince_step(Scene *scene, double h, Integrator_State *state) {
+  size_t n = scene_bodies(scene);
+  for (size_t stage = 1; stage < STAGES; stage++) {
+    for (size_t i = 0; i < n; i++) {
+      Body *body = scene_get_body(scene, i);
+      if (body_get_stop(body)) continue;
+      Vector x = state->x0[i];
+      Vector v = state->v0[i];
+      for (size_t j = 0; j < stage; j++) {
+        double a = h * STAGE_COEFF[stage][j];
+        x = vec_add(x, vec_multiply(a, state->kx[j][i]));
+        v = vec_add(v, vec_multiply(a, state->kv[j][i]));
+      }
+      body_set_state(body, x, v);
+    }
+    evaluate_forces(scene);
+    record_stage(scene, state, stage);
+  }
+
+  double error = 0;
+  for (size_t i = 0; i < n; i++) {
+    Vector ex = VEC_ZERO;
+    Vector ev = VEC_ZERO;
+    for (size_t stage = 0; stage < STAGES; stage++) {
+      ex = vec_add(ex, vec_multiply(h * ERROR_WEIGHT[stage], state->kx[stage][i]));
+      ev = vec_add(ev, vec_multiply(h * ERROR_WEIGHT[stage], state->kv[stage][i]));
+    }
+    error = fmax(error, fmax(fmax(fabs(ex.x), fabs(ex.y)), fmax(fabs(ev.x), fabs(ev.y))));
+  }
+  return error / state->config.tolerance;
+}
+
+void adaptive_step(Scene *scene, double dt, Integrator_State *state) {
+  begin_step(scene, state);
+  size_t n = scene_bodies(scene);
+  Adaptive_Config config = state->config;
+  Adaptive_Stats *stats = &state->stats;
+  stats->steps = 0;
+  stats->rejected = 0;
+  stats->smallest_dt = INFINITY;
+
+  // The forces accumulated at the start of the tick are the first stage.
+  // Impulses were folded into v0, so take velocities from there.
+  record_stage(scene, state, 0);
+  for (size_t i = 0; i < n; i++) {
+    if (!body_get_stop(scene_get_body(scene, i))) state->kx[0][i] = state->v0[i];
+  }
+
+  double t = 0;
+  double h = clamp(stats->next_dt, config.min_dt, config.max_dt);
+  while (t < dt) {
+    // Don't leave a sliver of the tick to rounding error
+    bool last = h * (1 + 1e-9) >= dt - t;
+    double step = last ? dt - t : h;
+    double error = dormand_prince_step(scene, step, state);
+    bool accepted = error <= 1 || step <= config.min_dt;
+
+    if (accepted) {
+      for (size_t i = 0; i < n; i++) {
+        Body *body = scene_get_body(scene, i);
+        state->x0[i] = body_get_centroid(body);
+        state->v0[i] = body_get_velocity(body);
+        state->kx[0][i] = state->kx[STAGES - 1][i];
+        state->kv[0][i] = state->kv[STAGES - 1][i];
+      }
+      t = last ? dt : t + step;
+      stats->steps++;
+      stats->smallest_dt = fmin(stats->smallest_dt, step);
+    } else {
+      stats->rejected++;
+    }
+
+    double factor = error > 0
+      ? clamp(SAFETY * pow(error, -0.2), MIN_SHRINK, MAX_GROWTH)
+      : MAX_GROWTH;
+    double next = step * factor;
+    // A step cut short to end the tick says little about how long one can be
+    if (accepted && step < h) next = fmax(next, h);
+    h = clamp(next, config.min_dt, config.max_dt);
+  }
+
+  stats->total_steps += stats->steps;
+  stats->next_dt = h;
+  if (stats->steps == 0) stats->smallest_dt = 0;
+  for (size_t i = 0; i < n; i++) {
+    body_reset_forces(scene_get_body(scene, i));
+  }
+}
+
+void integrator_step(Integrator integrator, Scene *scene, double dt,
+  Integrator_State *state) {
+    size_t n = scene_bodies(scene);
+    switch (integrator) {
+      case INTEGRATOR_DEFAULT:
+        for (size_t i = 0; i < n; i++) {
+          body_tick(scene_get_body(scene, i), dt);
+        }
+        break;
+      case INTEGRATOR_SYMPLECTIC_EULER:
+        symplectic_euler_step(scene, dt, state);
+        break;
+      case INTEGRATOR_VELOCITY_VERLET:
+        velocity_verlet_step(scene, dt, state);
+        break;
+      case INTEGRATOR_RK4:
+        rk4_step(scene, dt, state);
+        break;
+      case INTEGRATOR_ADAPTIVE_RK45:
+        adaptive_step(scene, dt, state);
+        break;
+    }
+}
+
+void integrator_step_body(Integrator integrator, Body *body, double dt) {
+  Body_Kinematics start = body_get_kinematics(body);
+  if (integrator == INTEGRATOR_DEFAULT) {
+    body_tick(body, dt);
+  } else if (integrates(body)) {
+    Vector v = vec_add(body_get_velocity(body), vec_multiply(1.0 / body_get_mass(body),
+      vec_add(body_get_impulse(body), vec_multiply(dt, body_get_force(body)))));
+    body_set_state(body, vec_add(body_get_centroid(body), vec_multiply(dt, v)), v);
+  } else if (!body_get_stop(body)) {
+    Vector v = body_get_velocity(body);
+    body_set_state(body, vec_add(body_get_centroid(body), vec_multiply(dt, v)), v);
+  }
+  body_reset_forces(body);
+  // body_tick() starts a tick of its own, which isn't what happened
+  Body_Kinematics end = body_get_kinematics(body);
+  end.previous_centroid = start.previous_centroid;
+  end.previous_angle = start.previous_angle;
+  body_set_kinematics(body, end);
+}
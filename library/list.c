@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "../include/list.h"
+#include "../include/allocator.h"
 #include <stddef.h>
 
 struct list {
@@ -12,11 +13,11 @@ struct list {
 };
 
 List *list_init(size_t initial_size, FreeFunc freer) {
-  List *list = (List *) malloc(sizeof(List));
+  List *list = (List *) ENGINE_MALLOC(sizeof(List));
   assert(list != NULL);
   list->size = 0;
   list->capacity = initial_size;
-  list->data = malloc(sizeof(void *) * list->capacity);
+  list->data = ENGINE_MALLOC(sizeof(void *) * list->capacity);
   list->freer = freer;
   return list;
 }
@@ -28,8 +29,8 @@ void list_free(List *list) {
       // Alternatively: arr_list_get(arr_list, i);
     }
   }
-  free(list->data);
-  free(list);
+  allocator_free(list->data);
+  allocator_free(list);
 }
 
 size_t list_size(List *list) {
@@ -75,7 +76,7 @@ void list_grow(List *list) {
     list->capacity *= GROW_FACTOR;
 
     /* https://www.tutorialspoint.com/c_standard_library/c_function_realloc.htm */
-    list->data = realloc(list->data, sizeof(void *) * list->capacity);
+    list->data = ENGINE_REALLOC(list->data, sizeof(void *) * list->capacity);
   }
 }
 
@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <assert.h>
 #include "list.h"
 #include "vector.h"
 #include "polygon.h"
+#include "allocator.h"
 
 double polygon_area(List *polygon) {
   double area = 0;
@@ -48,32 +50,149 @@ Vector polygon_centroid(List *polygon) {
 
 void polygon_translate(List *polygon, Vector translation) {
   /* For each vector in the given vector list, this applies the given
-     transformation. */
+     transformation in place. */
   size_t size = list_size(polygon);
   for(size_t i = 0; i < size; i++) {
-    Vector currVertex = *(Vector *)(list_get(polygon, i));
-    currVertex.x += translation.x;
-    currVertex.y += translation.y;
-    Vector *toSet = (Vector *) malloc(sizeof(Vector));
-    *toSet = currVertex;
-    list_set(polygon, i, toSet);
+    Vector *currVertex = (Vector *)(list_get(polygon, i));
+    currVertex->x += translation.x;
+    currVertex->y += translation.y;
   }
 }
 
 void polygon_rotate(List *polygon, double angle, Vector point) {
-
-  /* Translates the polygon to the (0, 0) position. */
-  Vector translateToZero = vec_multiply(-1.0, point);
-  polygon_translate(polygon, translateToZero);
-  size_t size = list_size(polygon);
   /* Rotates each vector in a given vector list by the given angle about the
-     given point. */
+     given point, in place. */
+  size_t size = list_size(polygon);
   for(size_t i = 0; i < size; i++) {
-    Vector rotatedVec = vec_rotate(*(Vector *)(list_get(polygon, i)), angle);
-    Vector *toSet = (Vector *) malloc(sizeof(Vector));
-    *toSet = rotatedVec;
-    list_set(polygon, i, toSet);
+    Vector *currVertex = (Vector *)(list_get(polygon, i));
+    Vector rotatedVec = vec_rotate(vec_subtract(*currVertex, point), angle);
+    *currVertex = vec_add(rotatedVec, point);
+  }
+}
+
+List *polygon_rectangle(Vector center, double width, double height) {
+  List *points = list_init(4, allocator_free);
+  list_add(points, vec_init((Vector) {center.x + width / 2, center.y + height / 2}));
+  list_add(points, vec_init((Vector) {center.x - width / 2, center.y + height / 2}));
+  list_add(points, vec_init((Vector) {center.x - width / 2, center.y - height / 2}));
+  list_add(points, vec_init((Vector) {center.x + width / 2, center.y - height / 2}));
+  return points;
+}
+
+List *polygon_circle(Vector center, double radius, size_t num_points) {
+  assert(num_points >= 3);
+  List *points = list_init(num_points, allocator_free);
+  for(size_t i = 0; i < num_points; i++) {
+    double angle = 2 * M_PI * i / num_points;
+    Vector pt = {center.x + radius * cos(angle), center.y + radius * sin(angle)};
+    list_add(points, vec_init(pt));
+  }
+  return points;
+}
+
+AABB polygon_bounds(List *polygon) {
+  AABB box = {{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
+  for (size_t i = 0; i < list_size(polygon); i++) {
+    Vector v = *(Vector *) list_get(polygon, i);
+    box.min.x = fmin(box.min.x, v.x);
+    box.min.y = fmin(box.min.y, v.y);
+    box.max.x = fmax(box.max.x, v.x);
+    box.max.y = fmax(box.max.y, v.y);
   }
-  /* Translate polygon back to its original centroid. */
-  polygon_translate(polygon, point);
+  return box;
+}
+
+bool polygon_contains(List *polygon, Vector point) {
+  // The point must be on the inner side of every edge
+  double side = polygon_area(polygon) >= 0 ? 1 : -1;
+  size_t size = list_size(polygon);
+  for (size_t i = 0; i < size; i++) {
+    Vector cur = *(Vector *) list_get(polygon, i);
+    Vector next = *(Vector *) list_get(polygon, (i + 1) % size);
+    if (side * vec_cross(vec_subtract(next, cur), vec_subtract(point, cur)) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether b is a convex corner between a and c, given the polygon's winding
+bool polygon_is_convex_corner(Vector a, Vector b, Vector c, double side) {
+  return side * vec_cross(vec_subtract(b, a), vec_subtract(c, b)) > 0;
+}
+
+// Whether a point is inside triangle abc, wound the given way, or on its edges
+bool triangle_contains(Vector a, Vector b, Vector c, double side, Vector point) {
+  return side * vec_cross(vec_subtract(b, a), vec_subtract(point, a)) >= 0
+    && side * vec_cross(vec_subtract(c, b), vec_subtract(point, b)) >= 0
+    && side * vec_cross(vec_subtract(a, c), vec_subtract(point, c)) >= 0;
+}
+
+size_t polygon_triangulate(List *polygon, size_t *triangles, size_t *scratch) {
+  size_t size = list_size(polygon);
+  assert(size >= 3);
+  double side = polygon_area(polygon) >= 0 ? 1 : -1;
+  bool convex = true;
+  for (size_t i = 0; i < size && convex; i++) {
+    Vector a = *(Vector *) list_get(polygon, i);
+    Vector b = *(Vector *) list_get(polygon, (i + 1) % size);
+    Vector c = *(Vector *) list_get(polygon, (i + 2) % size);
+    convex = side * vec_cross(vec_subtract(b, a), vec_subtract(c, b)) >= 0;
+  }
+  size_t count = 0;
+  if (!convex) {
+    // Ear clipping: repeatedly cut off a convex corner
+    // whose triangle holds none of the other remaining vertices
+    size_t *remaining = scratch;
+    for (size_t i = 0; i < size; i++) remaining[i] = i;
+    size_t num_remaining = size;
+    // Counts the corners tried since the last ear, to give up on bad input
+    size_t tried = 0;
+    for (size_t i = 0; num_remaining > 3 && tried < num_remaining;) {
+      size_t prev = remaining[(i + num_remaining - 1) % num_remaining];
+      size_t next = remaining[(i + 1) % num_remaining];
+      Vector a = *(Vector *) list_get(polygon, prev);
+      Vector b = *(Vector *) list_get(polygon, remaining[i]);
+      Vector c = *(Vector *) list_get(polygon, next);
+      bool ear = polygon_is_convex_corner(a, b, c, side);
+      for (size_t j = 0; j < num_remaining && ear; j++) {
+        size_t k = remaining[j];
+        if (k == prev || k == remaining[i] || k == next) continue;
+        ear = !triangle_contains(a, b, c, side, *(Vector *) list_get(polygon, k));
+      }
+      if (!ear) {
+        i = (i + 1) % num_remaining;
+        tried++;
+        continue;
+      }
+      triangles[3 * count] = prev;
+      triangles[3 * count + 1] = remaining[i];
+      triangles[3 * count + 2] = next;
+      count++;
+      num_remaining--;
+      for (size_t j = i; j < num_remaining; j++) remaining[j] = remaining[j + 1];
+      if (i == num_remaining) i = 0;
+      tried = 0;
+    }
+    // Whatever is left (a triangle, unless the polygon crosses itself) is fanned
+    for (size_t i = 1; i + 1 < num_remaining; i++) {
+      triangles[3 * count] = remaining[0];
+      triangles[3 * count + 1] = remaining[i];
+      triangles[3 * count + 2] = remaining[i + 1];
+      count++;
+    }
+    return count;
+  }
+  for (size_t i = 1; i + 1 < size; i++) {
+    triangles[3 * count] = 0;
+    triangles[3 * count + 1] = i;
+    triangles[3 * count + 2] = i + 1;
+    count++;
+  }
+  return count;
+}
+
+bool aabb_overlap(AABB box1, AABB box2) {
+  return box1.min.x <= box2.max.x && box2.min.x <= box1.max.x
+    && box1.min.y <= box2.max.y && box2.min.y <= box1.max.y;
 }
@@ -0,0 +1,253 @@
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "headless.h"
+
+// How deeply phases can nest
+#define MAX_DEPTH 16
+// The most ForceCreator functions told apart in one PHASE_FORCES;
+// the rest are lumped together under a NULL creator
+#define MAX_FORCE_TYPES 64
+#define US_PER_S 1e6
+
+const char *PHASE_NAMES[NUM_PHASES] = {
+  "tick", "forces", "force type", "collisions", "commands", "removal",
+  "integration", "impacts", "events", "render"
+};
+
+// A single-producer, single-consumer queue of fixed-size items.
+// head is only written by the producer and tail by the consumer,
+// so each side only has to wait for the other's writes to be visible.
+typedef struct {
+  char *items;
+  size_t item_size;
+  size_t capacity;
+  atomic_size_t head;
+  atomic_size_t tail;
+} Profile_Ring;
+
+typedef struct {
+  Profile_Phase phase;
+  double start;
+} Open_Phase;
+
+typedef struct {
+  ForceCreator creator;
+  size_t calls;
+  double time;
+} Force_Total;
+
+bool profiler_on = false;
+Profile_Ring profiler_spans;
+Profile_Ring profiler_ticks;
+atomic_size_t profiler_drops;
+atomic_size_t profiler_allocs;
+
+// Only touched by the thread ticking the scene
+Open_Phase profiler_stack[MAX_DEPTH];
+size_t profiler_depth = 0;
+Force_Total profiler_forces[MAX_FORCE_TYPES];
+size_t profiler_num_forces = 0;
+Profile_Tick profiler_tick;
+size_t profiler_allocs_at_tick = 0;
+size_t profiler_ticks_done = 0;
+
+#ifdef PROFILE
+// A profiled build is linked with malloc(), calloc() and realloc() wrapped
+// (see PROFILE in the Makefile), so each tick can count its allocations
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  atomic_fetch_add_explicit(&profiler_allocs, 1, memory_order_relaxed);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  atomic_fetch_add_explicit(&profiler_allocs, 1, memory_order_relaxed);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  atomic_fetch_add_explicit(&profiler_allocs, 1, memory_order_relaxed);
+  return __real_realloc(pointer, size);
+}
+#endif
+
+void ring_init(Profile_Ring *ring, size_t item_size, size_t capacity) {
+  assert(capacity > 0);
+  ring->items = malloc(item_size * capacity);
+  assert(ring->items != NULL);
+  ring->item_size = item_size;
+  ring->capacity = capacity;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+}
+
+void ring_push(Profile_Ring *ring, const void *item) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail == ring->capacity) {
+    atomic_fetch_add_explicit(&profiler_drops, 1, memory_order_relaxed);
+    return;
+  }
+  memcpy(ring->items + (head % ring->capacity) * ring->item_size, item,
+    ring->item_size);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+bool ring_pop(Profile_Ring *ring, void *item) {
+  if (ring->items == NULL) return false;
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail == head) return false;
+  memcpy(item, ring->items + (tail % ring->capacity) * ring->item_size,
+    ring->item_size);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+void profiler_start(size_t span_capacity, size_t tick_capacity) {
+  assert(!profiler_on);
+  ring_init(&profiler_spans, sizeof(Profile_Span), span_capacity);
+  ring_init(&profiler_ticks, sizeof(Profile_Tick), tick_capacity);
+  atomic_store(&profiler_drops, 0);
+  profiler_depth = 0;
+  profiler_num_forces = 0;
+  profiler_ticks_done = 0;
+  profiler_on = true;
+}
+
+void profiler_stop(void) {
+  profiler_on = false;
+  free(profiler_spans.items);
+  free(profiler_ticks.items);
+  profiler_spans.items = NULL;
+  profiler_ticks.items = NULL;
+}
+
+bool profiler_recording(void) {
+  return profiler_on;
+}
+
+bool profiler_read_span(Profile_Span *span) {
+  return ring_pop(&profiler_spans, span);
+}
+
+bool profiler_read_tick(Profile_Tick *tick) {
+  return ring_pop(&profiler_ticks, tick);
+}
+
+size_t profiler_dropped(void) {
+  return atomic_load(&profiler_drops);
+}
+
+void profiler_begin(Profile_Phase phase) {
+  if (!profiler_on) return;
+  assert(profiler_depth < MAX_DEPTH);
+  double now = headless_wall_time();
+  profiler_stack[profiler_depth++] = (Open_Phase) {phase, now};
+  if (phase == PHASE_TICK) {
+    memset(&profiler_tick, 0, sizeof(Profile_Tick));
+    profiler_tick.tick = profiler_ticks_done;
+    profiler_tick.start = now;
+    profiler_allocs_at_tick = atomic_load_explicit(&profiler_allocs, memory_order_relaxed);
+  }
+}
+
+// Ends the innermost phase, which should be the given one,
+// and returns when it started, or NAN if recording began since
+double profiler_pop(Profile_Phase phase, double now) {
+  if (profiler_depth == 0) return NAN;
+  Open_Phase open = profiler_stack[--profiler_depth];
+  assert(open.phase == phase);
+  profiler_tick.phase_time[phase] += now - open.start;
+  return open.start;
+}
+
+// Records one span for each ForceCreator function that ran during a
+// PHASE_FORCES, laid end to end from its start, and starts the next afresh
+void profiler_flush_forces(double start) {
+  for (size_t i = 0; i < profiler_num_forces; i++) {
+    Force_Total total = profiler_forces[i];
+    Profile_Span span = {PHASE_FORCE_TYPE, total.creator, total.calls,
+      profiler_ticks_done, start, total.time};
+    ring_push(&profiler_spans, &span);
+    start += total.time;
+  }
+  profiler_num_forces = 0;
+}
+
+void profiler_end(Profile_Phase phase) {
+  if (!profiler_on) return;
+  double now = headless_wall_time();
+  double start = profiler_pop(phase, now);
+  if (isnan(start)) return;
+
+  if (phase == PHASE_FORCES) profiler_flush_forces(start);
+  Profile_Span span = {phase, NULL, 0, profiler_ticks_done, start, now - start};
+  ring_push(&profiler_spans, &span);
+  if (phase == PHASE_TICK) {
+    profiler_tick.duration = now - start;
+    profiler_tick.allocations = atomic_load_explicit(&profiler_allocs,
+      memory_order_relaxed) - profiler_allocs_at_tick;
+    ring_push(&profiler_ticks, &profiler_tick);
+    profiler_ticks_done++;
+  }
+}
+
+void profiler_end_force(ForceCreator creator) {
+  if (!profiler_on) return;
+  double now = headless_wall_time();
+  double start = profiler_pop(PHASE_FORCE_TYPE, now);
+  if (isnan(start)) return;
+
+  size_t i = 0;
+  while (i < profiler_num_forces && profiler_forces[i].creator != creator) i++;
+  if (i == MAX_FORCE_TYPES) {
+    i = MAX_FORCE_TYPES - 1;
+    profiler_forces[i].creator = NULL;
+  } else if (i == profiler_num_forces) {
+    profiler_forces[profiler_num_forces++] = (Force_Total) {creator, 0, 0};
+  }
+  profiler_forces[i].calls++;
+  profiler_forces[i].time += now - start;
+}
+
+void profiler_count_narrowphase(void) {
+  if (profiler_on) profiler_tick.narrowphase_tests++;
+}
+
+void profiler_write_chrome_trace(FILE *out) {
+  fprintf(out, "{\"traceEvents\": [");
+  bool first = true;
+  Profile_Span span;
+  while (profiler_read_span(&span)) {
+    char name[32];
+    if (span.phase == PHASE_FORCE_TYPE) {
+      snprintf(name, sizeof(name), "force %p", (void *) (uintptr_t) span.creator);
+    } else {
+      snprintf(name, sizeof(name), "%s", PHASE_NAMES[span.phase]);
+    }
+    fprintf(out, "%s\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+      "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": 1, "
+      "\"args\": {\"tick\": %zu, \"calls\": %zu}}",
+      first ? "" : ",", name, PHASE_NAMES[span.phase], span.start * US_PER_S,
+      span.duration * US_PER_S, span.tick, span.calls);
+    first = false;
+  }
+  Profile_Tick tick;
+  while (profiler_read_tick(&tick)) {
+    fprintf(out, "%s\n  {\"name\": \"tick counts\", \"ph\": \"C\", \"ts\": %.3f, "
+      "\"pid\": 1, \"args\": {\"narrowphase tests\": %zu, \"allocations\": %zu}}",
+      first ? "" : ",", tick.start * US_PER_S, tick.narrowphase_tests,
+      tick.allocations);
+    first = false;
+  }
+  fprintf(out, "\n]}\n");
+}
@@ -0,0 +1,202 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "quadtree.h"
+#include "allocator.h"
+#include "list.h"
+
+#define NO_NODE -1
+#define NO_POINT -1
+// Points closer together than the root's width / 2^MAX_DEPTH share a leaf
+#define MAX_DEPTH 48
+// A depth-first traversal pushes at most 3 siblings per level plus 4 children
+#define STACK_SIZE (3 * MAX_DEPTH + 4)
+
+typedef struct {
+  Vector center; // center of the node's square
+  double half_width;
+  double mass; // total mass of the points inside
+  Vector center_of_mass; // mass-weighted sum of positions until the build ends
+  int children[4]; // indexed by quadrant(), or NO_NODE
+  long point; // the first point stored in a leaf, or NO_POINT
+  bool leaf;
+} Node;
+
+struct quadtree {
+  Node *nodes;
+  size_t num_nodes;
+  size_t capacity;
+  const Vector *positions;
+  const double *masses;
+  size_t num_points;
+};
+
+Quadtree *quadtree_init(void) {
+  Quadtree *tree = ENGINE_MALLOC(sizeof(Quadtree));
+  assert(tree != NULL);
+  tree->nodes = NULL;
+  tree->num_nodes = 0;
+  tree->capacity = 0;
+  tree->positions = NULL;
+  tree->masses = NULL;
+  tree->num_points = 0;
+  return tree;
+}
+
+void quadtree_free(Quadtree *tree) {
+  allocator_free(tree->nodes);
+  allocator_free(tree);
+}
+
+size_t quadtree_nodes(Quadtree *tree) {
+  return tree->num_nodes;
+}
+
+int quadtree_add_node(Quadtree *tree, Vector center, double half_width) {
+  if (tree->num_nodes == tree->capacity) {
+    tree->capacity = tree->capacity > 0 ? tree->capacity * GROW_FACTOR : INITIAL_CAPACITY;
+    tree->nodes = ENGINE_REALLOC(tree->nodes, sizeof(Node) * tree->capacity);
+    assert(tree->nodes != NULL);
+  }
+  Node *node = &tree->nodes[tree->num_nodes];
+  node->center = center;
+  node->half_width = half_width;
+  node->mass = 0;
+  node->center_of_mass = VEC_ZERO;
+  for (size_t q = 0; q < 4; q++) node->children[q] = NO_NODE;
+  node->point = NO_POINT;
+  node->leaf = true;
+  return tree->num_nodes++;
+}
+
+int quadrant(Node *node, Vector position) {
+  return (position.x >= node->center.x) + 2 * (position.y >= node->center.y);
+}
+
+// Gets the child of a node in the quadrant containing a position,
+// creating it if needed. May move the tree's nodes.
+int quadtree_child(Quadtree *tree, int parent, Vector position) {
+  Node *node = &tree->nodes[parent];
+  int q = quadrant(node, position);
+  if (node->children[q] == NO_NODE) {
+    double half = node->half_width / 2;
+    Vector center = {
+      node->center.x + (q & 1 ? half : -half),
+      node->center.y + (q & 2 ? half : -half)
+    };
+    int child = quadtree_add_node(tree, center, half);
+    tree->nodes[parent].children[q] = child;
+  }
+  return tree->nodes[parent].children[q];
+}
+
+void quadtree_add_mass(Quadtree *tree, int index, size_t point) {
+  Node *node = &tree->nodes[index];
+  double mass = tree->masses[point];
+  node->mass += mass;
+  node->center_of_mass = vec_add(node->center_of_mass,
+    vec_multiply(mass, tree->positions[point]));
+}
+
+void quadtree_insert(Quadtree *tree, size_t point) {
+  Vector position = tree->positions[point];
+  int index = 0;
+  for (size_t depth = 0; ; depth++) {
+    quadtree_add_mass(tree, index, point);
+    Node *node = &tree->nodes[index];
+    if (node->leaf && node->point == NO_POINT) {
+      node->point = point;
+      return;
+    }
+    if (node->leaf) {
+      // Coincident points would split forever, so stop and share the leaf
+      if (depth == MAX_DEPTH) return;
+      size_t resident = node->point;
+      node->leaf = false;
+      node->point = NO_POINT;
+      int child = quadtree_child(tree, index, tree->positions[resident]);
+      quadtree_add_mass(tree, child, resident);
+      tree->nodes[child].point = resident;
+    }
+    index = quadtree_child(tree, index, position);
+  }
+}
+
+void quadtree_build(Quadtree *tree, const Vector *positions, const double *masses,
+  size_t n) {
+    tree->positions = positions;
+    tree->masses = masses;
+    tree->num_points = n;
+    tree->num_nodes = 0;
+
+    // The root is the smallest square containing every point
+    Vector min = {INFINITY, INFINITY};
+    Vector max = {-INFINITY, -INFINITY};
+    for (size_t i = 0; i < n; i++) {
+      assert(isfinite(masses[i]));
+      min.x = fmin(min.x, positions[i].x);
+      min.y = fmin(min.y, positions[i].y);
+      max.x = fmax(max.x, positions[i].x);
+      max.y = fmax(max.y, positions[i].y);
+    }
+    if (n == 0) return;
+    double half_width = fmax(max.x - min.x, max.y - min.y) / 2;
+    // Points on the far edges belong to the upper quadrants, so pad a little
+    half_width = half_width > 0 ? half_width * (1 + 1e-9) : 1;
+    quadtree_add_node(tree, vec_multiply(0.5, vec_add(min, max)), half_width);
+
+    for (size_t i = 0; i < n; i++) {
+      quadtree_insert(tree, i);
+    }
+    for (size_t i = 0; i < tree->num_nodes; i++) {
+      Node *node = &tree->nodes[i];
+      node->center_of_mass = node->mass > 0
+        ? vec_multiply(1.0 / node->mass, node->center_of_mass)
+        : node->center;
+    }
+}
+
+Vector quadtree_field(Quadtree *tree, size_t index, double theta,
+  double min_distance) {
+    assert(index < tree->num_points);
+    Vector position = tree->positions[index];
+    // Accumulate component-wise: this is the innermost loop of N-body gravity
+    double field_x = 0, field_y = 0;
+    if (tree->num_nodes == 0) return VEC_ZERO;
+    double theta_squared = theta * theta;
+    double min_squared = min_distance * min_distance;
+
+    int stack[STACK_SIZE];
+    size_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      Node *node = &tree->nodes[stack[--top]];
+      double dx = node->center_of_mass.x - position.x;
+      double dy = node->center_of_mass.y - position.y;
+      double dist_squared = dx * dx + dy * dy;
+      // Leaves are single masses (or a few that can't be told apart);
+      // other nodes count as one mass when width / distance < theta.
+      // A node around the point includes its own mass, so always open it.
+      double width = 2 * node->half_width;
+      bool contains = fabs(position.x - node->center.x) <= node->half_width
+        && fabs(position.y - node->center.y) <= node->half_width;
+      bool far = !contains && width * width < theta_squared * dist_squared;
+      if (node->leaf || far) {
+        if (node->point == (long) index || dist_squared < min_squared
+          || dist_squared == 0) {
+            continue;
+        }
+        double scale = node->mass / (dist_squared * sqrt(dist_squared));
+        field_x += scale * dx;
+        field_y += scale * dy;
+        continue;
+      }
+      for (size_t q = 0; q < 4; q++) {
+        if (node->children[q] != NO_NODE) {
+          assert(top < STACK_SIZE);
+          stack[top++] = node->children[q];
+        }
+      }
+    }
+    return (Vector) {field_x, field_y};
+}
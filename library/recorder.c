@@ -0,0 +1,423 @@
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "recorder.h"
+#include "allocator.h"
+
+// "TRAJ", read as a little-endian integer
+#define RECORDING_MAGIC 0x4A415254u
+#define RECORDING_VERSION 1
+// The magic number, the version and the two quanta
+#define RECORDING_HEADER_SIZE 24
+// Each chunk's size in bytes, then its number of frames
+#define CHUNK_HEADER_SIZE 8
+#define FRAME_KEY 0
+#define FRAME_DELTA 1
+// The most bytes a variable-length 64-bit integer takes
+#define MAX_VARINT_BYTES 10
+// The fewest bytes a body takes in a frame: three one-byte integers
+#define MIN_BODY_BYTES 3
+
+// Encoded frames on their way to the writer thread
+typedef struct chunk {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  uint32_t num_frames;
+  struct chunk *next;
+} Chunk;
+
+// A body's position and angle, in quanta
+typedef struct {
+  int64_t x;
+  int64_t y;
+  int64_t angle;
+} Quantized;
+
+struct recorder {
+  Scene *scene;
+  FILE *file;
+  Recorder_Config config;
+  size_t tick;
+  double time;
+  // Where each body was in the last frame
+  Quantized *previous;
+  size_t num_previous;
+  size_t previous_capacity;
+  size_t frames_since_keyframe;
+  // The chunk being encoded
+  Chunk *chunk;
+  // The lock guards the queue of chunks waiting to be written, oldest first,
+  // and the flags the two threads share
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  Chunk *queue_head;
+  Chunk *queue_tail;
+  bool closing;
+  bool write_failed;
+  pthread_t writer;
+};
+
+struct trajectory {
+  FILE *file;
+  double position_quantum;
+  double angle_quantum;
+  // The chunk being decoded, and how far decoding has got
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  size_t position;
+  uint32_t frames_left;
+  bool failed;
+  // Where each body was in the last frame, and where to return it
+  Quantized *previous;
+  size_t num_previous;
+  size_t previous_capacity;
+  Vector *positions;
+  double *angles;
+};
+
+Chunk *chunk_init(size_t capacity) {
+  Chunk *chunk = ENGINE_MALLOC(sizeof(Chunk));
+  assert(chunk != NULL);
+  chunk->data = ENGINE_MALLOC(capacity);
+  assert(chunk->data != NULL);
+  chunk->size = 0;
+  chunk->capacity = capacity;
+  chunk->num_frames = 0;
+  chunk->next = NULL;
+  return chunk;
+}
+
+void chunk_free(Chunk *chunk) {
+  allocator_free(chunk->data);
+  allocator_free(chunk);
+}
+
+void chunk_reserve(Chunk *chunk, size_t bytes) {
+  if (chunk->size + bytes <= chunk->capacity) return;
+  while (chunk->size + bytes > chunk->capacity) chunk->capacity *= GROW_FACTOR;
+  chunk->data = ENGINE_REALLOC(chunk->data, chunk->capacity);
+  assert(chunk->data != NULL);
+}
+
+void encode_bytes(uint8_t *data, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) data[i] = (uint8_t) (value >> (8 * i));
+}
+
+uint64_t decode_bytes(const uint8_t *data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) value |= (uint64_t) data[i] << (8 * i);
+  return value;
+}
+
+void chunk_write_bytes(Chunk *chunk, uint64_t value, size_t bytes) {
+  chunk_reserve(chunk, bytes);
+  encode_bytes(chunk->data + chunk->size, value, bytes);
+  chunk->size += bytes;
+}
+
+void chunk_write_double(Chunk *chunk, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  chunk_write_bytes(chunk, bits, sizeof(bits));
+}
+
+// Seven bits per byte, low bits first, with the top bit set on all but the last
+void chunk_write_varint(Chunk *chunk, uint64_t value) {
+  chunk_reserve(chunk, MAX_VARINT_BYTES);
+  while (value >= 0x80) {
+    chunk->data[chunk->size++] = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  chunk->data[chunk->size++] = (uint8_t) value;
+}
+
+// Interleaves negative and positive values, so small ones of either sign are short
+void chunk_write_signed(Chunk *chunk, int64_t value) {
+  uint64_t doubled = (uint64_t) value << 1;
+  chunk_write_varint(chunk, value < 0 ? ~doubled : doubled);
+}
+
+void *recorder_write_chunks(Recorder *recorder) {
+  pthread_mutex_lock(&recorder->lock);
+  while (true) {
+    while (recorder->queue_head == NULL && !recorder->closing) {
+      pthread_cond_wait(&recorder->ready, &recorder->lock);
+    }
+    Chunk *chunk = recorder->queue_head;
+    if (chunk == NULL) break;
+    recorder->queue_head = chunk->next;
+    if (recorder->queue_head == NULL) recorder->queue_tail = NULL;
+    pthread_mutex_unlock(&recorder->lock);
+
+    uint8_t header[CHUNK_HEADER_SIZE];
+    encode_bytes(header, chunk->size, sizeof(uint32_t));
+    encode_bytes(header + sizeof(uint32_t), chunk->num_frames, sizeof(uint32_t));
+    bool written = fwrite(header, 1, CHUNK_HEADER_SIZE, recorder->file) == CHUNK_HEADER_SIZE
+      && fwrite(chunk->data, 1, chunk->size, recorder->file) == chunk->size;
+    chunk_free(chunk);
+
+    pthread_mutex_lock(&recorder->lock);
+    if (!written) recorder->write_failed = true;
+  }
+  pthread_mutex_unlock(&recorder->lock);
+  return NULL;
+}
+
+// Hands the chunk being encoded to the writer thread
+void recorder_submit(Recorder *recorder) {
+  Chunk *chunk = recorder->chunk;
+  recorder->chunk = chunk_init(recorder->config.chunk_size);
+  pthread_mutex_lock(&recorder->lock);
+  if (recorder->queue_tail != NULL) recorder->queue_tail->next = chunk;
+  else recorder->queue_head = chunk;
+  recorder->queue_tail = chunk;
+  pthread_cond_signal(&recorder->ready);
+  pthread_mutex_unlock(&recorder->lock);
+}
+
+void recorder_record(Scene *scene, Recorder *recorder) {
+  size_t num_bodies = scene_bodies(scene);
+  recorder->time += scene_get_tick_dt(scene);
+  Chunk *chunk = recorder->chunk;
+  bool keyframe = chunk->num_frames == 0
+    || num_bodies != recorder->num_previous
+    || recorder->frames_since_keyframe + 1 >= recorder->config.keyframe_interval;
+
+  chunk_write_bytes(chunk, keyframe ? FRAME_KEY : FRAME_DELTA, 1);
+  chunk_write_varint(chunk, recorder->tick);
+  chunk_write_double(chunk, recorder->time);
+  chunk_write_varint(chunk, num_bodies);
+  if (num_bodies > recorder->previous_capacity) {
+    recorder->previous_capacity = num_bodies * GROW_FACTOR;
+    recorder->previous = ENGINE_REALLOC(recorder->previous,
+      sizeof(Quantized) * recorder->previous_capacity);
+    assert(recorder->previous != NULL);
+  }
+  for (size_t i = 0; i < num_bodies; i++) {
+    Body *body = scene_get_body(scene, i);
+    Vector centroid = body_get_centroid(body);
+    Quantized now = {
+      llround(centroid.x / recorder->config.position_quantum),
+      llround(centroid.y / recorder->config.position_quantum),
+      llround(body_get_angle(body) / recorder->config.angle_quantum)
+    };
+    Quantized base = keyframe ? (Quantized) {0, 0, 0} : recorder->previous[i];
+    chunk_write_signed(chunk, now.x - base.x);
+    chunk_write_signed(chunk, now.y - base.y);
+    chunk_write_signed(chunk, now.angle - base.angle);
+    recorder->previous[i] = now;
+  }
+  recorder->num_previous = num_bodies;
+  recorder->frames_since_keyframe = keyframe ? 0 : recorder->frames_since_keyframe + 1;
+  recorder->tick++;
+  chunk->num_frames++;
+  if (chunk->size >= recorder->config.chunk_size) recorder_submit(recorder);
+}
+
+Recorder *recorder_init(Scene *scene, FILE *file, Recorder_Config config) {
+  assert(config.position_quantum > 0);
+  assert(config.angle_quantum > 0);
+  assert(config.keyframe_interval > 0);
+  assert(config.chunk_size > 0);
+  Recorder *recorder = ENGINE_MALLOC(sizeof(Recorder));
+  assert(recorder != NULL);
+  recorder->scene = scene;
+  recorder->file = file;
+  recorder->config = config;
+  recorder->tick = 0;
+  recorder->time = 0;
+  recorder->previous = NULL;
+  recorder->num_previous = 0;
+  recorder->previous_capacity = 0;
+  recorder->frames_since_keyframe = 0;
+  recorder->chunk = chunk_init(config.chunk_size);
+  recorder->queue_head = NULL;
+  recorder->queue_tail = NULL;
+  recorder->closing = false;
+
+  uint8_t header[RECORDING_HEADER_SIZE];
+  uint64_t position_bits, angle_bits;
+  memcpy(&position_bits, &config.position_quantum, sizeof(position_bits));
+  memcpy(&angle_bits, &config.angle_quantum, sizeof(angle_bits));
+  encode_bytes(header, RECORDING_MAGIC, sizeof(uint32_t));
+  encode_bytes(header + 4, RECORDING_VERSION, sizeof(uint32_t));
+  encode_bytes(header + 8, position_bits, sizeof(uint64_t));
+  encode_bytes(header + 16, angle_bits, sizeof(uint64_t));
+  recorder->write_failed =
+    fwrite(header, 1, RECORDING_HEADER_SIZE, file) != RECORDING_HEADER_SIZE;
+
+  pthread_mutex_init(&recorder->lock, NULL);
+  pthread_cond_init(&recorder->ready, NULL);
+  int started = pthread_create(&recorder->writer, NULL,
+    (void *(*)(void *)) recorder_write_chunks, recorder);
+  assert(started == 0);
+  scene_add_tick_listener(scene, (TickListener) recorder_record, recorder);
+  return recorder;
+}
+
+bool recorder_free(Recorder *recorder) {
+  scene_remove_tick_listener(recorder->scene, (TickListener) recorder_record, recorder);
+  if (recorder->chunk->num_frames > 0) recorder_submit(recorder);
+  chunk_free(recorder->chunk);
+
+  pthread_mutex_lock(&recorder->lock);
+  recorder->closing = true;
+  pthread_cond_signal(&recorder->ready);
+  pthread_mutex_unlock(&recorder->lock);
+  pthread_join(recorder->writer, NULL);
+
+  bool written = !recorder->write_failed && fflush(recorder->file) == 0;
+  pthread_mutex_destroy(&recorder->lock);
+  pthread_cond_destroy(&recorder->ready);
+  allocator_free(recorder->previous);
+  allocator_free(recorder);
+  return written;
+}
+
+uint64_t trajectory_read_bytes(Trajectory *trajectory, size_t bytes) {
+  if (trajectory->failed || trajectory->position + bytes > trajectory->size) {
+    trajectory->failed = true;
+    return 0;
+  }
+  uint64_t value = decode_bytes(trajectory->data + trajectory->position, bytes);
+  trajectory->position += bytes;
+  return value;
+}
+
+double trajectory_read_double(Trajectory *trajectory) {
+  uint64_t bits = trajectory_read_bytes(trajectory, sizeof(bits));
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint64_t trajectory_read_varint(Trajectory *trajectory) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < MAX_VARINT_BYTES; i++) {
+    uint64_t byte = trajectory_read_bytes(trajectory, 1);
+    value |= (byte & 0x7F) << (7 * i);
+    if (byte < 0x80) return value;
+  }
+  trajectory->failed = true;
+  return 0;
+}
+
+int64_t trajectory_read_signed(Trajectory *trajectory) {
+  uint64_t value = trajectory_read_varint(trajectory);
+  return (int64_t) (value & 1 ? ~(value >> 1) : value >> 1);
+}
+
+// Reads the next chunk's bytes in, returning false at the end of the file
+bool trajectory_read_chunk(Trajectory *trajectory) {
+  uint8_t header[CHUNK_HEADER_SIZE];
+  size_t read = fread(header, 1, CHUNK_HEADER_SIZE, trajectory->file);
+  if (read == 0) return false;
+  size_t size = decode_bytes(header, sizeof(uint32_t));
+  trajectory->frames_left = decode_bytes(header + sizeof(uint32_t), sizeof(uint32_t));
+  if (read < CHUNK_HEADER_SIZE || trajectory->frames_left == 0) {
+    trajectory->failed = true;
+    return false;
+  }
+  if (size > trajectory->capacity) {
+    trajectory->capacity = size;
+    trajectory->data = ENGINE_REALLOC(trajectory->data, size);
+    assert(trajectory->data != NULL);
+  }
+  trajectory->size = size;
+  trajectory->position = 0;
+  if (fread(trajectory->data, 1, size, trajectory->file) != size) {
+    trajectory->failed = true;
+    return false;
+  }
+  return true;
+}
+
+Trajectory *trajectory_open(FILE *file) {
+  Trajectory *trajectory = ENGINE_MALLOC(sizeof(Trajectory));
+  assert(trajectory != NULL);
+  trajectory->file = file;
+  trajectory->data = ENGINE_MALLOC(RECORDING_HEADER_SIZE);
+  assert(trajectory->data != NULL);
+  trajectory->capacity = RECORDING_HEADER_SIZE;
+  trajectory->size = fread(trajectory->data, 1, RECORDING_HEADER_SIZE, file);
+  trajectory->position = 0;
+  trajectory->frames_left = 0;
+  trajectory->failed = false;
+  trajectory->previous = NULL;
+  trajectory->num_previous = 0;
+  trajectory->previous_capacity = 0;
+  trajectory->positions = NULL;
+  trajectory->angles = NULL;
+
+  bool valid = trajectory_read_bytes(trajectory, sizeof(uint32_t)) == RECORDING_MAGIC
+    && trajectory_read_bytes(trajectory, sizeof(uint32_t)) == RECORDING_VERSION;
+  trajectory->position_quantum = trajectory_read_double(trajectory);
+  trajectory->angle_quantum = trajectory_read_double(trajectory);
+  if (!valid || trajectory->failed) {
+    trajectory_close(trajectory);
+    return NULL;
+  }
+  return trajectory;
+}
+
+bool trajectory_next_frame(Trajectory *trajectory, Trajectory_Frame *frame) {
+  if (trajectory->failed) return false;
+  if (trajectory->frames_left == 0 && !trajectory_read_chunk(trajectory)) return false;
+
+  uint64_t kind = trajectory_read_bytes(trajectory, 1);
+  frame->tick = trajectory_read_varint(trajectory);
+  frame->time = trajectory_read_double(trajectory);
+  uint64_t num_bodies = trajectory_read_varint(trajectory);
+  if ((kind != FRAME_KEY && kind != FRAME_DELTA)
+    || (kind == FRAME_DELTA && num_bodies != trajectory->num_previous)
+    || num_bodies > (trajectory->size - trajectory->position) / MIN_BODY_BYTES) {
+      trajectory->failed = true;
+      return false;
+  }
+  if (num_bodies > trajectory->previous_capacity) {
+    trajectory->previous_capacity = num_bodies;
+    trajectory->previous = ENGINE_REALLOC(trajectory->previous, sizeof(Quantized) * num_bodies);
+    trajectory->positions = ENGINE_REALLOC(trajectory->positions, sizeof(Vector) * num_bodies);
+    trajectory->angles = ENGINE_REALLOC(trajectory->angles, sizeof(double) * num_bodies);
+    assert(trajectory->previous != NULL && trajectory->positions != NULL
+      && trajectory->angles != NULL);
+  }
+  for (size_t i = 0; i < num_bodies; i++) {
+    Quantized *body = &trajectory->previous[i];
+    if (kind == FRAME_KEY) *body = (Quantized) {0, 0, 0};
+    // Wrapping, rather than overflowing, on corrupt deltas
+    body->x = (int64_t) ((uint64_t) body->x + (uint64_t) trajectory_read_signed(trajectory));
+    body->y = (int64_t) ((uint64_t) body->y + (uint64_t) trajectory_read_signed(trajectory));
+    body->angle = (int64_t) ((uint64_t) body->angle
+      + (uint64_t) trajectory_read_signed(trajectory));
+    trajectory->positions[i] = (Vector) {
+      body->x * trajectory->position_quantum,
+      body->y * trajectory->position_quantum
+    };
+    trajectory->angles[i] = body->angle * trajectory->angle_quantum;
+  }
+  trajectory->num_previous = num_bodies;
+  trajectory->frames_left--;
+  if (trajectory->frames_left == 0 && trajectory->position != trajectory->size) {
+    trajectory->failed = true;
+  }
+  if (trajectory->failed) return false;
+
+  frame->num_bodies = num_bodies;
+  frame->positions = trajectory->positions;
+  frame->angles = trajectory->angles;
+  return true;
+}
+
+void trajectory_close(Trajectory *trajectory) {
+  allocator_free(trajectory->data);
+  allocator_free(trajectory->previous);
+  allocator_free(trajectory->positions);
+  allocator_free(trajectory->angles);
+  allocator_free(trajectory);
+}
@@ -0,0 +1,36 @@
+#include <assert.h>
+#include "rng.h"
+
+// SplitMix64: the state steps by a fixed odd constant,
+// and each step is scrambled into an output
+const uint64_t RNG_INCREMENT = 0x9e3779b97f4a7c15;
+
+Rng rng_init(uint64_t seed) {
+  return (Rng) {seed};
+}
+
+uint64_t rng_next(Rng *rng) {
+  rng->state += RNG_INCREMENT;
+  uint64_t z = rng->state;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+double rng_double(Rng *rng, double min, double max) {
+  // The top 53 bits fill a double's significand exactly
+  double unit = (rng_next(rng) >> 11) * 0x1p-53;
+  return min + unit * (max - min);
+}
+
+size_t rng_index(Rng *rng, size_t n) {
+  assert(n > 0);
+  // Redraws values in the incomplete last run of n,
+  // which would otherwise favor the low indices
+  uint64_t limit = UINT64_MAX - UINT64_MAX % n;
+  uint64_t value;
+  do {
+    value = rng_next(rng);
+  } while (value >= limit);
+  return value % n;
+}
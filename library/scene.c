@@ -12,32 +12,189 @@
  #include <stdio.h>
  #include <stdlib.h>
  #include <math.h>
+ #include <stdint.h>
+ #include <string.h>
  #include "scene.h"
+ #include "allocator.h"
  #include "list.h"
  #include "vector.h"
  #include "polygon.h"
+ #include "collision.h"
+ #include "broadphase.h"
+ #include "profiler.h"
+
+// How close continuous collision detection brings two bodies before calling
+// them touching, as a fraction of how far they close in on each other per tick
+#define CCD_TOLERANCE 1e-3
+#define CCD_MAX_ITERATIONS 50
+// How many passes the solver makes over the touching pairs each tick
+#define SOLVER_ITERATIONS 8
+// Collisions whose impulse is larger than this set COLLISION_PHYSICS bodies spinning
+#define SPIN_IMPULSE 10
+// How much of their overlap the solver pushes touching bodies apart by each
+// tick, so that stacks don't sink into each other
+#define POSITION_CORRECTION 0.2
+
+// When, as a fraction of the last tick, two continuous bodies first touched
+typedef struct {
+  double time;
+  size_t first;
+  size_t second;
+  Vector axis;
+} Impact;
+
+// A pair of bodies touching, oriented as the first event filter covering
+// them asks. The pair's order in last tick's contacts is its rank.
+typedef struct {
+  Body *body1;
+  Body *body2;
+  Vector axis;
+  size_t rank;
+  bool seen;
+} Contact;
+
+// A collision table entry: a response, or an event filter
+typedef struct {
+  uint32_t mask1;
+  uint32_t mask2;
+  bool filter;
+  Collision_Response response;
+} Collision_Entry;
+
+// A touching pair the solver has to respond to. The axis points from
+// body1 towards body2, and body2 moving along it at target relative to
+// body1 is enough to part them; impulse is the total applied so far.
+typedef struct {
+  Body *body1;
+  Body *body2;
+  CollisionInfo info;
+  Collision_Response response;
+  double target;
+  double impulse;
+} Resolution;
+
+typedef enum {
+  COMMAND_ADD_BODY,
+  COMMAND_SET_BODY,
+  COMMAND_ADD_FORCE,
+  COMMAND_ADD_COLLISION_ENTRY
+} Command_Type;
+
+// A change to the scene asked for during a tick, held until a sync point.
+// Replacements name the body they replace rather than its index,
+// since indices shift as removed bodies are freed.
+typedef struct {
+  Command_Type type;
+  Body *body;
+  Body *replaced;
+  Instance_Force *force;
+  Collision_Entry *entry;
+} Command;
+
+// Where a body was when its query index box was last worked out
+typedef struct {
+  Body *body;
+  List *shape;
+  Vector centroid;
+  double angle;
+  AABB box;
+} Placement;
+
+// A function to call at the end of each tick
+typedef struct {
+  TickListener listener;
+  void *aux;
+} Tick_Listener_Entry;
 
 struct scene {
   List *bodies;
   size_t num_bodies;
+  // The bodies with each tag; each body knows its index in its list
+  List *tagged[NUM_TAGS];
   List *instance_forces;
   size_t num_instance_forces;
+  Integrator integrator;
+  Integrator_State *integrator_state;
+  double tick_dt;
+  List *collision_entries;
+  // For each tag, the tags some collision table entry pairs it with
+  uint32_t collides_with[NUM_TAGS];
+  Broadphase *broadphase;
+  // Finds the pairs whose paths through a tick crossed, for continuous bodies
+  Broadphase *swept_broadphase;
+  Impact *impacts;
+  size_t num_impacts;
+  size_t impacts_capacity;
+  // Scratch copies of a candidate pair's shapes, reused across impact tests
+  List *impact_shapes[2];
+  // Every body's bounding box, for queries, and whether it needs refreshing.
+  // Refreshing only works out the boxes of bodies that moved since their
+  // placements were recorded.
+  Broadphase *query_index;
+  bool query_index_stale;
+  Placement *placements;
+  size_t num_placements;
+  size_t placements_capacity;
+  // The pairs touching this tick, in the order found, and last tick,
+  // sorted by contact_compare(), for the collision event filters
+  Contact *contacts;
+  size_t num_contacts;
+  size_t contacts_capacity;
+  Contact *prev_contacts;
+  size_t num_prev_contacts;
+  size_t prev_contacts_capacity;
+  Collision_Event *events;
+  size_t num_events;
+  size_t events_capacity;
+  bool any_event_filters;
+  // The pairs found touching, waiting for the solver, and whether
+  // the tick is still gathering them; see scene_add_collision()
+  Resolution *resolutions;
+  size_t num_resolutions;
+  size_t resolutions_capacity;
+  bool gathering;
+  // Whether force creators may be running, so structural
+  // changes have to wait in the command buffer
+  bool ticking;
+  Command *commands;
+  size_t num_commands;
+  size_t commands_capacity;
+  Tick_Listener_Entry *listeners;
+  size_t num_listeners;
+  size_t listeners_capacity;
 };
 
+// What a query is looking for, and what it has found so far
+typedef struct {
+  Scene *scene;
+  Vector point;
+  Vector direction;
+  double max_distance;
+  List *shape;
+  Body **bodies;
+  Raycast_Hit *hits;
+  size_t capacity;
+  size_t found;
+} Query;
+
 struct instance_force {
   ForceCreator force_creator;
   void *aux; // one_body, two_bodies, n_bodies
   List *bodies; // slightly redundant in terms of storing bodies but exists
                 // so scene.c can access individual bodies without accessing the
                 // structs in forces.c
+  // The bodies a group force acts on, which outlive any one of them,
+  // or NULL; see scene_add_group_force_creator()
+  List *group;
   FreeFunc aux_freer;
 };
 
 Instance_Force *instance_force_init(ForceCreator force_creator, void *aux, List *bodies, FreeFunc freer) {
-  Instance_Force *instance_force = (Instance_Force *) malloc(sizeof(Instance_Force));
+  Instance_Force *instance_force = (Instance_Force *) ENGINE_MALLOC(sizeof(Instance_Force));
   instance_force->force_creator = force_creator;
   instance_force->aux = aux;
   instance_force->bodies = bodies;
+  instance_force->group = NULL;
   instance_force->aux_freer = freer;
   return instance_force;
 }
@@ -46,17 +203,61 @@ void instance_force_free_limited(Instance_Force *i) {
   if(i->aux_freer != NULL) {
     i->aux_freer(i->aux);
   }
-  free(i->bodies);
-  free(i);
+  list_free(i->bodies);
+  if (i->group != NULL) list_free(i->group);
+  allocator_free(i);
 }
 
 Scene *scene_init(void) {
-  Scene *scene = (Scene *) malloc(sizeof(Scene));
+  Scene *scene = (Scene *) ENGINE_MALLOC(sizeof(Scene));
   assert(scene != NULL);
   scene->bodies = list_init(INITIAL_CAPACITY, (FreeFunc) body_free);
   scene->num_bodies = 0;
+  for (size_t tag = 0; tag < NUM_TAGS; tag++) {
+    scene->tagged[tag] = list_init(INITIAL_CAPACITY, NULL);
+  }
   scene->instance_forces = list_init(INITIAL_CAPACITY, (FreeFunc) instance_force_free_limited);
   scene->num_instance_forces = 0;
+  scene->integrator = INTEGRATOR_DEFAULT;
+  scene->integrator_state = integrator_state_init();
+  scene->tick_dt = 0;
+  scene->collision_entries = list_init(INITIAL_CAPACITY, allocator_free);
+  for (size_t tag = 0; tag < NUM_TAGS; tag++) {
+    scene->collides_with[tag] = 0;
+  }
+  scene->broadphase = broadphase_init();
+  scene->swept_broadphase = broadphase_init();
+  scene->impacts = NULL;
+  scene->num_impacts = 0;
+  scene->impacts_capacity = 0;
+  scene->impact_shapes[0] = list_init(INITIAL_CAPACITY, allocator_free);
+  scene->impact_shapes[1] = list_init(INITIAL_CAPACITY, allocator_free);
+  scene->query_index = broadphase_init();
+  scene->query_index_stale = true;
+  scene->placements = NULL;
+  scene->num_placements = 0;
+  scene->placements_capacity = 0;
+  scene->contacts = NULL;
+  scene->num_contacts = 0;
+  scene->contacts_capacity = 0;
+  scene->prev_contacts = NULL;
+  scene->num_prev_contacts = 0;
+  scene->prev_contacts_capacity = 0;
+  scene->events = NULL;
+  scene->num_events = 0;
+  scene->events_capacity = 0;
+  scene->any_event_filters = false;
+  scene->resolutions = NULL;
+  scene->num_resolutions = 0;
+  scene->resolutions_capacity = 0;
+  scene->gathering = false;
+  scene->ticking = false;
+  scene->commands = NULL;
+  scene->num_commands = 0;
+  scene->commands_capacity = 0;
+  scene->listeners = NULL;
+  scene->num_listeners = 0;
+  scene->listeners_capacity = 0;
   return scene;
 }
 
@@ -64,7 +265,7 @@ Scene *scene_init(void) {
 void scene_free(Scene *scene) {
   list_free(scene->bodies);
   list_free(scene->instance_forces);
-  free(scene);
+  allocator_free(scene);
 }*/
 void scene_free(Scene *scene) {
     /*
@@ -73,8 +274,26 @@ void scene_free(Scene *scene) {
     instance_force->aux_freer(instance_force->aux);
 } */
     list_free(scene->bodies);
+    for (size_t tag = 0; tag < NUM_TAGS; tag++) {
+      list_free(scene->tagged[tag]);
+    }
     list_free(scene->instance_forces);
-    free(scene);
+    integrator_state_free(scene->integrator_state);
+    list_free(scene->collision_entries);
+    broadphase_free(scene->broadphase);
+    broadphase_free(scene->swept_broadphase);
+    allocator_free(scene->impacts);
+    list_free(scene->impact_shapes[0]);
+    list_free(scene->impact_shapes[1]);
+    broadphase_free(scene->query_index);
+    allocator_free(scene->placements);
+    allocator_free(scene->contacts);
+    allocator_free(scene->prev_contacts);
+    allocator_free(scene->events);
+    allocator_free(scene->resolutions);
+    allocator_free(scene->commands);
+    allocator_free(scene->listeners);
+    allocator_free(scene);
 }
 
 size_t scene_bodies(Scene *scene) {
@@ -85,9 +304,68 @@ Body *scene_get_body(Scene *scene, size_t index) {
   return list_get(scene->bodies, index);
 }
 
+// Files a body at the end of the list of bodies with its tag
+void scene_file_body(Scene *scene, Body *body) {
+  List *tagged = scene->tagged[body_get_tag(body)];
+  body_set_filing(body, scene, list_size(tagged));
+  list_add(tagged, body);
+}
+
+// Takes a body out of the list of bodies with a tag,
+// moving the last body in the list into its place
+void scene_unfile_body(Scene *scene, Body *body, size_t tag) {
+  List *tagged = scene->tagged[tag];
+  size_t index = body_get_filing_index(body);
+  assert(list_get(tagged, index) == body);
+  Body *last = list_remove(tagged, list_size(tagged) - 1);
+  if (last != body) {
+    list_set(tagged, index, last);
+    body_set_filing(last, scene, index);
+  }
+  body_set_filing(body, NULL, 0);
+}
+
+// Takes a body out of the tag index
+void scene_untag_body(Scene *scene, Body *body) {
+  scene_unfile_body(scene, body, body_get_tag(body));
+}
+
+void scene_refile_body(Scene *scene, Body *body, size_t old_tag) {
+  scene_unfile_body(scene, body, old_tag);
+  scene_file_body(scene, body);
+}
+
+size_t scene_tagged_bodies(Scene *scene, size_t tag) {
+  assert(tag < NUM_TAGS);
+  return list_size(scene->tagged[tag]);
+}
+
+Body *scene_get_tagged_body(Scene *scene, size_t tag, size_t index) {
+  assert(tag < NUM_TAGS);
+  return list_get(scene->tagged[tag], index);
+}
+
+void scene_defer(Scene *scene, Command command) {
+  if (scene->num_commands == scene->commands_capacity) {
+    scene->commands_capacity = scene->commands_capacity > 0
+      ? scene->commands_capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    scene->commands = ENGINE_REALLOC(scene->commands,
+      sizeof(Command) * scene->commands_capacity);
+    assert(scene->commands != NULL);
+  }
+  scene->commands[scene->num_commands++] = command;
+}
+
 void scene_add_body(Scene *scene, Body *body) {
+  if (scene->ticking) {
+    scene_defer(scene, (Command) {.type = COMMAND_ADD_BODY, .body = body});
+    return;
+  }
+  scene_file_body(scene, body);
   list_add(scene->bodies, body);
   scene->num_bodies++;
+  scene->query_index_stale = true;
 }
 
 // mark the body for removal
@@ -96,16 +374,90 @@ void scene_remove_body(Scene *scene, size_t index) {
     body_remove(b);
 }
 
-// this actually frees it
-void scene_free_body(Scene *scene, size_t index) {
+// Drops every contact and pending event that mentions a body,
+// so none outlives the body
+void scene_forget_contacts(Scene *scene, Body *body) {
+  size_t kept = 0;
+  for (size_t i = 0; i < scene->num_contacts; i++) {
+    Contact contact = scene->contacts[i];
+    if (contact.body1 != body && contact.body2 != body) {
+      scene->contacts[kept++] = contact;
+    }
+  }
+  scene->num_contacts = kept;
+
+  // Keeps the survivors sorted
+  kept = 0;
+  for (size_t i = 0; i < scene->num_prev_contacts; i++) {
+    Contact contact = scene->prev_contacts[i];
+    if (contact.body1 != body && contact.body2 != body) {
+      scene->prev_contacts[kept++] = contact;
+    }
+  }
+  scene->num_prev_contacts = kept;
+
+  kept = 0;
+  for (size_t i = 0; i < scene->num_events; i++) {
+    Collision_Event event = scene->events[i];
+    if (event.body1 != body && event.body2 != body) {
+      scene->events[kept++] = event;
+    }
+  }
+  scene->num_events = kept;
+}
+
+// Takes removed bodies out of the groups of every group force,
+// keeping the rest in order
+void scene_compact_groups(Scene *scene) {
+  for (size_t i = 0; i < scene->num_instance_forces; i++) {
+    List *group = ((Instance_Force *) list_get(scene->instance_forces, i))->group;
+    if (group == NULL) continue;
+    size_t kept = 0;
+    for (size_t j = 0; j < list_size(group); j++) {
+      Body *body = list_get(group, j);
+      if (!body_is_removed(body)) list_set(group, kept++, body);
+    }
+    while (list_size(group) > kept) list_remove(group, list_size(group) - 1);
+  }
+}
+
+// Frees a removed body that no group force still holds
+void scene_release_body(Scene *scene, size_t index) {
     Body *b = (Body *)scene_get_body(scene, index);
     list_remove(scene->bodies, index);
+    scene_untag_body(scene, b);
+    scene_forget_contacts(scene, b);
     body_free(b);
     scene->num_bodies--;
+    scene->query_index_stale = true;
+    // The bodies after it shift down into placements recorded for others
+    if (scene->num_placements > index) scene->num_placements = index;
+}
+
+// this actually frees it
+void scene_free_body(Scene *scene, size_t index) {
+    Body *b = (Body *)scene_get_body(scene, index);
+    body_remove(b);
+    if (scene->ticking) {
+      // Freeing it now would shift the indices being iterated over
+      return;
+    }
+    scene_compact_groups(scene);
+    scene_release_body(scene, index);
 }
 
 void scene_set_body(Scene *scene, size_t index, Body *b) {
+    if (scene->ticking) {
+      scene_defer(scene, (Command) {.type = COMMAND_SET_BODY, .body = b,
+        .replaced = scene_get_body(scene, index)});
+      return;
+    }
+    scene_untag_body(scene, scene_get_body(scene, index));
+    scene_forget_contacts(scene, scene_get_body(scene, index));
+    scene_file_body(scene, b);
     list_set(scene->bodies, index, b);
+    scene->query_index_stale = true;
+    if (index < scene->num_placements) scene->placements[index].body = NULL;
     //printf("New body inserted at %zu\n", index);
     //body_free(c);
 }
@@ -123,6 +475,10 @@ void scene_add_force_creator(Scene *scene, ForceCreator forcer, void *aux,
 void scene_add_bodies_force_creator(
   Scene *scene, ForceCreator forcer, void *aux, List *bodies_list, FreeFunc freer) {
       Instance_Force *to_add = instance_force_init(forcer, aux, bodies_list, freer);
+      if (scene->ticking) {
+        scene_defer(scene, (Command) {.type = COMMAND_ADD_FORCE, .force = to_add});
+        return;
+      }
       list_add(scene->instance_forces, to_add);
       scene->num_instance_forces++;
       /*
@@ -132,29 +488,629 @@ void scene_add_bodies_force_creator(
       */
 }
 
+void scene_add_group_force_creator(
+  Scene *scene, ForceCreator forcer, void *aux, List *group, FreeFunc freer) {
+    Instance_Force *to_add = instance_force_init(forcer, aux,
+      list_init(INITIAL_CAPACITY, NULL), freer);
+    to_add->group = group;
+    if (scene->ticking) {
+      scene_defer(scene, (Command) {.type = COMMAND_ADD_FORCE, .force = to_add});
+      return;
+    }
+    list_add(scene->instance_forces, to_add);
+    scene->num_instance_forces++;
+}
 
-void scene_tick(Scene *scene, double dt) {
-    // printf("scene_tick is running!\n");
-    // Debugging purposes: print the pointers of each body in scene->bodies.
-    for (size_t i = 0; i < scene->num_bodies; i++) {
-        // printf("The pointer of the body at index %zu is %p\n")
-        for (size_t j = 0; j < scene->num_bodies; j++) {
-            if (scene_get_body(scene, i) == scene_get_body(scene, j) && i != j) {
+void scene_insert_collision_entry(Scene *scene, Collision_Entry *entry) {
+  list_add(scene->collision_entries, entry);
+  for (size_t tag = 0; tag < NUM_TAGS; tag++) {
+    if (entry->mask1 & TAG_MASK(tag)) scene->collides_with[tag] |= entry->mask2;
+    if (entry->mask2 & TAG_MASK(tag)) scene->collides_with[tag] |= entry->mask1;
+  }
+  if (entry->filter) scene->any_event_filters = true;
+}
 
-                printf("Yikes at indices %zu and %zu in a list with the last index as %zu\n", i, j, scene->num_bodies - 1);
-            }
-        }
-    }
+size_t scene_force_creators(Scene *scene) {
+  return scene->num_instance_forces;
+}
+
+ForceCreator scene_get_force_creator(Scene *scene, size_t index, void **aux) {
+  Instance_Force *instance_force = list_get(scene->instance_forces, index);
+  *aux = instance_force->aux;
+  return instance_force->force_creator;
+}
+
+size_t scene_collision_entries(Scene *scene) {
+  return list_size(scene->collision_entries);
+}
+
+bool scene_get_collision_entry(Scene *scene, size_t index,
+  uint32_t *mask1, uint32_t *mask2, Collision_Response *response) {
+    Collision_Entry *entry = list_get(scene->collision_entries, index);
+    *mask1 = entry->mask1;
+    *mask2 = entry->mask2;
+    *response = entry->response;
+    return !entry->filter;
+}
+
+void scene_add_collision_entry(Scene *scene, Collision_Entry entry) {
+  Collision_Entry *to_add = ENGINE_MALLOC(sizeof(Collision_Entry));
+  assert(to_add != NULL);
+  *to_add = entry;
+  if (scene->ticking) {
+    scene_defer(scene, (Command) {.type = COMMAND_ADD_COLLISION_ENTRY, .entry = to_add});
+    return;
+  }
+  scene_insert_collision_entry(scene, to_add);
+}
+
+void scene_add_collision_response(Scene *scene, uint32_t mask1, uint32_t mask2,
+  Collision_Response response) {
+    scene_add_collision_entry(scene,
+      (Collision_Entry) {.mask1 = mask1, .mask2 = mask2, .response = response});
+}
+
+void scene_add_collision_events(Scene *scene, uint32_t mask1, uint32_t mask2) {
+  scene_add_collision_entry(scene,
+    (Collision_Entry) {.mask1 = mask1, .mask2 = mask2, .filter = true});
+}
+
+size_t scene_collision_events(Scene *scene) {
+  return scene->num_events;
+}
+
+Collision_Event scene_get_collision_event(Scene *scene, size_t index) {
+  assert(index < scene->num_events);
+  return scene->events[index];
+}
+
+void scene_clear_collision_events(Scene *scene) {
+  scene->num_events = 0;
+}
+
+void scene_set_integrator(Scene *scene, Integrator integrator) {
+  scene->integrator = integrator;
+}
+
+Integrator scene_get_integrator(Scene *scene) {
+  return scene->integrator;
+}
+
+void scene_set_adaptive_config(Scene *scene, Adaptive_Config config) {
+  integrator_set_adaptive_config(scene->integrator_state, config);
+}
+
+Adaptive_Config scene_get_adaptive_config(Scene *scene) {
+  return integrator_get_adaptive_config(scene->integrator_state);
+}
 
-    // Apply forces wherever necessary.
+Adaptive_Stats scene_get_adaptive_stats(Scene *scene) {
+  return integrator_get_adaptive_stats(scene->integrator_state);
+}
+
+double scene_get_tick_dt(Scene *scene) {
+  return scene->tick_dt;
+}
+
+void scene_apply_forces(Scene *scene) {
+    PROFILE_BEGIN(PHASE_FORCES);
     for (size_t j = 0; j < scene->num_instance_forces; j++) {
-        //printf("iterating at index %zu\n", j);
         Instance_Force *i = list_get(scene->instance_forces, j);
         ForceCreator curr_creator = i->force_creator;
+        PROFILE_BEGIN(PHASE_FORCE_TYPE);
         curr_creator(i->aux);
+        PROFILE_END_FORCE(curr_creator);
+    }
+    PROFILE_END(PHASE_FORCES);
+}
+
+void scene_add_resolution(Scene *scene, Body *a, Body *b, CollisionInfo info,
+  Collision_Response response) {
+    if (scene->num_resolutions == scene->resolutions_capacity) {
+      scene->resolutions_capacity = scene->resolutions_capacity > 0
+        ? scene->resolutions_capacity * GROW_FACTOR
+        : INITIAL_CAPACITY;
+      scene->resolutions = ENGINE_REALLOC(scene->resolutions,
+        sizeof(Resolution) * scene->resolutions_capacity);
+      assert(scene->resolutions != NULL);
+    }
+    scene->resolutions[scene->num_resolutions++] =
+      (Resolution) {.body1 = a, .body2 = b, .info = info, .response = response};
+}
+
+void scene_add_collision(Scene *scene, Body *body1, Body *body2, CollisionInfo info,
+  Collision_Response response) {
+    if (scene->gathering) scene_add_resolution(scene, body1, body2, info, response);
+}
+
+// Queues the response of every collision table entry that covers
+// a pair of touching bodies.
+void scene_gather_collision(Scene *scene, Body *a, Body *b, CollisionInfo info) {
+  uint32_t a_tag = TAG_MASK(body_get_tag(a));
+  uint32_t b_tag = TAG_MASK(body_get_tag(b));
+  for (size_t h = 0; h < list_size(scene->collision_entries); h++) {
+    Collision_Entry *entry = list_get(scene->collision_entries, h);
+    // Event filters only record contacts; see scene_add_contact()
+    if (entry->filter) continue;
+    if ((a_tag & entry->mask1) && (b_tag & entry->mask2)) {
+      scene_add_resolution(scene, a, b, info, entry->response);
+    } else if ((b_tag & entry->mask1) && (a_tag & entry->mask2)) {
+      CollisionInfo flipped = {true, vec_negate(info.axis), info.depth};
+      scene_add_resolution(scene, b, a, flipped, entry->response);
+    }
+  }
+}
+
+// How much of an impulse moves a body: none if it has infinite mass
+// or has been stopped
+double solver_inverse_mass(Body *body) {
+  if (body_get_stop(body) || body_get_mass(body) == INFINITY) return 0;
+  return 1 / body_get_mass(body);
+}
+
+// How fast a body will be going at the end of the tick
+// if nothing else pushes it, as the solver sees it
+Vector solver_velocity(Body *body, double dt) {
+  if (body_get_stop(body)) return VEC_ZERO;
+  return vec_add(body_get_velocity(body),
+    vec_multiply(dt * solver_inverse_mass(body), body_get_force(body)));
+}
+
+// How fast body2 is moving away from body1 along the axis
+double resolution_speed(Resolution *resolution, double dt) {
+  return vec_dot(vec_subtract(solver_velocity(resolution->body2, dt),
+    solver_velocity(resolution->body1, dt)), resolution->info.axis);
+}
+
+// Responds to every pair gathered since the last call. Bouncing pairs are
+// solved by sequential impulses: each pass gives every pair the impulse
+// that would bring its bodies to their target speed apart, never pulling
+// them together overall, so pairs sharing a body settle between them.
+// The impulses change the bodies' velocities directly, aiming at
+// where the forces on them would take them by the end of the tick.
+void scene_resolve_collisions(Scene *scene, double dt) {
+  for (size_t i = 0; i < scene->num_resolutions; i++) {
+    Resolution *resolution = &scene->resolutions[i];
+    switch (resolution->response.type) {
+      case COLLISION_PHYSICS:
+      case COLLISION_INELASTIC: {
+        double elasticity = resolution->response.type == COLLISION_PHYSICS
+          ? resolution->response.elasticity
+          : 0;
+        double speed = resolution_speed(resolution, dt);
+        // Closing pairs bounce; the rest are only kept from closing.
+        // Either way overlapping bodies are eased apart.
+        resolution->target = speed < 0 ? -elasticity * speed : 0;
+        if (dt > 0) {
+          resolution->target = fmax(resolution->target,
+            POSITION_CORRECTION * resolution->info.depth / dt);
+        }
+        resolution->impulse = 0;
+        break;
+      }
+      case COLLISION_STOP:
+        body_set_stop(resolution->body1, true);
+        break;
+      case COLLISION_DESTRUCTIVE:
+        body_remove(resolution->body1);
+        body_remove(resolution->body2);
+        break;
+      case COLLISION_SEMIDESTRUCTIVE:
+        body_remove(resolution->body2);
+        break;
     }
+  }
+
+  for (size_t pass = 0; pass < SOLVER_ITERATIONS; pass++) {
+    for (size_t i = 0; i < scene->num_resolutions; i++) {
+      Resolution *resolution = &scene->resolutions[i];
+      if (resolution->response.type != COLLISION_PHYSICS
+        && resolution->response.type != COLLISION_INELASTIC) continue;
+      double inverse_mass1 = solver_inverse_mass(resolution->body1);
+      double inverse_mass2 = solver_inverse_mass(resolution->body2);
+      if (inverse_mass1 + inverse_mass2 == 0) continue;
+      double impulse = (resolution->target - resolution_speed(resolution, dt))
+        / (inverse_mass1 + inverse_mass2);
+      impulse = fmax(impulse, -resolution->impulse);
+      if (impulse == 0) continue;
+      resolution->impulse += impulse;
+      Vector push = vec_multiply(impulse, resolution->info.axis);
+      body_set_velocity(resolution->body1, vec_subtract(body_get_velocity(resolution->body1),
+        vec_multiply(inverse_mass1, push)));
+      body_set_velocity(resolution->body2, vec_add(body_get_velocity(resolution->body2),
+        vec_multiply(inverse_mass2, push)));
+    }
+  }
+
+  for (size_t i = 0; i < scene->num_resolutions; i++) {
+    Resolution *resolution = &scene->resolutions[i];
+    if (resolution->response.type != COLLISION_PHYSICS
+      || resolution->impulse <= SPIN_IMPULSE) continue;
+    if (body_get_mass(resolution->body1) != INFINITY) {
+      body_add_torque(resolution->body1, resolution->impulse);
+    }
+    if (body_get_mass(resolution->body2) != INFINITY) {
+      body_add_torque(resolution->body2, -resolution->impulse);
+    }
+  }
+  scene->num_resolutions = 0;
+}
+
+// Orders contacts by their pair of bodies, whichever way round
+int contact_compare(const void *a, const void *b) {
+  const Contact *contact1 = a;
+  const Contact *contact2 = b;
+  uintptr_t low1 = (uintptr_t) contact1->body1;
+  uintptr_t high1 = (uintptr_t) contact1->body2;
+  if (low1 > high1) {
+    uintptr_t swap = low1;
+    low1 = high1;
+    high1 = swap;
+  }
+  uintptr_t low2 = (uintptr_t) contact2->body1;
+  uintptr_t high2 = (uintptr_t) contact2->body2;
+  if (low2 > high2) {
+    uintptr_t swap = low2;
+    low2 = high2;
+    high2 = swap;
+  }
+  if (low1 != low2) return low1 < low2 ? -1 : 1;
+  return high1 < high2 ? -1 : high1 > high2;
+}
+
+int contact_rank_compare(const void *a, const void *b) {
+  const Contact *contact1 = a;
+  const Contact *contact2 = b;
+  return contact1->rank < contact2->rank ? -1 : contact1->rank > contact2->rank;
+}
+
+Contact *grow_contacts(Contact *contacts, size_t *capacity, size_t needed) {
+  if (needed <= *capacity) return contacts;
+  *capacity = *capacity > 0 ? *capacity * GROW_FACTOR : INITIAL_CAPACITY;
+  contacts = ENGINE_REALLOC(contacts, sizeof(Contact) * *capacity);
+  assert(contacts != NULL);
+  return contacts;
+}
+
+void scene_add_event(Scene *scene, Collision_Phase phase, Contact contact) {
+  if (scene->num_events == scene->events_capacity) {
+    scene->events_capacity = scene->events_capacity > 0
+      ? scene->events_capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    scene->events = ENGINE_REALLOC(scene->events,
+      sizeof(Collision_Event) * scene->events_capacity);
+    assert(scene->events != NULL);
+  }
+  scene->events[scene->num_events++] =
+    (Collision_Event) {phase, contact.body1, contact.body2, contact.axis};
+}
+
+// Records that two bodies are touching, if some event filter covers them.
+// Each pass over the pairs finds a pair at most once, so only a later pass
+// needs to check scene_has_contact() first.
+void scene_add_contact(Scene *scene, Body *a, Body *b, Vector axis) {
+  if (!scene->any_event_filters) return;
+  uint32_t a_tag = TAG_MASK(body_get_tag(a));
+  uint32_t b_tag = TAG_MASK(body_get_tag(b));
+  Contact contact = {.seen = false};
+  for (size_t h = 0; h < list_size(scene->collision_entries); h++) {
+    Collision_Entry *entry = list_get(scene->collision_entries, h);
+    if (!entry->filter) continue;
+    if ((a_tag & entry->mask1) && (b_tag & entry->mask2)) {
+      contact = (Contact) {a, b, axis};
+      break;
+    } else if ((b_tag & entry->mask1) && (a_tag & entry->mask2)) {
+      contact = (Contact) {b, a, vec_negate(axis)};
+      break;
+    }
+  }
+  if (contact.body1 == NULL) return;
+
+  scene->contacts = grow_contacts(scene->contacts, &scene->contacts_capacity,
+    scene->num_contacts + 1);
+  scene->contacts[scene->num_contacts++] = contact;
+}
+
+// Returns whether a pair of bodies has been recorded as touching this tick.
+bool scene_has_contact(Scene *scene, Body *a, Body *b) {
+  Contact contact = {a, b};
+  for (size_t i = 0; i < scene->num_contacts; i++) {
+    if (contact_compare(&scene->contacts[i], &contact) == 0) return true;
+  }
+  return false;
+}
+
+// Turns this tick's contacts into events by comparing them with
+// last tick's: new pairs begin, old ones persist, and missing ones end.
+// Begin and persist events follow the order the pairs were found,
+// and end events the order they were found in last tick.
+void scene_update_contacts(Scene *scene) {
+  if (!scene->any_event_filters) return;
+
+  for (size_t i = 0; i < scene->num_contacts; i++) {
+    Contact *contact = &scene->contacts[i];
+    Contact *prev = bsearch(contact, scene->prev_contacts, scene->num_prev_contacts,
+      sizeof(Contact), contact_compare);
+    if (prev != NULL) prev->seen = true;
+    scene_add_event(scene, prev != NULL ? COLLISION_PERSIST : COLLISION_BEGIN, *contact);
+    contact->rank = i;
+  }
+
+  size_t ended = 0;
+  for (size_t i = 0; i < scene->num_prev_contacts; i++) {
+    if (!scene->prev_contacts[i].seen) {
+      scene->prev_contacts[ended++] = scene->prev_contacts[i];
+    }
+  }
+  qsort(scene->prev_contacts, ended, sizeof(Contact), contact_rank_compare);
+  for (size_t i = 0; i < ended; i++) {
+    scene_add_event(scene, COLLISION_END, scene->prev_contacts[i]);
+  }
+
+  // This tick's contacts become last tick's
+  qsort(scene->contacts, scene->num_contacts, sizeof(Contact), contact_compare);
+  Contact *swap = scene->prev_contacts;
+  size_t swap_capacity = scene->prev_contacts_capacity;
+  scene->prev_contacts = scene->contacts;
+  scene->num_prev_contacts = scene->num_contacts;
+  scene->prev_contacts_capacity = scene->contacts_capacity;
+  scene->contacts = swap;
+  scene->num_contacts = 0;
+  scene->contacts_capacity = swap_capacity;
+}
+
+// The box a body covered over its last tick, if swept, or now otherwise
+AABB body_bounds(Body *body, bool swept) {
+  AABB box = polygon_bounds(body_peek_shape(body));
+  if (!swept) return box;
+
+  Vector back = vec_subtract(body_get_previous_centroid(body), body_get_centroid(body));
+  // No point on the body turned further than its spin times its half-diagonal
+  double spin = fabs(body_get_angle(body) - body_get_previous_angle(body))
+    * vec_magnitude(vec_subtract(box.max, box.min)) / 2;
+  box.min.x = fmin(box.min.x, box.min.x + back.x) - spin;
+  box.min.y = fmin(box.min.y, box.min.y + back.y) - spin;
+  box.max.x = fmax(box.max.x, box.max.x + back.x) + spin;
+  box.max.y = fmax(box.max.y, box.max.y + back.y) + spin;
+  return box;
+}
+
+// Gives the broadphase every body some collision table entry could apply to.
+void scene_fill_broadphase(Scene *scene, Broadphase *broadphase, bool swept) {
+  broadphase_resize(broadphase, scene->num_bodies);
+  for (size_t i = 0; i < scene->num_bodies; i++) {
+    Body *body = scene_get_body(scene, i);
+    size_t tag = body_get_tag(body);
+    // Bodies whose tags no entry mentions never reach the sort
+    uint32_t mask = body_is_removed(body)
+      ? 0
+      : body_get_collision_mask(body) & scene->collides_with[tag];
+    AABB box = mask != 0 ? body_bounds(body, swept) : (AABB) {VEC_ZERO, VEC_ZERO};
+    broadphase_set(broadphase, i, box, TAG_MASK(tag), mask);
+  }
+}
+
+// Gathers the touching pairs of bodies each collision table entry covers.
+void scene_handle_collisions(Scene *scene) {
+  if (list_size(scene->collision_entries) == 0) return;
+
+  scene_fill_broadphase(scene, scene->broadphase, false);
+  size_t num_pairs = broadphase_find_pairs(scene->broadphase);
+  for (size_t p = 0; p < num_pairs; p++) {
+    Index_Pair pair = broadphase_get_pair(scene->broadphase, p);
+    Body *a = scene_get_body(scene, pair.first);
+    Body *b = scene_get_body(scene, pair.second);
+    PROFILE_NARROWPHASE();
+    CollisionInfo info = find_collision(body_peek_shape(a), body_peek_shape(b));
+    if (info.collided) {
+      scene_gather_collision(scene, a, b, info);
+      scene_add_contact(scene, a, b, info.axis);
+    }
+  }
+}
+
+// The furthest any vertex of a body is from its centroid
+double body_radius(Body *body) {
+  List *shape = body_peek_shape(body);
+  Vector centroid = body_get_centroid(body);
+  double radius = 0;
+  for (size_t i = 0; i < list_size(shape); i++) {
+    Vector offset = vec_subtract(*(Vector *) list_get(shape, i), centroid);
+    radius = fmax(radius, vec_magnitude(offset));
+  }
+  return radius;
+}
+
+// Overwrites a copy of a body's shape with where it was
+// part of the way through the last tick; see body_get_interpolated_shape().
+void place_shape(List *copy, Body *body, double alpha) {
+  List *shape = body_peek_shape(body);
+  Vector centroid = body_get_centroid(body);
+  double rotation = (alpha - 1) * (body_get_angle(body) - body_get_previous_angle(body));
+  Vector translation = vec_multiply(alpha - 1,
+    vec_subtract(centroid, body_get_previous_centroid(body)));
+  for (size_t i = 0; i < list_size(shape); i++) {
+    Vector offset = vec_subtract(*(Vector *) list_get(shape, i), centroid);
+    *(Vector *) list_get(copy, i) =
+      vec_add(vec_add(centroid, vec_rotate(offset, rotation)), translation);
+  }
+}
+
+// Sizes one of the scene's scratch lists to hold a body's vertices,
+// reusing the vectors it already has.
+List *scene_scratch_shape(List *scratch, Body *body) {
+  size_t n = list_size(body_peek_shape(body));
+  while (list_size(scratch) < n) list_add(scratch, vec_init(VEC_ZERO));
+  while (list_size(scratch) > n) allocator_free(list_remove(scratch, list_size(scratch) - 1));
+  return scratch;
+}
+
+// Finds when two bodies first touched during the last tick by conservative
+// advancement: no point on either body closed in faster than closing_speed,
+// so they can always be moved on by their separation over that speed
+// without passing through each other. Returns whether they touched.
+bool find_impact(Scene *scene, Body *a, Body *b, Impact *impact) {
+  Vector motion = vec_subtract(
+    vec_subtract(body_get_centroid(b), body_get_previous_centroid(b)),
+    vec_subtract(body_get_centroid(a), body_get_previous_centroid(a)));
+  double closing_speed = vec_magnitude(motion)
+    + fabs(body_get_angle(a) - body_get_previous_angle(a)) * body_radius(a)
+    + fabs(body_get_angle(b) - body_get_previous_angle(b)) * body_radius(b);
+  if (closing_speed == 0) return false;
+
+  List *shape_a = scene_scratch_shape(scene->impact_shapes[0], a);
+  List *shape_b = scene_scratch_shape(scene->impact_shapes[1], b);
+  bool touched = false;
+  double time = 0;
+  for (size_t i = 0; i < CCD_MAX_ITERATIONS && time <= 1; i++) {
+    place_shape(shape_a, a, time);
+    place_shape(shape_b, b, time);
+    double separation = find_separation(shape_a, shape_b, &impact->axis);
+    if (separation <= CCD_TOLERANCE * closing_speed) {
+      // Bodies touching as the tick began were up to scene_handle_collisions()
+      touched = time > 0;
+      break;
+    }
+    time += separation / closing_speed;
+  }
+  impact->time = time;
+  return touched;
+}
+
+int impact_compare(const void *a, const void *b) {
+  const Impact *impact1 = a;
+  const Impact *impact2 = b;
+  if (impact1->time != impact2->time) return impact1->time < impact2->time ? -1 : 1;
+  if (impact1->first != impact2->first) return impact1->first < impact2->first ? -1 : 1;
+  return impact1->second < impact2->second ? -1 : impact1->second > impact2->second;
+}
+
+void scene_add_impact(Scene *scene, Impact impact) {
+  if (scene->num_impacts == scene->impacts_capacity) {
+    scene->impacts_capacity = scene->impacts_capacity > 0
+      ? scene->impacts_capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    scene->impacts = ENGINE_REALLOC(scene->impacts, sizeof(Impact) * scene->impacts_capacity);
+    assert(scene->impacts != NULL);
+  }
+  scene->impacts[scene->num_impacts++] = impact;
+}
+
+// Catches the collisions of continuous bodies that passed through other
+// bodies during the tick just integrated, which the discrete test at the
+// start of the next tick would miss. Each such pair is moved back to when
+// it touched, responded to at once, and stepped on alone with
+// the scene's integrator for the rest of the tick. Their previous transforms
+// stay where the tick began, so rendering blends over the whole tick.
+void scene_handle_impacts(Scene *scene, double dt) {
+  if (list_size(scene->collision_entries) == 0) return;
+  bool any_continuous = false;
+  for (size_t i = 0; i < scene->num_bodies && !any_continuous; i++) {
+    any_continuous = body_get_continuous(scene_get_body(scene, i));
+  }
+  if (!any_continuous) return;
+
+  scene_fill_broadphase(scene, scene->swept_broadphase, true);
+  size_t num_pairs = broadphase_find_pairs(scene->swept_broadphase);
+  scene->num_impacts = 0;
+  for (size_t p = 0; p < num_pairs; p++) {
+    Index_Pair pair = broadphase_get_pair(scene->swept_broadphase, p);
+    Body *a = scene_get_body(scene, pair.first);
+    Body *b = scene_get_body(scene, pair.second);
+    if (!body_get_continuous(a) && !body_get_continuous(b)) continue;
+    // Bodies still overlapping are left to the next tick's discrete test
+    PROFILE_NARROWPHASE();
+    if (find_collision(body_peek_shape(a), body_peek_shape(b)).collided) continue;
+    Impact impact = {.first = pair.first, .second = pair.second};
+    if (find_impact(scene, a, b, &impact)) scene_add_impact(scene, impact);
+  }
+
+  // Once a body has hit something its path changes,
+  // so only its first impact in a tick counts
+  qsort(scene->impacts, scene->num_impacts, sizeof(Impact), impact_compare);
+  for (size_t i = 0; i < scene->num_impacts; i++) {
+    Impact impact = scene->impacts[i];
+    bool hit_earlier = false;
+    for (size_t j = 0; j < i && !hit_earlier; j++) {
+      Impact earlier = scene->impacts[j];
+      hit_earlier = earlier.first == impact.first || earlier.first == impact.second
+        || earlier.second == impact.first || earlier.second == impact.second;
+    }
+    if (hit_earlier) {
+      // Drop it so later impacts aren't compared against it
+      scene->impacts[i] = (Impact) {.first = SIZE_MAX, .second = SIZE_MAX};
+      continue;
+    }
+
+    Body *a = scene_get_body(scene, impact.first);
+    Body *b = scene_get_body(scene, impact.second);
+    body_rewind(a, impact.time);
+    body_rewind(b, impact.time);
+    // The bodies' forces were used up integrating, so no need to look ahead
+    scene_gather_collision(scene, a, b, (CollisionInfo) {true, impact.axis, 0});
+    scene_resolve_collisions(scene, 0);
+    // The pair may already have touched in this tick's discrete test
+    if (!scene_has_contact(scene, a, b)) scene_add_contact(scene, a, b, impact.axis);
+    integrator_step_body(scene->integrator, a, (1 - impact.time) * dt);
+    integrator_step_body(scene->integrator, b, (1 - impact.time) * dt);
+  }
+}
+
+// Makes the changes deferred since the last sync point, in the order
+// they were asked for
+void scene_apply_commands(Scene *scene) {
+  assert(!scene->ticking);
+  for (size_t i = 0; i < scene->num_commands; i++) {
+    Command command = scene->commands[i];
+    switch (command.type) {
+      case COMMAND_ADD_BODY:
+        scene_add_body(scene, command.body);
+        break;
+      case COMMAND_SET_BODY: {
+        // A replaced body that has since been freed leaves nothing to replace
+        size_t index = 0;
+        while (index < scene->num_bodies
+          && scene_get_body(scene, index) != command.replaced) index++;
+        if (index < scene->num_bodies) scene_set_body(scene, index, command.body);
+        else scene_add_body(scene, command.body);
+        break;
+      }
+      case COMMAND_ADD_FORCE:
+        list_add(scene->instance_forces, command.force);
+        scene->num_instance_forces++;
+        break;
+      case COMMAND_ADD_COLLISION_ENTRY:
+        scene_insert_collision_entry(scene, command.entry);
+        break;
+    }
+  }
+  scene->num_commands = 0;
+}
+
+void scene_tick(Scene *scene, double dt) {
+    PROFILE_BEGIN(PHASE_TICK);
+    scene->tick_dt = dt;
+
+    // Apply forces wherever necessary, gathering the touching pairs
+    // pair collisions report on the way
+    scene->ticking = true;
+    scene->gathering = true;
+    scene_apply_forces(scene);
+    PROFILE_BEGIN(PHASE_COLLISIONS);
+    scene_handle_collisions(scene);
+    scene->gathering = false;
+    scene_resolve_collisions(scene, dt);
+    PROFILE_END(PHASE_COLLISIONS);
+    scene->ticking = false;
+
+    // Sync point: whatever the force creators added
+    // joins the scene before removed bodies are freed
+    PROFILE_BEGIN(PHASE_COMMANDS);
+    scene_apply_commands(scene);
+    PROFILE_END(PHASE_COMMANDS);
 
     // Remove force creators associated with flagged bodies.
+    PROFILE_BEGIN(PHASE_REMOVAL);
     for (size_t i = 0; i < scene->num_instance_forces; i++) {
         bool free_instance_force = false;
         Instance_Force *k = list_get(scene->instance_forces, i);
@@ -176,6 +1132,9 @@ void scene_tick(Scene *scene, double dt) {
         }
     }
 
+    // Group forces outlive their bodies, so only lose the removed ones
+    scene_compact_groups(scene);
+
     // Remove bodies flagged for removal.
     for (size_t i = 0; i < scene->num_bodies; i++) {
         // printf("We're looking at the body in index %zu of %zu\n", i, scene->num_bodies);
@@ -183,15 +1142,194 @@ void scene_tick(Scene *scene, double dt) {
         // printf("%p\n", b);
         if (body_is_removed(b)) {
             //printf("We're about to free and remove the body at index %zu\n", i);
-            scene_free_body(scene, i);
+            scene_release_body(scene, i);
             i--;
         }
     }
+    PROFILE_END(PHASE_REMOVAL);
 
     // Tick bodies that still exist.
+    scene->ticking = true;
+    PROFILE_BEGIN(PHASE_INTEGRATION);
+    integrator_step(scene->integrator, scene, dt, scene->integrator_state);
+    PROFILE_END(PHASE_INTEGRATION);
+    PROFILE_BEGIN(PHASE_IMPACTS);
+    scene_handle_impacts(scene, dt);
+    PROFILE_END(PHASE_IMPACTS);
+    scene->ticking = false;
+    PROFILE_BEGIN(PHASE_COMMANDS);
+    scene_apply_commands(scene);
+    PROFILE_END(PHASE_COMMANDS);
+    PROFILE_BEGIN(PHASE_EVENTS);
+    scene_update_contacts(scene);
+    scene->query_index_stale = true;
+
+    for (size_t i = 0; i < scene->num_listeners; i++) {
+        scene->listeners[i].listener(scene, scene->listeners[i].aux);
+    }
+    PROFILE_END(PHASE_EVENTS);
+    PROFILE_END(PHASE_TICK);
+}
+
+void scene_add_tick_listener(Scene *scene, TickListener listener, void *aux) {
+  if (scene->num_listeners == scene->listeners_capacity) {
+    scene->listeners_capacity = scene->listeners_capacity > 0
+      ? scene->listeners_capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    scene->listeners = ENGINE_REALLOC(scene->listeners,
+      sizeof(Tick_Listener_Entry) * scene->listeners_capacity);
+    assert(scene->listeners != NULL);
+  }
+  scene->listeners[scene->num_listeners++] = (Tick_Listener_Entry) {listener, aux};
+}
+
+void scene_remove_tick_listener(Scene *scene, TickListener listener, void *aux) {
+  for (size_t i = 0; i < scene->num_listeners; i++) {
+    Tick_Listener_Entry *entry = &scene->listeners[i];
+    if (entry->listener == listener && entry->aux == aux) {
+      memmove(entry, entry + 1,
+        sizeof(Tick_Listener_Entry) * (scene->num_listeners - i - 1));
+      scene->num_listeners--;
+      return;
+    }
+  }
+}
+
+Broadphase *scene_query_index(Scene *scene) {
+  if (scene->query_index_stale) {
+    if (scene->num_bodies > scene->placements_capacity) {
+      while (scene->placements_capacity < scene->num_bodies) {
+        scene->placements_capacity = scene->placements_capacity > 0
+          ? scene->placements_capacity * GROW_FACTOR
+          : INITIAL_CAPACITY;
+      }
+      scene->placements = ENGINE_REALLOC(scene->placements,
+        sizeof(Placement) * scene->placements_capacity);
+      assert(scene->placements != NULL);
+    }
+    broadphase_resize(scene->query_index, scene->num_bodies);
     for (size_t i = 0; i < scene->num_bodies; i++) {
-        Body *b = scene_get_body(scene, i);
-        body_tick(b, dt);
+      Body *body = scene_get_body(scene, i);
+      Placement *placement = &scene->placements[i];
+      // Bodies that haven't moved since the last refresh keep their boxes
+      bool placed = i < scene->num_placements
+        && placement->body == body
+        && placement->shape == body_peek_shape(body)
+        && vec_equal(placement->centroid, body_get_centroid(body))
+        && placement->angle == body_get_angle(body);
+      if (!placed) {
+        *placement = (Placement) {body, body_peek_shape(body), body_get_centroid(body),
+          body_get_angle(body), polygon_bounds(body_peek_shape(body))};
+      }
+      uint32_t mask = body_is_removed(body) ? 0 : ALL_TAGS;
+      broadphase_set(scene->query_index, i, placement->box,
+        TAG_MASK(body_get_tag(body)), mask);
     }
+    scene->num_placements = scene->num_bodies;
+    broadphase_update(scene->query_index);
+    scene->query_index_stale = false;
+  }
+  return scene->query_index;
+}
+
+// Bodies removed since the index was refreshed are still in it
+void query_add_body(Query *query, Body *body) {
+  if (body_is_removed(body)) return;
+  if (query->found < query->capacity) query->bodies[query->found] = body;
+  query->found++;
+}
+
+// Keeps the nearest hits, nearest first
+void query_add_hit(Query *query, Raycast_Hit hit) {
+  if (body_is_removed(hit.body)) return;
+  size_t last = query->found < query->capacity ? query->found : query->capacity;
+  query->found++;
+  size_t i = last;
+  while (i > 0 && query->hits[i - 1].distance > hit.distance) {
+    if (i < query->capacity) query->hits[i] = query->hits[i - 1];
+    i--;
+  }
+  if (i < query->capacity) query->hits[i] = hit;
+}
+
+void visit_ray(size_t index, Query *query) {
+  Raycast_Hit hit = {.body = scene_get_body(query->scene, index)};
+  if (find_ray_intersection(body_peek_shape(hit.body), query->point,
+    query->direction, query->max_distance, &hit.distance, &hit.normal)) {
+      hit.point = vec_add(query->point, vec_multiply(hit.distance, query->direction));
+      query_add_hit(query, hit);
+  }
+}
+
+size_t scene_raycast_all(Scene *scene, Vector origin, Vector direction,
+  double max_distance, uint32_t tag_mask, Raycast_Hit *hits, size_t max_hits) {
+    Vector unit = vec_unit(direction);
+    // A ray along an axis never leaves its row or column, even if infinite
+    Vector end = {
+      unit.x == 0 ? origin.x : origin.x + unit.x * max_distance,
+      unit.y == 0 ? origin.y : origin.y + unit.y * max_distance
+    };
+    AABB box = {
+      {fmin(origin.x, end.x), fmin(origin.y, end.y)},
+      {fmax(origin.x, end.x), fmax(origin.y, end.y)}
+    };
+    Query query = {
+      .scene = scene, .point = origin, .direction = unit,
+      .max_distance = max_distance, .hits = hits, .capacity = max_hits
+    };
+    broadphase_query_box(scene_query_index(scene), box, tag_mask,
+      (Box_Visitor) visit_ray, &query);
+    return query.found;
+}
+
+bool scene_raycast(Scene *scene, Vector origin, Vector direction,
+  double max_distance, uint32_t tag_mask, Raycast_Hit *hit) {
+    return scene_raycast_all(scene, origin, direction, max_distance, tag_mask,
+      hit, 1) > 0;
+}
+
+void visit_point(size_t index, Query *query) {
+  Body *body = scene_get_body(query->scene, index);
+  if (polygon_contains(body_peek_shape(body), query->point)) {
+    query_add_body(query, body);
+  }
+}
+
+size_t scene_query_point(Scene *scene, Vector point, uint32_t tag_mask,
+  Body **bodies, size_t max_bodies) {
+    Query query = {
+      .scene = scene, .point = point, .bodies = bodies, .capacity = max_bodies
+    };
+    broadphase_query_box(scene_query_index(scene), (AABB) {point, point},
+      tag_mask, (Box_Visitor) visit_point, &query);
+    return query.found;
+}
+
+void visit_box(size_t index, Query *query) {
+  query_add_body(query, scene_get_body(query->scene, index));
+}
+
+size_t scene_query_box(Scene *scene, AABB box, uint32_t tag_mask,
+  Body **bodies, size_t max_bodies) {
+    Query query = {.scene = scene, .bodies = bodies, .capacity = max_bodies};
+    broadphase_query_box(scene_query_index(scene), box, tag_mask,
+      (Box_Visitor) visit_box, &query);
+    return query.found;
+}
+
+void visit_shape(size_t index, Query *query) {
+  Body *body = scene_get_body(query->scene, index);
+  if (find_collision(query->shape, body_peek_shape(body)).collided) {
+    query_add_body(query, body);
+  }
+}
 
+size_t scene_query_shape(Scene *scene, List *shape, uint32_t tag_mask,
+  Body **bodies, size_t max_bodies) {
+    Query query = {
+      .scene = scene, .shape = shape, .bodies = bodies, .capacity = max_bodies
+    };
+    broadphase_query_box(scene_query_index(scene), polygon_bounds(shape),
+      tag_mask, (Box_Visitor) visit_shape, &query);
+    return query.found;
 }
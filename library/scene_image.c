@@ -0,0 +1,258 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scene_image.h"
+#include "allocator.h"
+
+// "SIMG", read as a little-endian integer; reads differently on other machines
+#define IMAGE_MAGIC 0x474D4953u
+// Every section starts at a multiple of this, so the doubles in it are aligned
+#define IMAGE_ALIGNMENT 8
+// Stored in place of a text offset for bodies with no text
+#define NO_TEXT UINT32_MAX
+
+// Bits of a body's flags word
+#define FLAG_CONTINUOUS 1u
+#define FLAG_STOP 2u
+#define FLAG_REMOVED 4u
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t integrator;
+  uint32_t num_bodies;
+  Adaptive_Config adaptive_config;
+  uint64_t num_vertices;
+  // Offsets from the start of the file
+  uint64_t bodies_offset;
+  uint64_t vertices_offset;
+  uint64_t forces_offset;
+  uint64_t forces_size;
+  uint64_t text_offset;
+  uint64_t text_size;
+} Image_Header;
+
+typedef struct {
+  Body_Kinematics kinematics;
+  double mass;
+  double inertia;
+  RGBColor color;
+  // The index of the body's first vertex in the vertex array
+  uint32_t first_vertex;
+  uint32_t num_vertices;
+  uint32_t tag;
+  uint32_t collision_mask;
+  uint32_t flags;
+  // An offset into the text section, or NO_TEXT
+  uint32_t text;
+} Image_Body;
+
+struct scene_image {
+  uint8_t *data;
+  size_t size;
+  bool loaded;
+};
+
+size_t image_align(size_t offset) {
+  return (offset + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+}
+
+// Writes zeros up to the next aligned offset
+bool image_pad(FILE *file, size_t *offset) {
+  uint8_t zeros[IMAGE_ALIGNMENT] = {0};
+  size_t padding = image_align(*offset) - *offset;
+  *offset += padding;
+  return fwrite(zeros, 1, padding, file) == padding;
+}
+
+bool image_write(FILE *file, const void *data, size_t size, size_t *offset) {
+  *offset += size;
+  return fwrite(data, 1, size, file) == size;
+}
+
+bool scene_image_save(Scene *scene, const char *path, Force_Registry *registry) {
+  size_t forces_size;
+  void *forces = scene_save_forces(scene, registry, &forces_size);
+  if (forces == NULL) return false;
+
+  size_t num_bodies = scene_bodies(scene);
+  Image_Body *bodies = ENGINE_CALLOC(num_bodies > 0 ? num_bodies : 1, sizeof(Image_Body));
+  assert(bodies != NULL);
+  size_t num_vertices = 0;
+  size_t text_size = 0;
+  for (size_t i = 0; i < num_bodies; i++) {
+    Body *body = scene_get_body(scene, i);
+    Image_Body *record = &bodies[i];
+    record->kinematics = body_get_kinematics(body);
+    record->mass = body_get_mass(body);
+    record->inertia = body_get_inertia(body);
+    record->color = body_get_color(body);
+    record->first_vertex = num_vertices;
+    record->num_vertices = list_size(body_peek_shape(body));
+    record->tag = body_get_tag(body);
+    record->collision_mask = body_get_collision_mask(body);
+    record->flags = (body_get_continuous(body) ? FLAG_CONTINUOUS : 0)
+      | (body_get_stop(body) ? FLAG_STOP : 0)
+      | (body_is_removed(body) ? FLAG_REMOVED : 0);
+    char *text = body_get_text(body);
+    record->text = text != NULL ? text_size : NO_TEXT;
+    if (text != NULL) text_size += strlen(text) + 1;
+    num_vertices += record->num_vertices;
+  }
+
+  Image_Header header = {
+    .magic = IMAGE_MAGIC,
+    .version = SCENE_IMAGE_VERSION,
+    .integrator = scene_get_integrator(scene),
+    .num_bodies = num_bodies,
+    .adaptive_config = scene_get_adaptive_config(scene),
+    .num_vertices = num_vertices,
+    .forces_size = forces_size,
+    .text_size = text_size
+  };
+  header.bodies_offset = image_align(sizeof(Image_Header));
+  header.vertices_offset = image_align(header.bodies_offset + sizeof(Image_Body) * num_bodies);
+  header.forces_offset = image_align(header.vertices_offset + sizeof(Vector) * num_vertices);
+  header.text_offset = image_align(header.forces_offset + forces_size);
+
+  FILE *file = fopen(path, "wb");
+  bool saved = file != NULL;
+  size_t offset = 0;
+  if (saved) {
+    saved = image_write(file, &header, sizeof(header), &offset)
+      && image_pad(file, &offset)
+      && image_write(file, bodies, sizeof(Image_Body) * num_bodies, &offset)
+      && image_pad(file, &offset);
+  }
+  for (size_t i = 0; i < num_bodies && saved; i++) {
+    List *shape = body_peek_shape(scene_get_body(scene, i));
+    for (size_t j = 0; j < list_size(shape) && saved; j++) {
+      saved = image_write(file, list_get(shape, j), sizeof(Vector), &offset);
+    }
+  }
+  saved = saved && image_pad(file, &offset)
+    && image_write(file, forces, forces_size, &offset)
+    && image_pad(file, &offset);
+  for (size_t i = 0; i < num_bodies && saved; i++) {
+    char *text = body_get_text(scene_get_body(scene, i));
+    if (text != NULL) saved = image_write(file, text, strlen(text) + 1, &offset);
+  }
+  if (file != NULL && fclose(file) != 0) saved = false;
+  allocator_free(forces);
+  allocator_free(bodies);
+  return saved;
+}
+
+// Whether count items of a size fit in the file at an aligned offset
+bool image_section_fits(uint64_t offset, uint64_t count, size_t item_size, size_t size) {
+  return offset % IMAGE_ALIGNMENT == 0 && offset <= size
+    && count <= (size - offset) / item_size;
+}
+
+bool image_header_valid(Image_Header *header, size_t size) {
+  return header->magic == IMAGE_MAGIC
+    && header->version == SCENE_IMAGE_VERSION
+    && image_section_fits(header->bodies_offset, header->num_bodies, sizeof(Image_Body), size)
+    && image_section_fits(header->vertices_offset, header->num_vertices, sizeof(Vector), size)
+    && image_section_fits(header->forces_offset, header->forces_size, 1, size)
+    && image_section_fits(header->text_offset, header->text_size, 1, size);
+}
+
+Scene_Image *scene_image_map(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(Image_Header)) {
+    close(fd);
+    return NULL;
+  }
+  // Private and writable, so bodies can move their vertices in place
+  size_t size = info.st_size;
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  if (!image_header_valid(data, size)) {
+    munmap(data, size);
+    return NULL;
+  }
+
+  Scene_Image *image = ENGINE_MALLOC(sizeof(Scene_Image));
+  assert(image != NULL);
+  image->data = data;
+  image->size = size;
+  image->loaded = false;
+  return image;
+}
+
+// Returns NULL if the record doesn't describe a valid body
+Body *image_body_init(Scene_Image *image, Image_Body *record) {
+  Image_Header *header = (Image_Header *) image->data;
+  char *text = (char *) image->data + header->text_offset;
+  bool text_valid = record->text == NO_TEXT
+    || (record->text < header->text_size
+      && memchr(text + record->text, '\0', header->text_size - record->text) != NULL);
+  if (record->num_vertices < 3 || record->first_vertex > header->num_vertices
+    || record->num_vertices > header->num_vertices - record->first_vertex
+    || !(record->mass > 0) || record->tag >= NUM_TAGS || !text_valid) {
+      return NULL;
+  }
+
+  Vector *vertices = (Vector *) (image->data + header->vertices_offset)
+    + record->first_vertex;
+  // The vertices belong to the image, so the shape doesn't free them
+  List *shape = list_init(record->num_vertices, NULL);
+  for (size_t i = 0; i < record->num_vertices; i++) {
+    list_add(shape, &vertices[i]);
+  }
+  Body *body = body_init(shape, record->mass, record->color);
+  body_set_inertia(body, record->inertia);
+  body_set_kinematics(body, record->kinematics);
+  body_set_tag(body, record->tag);
+  body_set_collision_mask(body, record->collision_mask);
+  body_set_continuous(body, record->flags & FLAG_CONTINUOUS);
+  body_set_stop(body, record->flags & FLAG_STOP);
+  if (record->flags & FLAG_REMOVED) body_remove(body);
+  if (record->text != NO_TEXT) body_set_text(body, text + record->text);
+  return body;
+}
+
+Scene *scene_image_load(Scene_Image *image, Force_Registry *registry) {
+  assert(!image->loaded);
+  Image_Header *header = (Image_Header *) image->data;
+  Adaptive_Config config = header->adaptive_config;
+  if (header->integrator > INTEGRATOR_ADAPTIVE_RK45 || !(config.min_dt > 0)
+    || !(config.min_dt <= config.max_dt) || !(config.tolerance > 0)) {
+      return NULL;
+  }
+  Scene *scene = scene_init();
+  scene_set_integrator(scene, header->integrator);
+  scene_set_adaptive_config(scene, config);
+
+  Image_Body *bodies = (Image_Body *) (image->data + header->bodies_offset);
+  for (size_t i = 0; i < header->num_bodies; i++) {
+    Body *body = image_body_init(image, &bodies[i]);
+    if (body == NULL) {
+      scene_free(scene);
+      return NULL;
+    }
+    scene_add_body(scene, body);
+  }
+  if (!scene_load_forces(scene, image->data + header->forces_offset,
+    header->forces_size, registry)) {
+      scene_free(scene);
+      return NULL;
+  }
+  image->loaded = true;
+  return scene;
+}
+
+void scene_image_unmap(Scene_Image *image) {
+  munmap(image->data, image->size);
+  allocator_free(image);
+}
@@ -1,17 +1,41 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL2_gfxPrimitives.h>
 #include <SDL2/SDL_ttf.h>
 #include <time.h>
 #include "sdl_wrapper.h"
+#include "allocator.h"
 #include "scene.h"
+#include "input_log.h"
+#include "profiler.h"
+
+// Every frame's polygons are drawn with one SDL_RenderGeometry() call
+#if !SDL_VERSION_ATLEAST(2, 0, 18)
+#error "sdl_wrapper.c needs SDL 2.0.18 or newer for SDL_RenderGeometry()"
+#endif
 
 #define WINDOW_TITLE "CS 3"
 #define WINDOW_WIDTH 1000
 #define WINDOW_HEIGHT 500
 #define MS_PER_S 1e3
+// The mouse position sdl_is_done() returns when there is no mouse input
+#define IDLE_X 145
+#define IDLE_Y (WINDOW_HEIGHT - 140)
+// The profiler buffer sizes for --profile: about a million spans,
+// or a few minutes at a few dozen spans per tick
+#define PROFILE_SPANS (1 << 20)
+#define PROFILE_TICKS (1 << 16)
+#define FONT_FILE "arial.ttf"
+// The most rendered strings kept as textures; once it is full,
+// the least recently drawn string's texture is replaced
+#define TEXT_CACHE_SIZE 256
+// Buckets the cached strings are looked up in by hash, a power of 2
+#define TEXT_CACHE_BUCKETS 512
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
 
 /**
  * The coordinate at the center of the screen.
@@ -39,16 +63,123 @@ KeyHandler key_handler = NULL;
  */
 uint32_t key_start_timestamp;
 /**
- * The value of clock() when time_since_last_tick() was last called.
- * Initially 0.
+ * The value of SDL_GetPerformanceCounter() when time_since_last_tick()
+ * was last called. Initially 0.
  */
-clock_t last_clock = 0;
+uint64_t last_counter = 0;
 /**
  * Stores whether the mouse is currently pressed (held down).
  */
 bool flag = false;
 
-TTF_Font *font = NULL;
+/**
+ * A font opened at one size.
+ */
+typedef struct {
+    int ptsize;
+    // NULL if the font file couldn't be opened
+    TTF_Font *font;
+} Font_Entry;
+
+/**
+ * A string rendered to a texture, with what it was rendered with.
+ */
+typedef struct text_entry {
+    uint64_t hash;
+    char *text;
+    int ptsize;
+    SDL_Color color;
+    SDL_Texture *texture;
+    int width;
+    int height;
+    // The value of text_draws when it was last drawn
+    size_t last_used;
+    // The next entry in the same bucket, or NULL
+    struct text_entry *next;
+} Text_Entry;
+
+/**
+ * A cached string's texture to copy to the window once the polygons are drawn.
+ */
+typedef struct {
+    SDL_Texture *texture;
+    SDL_Rect rect;
+} Text_Copy;
+
+/**
+ * The polygons drawn since the batch was last flushed, as triangles
+ * for a single SDL_RenderGeometry() call.
+ */
+SDL_Vertex *batch_vertices = NULL;
+size_t batch_num_vertices = 0;
+size_t batch_vertices_capacity = 0;
+int *batch_indices = NULL;
+size_t batch_num_indices = 0;
+size_t batch_indices_capacity = 0;
+/**
+ * Room for one polygon's triangles from polygon_triangulate(),
+ * followed by room for it to work in.
+ */
+size_t *polygon_triangles = NULL;
+size_t polygon_triangles_capacity = 0;
+/**
+ * Where the center of the scene goes in the window and how many pixels
+ * a unit is, worked out from the window size when a batch starts.
+ */
+double screen_center_x;
+double screen_center_y;
+double screen_scale;
+
+/**
+ * The fonts opened so far, one per size, kept open until sdl_clean_up().
+ */
+Font_Entry *fonts = NULL;
+size_t num_fonts = 0;
+size_t fonts_capacity = 0;
+/**
+ * The textures of the strings drawn most recently,
+ * chained into buckets by the low bits of their hashes.
+ */
+Text_Entry text_cache[TEXT_CACHE_SIZE];
+size_t text_cache_size = 0;
+Text_Entry *text_buckets[TEXT_CACHE_BUCKETS];
+size_t text_draws = 0;
+/**
+ * The text drawn since the batch was last flushed, in order,
+ * and the value of text_draws then; strings drawn after it are in the batch.
+ */
+Text_Copy *batch_text = NULL;
+size_t batch_num_text = 0;
+size_t batch_text_capacity = 0;
+size_t batch_text_draws = 0;
+
+/**
+ * The file input is being recorded to, or NULL if it isn't being recorded.
+ */
+FILE *input_recording = NULL;
+/**
+ * The log being replayed in place of real input, or NULL.
+ */
+Input_Log *input_replay = NULL;
+/**
+ * Whether to run without a window, drawing nothing; only when replaying.
+ */
+bool headless = false;
+/**
+ * The number of calls to sdl_is_done() so far, which numbers the frames
+ * in input logs.
+ */
+size_t frame = 0;
+/**
+ * The value of SDL_GetPerformanceCounter() when replaying started,
+ * and whether the time the replay took has been reported.
+ */
+uint64_t replay_start;
+bool replay_reported = false;
+/**
+ * The file the profile is written to at exit, or NULL if not profiling.
+ */
+FILE *profile_trace = NULL;
 
 /**
  * Converts an SDL key code to a char.
@@ -77,6 +208,7 @@ void sdl_init(Vector min, Vector max) {
 
     center = vec_multiply(0.5, vec_add(min, max)),
     max_diff = vec_subtract(max, center);
+    if (headless) return;
     SDL_Init(SDL_INIT_EVERYTHING);
 
     // addition is to initialize ttf
@@ -93,11 +225,15 @@ void sdl_init(Vector min, Vector max) {
     renderer = SDL_CreateRenderer(window, -1, 0);
 }
 
-Bool_Coords sdl_is_done(Scene *scene, Body *body) {
-    SDL_Event *event = malloc(sizeof(*event));
+void sdl_record_event(Input_Event event) {
+    if (input_recording != NULL) input_log_write_event(input_recording, frame, event);
+}
+
+Bool_Coords sdl_poll_events(Scene *scene, Body *body) {
+    SDL_Event *event = ENGINE_MALLOC(sizeof(*event));
     assert(event);
-    int x = 145;
-    int y = WINDOW_HEIGHT - 140;
+    int x = IDLE_X;
+    int y = IDLE_Y;
     bool event_done = false;
     while (SDL_PollEvent(event)) {
 
@@ -126,7 +262,8 @@ Bool_Coords sdl_is_done(Scene *scene, Body *body) {
                 event_done = true;
                 break;
             case SDL_QUIT:
-                free(event);
+                sdl_record_event((Input_Event) {.type = INPUT_QUIT});
+                allocator_free(event);
                 return (Bool_Coords){.b = true, .x = 0, .y = 0};
             case SDL_KEYDOWN:
             case SDL_KEYUP:
@@ -144,6 +281,8 @@ Bool_Coords sdl_is_done(Scene *scene, Body *body) {
                     event->type == SDL_KEYDOWN ? KEY_PRESSED : KEY_RELEASED;
                 double held_time =
                     (timestamp - key_start_timestamp) / MS_PER_S;
+                sdl_record_event((Input_Event) {.type = INPUT_KEY, .key = key,
+                    .released = type == KEY_RELEASED, .held_time = held_time});
                 key_handler(key, type, held_time, scene, body);
                 break;
             //default:
@@ -152,76 +291,209 @@ Bool_Coords sdl_is_done(Scene *scene, Body *body) {
         }
         if(event_done) break;
     }
-    free(event);
+    allocator_free(event);
     //printf("%d %d\n", x, y);
+    if (x != IDLE_X || y != IDLE_Y) {
+        sdl_record_event((Input_Event) {.type = INPUT_POINTER, .x = x, .y = y});
+    }
     return (Bool_Coords){.b = false, .x = x, .y = y};
 }
 
+// Hands the key handler the keys pressed during this frame of the replay
+Bool_Coords sdl_replay_events(Scene *scene, Body *body) {
+    Bool_Coords result = {.b = false, .x = IDLE_X, .y = IDLE_Y};
+    Input_Event event;
+    while (input_log_next_event(input_replay, frame, &event)) {
+        switch (event.type) {
+            case INPUT_KEY:
+                if (key_handler) {
+                    key_handler(event.key, event.released ? KEY_RELEASED : KEY_PRESSED,
+                        event.held_time, scene, body);
+                }
+                break;
+            case INPUT_POINTER:
+                result.x = event.x;
+                result.y = event.y;
+                break;
+            case INPUT_QUIT:
+                result.b = true;
+                break;
+        }
+    }
+    // A recording that was cut short ends as though the window closed
+    if (input_log_finished(input_replay)) result.b = true;
+    if (!result.b) return result;
+
+    if (!replay_reported) {
+        double seconds = (double) (SDL_GetPerformanceCounter() - replay_start)
+            / SDL_GetPerformanceFrequency();
+        fprintf(stderr, "Replayed %zu frames in %.3f s\n", frame + 1, seconds);
+        replay_reported = true;
+    }
+    return (Bool_Coords){.b = true, .x = 0, .y = 0};
+}
+
+Bool_Coords sdl_is_done(Scene *scene, Body *body) {
+    Bool_Coords result = input_replay != NULL
+        ? sdl_replay_events(scene, body)
+        : sdl_poll_events(scene, body);
+    frame++;
+    return result;
+}
+
 void sdl_clear(void) {
+    if (headless) return;
+    // Anything not yet drawn would be cleared anyway
+    batch_num_vertices = 0;
+    batch_num_indices = 0;
+    batch_num_text = 0;
+    batch_text_draws = text_draws;
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderClear(renderer);
 }
 
-void sdl_draw_polygon(List *points, RGBColor color) {
-    // Check parameters
+// Grows an array, if need be, to hold at least the given number of items
+void *sdl_reserve(void *array, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) return array;
+    size_t new_capacity = *capacity > 0 ? *capacity : INITIAL_CAPACITY;
+    while (new_capacity < needed) new_capacity *= GROW_FACTOR;
+    array = ENGINE_REALLOC(array, item_size * new_capacity);
+    assert(array != NULL);
+    *capacity = new_capacity;
+    return array;
+}
+
+// Scales the scene so it fits entirely in the window,
+// with the center of the scene at the center of the window
+void sdl_update_screen_transform(void) {
+    int width, height;
+    SDL_GetWindowSize(window, &width, &height);
+    screen_center_x = width / 2.0;
+    screen_center_y = height / 2.0;
+    double x_scale = screen_center_x / max_diff.x,
+           y_scale = screen_center_y / max_diff.y;
+    screen_scale = x_scale < y_scale ? x_scale : y_scale;
+}
+
+// Adds a polygon, split into the given triangles, to the batch,
+// rotated by an angle about a pivot and then translated, without changing the list
+void sdl_batch_polygon(List *points, const size_t *triangles, size_t num_triangles,
+        RGBColor color, double angle, Vector pivot, Vector translation) {
+    // Fewer than 3 points cover nothing
+    if (num_triangles == 0) return;
     size_t n = list_size(points);
-    assert(n >= 3);
-    assert(0 <= color.r && color.r <= 1);
-    assert(0 <= color.g && color.g <= 1);
-    assert(0 <= color.b && color.b <= 1);
+    if (batch_num_vertices == 0) sdl_update_screen_transform();
+    batch_vertices = sdl_reserve(batch_vertices, &batch_vertices_capacity,
+        batch_num_vertices + n, sizeof(SDL_Vertex));
+    batch_indices = sdl_reserve(batch_indices, &batch_indices_capacity,
+        batch_num_indices + 3 * num_triangles, sizeof(int));
 
-    // Scale scene so it fits entirely in the window,
-    // with the center of the scene at the center of the window
-    int *width = malloc(sizeof(*width)),
-        *height = malloc(sizeof(*height));
-    assert(width);
-    assert(height);
-    SDL_GetWindowSize(window, width, height);
-    double center_x = *width / 2.0,
-           center_y = *height / 2.0;
-    free(width);
-    free(height);
-    double x_scale = center_x / max_diff.x,
-           y_scale = center_y / max_diff.y;
-    double scale = x_scale < y_scale ? x_scale : y_scale;
-
-    // Convert each vertex to a point on screen
-    short *x_points = malloc(sizeof(*x_points) * n),
-          *y_points = malloc(sizeof(*y_points) * n);
-    assert(x_points);
-    assert(y_points);
+    SDL_Color vertex_color = {color.r * 255, color.g * 255, color.b * 255, 255};
+    double cos_angle = cos(angle), sin_angle = sin(angle);
     for (size_t i = 0; i < n; i++) {
-        Vector *vertex = list_get(points, i);
-        Vector pos_from_center =
-            vec_multiply(scale, vec_subtract(*vertex, center));
+        Vector vertex = *(Vector *) list_get(points, i);
+        Vector from_pivot = vec_subtract(vertex, pivot);
+        vertex = (Vector) {
+            pivot.x + translation.x + from_pivot.x * cos_angle - from_pivot.y * sin_angle,
+            pivot.y + translation.y + from_pivot.x * sin_angle + from_pivot.y * cos_angle
+        };
+        Vector pos_from_center = vec_multiply(screen_scale, vec_subtract(vertex, center));
         // Flip y axis since positive y is down on the screen
-        x_points[i] = round(center_x + pos_from_center.x);
-        y_points[i] = round(center_y - pos_from_center.y);
+        batch_vertices[batch_num_vertices + i] = (SDL_Vertex) {
+            {screen_center_x + pos_from_center.x, screen_center_y - pos_from_center.y},
+            vertex_color, {0, 0}
+        };
     }
+    // Moving the polygon doesn't change how it splits into triangles
+    size_t num_indices = 3 * num_triangles;
+    for (size_t i = 0; i < num_indices; i++) {
+        batch_indices[batch_num_indices + i] = batch_num_vertices + triangles[i];
+    }
+    batch_num_vertices += n;
+    batch_num_indices += num_indices;
+}
 
-    // Draw polygon with the given color
-    filledPolygonRGBA(
-        renderer,
-        x_points, y_points, n,
-        color.r * 255, color.g * 255, color.b * 255, 255
-    );
-    free(x_points);
-    free(y_points);
+// Draws the batched polygons, in the order they were added, then the batched
+// text on top of them, and empties the batch
+void sdl_flush_batch(void) {
+    if (batch_num_indices > 0) {
+        SDL_RenderGeometry(renderer, NULL, batch_vertices, batch_num_vertices,
+            batch_indices, batch_num_indices);
+    }
+    for (size_t i = 0; i < batch_num_text; i++) {
+        SDL_RenderCopy(renderer, batch_text[i].texture, NULL, &batch_text[i].rect);
+    }
+    batch_num_vertices = 0;
+    batch_num_indices = 0;
+    batch_num_text = 0;
+    batch_text_draws = text_draws;
+}
+
+void sdl_free_batch(void) {
+    allocator_free(batch_vertices);
+    allocator_free(batch_indices);
+    allocator_free(polygon_triangles);
+    allocator_free(batch_text);
+    batch_vertices = NULL;
+    batch_indices = NULL;
+    polygon_triangles = NULL;
+    batch_text = NULL;
+    batch_num_vertices = batch_vertices_capacity = 0;
+    batch_num_indices = batch_indices_capacity = 0;
+    batch_num_text = batch_text_capacity = 0;
+    polygon_triangles_capacity = 0;
+}
+
+void sdl_draw_polygon(List *points, RGBColor color) {
+    // Check parameters
+    size_t n = list_size(points);
+    assert(0 <= color.r && color.r <= 1);
+    assert(0 <= color.g && color.g <= 1);
+    assert(0 <= color.b && color.b <= 1);
+    if (headless || n < 3) return;
+    polygon_triangles = sdl_reserve(polygon_triangles, &polygon_triangles_capacity,
+        3 * (n - 2) + n, sizeof(size_t));
+    size_t num_triangles = polygon_triangulate(points, polygon_triangles,
+        polygon_triangles + 3 * (n - 2));
+    sdl_batch_polygon(points, polygon_triangles, num_triangles, color,
+        0, VEC_ZERO, VEC_ZERO);
 }
 
 void sdl_show(void) {
+    if (headless) return;
+    sdl_flush_batch();
     SDL_RenderPresent(renderer);
 }
 
 void sdl_render_scene(Scene *scene) {
+    sdl_render_scene_interpolated(scene, 1.0);
+}
+
+void sdl_render_scene_interpolated(Scene *scene, double alpha) {
+    if (headless) return;
+    PROFILE_BEGIN(PHASE_RENDER);
     sdl_clear();
     size_t body_count = scene_bodies(scene);
     for (size_t i = 0; i < body_count; i++) {
         Body *body = scene_get_body(scene, i);
-        List *shape = body_get_shape(body);
-        sdl_draw_polygon(shape, body_get_color(body));
-        list_free(shape);
+        // Moves the shape back as body_get_interpolated_shape() does,
+        // without copying it
+        Vector centroid = body_get_centroid(body);
+        double rotation = (alpha - 1)
+            * (body_get_angle(body) - body_get_previous_angle(body));
+        Vector translation = vec_multiply(alpha - 1,
+            vec_subtract(centroid, body_get_previous_centroid(body)));
+        // A body's triangles are worked out once, not every frame
+        size_t num_triangles;
+        const size_t *triangles = body_get_triangles(body, &num_triangles);
+        sdl_batch_polygon(body_peek_shape(body), triangles, num_triangles,
+            body_get_color(body), rotation, centroid, translation);
+    }
+    // All the polygons go in one draw call, and the text is copied on top
+    for (size_t i = 0; i < body_count; i++) {
+        Body *body = scene_get_body(scene, i);
         char *text = body_get_text(body);
+        if (text == NULL) continue;
         /* IMPORTANT NOTE: in sdl_ttf (0, 0) is top left but
          * for all other sdl function (0, 0) is top right
          * so unfortunately we have to account for that. */
@@ -229,8 +501,9 @@ void sdl_render_scene(Scene *scene) {
         Vector adjusted_centroid = (Vector) {centroid.x, WINDOW_HEIGHT - centroid.y};
         sdl_draw_text(text, adjusted_centroid);
     }
-    
+
     sdl_show();
+    PROFILE_END(PHASE_RENDER);
 }
 
 void sdl_on_key(KeyHandler handler) {
@@ -238,11 +511,20 @@ void sdl_on_key(KeyHandler handler) {
 }
 
 double time_since_last_tick(void) {
-    clock_t now = clock();
-    double difference = last_clock
-        ? (double) (now - last_clock) / CLOCKS_PER_SEC
+    if (input_replay != NULL) {
+        // Past the end of the recording, time stands still
+        double dt = 0.0;
+        input_log_next_dt(input_replay, &dt);
+        return dt;
+    }
+    // clock() measures CPU time, which stalls while the process waits on
+    // vsync or the OS, so measure wall-clock time instead
+    uint64_t now = SDL_GetPerformanceCounter();
+    double difference = last_counter
+        ? (double) (now - last_counter) / SDL_GetPerformanceFrequency()
         : 0.0; // return 0 the first time this is called
-    last_clock = now;
+    last_counter = now;
+    if (input_recording != NULL) input_log_write_dt(input_recording, difference);
     return difference;
 }
 
@@ -250,29 +532,211 @@ void sdl_draw_text(char *txt, Vector centroid) {
   sdl_draw_permanent_text(txt, 20, (SDL_Color) {0, 0, 0}, centroid);
 }
 
+// Opens the font at a size the first time it is asked for
+TTF_Font *sdl_get_font(int ptsize) {
+    for (size_t i = 0; i < num_fonts; i++) {
+        if (fonts[i].ptsize == ptsize) return fonts[i].font;
+    }
+    if (num_fonts == fonts_capacity) {
+        fonts_capacity = fonts_capacity > 0 ? fonts_capacity * GROW_FACTOR : INITIAL_CAPACITY;
+        fonts = ENGINE_REALLOC(fonts, sizeof(Font_Entry) * fonts_capacity);
+        assert(fonts != NULL);
+    }
+    TTF_Font *font = TTF_OpenFont(FONT_FILE, ptsize);
+    if (font == NULL) {
+        fprintf(stderr, "Couldn't open font %s: %s\n", FONT_FILE, TTF_GetError());
+    }
+    fonts[num_fonts++] = (Font_Entry) {ptsize, font};
+    return font;
+}
+
+uint64_t text_hash(const char *txt, int ptsize, SDL_Color color) {
+    uint64_t hash = FNV_OFFSET;
+    for (const char *c = txt; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * FNV_PRIME;
+    }
+    uint32_t rgba = color.r | color.g << 8 | color.b << 16 | (uint32_t) color.a << 24;
+    hash = (hash ^ (uint32_t) ptsize) * FNV_PRIME;
+    return (hash ^ rgba) * FNV_PRIME;
+}
+
+// Finds the texture of a string, rendering it if it isn't in the cache.
+// Returns NULL if it can't be rendered.
+Text_Entry *sdl_get_text(char *txt, int ptsize, SDL_Color color) {
+    uint64_t hash = text_hash(txt, ptsize, color);
+    Text_Entry **bucket = &text_buckets[hash & (TEXT_CACHE_BUCKETS - 1)];
+    for (Text_Entry *entry = *bucket; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->ptsize == ptsize
+                && memcmp(&entry->color, &color, sizeof(SDL_Color)) == 0
+                && strcmp(entry->text, txt) == 0) {
+            entry->last_used = ++text_draws;
+            return entry;
+        }
+    }
+
+    TTF_Font *font = sdl_get_font(ptsize);
+    if (font == NULL) return NULL;
+    SDL_Surface *message = TTF_RenderText_Solid(font, txt, color);
+    if (message == NULL) return NULL;
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, message);
+    SDL_FreeSurface(message);
+    if (texture == NULL) return NULL;
+
+    Text_Entry *entry;
+    if (text_cache_size < TEXT_CACHE_SIZE) {
+        entry = &text_cache[text_cache_size++];
+    } else {
+        entry = &text_cache[0];
+        for (size_t i = 1; i < TEXT_CACHE_SIZE; i++) {
+            if (text_cache[i].last_used < entry->last_used) entry = &text_cache[i];
+        }
+        // Only when a frame draws more strings than the cache holds
+        if (entry->last_used > batch_text_draws) sdl_flush_batch();
+        Text_Entry **link = &text_buckets[entry->hash & (TEXT_CACHE_BUCKETS - 1)];
+        while (*link != entry) link = &(*link)->next;
+        *link = entry->next;
+        SDL_DestroyTexture(entry->texture);
+        allocator_free(entry->text);
+    }
+    size_t length = strlen(txt);
+    entry->text = ENGINE_MALLOC(length + 1);
+    assert(entry->text != NULL);
+    memcpy(entry->text, txt, length + 1);
+    entry->hash = hash;
+    entry->ptsize = ptsize;
+    entry->color = color;
+    entry->texture = texture;
+    SDL_QueryTexture(texture, NULL, NULL, &entry->width, &entry->height);
+    entry->last_used = ++text_draws;
+    entry->next = *bucket;
+    *bucket = entry;
+    return entry;
+}
+
 void sdl_draw_permanent_text(char *txt, int ptsize, SDL_Color color, Vector centroid) {
-  font = TTF_OpenFont("arial.ttf", ptsize);
-  SDL_Surface *message = TTF_RenderText_Solid(font, txt, color);
-  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, message);
-  int text_width;
-  int text_height;
-  // finds values of text_width and text_height
-  SDL_QueryTexture(texture, NULL, NULL, &text_width, &text_height);
-
-  double left_x = centroid.x - text_width / 2;
-  double left_y = centroid.y - text_height / 2;
-	// upper left x coordinate, upper left y coordinate, width, height
-  SDL_Rect rect = {left_x, left_y, text_width, text_height};
-  SDL_Rect *dstrect = (SDL_Rect *) malloc(sizeof(SDL_Rect));
-  *dstrect = rect;
-
-  SDL_RenderCopy(renderer, texture, NULL, dstrect);
-  TTF_CloseFont(font);
+    if (headless || txt == NULL || txt[0] == '\0') return;
+    Text_Entry *entry = sdl_get_text(txt, ptsize, color);
+    if (entry == NULL) return;
+
+    // upper left x coordinate, upper left y coordinate, width, height
+    SDL_Rect rect = {centroid.x - entry->width / 2, centroid.y - entry->height / 2,
+        entry->width, entry->height};
+    // Copied after the polygons, so the batch stays a single draw call
+    batch_text = sdl_reserve(batch_text, &batch_text_capacity,
+        batch_num_text + 1, sizeof(Text_Copy));
+    batch_text[batch_num_text++] = (Text_Copy) {entry->texture, rect};
+}
+
+// Releases the cached textures and fonts, while SDL is still running
+void sdl_free_text(void) {
+    for (size_t i = 0; i < text_cache_size; i++) {
+        SDL_DestroyTexture(text_cache[i].texture);
+        allocator_free(text_cache[i].text);
+    }
+    text_cache_size = 0;
+    memset(text_buckets, 0, sizeof(text_buckets));
+    batch_num_text = 0;
+    for (size_t i = 0; i < num_fonts; i++) {
+        if (fonts[i].font != NULL) TTF_CloseFont(fonts[i].font);
+    }
+    allocator_free(fonts);
+    fonts = NULL;
+    num_fonts = 0;
+    fonts_capacity = 0;
 }
 
 void sdl_clean_up(Scene *scene) {
   scene_free(scene);
+  if (headless) return;
+  sdl_free_text();
+  sdl_free_batch();
   SDL_DestroyRenderer(renderer);
   TTF_Quit();
   SDL_Quit();
 }
+
+// Finishes writing the recording, however the demo exits
+void sdl_close_input(void) {
+    if (input_recording != NULL) fclose(input_recording);
+    input_recording = NULL;
+    if (input_replay != NULL) input_log_free(input_replay);
+    input_replay = NULL;
+}
+
+bool sdl_record_input(const char *path) {
+    assert(input_recording == NULL && input_replay == NULL);
+    input_recording = fopen(path, "w");
+    if (input_recording == NULL) {
+        fprintf(stderr, "Couldn't open file %s\n", path);
+        return false;
+    }
+    input_log_write_header(input_recording);
+    atexit(sdl_close_input);
+    return true;
+}
+
+bool sdl_replay_input(const char *path, bool run_headless) {
+    assert(input_recording == NULL && input_replay == NULL);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Couldn't open file %s\n", path);
+        return false;
+    }
+    input_replay = input_log_read(file);
+    fclose(file);
+    if (input_replay == NULL) return false;
+    headless = run_headless;
+    replay_start = SDL_GetPerformanceCounter();
+    atexit(sdl_close_input);
+    return true;
+}
+
+// Writes out everything profiled, however the demo exits
+void sdl_write_profile(void) {
+    if (profile_trace == NULL) return;
+    if (profiler_dropped() > 0) {
+        fprintf(stderr, "The profiler's buffers filled up; %zu records were dropped\n",
+            profiler_dropped());
+    }
+    profiler_write_chrome_trace(profile_trace);
+    fclose(profile_trace);
+    profile_trace = NULL;
+    profiler_stop();
+}
+
+bool sdl_profile(const char *path) {
+    assert(profile_trace == NULL);
+    profile_trace = fopen(path, "w");
+    if (profile_trace == NULL) {
+        fprintf(stderr, "Couldn't open file %s\n", path);
+        return false;
+    }
+#ifndef PROFILE
+    fprintf(stderr, "Built without PROFILE=1, so the profile will be empty\n");
+#endif
+    profiler_start(PROFILE_SPANS, PROFILE_TICKS);
+    atexit(sdl_write_profile);
+    return true;
+}
+
+bool sdl_input_options(int argc, char *argv[]) {
+    const char *record = NULL, *replay = NULL, *profile = NULL;
+    bool run_headless = false;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) record = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) replay = argv[++i];
+        else if (strcmp(argv[i], "--headless") == 0) run_headless = true;
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) profile = argv[++i];
+        else valid = false;
+    }
+    if (!valid || (record != NULL && replay != NULL) || (run_headless && replay == NULL)) {
+        fprintf(stderr, "Usage: %s [--record <log> | --replay <log> [--headless]] "
+            "[--profile <trace>]\n", argv[0]);
+        return false;
+    }
+    if (profile != NULL && !sdl_profile(profile)) return false;
+    if (record != NULL) return sdl_record_input(record);
+    if (replay != NULL) return sdl_replay_input(replay, run_headless);
+    return true;
+}
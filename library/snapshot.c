@@ -0,0 +1,497 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "allocator.h"
+
+// "SCNE", read as a little-endian integer
+#define SNAPSHOT_MAGIC 0x454E4353u
+// Written in place of a NULL body
+#define NO_BODY UINT32_MAX
+// Written before each collision table entry: an event filter, or a response
+#define EVENT_FILTER 0
+#define RESPONSE_ENTRY 1
+#define READ_CHUNK 4096
+
+// Bits of a body's flags word
+#define FLAG_CONTINUOUS 1u
+#define FLAG_STOP 2u
+#define FLAG_REMOVED 4u
+
+struct force_registry {
+  Force_Type *types;
+  size_t num_types;
+  size_t capacity;
+};
+
+// Where a body is in the scene being saved
+typedef struct {
+  Body *body;
+  uint32_t index;
+} Body_Index;
+
+struct snapshot {
+  Force_Registry *registry;
+  bool failed;
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  // How far reading has got
+  size_t position;
+  // Writing looks bodies up by address, reading by index
+  Body_Index *body_indices;
+  Body **bodies;
+  size_t num_bodies;
+};
+
+Force_Registry *force_registry_init(void) {
+  Force_Registry *registry = ENGINE_MALLOC(sizeof(Force_Registry));
+  assert(registry != NULL);
+  registry->types = NULL;
+  registry->num_types = 0;
+  registry->capacity = 0;
+  return registry;
+}
+
+void force_registry_free(Force_Registry *registry) {
+  allocator_free(registry->types);
+  allocator_free(registry);
+}
+
+Force_Type *registry_find_id(Force_Registry *registry, uint32_t id) {
+  for (size_t i = 0; i < registry->num_types; i++) {
+    if (registry->types[i].id == id) return &registry->types[i];
+  }
+  return NULL;
+}
+
+void force_registry_add(Force_Registry *registry, Force_Type type) {
+  assert(type.id != 0);
+  assert(registry_find_id(registry, type.id) == NULL);
+  assert(type.creator != NULL);
+  if (registry->num_types == registry->capacity) {
+    registry->capacity = registry->capacity > 0
+      ? registry->capacity * GROW_FACTOR
+      : INITIAL_CAPACITY;
+    registry->types = ENGINE_REALLOC(registry->types, sizeof(Force_Type) * registry->capacity);
+    assert(registry->types != NULL);
+  }
+  registry->types[registry->num_types++] = type;
+}
+
+Force_Type *registry_find_creator(Force_Registry *registry, ForceCreator creator) {
+  for (size_t i = 0; i < registry->num_types; i++) {
+    if (registry->types[i].creator == creator) return &registry->types[i];
+  }
+  return NULL;
+}
+
+// Makes room for some more bytes at the end of the data
+void snapshot_reserve(Snapshot *snapshot, size_t bytes) {
+  if (snapshot->size + bytes <= snapshot->capacity) return;
+  while (snapshot->size + bytes > snapshot->capacity) {
+    snapshot->capacity = snapshot->capacity > 0
+      ? snapshot->capacity * GROW_FACTOR
+      : READ_CHUNK;
+  }
+  snapshot->data = ENGINE_REALLOC(snapshot->data, snapshot->capacity);
+  assert(snapshot->data != NULL);
+}
+
+void snapshot_write_bytes(Snapshot *snapshot, uint64_t value, size_t bytes) {
+  snapshot_reserve(snapshot, bytes);
+  for (size_t i = 0; i < bytes; i++) {
+    snapshot->data[snapshot->size++] = (uint8_t) (value >> (8 * i));
+  }
+}
+
+uint64_t snapshot_read_bytes(Snapshot *snapshot, size_t bytes) {
+  if (snapshot->failed || snapshot->position + bytes > snapshot->size) {
+    snapshot->failed = true;
+    return 0;
+  }
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value |= (uint64_t) snapshot->data[snapshot->position++] << (8 * i);
+  }
+  return value;
+}
+
+void snapshot_write_u32(Snapshot *snapshot, uint32_t value) {
+  snapshot_write_bytes(snapshot, value, sizeof(uint32_t));
+}
+
+void snapshot_write_double(Snapshot *snapshot, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  snapshot_write_bytes(snapshot, bits, sizeof(bits));
+}
+
+void snapshot_write_vector(Snapshot *snapshot, Vector value) {
+  snapshot_write_double(snapshot, value.x);
+  snapshot_write_double(snapshot, value.y);
+}
+
+int body_index_compare(const void *a, const void *b) {
+  uintptr_t body1 = (uintptr_t) ((const Body_Index *) a)->body;
+  uintptr_t body2 = (uintptr_t) ((const Body_Index *) b)->body;
+  return body1 < body2 ? -1 : body1 > body2;
+}
+
+void snapshot_write_body(Snapshot *snapshot, Body *body) {
+  if (body == NULL) {
+    snapshot_write_u32(snapshot, NO_BODY);
+    return;
+  }
+  Body_Index key = {body, 0};
+  Body_Index *found = bsearch(&key, snapshot->body_indices, snapshot->num_bodies,
+    sizeof(Body_Index), body_index_compare);
+  if (found == NULL) snapshot->failed = true;
+  snapshot_write_u32(snapshot, found != NULL ? found->index : NO_BODY);
+}
+
+void snapshot_write_body_list(Snapshot *snapshot, List *bodies) {
+  snapshot_write_u32(snapshot, list_size(bodies));
+  for (size_t i = 0; i < list_size(bodies); i++) {
+    snapshot_write_body(snapshot, list_get(bodies, i));
+  }
+}
+
+void snapshot_write_response(Snapshot *snapshot, Collision_Response response) {
+  snapshot_write_u32(snapshot, response.type);
+  snapshot_write_double(snapshot, response.elasticity);
+}
+
+uint32_t snapshot_read_u32(Snapshot *snapshot) {
+  return (uint32_t) snapshot_read_bytes(snapshot, sizeof(uint32_t));
+}
+
+uint32_t snapshot_read_index(Snapshot *snapshot, uint32_t limit) {
+  uint32_t index = snapshot_read_u32(snapshot);
+  if (index >= limit) {
+    snapshot->failed = true;
+    return 0;
+  }
+  return index;
+}
+
+uint32_t snapshot_read_count(Snapshot *snapshot, size_t item_size) {
+  uint32_t count = snapshot_read_u32(snapshot);
+  if (count > (snapshot->size - snapshot->position) / item_size) {
+    snapshot->failed = true;
+    return 0;
+  }
+  return count;
+}
+
+double snapshot_read_double(Snapshot *snapshot) {
+  uint64_t bits = snapshot_read_bytes(snapshot, sizeof(bits));
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+Vector snapshot_read_vector(Snapshot *snapshot) {
+  double x = snapshot_read_double(snapshot);
+  double y = snapshot_read_double(snapshot);
+  return (Vector) {x, y};
+}
+
+Body *snapshot_read_body(Snapshot *snapshot) {
+  uint32_t index = snapshot_read_u32(snapshot);
+  if (index == NO_BODY) return NULL;
+  if (index >= snapshot->num_bodies) {
+    snapshot->failed = true;
+    return NULL;
+  }
+  return snapshot->bodies[index];
+}
+
+Body *snapshot_read_required_body(Snapshot *snapshot) {
+  Body *body = snapshot_read_body(snapshot);
+  if (body == NULL) snapshot->failed = true;
+  return body;
+}
+
+List *snapshot_read_body_list(Snapshot *snapshot) {
+  uint32_t size = snapshot_read_count(snapshot, sizeof(uint32_t));
+  List *bodies = list_init(size > 0 ? size : INITIAL_CAPACITY, NULL);
+  for (size_t i = 0; i < size; i++) {
+    list_add(bodies, snapshot_read_required_body(snapshot));
+  }
+  return bodies;
+}
+
+void snapshot_fail(Snapshot *snapshot) {
+  snapshot->failed = true;
+}
+
+Collision_Response snapshot_read_response(Snapshot *snapshot) {
+  Collision_Response response;
+  response.type = snapshot_read_index(snapshot, COLLISION_SEMIDESTRUCTIVE + 1);
+  response.elasticity = snapshot_read_double(snapshot);
+  return response;
+}
+
+void snapshot_write_scene_body(Snapshot *snapshot, Body *body) {
+  List *shape = body_peek_shape(body);
+  snapshot_write_u32(snapshot, list_size(shape));
+  for (size_t i = 0; i < list_size(shape); i++) {
+    snapshot_write_vector(snapshot, *(Vector *) list_get(shape, i));
+  }
+  snapshot_write_double(snapshot, body_get_mass(body));
+  snapshot_write_double(snapshot, body_get_inertia(body));
+  RGBColor color = body_get_color(body);
+  snapshot_write_double(snapshot, color.r);
+  snapshot_write_double(snapshot, color.g);
+  snapshot_write_double(snapshot, color.b);
+
+  Body_Kinematics kinematics = body_get_kinematics(body);
+  snapshot_write_vector(snapshot, kinematics.centroid);
+  snapshot_write_vector(snapshot, kinematics.previous_centroid);
+  snapshot_write_vector(snapshot, kinematics.velocity);
+  snapshot_write_double(snapshot, kinematics.angle);
+  snapshot_write_double(snapshot, kinematics.previous_angle);
+  snapshot_write_double(snapshot, kinematics.angular_velocity);
+
+  snapshot_write_u32(snapshot, body_get_tag(body));
+  snapshot_write_u32(snapshot, body_get_collision_mask(body));
+  uint32_t flags = (body_get_continuous(body) ? FLAG_CONTINUOUS : 0)
+    | (body_get_stop(body) ? FLAG_STOP : 0)
+    | (body_is_removed(body) ? FLAG_REMOVED : 0);
+  snapshot_write_u32(snapshot, flags);
+}
+
+// Returns NULL, with the snapshot marked as failed, if the body is invalid
+Body *snapshot_read_scene_body(Snapshot *snapshot) {
+  uint32_t num_vertices = snapshot_read_count(snapshot, sizeof(Vector));
+  if (num_vertices < 3) {
+    snapshot->failed = true;
+    return NULL;
+  }
+  List *shape = list_init(num_vertices, allocator_free);
+  for (size_t i = 0; i < num_vertices; i++) {
+    Vector *vertex = ENGINE_MALLOC(sizeof(Vector));
+    assert(vertex != NULL);
+    *vertex = snapshot_read_vector(snapshot);
+    list_add(shape, vertex);
+  }
+  double mass = snapshot_read_double(snapshot);
+  double inertia = snapshot_read_double(snapshot);
+  RGBColor color;
+  color.r = snapshot_read_double(snapshot);
+  color.g = snapshot_read_double(snapshot);
+  color.b = snapshot_read_double(snapshot);
+  if (!(mass > 0)) {
+    snapshot->failed = true;
+    list_free(shape);
+    return NULL;
+  }
+  Body *body = body_init(shape, mass, color);
+  body_set_inertia(body, inertia);
+
+  Body_Kinematics kinematics;
+  kinematics.centroid = snapshot_read_vector(snapshot);
+  kinematics.previous_centroid = snapshot_read_vector(snapshot);
+  kinematics.velocity = snapshot_read_vector(snapshot);
+  kinematics.angle = snapshot_read_double(snapshot);
+  kinematics.previous_angle = snapshot_read_double(snapshot);
+  kinematics.angular_velocity = snapshot_read_double(snapshot);
+  body_set_kinematics(body, kinematics);
+
+  uint32_t tag = snapshot_read_u32(snapshot);
+  body_set_tag(body, tag < NUM_TAGS ? tag : 0);
+  if (tag >= NUM_TAGS) snapshot->failed = true;
+  body_set_collision_mask(body, snapshot_read_u32(snapshot));
+  uint32_t flags = snapshot_read_u32(snapshot);
+  body_set_continuous(body, flags & FLAG_CONTINUOUS);
+  body_set_stop(body, flags & FLAG_STOP);
+  if (flags & FLAG_REMOVED) body_remove(body);
+  return body;
+}
+
+// Indexes the scene's bodies by address, for snapshot_write_body()
+void snapshot_index_bodies(Snapshot *snapshot, Scene *scene) {
+  size_t num_bodies = scene_bodies(scene);
+  snapshot->num_bodies = num_bodies;
+  snapshot->body_indices = ENGINE_MALLOC(sizeof(Body_Index) * (num_bodies > 0 ? num_bodies : 1));
+  assert(snapshot->body_indices != NULL);
+  for (size_t i = 0; i < num_bodies; i++) {
+    snapshot->body_indices[i] = (Body_Index) {scene_get_body(scene, i), i};
+  }
+  qsort(snapshot->body_indices, num_bodies, sizeof(Body_Index), body_index_compare);
+}
+
+// Writes the scene's force creators, then its collision table
+void snapshot_write_forces(Snapshot *snapshot, Scene *scene) {
+  size_t num_forces = scene_force_creators(scene);
+  snapshot_write_u32(snapshot, num_forces);
+  for (size_t i = 0; i < num_forces && !snapshot->failed; i++) {
+    void *aux;
+    Force_Type *type = registry_find_creator(snapshot->registry,
+      scene_get_force_creator(scene, i, &aux));
+    if (type == NULL) {
+      snapshot->failed = true;
+      return;
+    }
+    snapshot_write_u32(snapshot, type->id);
+    if (type->save != NULL) type->save(aux, snapshot);
+  }
+
+  size_t num_entries = scene_collision_entries(scene);
+  snapshot_write_u32(snapshot, num_entries);
+  for (size_t i = 0; i < num_entries; i++) {
+    uint32_t mask1, mask2;
+    Collision_Response response;
+    bool is_response = scene_get_collision_entry(scene, i, &mask1, &mask2, &response);
+    snapshot_write_u32(snapshot, mask1);
+    snapshot_write_u32(snapshot, mask2);
+    snapshot_write_u32(snapshot, is_response ? RESPONSE_ENTRY : EVENT_FILTER);
+    if (is_response) snapshot_write_response(snapshot, response);
+  }
+}
+
+// Reads what snapshot_write_forces() wrote into the scene
+void snapshot_read_forces(Snapshot *snapshot, Scene *scene) {
+  Force_Registry *registry = snapshot->registry;
+  uint32_t num_forces = snapshot_read_u32(snapshot);
+  for (size_t i = 0; i < num_forces && !snapshot->failed; i++) {
+    Force_Type *type = registry_find_id(registry, snapshot_read_u32(snapshot));
+    if (type == NULL || type->creator == NULL) {
+      snapshot->failed = true;
+      return;
+    }
+    List *bodies = NULL;
+    void *aux = type->load != NULL ? type->load(snapshot, scene, &bodies) : NULL;
+    if (bodies == NULL) bodies = list_init(INITIAL_CAPACITY, NULL);
+    // What a corrupt snapshot loads may refer to bodies that don't exist
+    if (snapshot->failed) {
+      if (aux != NULL && type->freer != NULL) type->freer(aux);
+      list_free(bodies);
+      return;
+    }
+    if (type->group) {
+      scene_add_group_force_creator(scene, type->creator, aux, bodies, type->freer);
+    } else {
+      scene_add_bodies_force_creator(scene, type->creator, aux, bodies, type->freer);
+    }
+  }
+
+  uint32_t num_entries = snapshot_read_u32(snapshot);
+  for (size_t i = 0; i < num_entries && !snapshot->failed; i++) {
+    uint32_t mask1 = snapshot_read_u32(snapshot);
+    uint32_t mask2 = snapshot_read_u32(snapshot);
+    uint32_t kind = snapshot_read_index(snapshot, RESPONSE_ENTRY + 1);
+    if (kind == EVENT_FILTER) {
+      if (!snapshot->failed) scene_add_collision_events(scene, mask1, mask2);
+      continue;
+    }
+    Collision_Response response = snapshot_read_response(snapshot);
+    if (snapshot->failed) return;
+    scene_add_collision_response(scene, mask1, mask2, response);
+  }
+}
+
+bool scene_save(Scene *scene, FILE *file, Force_Registry *registry) {
+  Snapshot snapshot = {.registry = registry, .failed = false};
+  snapshot_index_bodies(&snapshot, scene);
+
+  snapshot_write_u32(&snapshot, SNAPSHOT_MAGIC);
+  snapshot_write_u32(&snapshot, SNAPSHOT_VERSION);
+  snapshot_write_u32(&snapshot, scene_get_integrator(scene));
+  Adaptive_Config config = scene_get_adaptive_config(scene);
+  snapshot_write_double(&snapshot, config.min_dt);
+  snapshot_write_double(&snapshot, config.max_dt);
+  snapshot_write_double(&snapshot, config.tolerance);
+
+  snapshot_write_u32(&snapshot, snapshot.num_bodies);
+  for (size_t i = 0; i < snapshot.num_bodies; i++) {
+    snapshot_write_scene_body(&snapshot, scene_get_body(scene, i));
+  }
+  snapshot_write_forces(&snapshot, scene);
+
+  bool saved = !snapshot.failed
+    && fwrite(snapshot.data, 1, snapshot.size, file) == snapshot.size;
+  allocator_free(snapshot.data);
+  allocator_free(snapshot.body_indices);
+  return saved;
+}
+
+Scene *scene_load(FILE *file, Force_Registry *registry) {
+  // Read the whole file, so parsing never waits on it
+  Snapshot snapshot = {.registry = registry, .failed = false};
+  size_t read;
+  do {
+    snapshot_reserve(&snapshot, READ_CHUNK);
+    read = fread(snapshot.data + snapshot.size, 1, READ_CHUNK, file);
+    snapshot.size += read;
+  } while (read == READ_CHUNK);
+
+  if (snapshot_read_u32(&snapshot) != SNAPSHOT_MAGIC
+    || snapshot_read_u32(&snapshot) != SNAPSHOT_VERSION) {
+      allocator_free(snapshot.data);
+      return NULL;
+  }
+  Scene *scene = scene_init();
+  uint32_t integrator = snapshot_read_u32(&snapshot);
+  if (integrator > INTEGRATOR_ADAPTIVE_RK45) snapshot.failed = true;
+  else scene_set_integrator(scene, integrator);
+  Adaptive_Config config;
+  config.min_dt = snapshot_read_double(&snapshot);
+  config.max_dt = snapshot_read_double(&snapshot);
+  config.tolerance = snapshot_read_double(&snapshot);
+  if (config.min_dt > 0 && config.min_dt <= config.max_dt && config.tolerance > 0) {
+    scene_set_adaptive_config(scene, config);
+  } else {
+    snapshot.failed = true;
+  }
+
+  uint32_t num_bodies = snapshot_read_count(&snapshot, sizeof(Vector) * 3);
+  snapshot.bodies = ENGINE_MALLOC(sizeof(Body *) * (num_bodies > 0 ? num_bodies : 1));
+  assert(snapshot.bodies != NULL);
+  for (size_t i = 0; i < num_bodies && !snapshot.failed; i++) {
+    Body *body = snapshot_read_scene_body(&snapshot);
+    if (body == NULL) break;
+    scene_add_body(scene, body);
+    snapshot.bodies[snapshot.num_bodies++] = body;
+  }
+  snapshot_read_forces(&snapshot, scene);
+
+  if (snapshot.position != snapshot.size) snapshot.failed = true;
+  allocator_free(snapshot.data);
+  allocator_free(snapshot.bodies);
+  if (snapshot.failed) {
+    scene_free(scene);
+    return NULL;
+  }
+  return scene;
+}
+
+void *scene_save_forces(Scene *scene, Force_Registry *registry, size_t *size) {
+  Snapshot snapshot = {.registry = registry, .failed = false};
+  snapshot_index_bodies(&snapshot, scene);
+  snapshot_write_forces(&snapshot, scene);
+  allocator_free(snapshot.body_indices);
+  if (snapshot.failed) {
+    allocator_free(snapshot.data);
+    return NULL;
+  }
+  *size = snapshot.size;
+  return snapshot.data;
+}
+
+bool scene_load_forces(Scene *scene, const void *data, size_t size,
+  Force_Registry *registry) {
+    // Reading never writes to the data
+    Snapshot snapshot = {.registry = registry, .failed = false,
+      .data = (uint8_t *) data, .size = size};
+    snapshot.num_bodies = scene_bodies(scene);
+    snapshot.bodies = ENGINE_MALLOC(sizeof(Body *) * (snapshot.num_bodies > 0 ? snapshot.num_bodies : 1));
+    assert(snapshot.bodies != NULL);
+    for (size_t i = 0; i < snapshot.num_bodies; i++) {
+      snapshot.bodies[i] = scene_get_body(scene, i);
+    }
+    snapshot_read_forces(&snapshot, scene);
+    allocator_free(snapshot.bodies);
+    return !snapshot.failed && snapshot.position == snapshot.size;
+}
@@ -0,0 +1,364 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "spring_network.h"
+#include "allocator.h"
+#include "forces.h"
+
+// Conjugate gradients stops once the residual shrinks by this much
+#define CG_TOLERANCE 1e-10
+#define CG_MAX_ITERATIONS 200
+
+typedef struct {
+  Scene *scene;
+  List *bodies;
+  bool implicit;
+  size_t num_bodies;
+  size_t num_springs;
+
+  // Springs in compressed sparse row form: the springs whose lower-numbered
+  // body is i are row_start[i] to row_start[i + 1], and other[s] is the
+  // higher-numbered body of spring s
+  size_t *row_start;
+  size_t *other;
+  double *rest_length;
+  double *stiffness;
+  double *damping;
+
+  // The bodies' state at the start of each evaluation, and their forces
+  double *x, *y, *vx, *vy, *mass;
+  double *fx, *fy;
+
+  // Implicit mode: each spring's 2x2 stiffness Jacobian and system block,
+  // and the conjugate gradient vectors over the bodies
+  double *kxx, *kxy, *kyy;
+  double *sxx, *sxy, *syy;
+  double *dvx, *dvy, *rx, *ry, *px, *py, *apx, *apy;
+} Spring_Network;
+
+double *network_array(size_t n) {
+  double *array = ENGINE_CALLOC(n > 0 ? n : 1, sizeof(double));
+  assert(array != NULL);
+  return array;
+}
+
+Spring_Network *spring_network_init(Scene *scene, List *bodies,
+  const Spring *springs, size_t num_springs, bool implicit) {
+    Spring_Network *network = ENGINE_MALLOC(sizeof(Spring_Network));
+    assert(network != NULL);
+    size_t n = list_size(bodies);
+    network->scene = scene;
+    network->bodies = bodies;
+    network->implicit = implicit;
+    network->num_bodies = n;
+    network->num_springs = num_springs;
+
+    // Count each body's springs, then place them with a prefix sum
+    network->row_start = ENGINE_CALLOC(n + 1, sizeof(size_t));
+    network->other = ENGINE_MALLOC(sizeof(size_t) * (num_springs > 0 ? num_springs : 1));
+    assert(network->row_start != NULL && network->other != NULL);
+    network->rest_length = network_array(num_springs);
+    network->stiffness = network_array(num_springs);
+    network->damping = network_array(num_springs);
+    for (size_t s = 0; s < num_springs; s++) {
+      assert(springs[s].body1 < n && springs[s].body2 < n);
+      assert(springs[s].body1 != springs[s].body2);
+      size_t low = springs[s].body1 < springs[s].body2 ? springs[s].body1 : springs[s].body2;
+      network->row_start[low + 1]++;
+    }
+    for (size_t i = 0; i < n; i++) {
+      network->row_start[i + 1] += network->row_start[i];
+    }
+    size_t *next = ENGINE_MALLOC(sizeof(size_t) * (n > 0 ? n : 1));
+    assert(next != NULL);
+    for (size_t i = 0; i < n; i++) next[i] = network->row_start[i];
+    for (size_t s = 0; s < num_springs; s++) {
+      Spring spring = springs[s];
+      size_t low = spring.body1 < spring.body2 ? spring.body1 : spring.body2;
+      size_t high = spring.body1 < spring.body2 ? spring.body2 : spring.body1;
+      size_t slot = next[low]++;
+      network->other[slot] = high;
+      network->rest_length[slot] = spring.rest_length;
+      network->stiffness[slot] = spring.stiffness;
+      network->damping[slot] = spring.damping;
+    }
+    allocator_free(next);
+
+    network->x = network_array(n);
+    network->y = network_array(n);
+    network->vx = network_array(n);
+    network->vy = network_array(n);
+    network->mass = network_array(n);
+    network->fx = network_array(n);
+    network->fy = network_array(n);
+    size_t spring_scratch = implicit ? num_springs : 0;
+    size_t body_scratch = implicit ? n : 0;
+    network->kxx = network_array(spring_scratch);
+    network->kxy = network_array(spring_scratch);
+    network->kyy = network_array(spring_scratch);
+    network->sxx = network_array(spring_scratch);
+    network->sxy = network_array(spring_scratch);
+    network->syy = network_array(spring_scratch);
+    network->dvx = network_array(body_scratch);
+    network->dvy = network_array(body_scratch);
+    network->rx = network_array(body_scratch);
+    network->ry = network_array(body_scratch);
+    network->px = network_array(body_scratch);
+    network->py = network_array(body_scratch);
+    network->apx = network_array(body_scratch);
+    network->apy = network_array(body_scratch);
+    return network;
+}
+
+// Frees everything but the body list, which belongs to the scene
+void spring_network_free(Spring_Network *network) {
+  double *arrays[] = {
+    network->rest_length, network->stiffness, network->damping,
+    network->x, network->y, network->vx, network->vy, network->mass,
+    network->fx, network->fy,
+    network->kxx, network->kxy, network->kyy,
+    network->sxx, network->sxy, network->syy,
+    network->dvx, network->dvy, network->rx, network->ry,
+    network->px, network->py, network->apx, network->apy
+  };
+  for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+    allocator_free(arrays[i]);
+  }
+  allocator_free(network->row_start);
+  allocator_free(network->other);
+  allocator_free(network);
+}
+
+void spring_network_gather(Spring_Network *network) {
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    Body *body = list_get(network->bodies, i);
+    Vector centroid = body_get_centroid(body);
+    Vector velocity = body_get_velocity(body);
+    network->x[i] = centroid.x;
+    network->y[i] = centroid.y;
+    network->vx[i] = velocity.x;
+    network->vy[i] = velocity.y;
+    network->mass[i] = body_get_mass(body);
+    network->fx[i] = 0;
+    network->fy[i] = 0;
+  }
+}
+
+// Sums the spring forces on every body into fx and fy. In implicit mode,
+// also records each spring's Jacobians for the solve.
+void spring_network_forces(Spring_Network *network, double dt) {
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    double fx = 0, fy = 0;
+    for (size_t s = network->row_start[i]; s < network->row_start[i + 1]; s++) {
+      size_t j = network->other[s];
+      double dx = network->x[j] - network->x[i];
+      double dy = network->y[j] - network->y[i];
+      double length = sqrt(dx * dx + dy * dy);
+      // Coincident bodies have no direction to push along
+      double inv_length = length > 0 ? 1 / length : 0;
+      double ux = dx * inv_length, uy = dy * inv_length;
+      double closing = (network->vx[j] - network->vx[i]) * ux
+        + (network->vy[j] - network->vy[i]) * uy;
+      double magnitude = network->stiffness[s] * (length - network->rest_length[s])
+        + network->damping[s] * closing;
+      fx += magnitude * ux;
+      fy += magnitude * uy;
+      network->fx[j] -= magnitude * ux;
+      network->fy[j] -= magnitude * uy;
+
+      if (network->implicit) {
+        // d(force on i) / d(position of j) = k (u u^T + (1 - L / r) (I - u u^T)),
+        // dropping the transverse term under compression so the system
+        // stays positive definite
+        double k = network->stiffness[s];
+        double transverse = length > 0
+          ? fmax(0, 1 - network->rest_length[s] * inv_length)
+          : 0;
+        network->kxx[s] = k * (ux * ux + transverse * (1 - ux * ux));
+        network->kxy[s] = k * (ux * uy - transverse * ux * uy);
+        network->kyy[s] = k * (uy * uy + transverse * (1 - uy * uy));
+        double c = network->damping[s];
+        network->sxx[s] = dt * c * ux * ux + dt * dt * network->kxx[s];
+        network->sxy[s] = dt * c * ux * uy + dt * dt * network->kxy[s];
+        network->syy[s] = dt * c * uy * uy + dt * dt * network->kyy[s];
+      }
+    }
+    network->fx[i] += fx;
+    network->fy[i] += fy;
+  }
+}
+
+bool network_body_free(Spring_Network *network, size_t i) {
+  return network->mass[i] != INFINITY;
+}
+
+// ap = A p, where A = M + sum over springs of S (p_i - p_j) terms
+void spring_network_multiply(Spring_Network *network) {
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    bool free_body = network_body_free(network, i);
+    network->apx[i] = free_body ? network->mass[i] * network->px[i] : 0;
+    network->apy[i] = free_body ? network->mass[i] * network->py[i] : 0;
+  }
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    for (size_t s = network->row_start[i]; s < network->row_start[i + 1]; s++) {
+      size_t j = network->other[s];
+      double dx = network->px[i] - network->px[j];
+      double dy = network->py[i] - network->py[j];
+      double sx = network->sxx[s] * dx + network->sxy[s] * dy;
+      double sy = network->sxy[s] * dx + network->syy[s] * dy;
+      network->apx[i] += sx;
+      network->apy[i] += sy;
+      network->apx[j] -= sx;
+      network->apy[j] -= sy;
+    }
+  }
+  // Bodies with infinite mass don't take part
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    if (!network_body_free(network, i)) {
+      network->apx[i] = 0;
+      network->apy[i] = 0;
+    }
+  }
+}
+
+double network_dot(Spring_Network *network, double *ax, double *ay,
+  double *bx, double *by) {
+    double sum = 0;
+    for (size_t i = 0; i < network->num_bodies; i++) {
+      sum += ax[i] * bx[i] + ay[i] * by[i];
+    }
+    return sum;
+}
+
+// Solves (M - dt D - dt^2 K) dv = dt (f + dt K v) for the backward Euler
+// velocity change, then replaces fx and fy with the forces that produce it.
+void spring_network_solve(Spring_Network *network, double dt) {
+  size_t n = network->num_bodies;
+  for (size_t i = 0; i < n; i++) {
+    network->rx[i] = dt * network->fx[i];
+    network->ry[i] = dt * network->fy[i];
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t s = network->row_start[i]; s < network->row_start[i + 1]; s++) {
+      size_t j = network->other[s];
+      double dvx = network->vx[j] - network->vx[i];
+      double dvy = network->vy[j] - network->vy[i];
+      double kx = dt * dt * (network->kxx[s] * dvx + network->kxy[s] * dvy);
+      double ky = dt * dt * (network->kxy[s] * dvx + network->kyy[s] * dvy);
+      network->rx[i] += kx;
+      network->ry[i] += ky;
+      network->rx[j] -= kx;
+      network->ry[j] -= ky;
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (!network_body_free(network, i)) {
+      network->rx[i] = 0;
+      network->ry[i] = 0;
+    }
+    network->dvx[i] = 0;
+    network->dvy[i] = 0;
+    network->px[i] = network->rx[i];
+    network->py[i] = network->ry[i];
+  }
+
+  double residual = network_dot(network, network->rx, network->ry,
+    network->rx, network->ry);
+  double target = residual * CG_TOLERANCE * CG_TOLERANCE;
+  for (size_t iteration = 0; iteration < CG_MAX_ITERATIONS && residual > target;
+    iteration++) {
+      spring_network_multiply(network);
+      double alpha = residual / network_dot(network, network->px, network->py,
+        network->apx, network->apy);
+      for (size_t i = 0; i < n; i++) {
+        network->dvx[i] += alpha * network->px[i];
+        network->dvy[i] += alpha * network->py[i];
+        network->rx[i] -= alpha * network->apx[i];
+        network->ry[i] -= alpha * network->apy[i];
+      }
+      double next = network_dot(network, network->rx, network->ry,
+        network->rx, network->ry);
+      double beta = next / residual;
+      for (size_t i = 0; i < n; i++) {
+        network->px[i] = network->rx[i] + beta * network->px[i];
+        network->py[i] = network->ry[i] + beta * network->py[i];
+      }
+      residual = next;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (network_body_free(network, i)) {
+      network->fx[i] = network->mass[i] * network->dvx[i] / dt;
+      network->fy[i] = network->mass[i] * network->dvy[i] / dt;
+    }
+  }
+}
+
+void spring_network_force(Spring_Network *network) {
+  double dt = scene_get_tick_dt(network->scene);
+  bool implicit = network->implicit && dt > 0;
+  spring_network_gather(network);
+  spring_network_forces(network, dt);
+  if (implicit) spring_network_solve(network, dt);
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    body_add_force(list_get(network->bodies, i),
+      (Vector) {network->fx[i], network->fy[i]});
+  }
+}
+
+void create_spring_network(Scene *scene, List *bodies, const Spring *springs,
+  size_t num_springs, bool implicit) {
+    Spring_Network *network = spring_network_init(scene, bodies, springs,
+      num_springs, implicit);
+    scene_add_bodies_force_creator(scene, (ForceCreator) spring_network_force,
+      network, bodies, (FreeFunc) spring_network_free);
+}
+
+void spring_network_save(Spring_Network *network, Snapshot *snapshot) {
+  snapshot_write_body_list(snapshot, network->bodies);
+  snapshot_write_u32(snapshot, network->implicit);
+  snapshot_write_u32(snapshot, network->num_springs);
+  for (size_t i = 0; i < network->num_bodies; i++) {
+    for (size_t s = network->row_start[i]; s < network->row_start[i + 1]; s++) {
+      snapshot_write_u32(snapshot, i);
+      snapshot_write_u32(snapshot, network->other[s]);
+      snapshot_write_double(snapshot, network->rest_length[s]);
+      snapshot_write_double(snapshot, network->stiffness[s]);
+      snapshot_write_double(snapshot, network->damping[s]);
+    }
+  }
+}
+
+Spring_Network *spring_network_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+  *bodies = snapshot_read_body_list(snapshot);
+  bool implicit = snapshot_read_u32(snapshot);
+  // Each spring takes two indices and three doubles
+  size_t num_springs = snapshot_read_count(snapshot, 2 * sizeof(uint32_t) + 3 * sizeof(double));
+  size_t n = list_size(*bodies);
+  Spring *springs = ENGINE_MALLOC(sizeof(Spring) * (num_springs > 0 ? num_springs : 1));
+  assert(springs != NULL);
+  size_t valid = 0;
+  for (size_t s = 0; s < num_springs; s++) {
+    Spring spring;
+    spring.body1 = snapshot_read_index(snapshot, n);
+    spring.body2 = snapshot_read_index(snapshot, n);
+    spring.rest_length = snapshot_read_double(snapshot);
+    spring.stiffness = snapshot_read_double(snapshot);
+    spring.damping = snapshot_read_double(snapshot);
+    // A corrupt spring is dropped; snapshot_read_index() fails the snapshot
+    if (spring.body1 != spring.body2) {
+      springs[valid++] = spring;
+    }
+  }
+  Spring_Network *network = spring_network_init(scene, *bodies, springs, valid, implicit);
+  allocator_free(springs);
+  return network;
+}
+
+void spring_network_register_type(Force_Registry *registry) {
+  force_registry_add(registry, (Force_Type) {
+    FORCE_TYPE_SPRING_NETWORK, (ForceCreator) spring_network_force,
+    (Force_Saver) spring_network_save, (Force_Loader) spring_network_load,
+    (FreeFunc) spring_network_free
+  });
+}
@@ -0,0 +1,60 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include "stepper.h"
+#include "allocator.h"
+
+struct stepper {
+  double dt;
+  size_t max_substeps;
+  double accumulator;
+  size_t ticks;
+};
+
+Stepper *stepper_init(double dt, size_t max_substeps) {
+  assert(dt > 0);
+  assert(max_substeps > 0);
+  Stepper *stepper = (Stepper *) ENGINE_MALLOC(sizeof(Stepper));
+  assert(stepper != NULL);
+  stepper->dt = dt;
+  stepper->max_substeps = max_substeps;
+  stepper->accumulator = 0;
+  stepper->ticks = 0;
+  return stepper;
+}
+
+void stepper_free(Stepper *stepper) {
+  allocator_free(stepper);
+}
+
+size_t stepper_advance(Stepper *stepper, Scene *scene, double frame_time) {
+  if (frame_time > 0) stepper->accumulator += frame_time;
+
+  size_t substeps = 0;
+  while (stepper->accumulator >= stepper->dt && substeps < stepper->max_substeps) {
+    scene_tick(scene, stepper->dt);
+    stepper->accumulator -= stepper->dt;
+    substeps++;
+  }
+
+  // Drop whole timesteps we didn't have the budget for, keeping the fraction
+  // so the interpolation factor stays continuous.
+  if (stepper->accumulator >= stepper->dt) {
+    stepper->accumulator = fmod(stepper->accumulator, stepper->dt);
+  }
+
+  stepper->ticks += substeps;
+  return substeps;
+}
+
+double stepper_alpha(Stepper *stepper) {
+  return stepper->accumulator / stepper->dt;
+}
+
+double stepper_dt(Stepper *stepper) {
+  return stepper->dt;
+}
+
+size_t stepper_ticks(Stepper *stepper) {
+  return stepper->ticks;
+}
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include "../include/vector.h"
+#include "../include/allocator.h"
 
 const Vector VEC_ZERO = {
   .x = 0.0,
@@ -9,7 +10,7 @@ const Vector VEC_ZERO = {
 };
 
 Vector *vec_init(Vector v) {
-  Vector *new_v = malloc(sizeof(Vector));
+  Vector *new_v = ENGINE_MALLOC(sizeof(Vector));
   *new_v = v;
   return new_v;
 }
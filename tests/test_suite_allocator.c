@@ -0,0 +1,146 @@
+#include "allocator.h"
+#include "forces.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_default_allocator() {
+    assert(allocator_get().allocate == ALLOCATOR_DEFAULT.allocate);
+    int *numbers = ENGINE_CALLOC(4, sizeof(int));
+    for (size_t i = 0; i < 4; i++) assert(numbers[i] == 0);
+    numbers = ENGINE_REALLOC(numbers, sizeof(int) * 100);
+    numbers[99] = 1;
+    allocator_free(numbers);
+    allocator_free(NULL);
+    // The default allocator's blocks are malloc()'s
+    free(ENGINE_MALLOC(1));
+}
+
+void test_tracker_sites() {
+    Tracker *tracker = tracker_init();
+    allocator_set(tracker_allocator(tracker));
+    char *block = ENGINE_MALLOC(10);
+    assert(tracker_num_sites(tracker) == 1);
+    Alloc_Site site = tracker_get_site(tracker, 0);
+    assert(strstr(site.site, "test_suite_allocator.c:") != NULL);
+    assert(site.calls == 1 && site.bytes == 10);
+    assert(site.live_blocks == 1 && site.live_bytes == 10);
+
+    block = ENGINE_REALLOC(block, 30);
+    assert(tracker_num_sites(tracker) == 2);
+    // The block now belongs to the site that resized it
+    site = tracker_get_site(tracker, 0);
+    assert(site.calls == 1 && site.live_blocks == 0 && site.live_bytes == 0);
+    site = tracker_get_site(tracker, 1);
+    assert(site.calls == 1 && site.bytes == 30 && site.live_bytes == 30);
+    assert(tracker_live_bytes(tracker, "test_suite_allocator") == 30);
+    assert(tracker_live_bytes(tracker, "list") == 0);
+    assert(tracker_live_bytes(tracker, NULL) == 30);
+
+    allocator_free(block);
+    assert(tracker_live_blocks(tracker, NULL) == 0);
+    // Blocks the tracker didn't allocate are released all the same
+    allocator_free(malloc(1));
+    assert(tracker_get_site(tracker, 1).calls == 1);
+    allocator_set(ALLOCATOR_DEFAULT);
+    tracker_free(tracker);
+}
+
+void test_tracker_many_blocks() {
+    Tracker *tracker = tracker_init();
+    allocator_set(tracker_allocator(tracker));
+    size_t n = 10000;
+    void **blocks = malloc(sizeof(void *) * n);
+    for (size_t i = 0; i < n; i++) blocks[i] = ENGINE_MALLOC(i % 7 + 1);
+    for (size_t i = 0; i < n; i += 2) allocator_free(blocks[i]);
+    assert(tracker_live_blocks(tracker, NULL) == n / 2);
+    size_t live_bytes = 0;
+    for (size_t i = 1; i < n; i += 2) live_bytes += i % 7 + 1;
+    assert(tracker_live_bytes(tracker, NULL) == live_bytes);
+    for (size_t i = 1; i < n; i += 2) allocator_free(blocks[i]);
+    assert(tracker_live_blocks(tracker, NULL) == 0);
+    assert(tracker_live_bytes(tracker, NULL) == 0);
+    free(blocks);
+    allocator_set(ALLOCATOR_DEFAULT);
+    tracker_free(tracker);
+}
+
+Scene *make_scene(Tracker *tracker) {
+    allocator_set(tracker_allocator(tracker));
+    Scene *scene = scene_init();
+    Body *body1 = body_init(polygon_rectangle(VEC_ZERO, 1, 1), 1,
+        (RGBColor) {0, 0, 0});
+    Body *body2 = body_init(polygon_circle((Vector) {1, 0}, 1, 10), 1,
+        (RGBColor) {0, 0, 0});
+    scene_add_body(scene, body1);
+    scene_add_body(scene, body2);
+    create_drag(scene, 1, body1);
+    create_physics_collision(scene, 1, body1, body2);
+    for (size_t i = 0; i < 10; i++) scene_tick(scene, 0.01);
+    return scene;
+}
+
+// Freeing a scene frees everything the scene allocated
+void test_scene_no_leaks() {
+    char report[1024] = "";
+    FILE *out = fmemopen(report, sizeof(report), "w");
+    Tracker *tracker = tracker_init();
+    Scene *scene = make_scene(tracker);
+    assert(tracker_live_bytes(tracker, "scene") > 0);
+    assert(tracker_live_blocks(tracker, "body") == 2);
+    scene_free(scene);
+    assert(tracker_report_leaks(tracker, out) == 0);
+    fclose(out);
+    assert(tracker_live_blocks(tracker, NULL) == 0);
+    assert(strlen(report) == 0);
+    allocator_set(ALLOCATOR_DEFAULT);
+    tracker_free(tracker);
+}
+
+void test_scene_leaks() {
+    char report[1024] = "";
+    FILE *out = fmemopen(report, sizeof(report), "w");
+    Tracker *tracker = tracker_init();
+    Scene *scene = make_scene(tracker);
+    List *shape = body_get_shape(scene_get_body(scene, 0));
+    scene_free(scene);
+    assert(tracker_report_leaks(tracker, out) == 6);
+    fclose(out);
+    // The shape's list, its array and its 4 vertices
+    assert(tracker_live_blocks(tracker, "list") == 2);
+    assert(tracker_live_blocks(tracker, "vector") == 4);
+    assert(tracker_live_blocks(tracker, NULL) == 6);
+    assert(strstr(report, "leak: 64 bytes in 4 blocks allocated at library/vector.c:") != NULL);
+    list_free(shape);
+    assert(tracker_live_blocks(tracker, NULL) == 0);
+
+    char table[8192] = "";
+    out = fmemopen(table, sizeof(table), "w");
+    tracker_report(tracker, out);
+    fclose(out);
+    assert(strstr(table, "library/list.c:") != NULL);
+    assert(strstr(table, "\nscene ") != NULL);
+    allocator_set(ALLOCATOR_DEFAULT);
+    tracker_free(tracker);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_default_allocator)
+    DO_TEST(test_tracker_sites)
+    DO_TEST(test_tracker_many_blocks)
+    DO_TEST(test_scene_no_leaks)
+    DO_TEST(test_scene_leaks)
+
+    puts("allocator_test PASS");
+    return 0;
+}
@@ -1,4 +1,59 @@
-int main(int argc, char const *argv[]) {
-  /* code */
-  return 0;
+#include "body.h"
+#include "allocator.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// Moving a body keeps its triangles; a new shape gets new ones
+void test_triangles() {
+    Vector l[] = {{2, 2}, {0, 2}, {0, 0}, {4, 0}, {4, 1}, {2, 1}};
+    List *shape = list_init(6, allocator_free);
+    for (size_t i = 0; i < 6; i++) list_add(shape, vec_init(l[i]));
+    Body *body = body_init(shape, 1, (RGBColor) {0, 0, 0});
+    size_t count;
+    const size_t *triangles = body_get_triangles(body, &count);
+    assert(count == 4);
+    size_t expected[12], scratch[6];
+    assert(polygon_triangulate(shape, expected, scratch) == 4);
+    for (size_t i = 0; i < 12; i++) assert(triangles[i] == expected[i]);
+
+    body_set_velocity(body, (Vector) {3, -1});
+    body_set_rotation(body, M_PI / 3);
+    body_tick(body, 1);
+    assert(body_get_triangles(body, &count) == triangles);
+    assert(count == 4);
+
+    List *square = polygon_rectangle(VEC_ZERO, 1, 1);
+    body_set_shape(body, square);
+    triangles = body_get_triangles(body, &count);
+    assert(count == 2);
+    for (size_t i = 0; i < 6; i++) assert(triangles[i] < 4);
+    list_free(shape);
+    body_free(body);
+
+    // Too few vertices to cover anything
+    List *line = list_init(2, allocator_free);
+    list_add(line, vec_init(VEC_ZERO));
+    list_add(line, vec_init((Vector) {1, 1}));
+    body = body_init(line, 1, (RGBColor) {0, 0, 0});
+    body_get_triangles(body, &count);
+    assert(count == 0);
+    body_free(body);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_triangles)
+
+    puts("body_test PASS");
+    return 0;
 }
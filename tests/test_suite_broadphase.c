@@ -0,0 +1,172 @@
+#include "broadphase.h"
+#include "body.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+AABB square(double x, double y, double size) {
+    return (AABB) {{x, y}, {x + size, y + size}};
+}
+
+// Whether the last broadphase_find_pairs() reported the pair (first, second)
+bool has_pair(Broadphase *broadphase, size_t num_pairs, size_t first, size_t second) {
+    for (size_t i = 0; i < num_pairs; i++) {
+        Index_Pair pair = broadphase_get_pair(broadphase, i);
+        if (pair.first == first && pair.second == second) return true;
+    }
+    return false;
+}
+
+void test_overlapping_boxes() {
+    Broadphase *broadphase = broadphase_init();
+    broadphase_resize(broadphase, 4);
+    broadphase_set(broadphase, 0, square(0, 0, 2), 1, ALL_TAGS);
+    broadphase_set(broadphase, 1, square(1, 1, 2), 1, ALL_TAGS);
+    // Overlaps 0 in x but not in y
+    broadphase_set(broadphase, 2, square(0, 5, 2), 1, ALL_TAGS);
+    // Touching edges count as overlapping
+    broadphase_set(broadphase, 3, square(-2, 6, 2), 1, ALL_TAGS);
+    size_t num_pairs = broadphase_find_pairs(broadphase);
+    assert(num_pairs == 2);
+    assert(has_pair(broadphase, num_pairs, 0, 1));
+    assert(has_pair(broadphase, num_pairs, 2, 3));
+    broadphase_free(broadphase);
+}
+
+void test_masks() {
+    Broadphase *broadphase = broadphase_init();
+    broadphase_resize(broadphase, 4);
+    // All four boxes overlap
+    broadphase_set(broadphase, 0, square(0, 0, 2), 1 << 0, 1 << 1);
+    broadphase_set(broadphase, 1, square(0, 0, 2), 1 << 1, ALL_TAGS);
+    // Collides with 0, but 0 doesn't collide with it
+    broadphase_set(broadphase, 2, square(0, 0, 2), 1 << 2, ALL_TAGS);
+    // Collides with nothing
+    broadphase_set(broadphase, 3, square(0, 0, 2), 1 << 1, 0);
+    size_t num_pairs = broadphase_find_pairs(broadphase);
+    assert(num_pairs == 2);
+    assert(has_pair(broadphase, num_pairs, 0, 1));
+    assert(has_pair(broadphase, num_pairs, 1, 2));
+    broadphase_free(broadphase);
+}
+
+// Compares sweep and prune with testing every pair, as boxes move and
+// the number of boxes changes
+void test_matches_brute_force() {
+    const size_t N = 300;
+    AABB boxes[N];
+    Broadphase *broadphase = broadphase_init();
+    srand(34);
+    for (size_t round = 0; round < 20; round++) {
+        size_t n = round < 10 ? N : N / 2 + round;
+        broadphase_resize(broadphase, n);
+        for (size_t i = 0; i < n; i++) {
+            if (round == 0 || round == 10) {
+                boxes[i] = square((double) rand() / RAND_MAX * 100,
+                    (double) rand() / RAND_MAX * 100, 1 + rand() % 5);
+            } else {
+                double dx = (double) rand() / RAND_MAX - 0.5;
+                boxes[i].min.x += dx;
+                boxes[i].max.x += dx;
+            }
+            broadphase_set(broadphase, i, boxes[i], 1, ALL_TAGS);
+        }
+
+        size_t num_pairs = broadphase_find_pairs(broadphase);
+        size_t expected = 0;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = i + 1; j < n; j++) {
+                if (aabb_overlap(boxes[i], boxes[j])) {
+                    expected++;
+                    assert(has_pair(broadphase, num_pairs, i, j));
+                }
+            }
+        }
+        assert(num_pairs == expected);
+    }
+    broadphase_free(broadphase);
+}
+
+void count_visit(size_t index, void *aux) {
+    (*(size_t *) aux)++;
+}
+
+// Box queries find the same boxes as testing every box
+void test_query_box() {
+    const size_t N = 200;
+    AABB boxes[N];
+    Broadphase *broadphase = broadphase_init();
+    broadphase_resize(broadphase, N);
+    srand(36);
+    for (size_t i = 0; i < N; i++) {
+        // A few wide boxes, which start well left of the ones they overlap
+        double size = i % 20 == 1 ? 40 : 1 + rand() % 3;
+        boxes[i] = square((double) rand() / RAND_MAX * 100,
+            (double) rand() / RAND_MAX * 100, size);
+        broadphase_set(broadphase, i, boxes[i], 1 << (i % 2), ALL_TAGS);
+    }
+    broadphase_update(broadphase);
+    for (size_t q = 0; q < 50; q++) {
+        AABB query = square((double) rand() / RAND_MAX * 100,
+            (double) rand() / RAND_MAX * 100, 5);
+        size_t expected = 0;
+        for (size_t i = 0; i < N; i++) {
+            if (i % 2 == 1 && aabb_overlap(boxes[i], query)) expected++;
+        }
+        size_t found = 0;
+        broadphase_query_box(broadphase, query, 1 << 1, count_visit, &found);
+        assert(found == expected);
+    }
+    broadphase_free(broadphase);
+}
+
+// A box far wider than the rest is still found, and doesn't hide the others
+void test_query_wide_box() {
+    const size_t N = 100;
+    Broadphase *broadphase = broadphase_init();
+    broadphase_resize(broadphase, N + 1);
+    for (size_t i = 0; i < N; i++) {
+        broadphase_set(broadphase, i, square(10 * i, 0, 1), 1, ALL_TAGS);
+    }
+    broadphase_set(broadphase, N, (AABB) {{-1e6, -5}, {1e6, 0}}, 2, ALL_TAGS);
+    broadphase_update(broadphase);
+    for (size_t i = 0; i < N; i++) {
+        size_t found = 0;
+        broadphase_query_box(broadphase, square(10 * i + 0.5, 0.5, 0), 1, count_visit, &found);
+        assert(found == 1);
+        found = 0;
+        broadphase_query_box(broadphase, square(10 * i + 0.5, 0, 0), ALL_TAGS,
+            count_visit, &found);
+        assert(found == 2);
+    }
+    broadphase_free(broadphase);
+}
+
+void test_polygon_bounds() {
+    List *shape = polygon_rectangle((Vector) {1, 2}, 4, 6);
+    AABB box = polygon_bounds(shape);
+    assert(vec_equal(box.min, (Vector) {-1, -1}));
+    assert(vec_equal(box.max, (Vector) {3, 5}));
+    list_free(shape);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_overlapping_boxes)
+    DO_TEST(test_masks)
+    DO_TEST(test_matches_brute_force)
+    DO_TEST(test_query_box)
+    DO_TEST(test_query_wide_box)
+    DO_TEST(test_polygon_bounds)
+
+    puts("broadphase_test PASS");
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "forces.h"
+#include "polygon.h"
 #include "test_util.h"
 #include <assert.h>
 #include <math.h>
@@ -155,6 +156,404 @@ void test_forces_removed() {
     scene_free(scene);
 }
 
+// Barnes-Hut gravity with theta = 0 matches gravity added pair by pair
+void test_nbody_gravity() {
+    const int N = 12;
+    Scene *pairs = scene_init();
+    Scene *tree = scene_init();
+    List *bodies = list_init(N, NULL);
+    for (int i = 0; i < N; i++) {
+        Vector center = {10 * cos(i * 2.4) * (i + 1), 10 * sin(i * 2.4) * (i + 1)};
+        Body *body = body_init(make_shape(), i + 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, center);
+        scene_add_body(pairs, body);
+        for (int j = 0; j < i; j++) {
+            create_newtonian_gravity(pairs, 5, body, scene_get_body(pairs, j));
+        }
+        body = body_init(make_shape(), i + 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, center);
+        scene_add_body(tree, body);
+        list_add(bodies, body);
+    }
+    create_nbody_gravity(tree, 5, 0, bodies);
+
+    for (int step = 0; step < 10; step++) {
+        scene_tick(pairs, 0.1);
+        scene_tick(tree, 0.1);
+    }
+    for (int i = 0; i < N; i++) {
+        assert(vec_isclose(body_get_centroid(scene_get_body(pairs, i)),
+            body_get_centroid(scene_get_body(tree, i))));
+        assert(vec_isclose(body_get_velocity(scene_get_body(pairs, i)),
+            body_get_velocity(scene_get_body(tree, i))));
+    }
+    assert(!vec_equal(body_get_velocity(scene_get_body(tree, 0)), VEC_ZERO));
+    scene_free(pairs);
+    scene_free(tree);
+}
+
+// Removing a body from a gravity group only takes it out of the group,
+// and bodies added to the group later are pulled too
+void check_gravity_group(void (*create)(Scene *, double, double, List *), double param) {
+    Scene *scene = scene_init();
+    List *bodies = list_init(3, NULL);
+    for (int i = 0; i < 3; i++) {
+        Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, (Vector) {10 * i, 0});
+        scene_add_body(scene, body);
+        list_add(bodies, body);
+    }
+    create(scene, 5, param, bodies);
+    scene_tick(scene, 0.1);
+    body_remove(scene_get_body(scene, 1));
+    scene_tick(scene, 0.1);
+    assert(scene_bodies(scene) == 2);
+    assert(scene_force_creators(scene) == 1);
+    assert(list_size(bodies) == 2);
+
+    // More bodies than the group has ever held
+    for (int i = 0; i < 30; i++) {
+        Body *body = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, (Vector) {10 * i, 50});
+        scene_add_body(scene, body);
+        list_add(bodies, body);
+    }
+    scene_tick(scene, 0.1);
+    for (size_t i = 2; i < scene_bodies(scene); i++) {
+        assert(body_get_velocity(scene_get_body(scene, i)).y < 0);
+    }
+    scene_free_body(scene, 0);
+    assert(list_size(bodies) == 31);
+    scene_tick(scene, 0.1);
+    scene_free(scene);
+}
+
+void test_nbody_gravity_group() {
+    check_gravity_group(create_nbody_gravity, 0.5);
+}
+
+void test_direct_gravity_group() {
+    check_gravity_group(create_direct_gravity, 1e-4);
+}
+
+// The direct sum is exact apart from the softening
+void test_gravity_direct_sum() {
+    double x[] = {0, 3, 0};
+    double y[] = {0, 4, 0};
+    double mass[] = {2, 5, 1};
+    double field_x[3], field_y[3];
+    gravity_direct_sum(3, x, y, mass, 1e-6, field_x, field_y);
+    // 5 / 5^2 along (3, 4) / 5, plus nothing from the coincident point
+    assert(within(1e-9, field_x[0], 0.12));
+    assert(within(1e-9, field_y[0], 0.16));
+    assert(within(1e-9, field_x[1], -3.0 * 3 / 125));
+    assert(within(1e-9, field_y[1], -3.0 * 4 / 125));
+
+    // Softening keeps the field finite at the bodies' positions
+    gravity_direct_sum(3, x, y, mass, 1, field_x, field_y);
+    assert(within(1e-9, field_x[0], 5 * 3 / pow(26, 1.5)));
+    assert(within(1e-9, field_y[2], 5 * 4 / pow(26, 1.5)));
+
+    // Enough points to span several tiles agree with a plain double loop
+    const size_t N = 700;
+    double *xs = malloc(sizeof(double) * N), *ys = malloc(sizeof(double) * N);
+    double *ms = malloc(sizeof(double) * N);
+    double *fx = malloc(sizeof(double) * N), *fy = malloc(sizeof(double) * N);
+    for (size_t i = 0; i < N; i++) {
+        xs[i] = cos(i * 2.4) * i;
+        ys[i] = sin(i * 2.4) * i;
+        ms[i] = i % 5 + 1;
+    }
+    gravity_direct_sum(N, xs, ys, ms, 0.5, fx, fy);
+    for (size_t i = 0; i < N; i += 7) {
+        double expected_x = 0, expected_y = 0;
+        for (size_t j = 0; j < N; j++) {
+            double dx = xs[j] - xs[i], dy = ys[j] - ys[i];
+            double r = sqrt(dx * dx + dy * dy + 0.25);
+            expected_x += ms[j] * dx / (r * r * r);
+            expected_y += ms[j] * dy / (r * r * r);
+        }
+        assert(within(1e-9, fx[i], expected_x));
+        assert(within(1e-9, fy[i], expected_y));
+    }
+    free(xs);
+    free(ys);
+    free(ms);
+    free(fx);
+    free(fy);
+}
+
+// Direct-sum gravity matches gravity added pair by pair
+void test_direct_gravity() {
+    const int N = 40;
+    Scene *pairs = scene_init();
+    Scene *direct = scene_init();
+    List *bodies = list_init(N, NULL);
+    for (int i = 0; i < N; i++) {
+        Vector center = {10 * cos(i * 2.4) * (i + 1), 10 * sin(i * 2.4) * (i + 1)};
+        Body *body = body_init(make_shape(), i % 7 + 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, center);
+        scene_add_body(pairs, body);
+        for (int j = 0; j < i; j++) {
+            create_newtonian_gravity(pairs, 5, body, scene_get_body(pairs, j));
+        }
+        body = body_init(make_shape(), i % 7 + 1, (RGBColor) {0, 0, 0});
+        body_set_centroid(body, center);
+        scene_add_body(direct, body);
+        list_add(bodies, body);
+    }
+    create_direct_gravity(direct, 5, 1e-4, bodies);
+
+    for (int step = 0; step < 10; step++) {
+        scene_tick(pairs, 0.1);
+        scene_tick(direct, 0.1);
+    }
+    for (int i = 0; i < N; i++) {
+        assert(vec_isclose(body_get_velocity(scene_get_body(pairs, i)),
+            body_get_velocity(scene_get_body(direct, i))));
+    }
+    assert(!vec_equal(body_get_velocity(scene_get_body(direct, 0)), VEC_ZERO));
+    scene_free(pairs);
+    scene_free(direct);
+}
+
+// A field acts only on finite-mass bodies with a tag in its mask,
+// including bodies added after the field
+void test_uniform_field_tags() {
+    Scene *scene = scene_init();
+    Uniform_Field gravity = {.acceleration = {0, -10}};
+    create_uniform_field(scene, gravity, TAG_MASK(1) | TAG_MASK(3));
+    Body *untagged = body_init(make_shape(), 2, (RGBColor) {0, 0, 0});
+    Body *tagged = body_init(make_shape(), 2, (RGBColor) {0, 0, 0});
+    body_set_tag(tagged, 3);
+    Body *fixed = body_init(make_shape(), INFINITY, (RGBColor) {0, 0, 0});
+    body_set_tag(fixed, 1);
+    assert(body_get_tag(untagged) == 0);
+    assert(body_get_tag(tagged) == 3);
+    scene_add_body(scene, untagged);
+    scene_add_body(scene, tagged);
+    scene_add_body(scene, fixed);
+    scene_tick(scene, 0.5);
+    assert(vec_equal(body_get_velocity(untagged), VEC_ZERO));
+    assert(vec_isclose(body_get_velocity(tagged), (Vector) {0, -5}));
+    assert(vec_equal(body_get_velocity(fixed), VEC_ZERO));
+
+    Body *late = body_init(make_shape(), 7, (RGBColor) {0, 0, 0});
+    body_set_tag(late, 1);
+    scene_add_body(scene, late);
+    scene_tick(scene, 0.5);
+    assert(vec_isclose(body_get_velocity(late), (Vector) {0, -5}));
+    assert(vec_isclose(body_get_velocity(tagged), (Vector) {0, -10}));
+
+    // Retagging between ticks moves a body in or out of the field
+    body_set_tag(untagged, 1);
+    body_set_tag(tagged, 2);
+    scene_tick(scene, 0.5);
+    assert(vec_isclose(body_get_velocity(untagged), (Vector) {0, -5}));
+    assert(vec_isclose(body_get_velocity(tagged), (Vector) {0, -10}));
+    scene_free(scene);
+}
+
+// Drag carries bodies towards the wind, reaching the speed where
+// it balances the field's acceleration
+void test_uniform_field_drag() {
+    Scene *scene = scene_init();
+    Uniform_Field linear = {.acceleration = {0, -10}, .linear_drag = 4, .wind = {3, 0}};
+    create_uniform_field(scene, linear, TAG_MASK(0));
+    Uniform_Field quadratic = {.quadratic_drag = 0.5, .wind = {-1, 0}};
+    create_uniform_field(scene, quadratic, TAG_MASK(1));
+    Body *light = body_init(make_shape(), 2, (RGBColor) {0, 0, 0});
+    Body *fast = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_tag(fast, 1);
+    body_set_velocity(fast, (Vector) {9, 0});
+    scene_add_body(scene, light);
+    scene_add_body(scene, fast);
+    for (int i = 0; i < 10000; i++) {
+        scene_tick(scene, 1e-3);
+    }
+    // m g = b v, so v = 2 * 10 / 4 below the wind
+    assert(vec_isclose(body_get_velocity(light), (Vector) {3, -5}));
+    // dv/dt = -c v^2 relative to the air: 1 / v = 1 / 10 + c t
+    assert(within(1e-3, body_get_velocity(fast).x, -1 + 1 / (0.1 + 0.5 * 10)));
+    scene_free(scene);
+}
+
+// The same collisions as test_collisions(), registered once for every body
+void test_group_destructive_collision() {
+    const double DT = 0.1;
+    const double V = 1.23;
+    const double SEPARATION_AT_COLLISION = 1.5;
+    const int TICKS_TO_COLLISION = 10;
+
+    Scene *scene = scene_init();
+    create_group_destructive_collision(scene, TAG_MASK(0), TAG_MASK(0));
+    Vector initial_separation =
+        {SEPARATION_AT_COLLISION + V * DT * (TICKS_TO_COLLISION - 0.5), 0};
+    for (int i = -1; i <= 1; i++) {
+        Body *body = make_triangle_body();
+        body_set_centroid(body, vec_multiply(i, initial_separation));
+        body_set_velocity(body, (Vector) {-i * V, 0});
+        scene_add_body(scene, body);
+    }
+    for (int i = 0; i < TICKS_TO_COLLISION * 2; i++) {
+        scene_tick(scene, DT);
+        assert(scene_bodies(scene) == (i < TICKS_TO_COLLISION ? 3 : 0));
+    }
+    scene_free(scene);
+}
+
+// Responses reach only the tags they were registered for, in that order,
+// and bodies can opt out with their collision mask
+void test_group_collision_filtering() {
+    Scene *scene = scene_init();
+    create_group_collision(scene, TAG_MASK(2), TAG_MASK(1),
+        (Collision_Response) {COLLISION_STOP});
+    Body *first = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_tag(first, 1);
+    Body *second = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_tag(second, 2);
+    body_set_centroid(second, (Vector) {1, 0});
+    // Overlaps both, but has no response
+    Body *untagged = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    // Too far to touch
+    Body *far = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+    body_set_tag(far, 2);
+    body_set_centroid(far, (Vector) {10, 0});
+    scene_add_body(scene, first);
+    scene_add_body(scene, second);
+    scene_add_body(scene, untagged);
+    scene_add_body(scene, far);
+
+    scene_tick(scene, 0);
+    // Only body1, from the first mask, is stopped
+    assert(body_get_stop(second) && !body_get_stop(first));
+    assert(!body_get_stop(untagged) && !body_get_stop(far));
+    body_set_stop(second, false);
+
+    assert(body_get_collision_mask(first) == ALL_TAGS);
+    body_set_collision_mask(first, ALL_TAGS & ~TAG_MASK(2));
+    scene_tick(scene, 0);
+    assert(!body_get_stop(second));
+    body_set_collision_mask(first, ALL_TAGS);
+    body_set_collision_mask(second, TAG_MASK(1));
+    scene_tick(scene, 0);
+    assert(body_get_stop(second));
+    scene_free(scene);
+}
+
+// A fast body passes through a thin wall in one tick unless it is continuous,
+// in which case it bounces off the wall's near side
+void test_continuous_collision() {
+    for (int continuous = 0; continuous <= 1; continuous++) {
+        Scene *scene = scene_init();
+        create_group_physics_collision(scene, 1, TAG_MASK(1), TAG_MASK(2));
+        Body *wall = body_init(polygon_rectangle((Vector) {5, 0}, 0.2, 10),
+            INFINITY, (RGBColor) {0, 0, 0});
+        body_set_tag(wall, 2);
+        Body *bullet = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_tag(bullet, 1);
+        body_set_velocity(bullet, (Vector) {100, 0});
+        body_set_continuous(bullet, continuous);
+        scene_add_body(scene, wall);
+        scene_add_body(scene, bullet);
+
+        // Starts 3.9 short of the wall and moves 10 per tick
+        scene_tick(scene, 0.1);
+        double x = body_get_centroid(bullet).x;
+        if (continuous) {
+            assert(body_get_continuous(bullet));
+            // Touched after 0.39 of the tick, then went back for the other 0.61
+            assert(within(1e-2, x, 3.9 - 6.1));
+            assert(vec_isclose(body_get_velocity(bullet), (Vector) {-100, 0}));
+        } else {
+            assert(within(1e-9, x, 10));
+            assert(vec_equal(body_get_velocity(bullet), (Vector) {100, 0}));
+        }
+        scene_tick(scene, 0.1);
+        assert(continuous
+            ? body_get_centroid(bullet).x < 0
+            : body_get_centroid(bullet).x > 10);
+        scene_free(scene);
+    }
+}
+
+// Whatever the integrator, an impact is stepped on with it, and the
+// bullet's previous position stays where its tick began
+void test_continuous_collision_integrators() {
+    Integrator integrators[] = {INTEGRATOR_DEFAULT, INTEGRATOR_SYMPLECTIC_EULER};
+    for (size_t i = 0; i < 2; i++) {
+        Scene *scene = scene_init();
+        scene_set_integrator(scene, integrators[i]);
+        create_group_physics_collision(scene, 1, TAG_MASK(1), TAG_MASK(2));
+        Body *wall = body_init(polygon_rectangle((Vector) {5, 0}, 0.2, 10),
+            INFINITY, (RGBColor) {0, 0, 0});
+        body_set_tag(wall, 2);
+        Body *bullet = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_tag(bullet, 1);
+        body_set_velocity(bullet, (Vector) {100, 0});
+        body_set_continuous(bullet, true);
+        scene_add_body(scene, wall);
+        scene_add_body(scene, bullet);
+
+        Vector start = body_get_centroid(bullet);
+        scene_tick(scene, 0.1);
+        assert(within(1e-2, body_get_centroid(bullet).x, 3.9 - 6.1));
+        assert(vec_isclose(body_get_velocity(bullet), (Vector) {-100, 0}));
+        assert(vec_isclose(body_get_previous_centroid(bullet), start));
+        assert(vec_equal(body_get_impulse(bullet), VEC_ZERO));
+        scene_free(scene);
+    }
+}
+
+// Two boxes stacked on a floor under gravity come to rest and stay put,
+// held up by the collision solver alone
+void test_resting_contact() {
+    Scene *scene = scene_init();
+    create_uniform_field(scene, (Uniform_Field) {.acceleration = {0, -10}},
+        TAG_MASK(1));
+    create_group_inelastic_collision(scene, TAG_MASK(1), TAG_MASK(1) | TAG_MASK(2));
+    Body *floor = body_init(polygon_rectangle((Vector) {0, -1}, 20, 2), INFINITY,
+        (RGBColor) {0, 0, 0});
+    body_set_tag(floor, 2);
+    scene_add_body(scene, floor);
+    Body *boxes[2];
+    for (size_t i = 0; i < 2; i++) {
+        boxes[i] = body_init(polygon_rectangle((Vector) {0, 0.5 + i}, 1, 1),
+            1 + i, (RGBColor) {0, 0, 0});
+        body_set_tag(boxes[i], 1);
+        scene_add_body(scene, boxes[i]);
+    }
+    for (size_t tick = 0; tick < 1000; tick++) scene_tick(scene, 0.01);
+    for (size_t i = 0; i < 2; i++) {
+        assert(within(1e-2, body_get_centroid(boxes[i]).y, 0.5 + i));
+        assert(vec_magnitude(body_get_velocity(boxes[i])) < 1e-6);
+    }
+    scene_free(scene);
+}
+
+// A pair collision bounces a body once per tick, however many times
+// the integrator evaluates the force creators
+void test_pair_collision_integrators() {
+    Integrator integrators[] = {INTEGRATOR_DEFAULT, INTEGRATOR_RK4};
+    for (size_t i = 0; i < 2; i++) {
+        Scene *scene = scene_init();
+        scene_set_integrator(scene, integrators[i]);
+        // Just touching the ball's right side
+        Body *wall = body_init(polygon_rectangle((Vector) {1.5, 0}, 1, 10),
+            INFINITY, (RGBColor) {0, 0, 0});
+        Body *ball = body_init(make_shape(), 1, (RGBColor) {0, 0, 0});
+        body_set_velocity(ball, (Vector) {2, 0});
+        scene_add_body(scene, wall);
+        scene_add_body(scene, ball);
+        create_physics_collision(scene, 0.5, ball, wall);
+        scene_tick(scene, 0.01);
+        assert(vec_isclose(body_get_velocity(ball), (Vector) {-1, 0}));
+        scene_tick(scene, 0.01);
+        assert(vec_isclose(body_get_velocity(ball), (Vector) {-1, 0}));
+        scene_free(scene);
+    }
+}
+
 int main(int argc, char *argv[]) {
     // Run all tests if there are no command-line arguments
     bool all_tests = argc == 1;
@@ -168,6 +567,19 @@ int main(int argc, char *argv[]) {
     // DO_TEST(test_energy_conservation)
     DO_TEST(test_collisions)
     DO_TEST(test_forces_removed)
+    DO_TEST(test_nbody_gravity)
+    DO_TEST(test_nbody_gravity_group)
+    DO_TEST(test_gravity_direct_sum)
+    DO_TEST(test_direct_gravity)
+    DO_TEST(test_direct_gravity_group)
+    DO_TEST(test_uniform_field_tags)
+    DO_TEST(test_uniform_field_drag)
+    DO_TEST(test_group_destructive_collision)
+    DO_TEST(test_group_collision_filtering)
+    DO_TEST(test_resting_contact)
+    DO_TEST(test_pair_collision_integrators)
+    DO_TEST(test_continuous_collision)
+    DO_TEST(test_continuous_collision_integrators)
 
     puts("forces_test PASS");
     return 0;
@@ -0,0 +1,207 @@
+#include "headless.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+Scene *parse_string(char *description) {
+    FILE *f = fmemopen(description, strlen(description), "r");
+    assert(f != NULL);
+    Scene *scene = headless_parse_scene(f);
+    fclose(f);
+    return scene;
+}
+
+void test_parse_bodies() {
+    Scene *scene = parse_string(
+        "# a comment\n"
+        "\n"
+        "rect 1 2 4 2 3\n"
+        "circle -5 0 1 inf\n"
+        "rect 0 0 1 1 1 2 -3\n"
+    );
+    assert(scene != NULL);
+    assert(scene_bodies(scene) == 3);
+    assert(vec_isclose(body_get_centroid(scene_get_body(scene, 0)), (Vector) {1, 2}));
+    assert(body_get_mass(scene_get_body(scene, 0)) == 3);
+    assert(vec_isclose(body_get_centroid(scene_get_body(scene, 1)), (Vector) {-5, 0}));
+    assert(body_get_mass(scene_get_body(scene, 1)) == INFINITY);
+    assert(vec_equal(body_get_velocity(scene_get_body(scene, 2)), (Vector) {2, -3}));
+    scene_free(scene);
+}
+
+void test_parse_errors() {
+    assert(parse_string("rect 0 0 1 1\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 -2\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 1\nspring 1 0 1\n") == NULL);
+    assert(parse_string("teleport 0 0\n") == NULL);
+    assert(parse_string("integrator leapfrog\n") == NULL);
+    assert(parse_string("adaptive 0.1 0.01 1e-6\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 inf\nnbody 1 0.5\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 1\ndirect 1 0\n") == NULL);
+    assert(parse_string("field 0 -10 0\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 1\ntag 32 0\n") == NULL);
+    assert(parse_string("collide 1 0 1.5\n") == NULL);
+    // Body indices must be whole and non-negative
+    assert(parse_string("rect 0 0 1 1 1\nrect 2 0 1 1 1\nspring 1 0 0.5\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 1\ndrag 1 -1\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 1\ncontinuous -0.5\n") == NULL);
+    assert(parse_string("rect 0 0 1 1 1\ntag 1 nan\n") == NULL);
+}
+
+void test_parse_integrator() {
+    Scene *scene = parse_string("rect 0 0 1 1 1\n");
+    assert(scene_get_integrator(scene) == INTEGRATOR_DEFAULT);
+    scene_free(scene);
+    scene = parse_string("integrator rk4\nrect 0 0 1 1 1\n");
+    assert(scene_get_integrator(scene) == INTEGRATOR_RK4);
+    scene_free(scene);
+}
+
+void test_run_adaptive() {
+    Scene *scene = parse_string(
+        "integrator adaptive\n"
+        "adaptive 1e-4 1e-2 1e-6\n"
+        "rect 3 0 2 2 10\n"
+        "rect 0 0 2 2 inf\n"
+        "spring 2 0 1\n"
+    );
+    assert(scene != NULL);
+    assert(scene_get_integrator(scene) == INTEGRATOR_ADAPTIVE_RK45);
+    Headless_Stats stats = headless_run(scene, 0.1, 10);
+    assert(stats.steps == 10);
+    // max_dt caps every tick at no fewer than 10 steps
+    assert(stats.integrator_steps >= 100);
+    scene_free(scene);
+}
+
+// Group gravity pulls every declared body towards the others
+void test_run_nbody() {
+    Scene *scene = parse_string(
+        "circle -10 0 1 5\n"
+        "circle 10 0 1 5\n"
+        "circle 0 30 1 5\n"
+        "nbody 10 0.5\n"
+    );
+    assert(scene != NULL);
+    headless_run(scene, 1e-2, 100);
+    assert(body_get_centroid(scene_get_body(scene, 0)).x > -10);
+    scene_free(scene);
+
+    scene = parse_string(
+        "circle -10 0 1 5\n"
+        "circle 10 0 1 5\n"
+        "circle 0 30 1 5\n"
+        "direct 10 0.1\n"
+    );
+    assert(scene != NULL);
+    headless_run(scene, 1e-2, 100);
+    assert(body_get_centroid(scene_get_body(scene, 0)).x > -10);
+    assert(body_get_centroid(scene_get_body(scene, 1)).x < 10);
+    assert(body_get_centroid(scene_get_body(scene, 2)).y < 30);
+    scene_free(scene);
+}
+
+// A field declared before any body still acts on the bodies declared later
+void test_run_field() {
+    Scene *scene = parse_string(
+        "field 0 -10 0 0\n"
+        "rect 0 0 2 2 3\n"
+        "rect 5 0 2 2 inf\n"
+    );
+    assert(scene != NULL);
+    headless_run(scene, 0.1, 10);
+    assert(vec_isclose(body_get_velocity(scene_get_body(scene, 0)), (Vector) {0, -10}));
+    assert(vec_equal(body_get_centroid(scene_get_body(scene, 1)), (Vector) {5, 0}));
+    scene_free(scene);
+}
+
+// Checks that a described spring scene runs and moves the mass
+void test_run_spring() {
+    Scene *scene = parse_string(
+        "rect 3 0 2 2 10\n"
+        "rect 0 0 2 2 inf\n"
+        "spring 2 0 1\n"
+    );
+    assert(scene != NULL);
+    Headless_Stats stats = headless_run(scene, 1e-3, 1000);
+    assert(stats.steps == 1000);
+    assert(stats.dt == 1e-3);
+    assert(stats.bodies == 2);
+    assert(stats.wall_seconds >= 0);
+    // After one second, x = 3 cos(sqrt(2 / 10))
+    assert(within(1e-2, body_get_centroid(scene_get_body(scene, 0)).x,
+        3 * cos(sqrt(0.2))));
+    assert(vec_equal(body_get_centroid(scene_get_body(scene, 1)), VEC_ZERO));
+    scene_free(scene);
+}
+
+void test_run_destructive() {
+    Scene *scene = parse_string(
+        "rect -3 0 2 2 1 1 0\n"
+        "rect 3 0 2 2 1 -1 0\n"
+        "destructive 0 1\n"
+    );
+    assert(scene != NULL);
+    Headless_Stats stats = headless_run(scene, 0.1, 40);
+    assert(stats.bodies == 0);
+    scene_free(scene);
+}
+
+// Tagged bodies bounce off each other; the untagged one passes through
+void test_run_collide() {
+    Scene *scene = parse_string(
+        "rect -3 0 2 2 1 1 0\n"
+        "rect 3 0 2 2 1 -1 0\n"
+        "rect 0 -3 2 2 1 0 1\n"
+        "tag 1 0\n"
+        "tag 2 1\n"
+        "collide 1 1 2\n"
+    );
+    assert(scene != NULL);
+    headless_run(scene, 0.1, 40);
+    assert(vec_isclose(body_get_velocity(scene_get_body(scene, 0)), (Vector) {-1, 0}));
+    assert(vec_isclose(body_get_velocity(scene_get_body(scene, 1)), (Vector) {1, 0}));
+    assert(vec_isclose(body_get_velocity(scene_get_body(scene, 2)), (Vector) {0, 1}));
+    scene_free(scene);
+}
+
+// A fast continuous body bounces off a thin wall instead of passing through
+void test_run_continuous() {
+    Scene *scene = parse_string(
+        "rect 5 0 0.2 10 inf\n"
+        "rect 0 0 2 2 1 100 0\n"
+        "tag 1 1\n"
+        "continuous 1\n"
+        "collide 1 0 1\n"
+    );
+    assert(scene != NULL);
+    headless_run(scene, 0.1, 5);
+    assert(body_get_centroid(scene_get_body(scene, 1)).x < 0);
+    scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_parse_bodies)
+    DO_TEST(test_parse_errors)
+    DO_TEST(test_parse_integrator)
+    DO_TEST(test_run_adaptive)
+    DO_TEST(test_run_nbody)
+    DO_TEST(test_run_field)
+    DO_TEST(test_run_spring)
+    DO_TEST(test_run_destructive)
+    DO_TEST(test_run_collide)
+    DO_TEST(test_run_continuous)
+
+    puts("headless_test PASS");
+    return 0;
+}
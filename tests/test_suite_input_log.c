@@ -0,0 +1,102 @@
+#include "input_log.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+FILE *file_with(const char *text) {
+    FILE *file = tmpfile();
+    fputs(text, file);
+    rewind(file);
+    return file;
+}
+
+void test_round_trip() {
+    FILE *file = tmpfile();
+    input_log_write_header(file);
+    input_log_write_dt(file, 0.0);
+    input_log_write_event(file, 2, (Input_Event) {.type = INPUT_KEY, .key = 'a',
+        .released = false, .held_time = 0.1});
+    input_log_write_event(file, 2, (Input_Event) {.type = INPUT_POINTER, .x = 10, .y = -1});
+    input_log_write_dt(file, 1.0 / 60);
+    input_log_write_event(file, 5, (Input_Event) {.type = INPUT_KEY, .key = 3,
+        .released = true, .held_time = 1.0 / 3});
+    input_log_write_event(file, 9, (Input_Event) {.type = INPUT_QUIT});
+    rewind(file);
+
+    Input_Log *log = input_log_read(file);
+    fclose(file);
+    assert(log != NULL);
+    double dt;
+    assert(input_log_next_dt(log, &dt) && dt == 0.0);
+    // Times come back exactly
+    assert(input_log_next_dt(log, &dt) && dt == 1.0 / 60);
+    assert(!input_log_next_dt(log, &dt));
+
+    Input_Event event;
+    assert(!input_log_next_event(log, 0, &event));
+    assert(!input_log_next_event(log, 1, &event));
+    assert(input_log_next_event(log, 2, &event));
+    assert(event.type == INPUT_KEY && event.key == 'a' && !event.released);
+    assert(event.held_time == 0.1);
+    assert(input_log_next_event(log, 2, &event));
+    assert(event.type == INPUT_POINTER && event.x == 10 && event.y == -1);
+    assert(!input_log_next_event(log, 2, &event));
+    assert(input_log_next_event(log, 5, &event));
+    assert(event.key == 3 && event.released && event.held_time == 1.0 / 3);
+    assert(!input_log_finished(log));
+    assert(input_log_next_event(log, 9, &event) && event.type == INPUT_QUIT);
+    assert(input_log_finished(log));
+    input_log_free(log);
+}
+
+// Input from frames that were never asked about is dropped
+void test_skipped_frames() {
+    FILE *file = file_with("input-log 1\npointer 1 5 5\npointer 3 6 6\n");
+    Input_Log *log = input_log_read(file);
+    fclose(file);
+    Input_Event event;
+    assert(input_log_next_event(log, 2, &event) == false);
+    assert(input_log_next_event(log, 3, &event) && event.x == 6);
+    assert(input_log_finished(log));
+    input_log_free(log);
+}
+
+void test_invalid_logs() {
+    const char *logs[] = {
+        "",
+        "input-log 2\n",
+        "input-log 1\ndt\n",
+        "input-log 1\ndt -1\n",
+        "input-log 1\nkey 1 97 held 0\n",
+        "input-log 1\nkey 1 0 pressed 0\n",
+        "input-log 1\npointer 1 2\n",
+        "input-log 1\nquit 1 2\n",
+        "input-log 1\njump 1\n",
+        // Frames must not go backwards
+        "input-log 1\nquit 4\npointer 3 1 1\n"
+    };
+    for (size_t i = 0; i < sizeof(logs) / sizeof(logs[0]); i++) {
+        FILE *file = file_with(logs[i]);
+        assert(input_log_read(file) == NULL);
+        fclose(file);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_round_trip)
+    DO_TEST(test_skipped_frames)
+    DO_TEST(test_invalid_logs)
+
+    puts("input_log_test PASS");
+    return 0;
+}
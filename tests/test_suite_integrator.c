@@ -0,0 +1,199 @@
+#include "forces.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+Body *make_box(Vector center, double mass) {
+    return body_init(polygon_rectangle(center, 2, 2), mass, (RGBColor) {0, 0, 0});
+}
+
+// Runs a mass on a spring for one period, returning the largest deviation
+// from A cos(sqrt(K / M) * t)
+double spring_error(Integrator integrator, double dt) {
+    const double M = 10;
+    const double K = 2;
+    const double A = 3;
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, integrator);
+    Body *mass = make_box((Vector) {A, 0}, M);
+    scene_add_body(scene, mass);
+    Body *anchor = make_box(VEC_ZERO, INFINITY);
+    scene_add_body(scene, anchor);
+    create_spring(scene, K, mass, anchor);
+
+    double omega = sqrt(K / M);
+    int steps = (int) round(2 * M_PI / omega / dt);
+    double max_error = 0;
+    for (int i = 0; i < steps; i++) {
+        scene_tick(scene, dt);
+        Vector expected = {A * cos(omega * (i + 1) * dt), 0};
+        Vector diff = vec_subtract(body_get_centroid(mass), expected);
+        max_error = fmax(max_error, vec_magnitude(diff));
+    }
+    assert(vec_equal(body_get_centroid(anchor), VEC_ZERO));
+    scene_free(scene);
+    return max_error;
+}
+
+double gravity_energy(Body *body1, Body *body2, double G) {
+    Vector r = vec_subtract(body_get_centroid(body2), body_get_centroid(body1));
+    Vector v1 = body_get_velocity(body1), v2 = body_get_velocity(body2);
+    return -G * body_get_mass(body1) * body_get_mass(body2) / vec_magnitude(r)
+        + body_get_mass(body1) * vec_dot(v1, v1) / 2
+        + body_get_mass(body2) * vec_dot(v2, v2) / 2;
+}
+
+// Returns the largest relative energy drift of a circular orbit over one period
+double orbit_energy_drift(Integrator integrator, double dt) {
+    const double G = 10, M = 1000, R = 100;
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, integrator);
+    Body *planet = make_box(VEC_ZERO, M);
+    Body *moon = make_box((Vector) {R, 0}, 1);
+    body_set_velocity(moon, (Vector) {0, sqrt(G * M / R)});
+    scene_add_body(scene, planet);
+    scene_add_body(scene, moon);
+    create_newtonian_gravity(scene, G, planet, moon);
+
+    double initial = gravity_energy(planet, moon, G);
+    int steps = (int) round(2 * M_PI * R / sqrt(G * M / R) / dt);
+    double drift = 0;
+    for (int i = 0; i < steps; i++) {
+        scene_tick(scene, dt);
+        drift = fmax(drift, fabs(gravity_energy(planet, moon, G) / initial - 1));
+    }
+    scene_free(scene);
+    return drift;
+}
+
+// The default integrator needs dt = 1e-3 to stay within 1e-3 of the
+// analytic solution over a period; the higher-order ones need far fewer steps
+void test_spring_accuracy() {
+    assert(spring_error(INTEGRATOR_DEFAULT, 1e-3) < 1e-3);
+    assert(spring_error(INTEGRATOR_SYMPLECTIC_EULER, 1e-3) < 1e-3);
+    assert(spring_error(INTEGRATOR_VELOCITY_VERLET, 1e-2) < 1e-3);
+    assert(spring_error(INTEGRATOR_RK4, 5e-2) < 1e-3);
+}
+
+void test_orbit_energy() {
+    assert(orbit_energy_drift(INTEGRATOR_SYMPLECTIC_EULER, 1e-2) < 1e-5);
+    assert(orbit_energy_drift(INTEGRATOR_VELOCITY_VERLET, 1e-2) < 1e-8);
+    assert(orbit_energy_drift(INTEGRATOR_RK4, 1e-1) < 1e-9);
+}
+
+// Infinite-mass bodies keep moving at constant velocity, and impulses still
+// change velocities instantly
+void test_kinematic_and_impulse() {
+    Integrator integrators[] = {INTEGRATOR_SYMPLECTIC_EULER,
+        INTEGRATOR_VELOCITY_VERLET, INTEGRATOR_RK4, INTEGRATOR_ADAPTIVE_RK45};
+    for (size_t i = 0; i < 4; i++) {
+        Scene *scene = scene_init();
+        scene_set_integrator(scene, integrators[i]);
+        assert(scene_get_integrator(scene) == integrators[i]);
+        Body *wall = make_box(VEC_ZERO, INFINITY);
+        body_set_velocity(wall, (Vector) {1, 0});
+        Body *ball = make_box((Vector) {10, 0}, 2);
+        scene_add_body(scene, wall);
+        scene_add_body(scene, ball);
+
+        body_add_impulse(ball, (Vector) {0, 4});
+        scene_tick(scene, 0.5);
+        assert(vec_isclose(body_get_centroid(wall), (Vector) {0.5, 0}));
+        assert(vec_isclose(body_get_velocity(ball), (Vector) {0, 2}));
+        assert(vec_isclose(body_get_centroid(ball), (Vector) {10, 1}));
+        assert(vec_isclose(body_get_previous_centroid(ball), (Vector) {10, 0}));
+        scene_tick(scene, 0.5);
+        assert(vec_isclose(body_get_centroid(ball), (Vector) {10, 2}));
+        scene_free(scene);
+    }
+}
+
+// An eccentric orbit needs tiny steps near its closest approach and few
+// elsewhere; the adaptive integrator should find both on its own
+void test_adaptive_eccentric_orbit() {
+    const double G = 10, M = 1000, R = 100;
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, INTEGRATOR_ADAPTIVE_RK45);
+    Adaptive_Config config = {1e-6, 1.0, 1e-9};
+    scene_set_adaptive_config(scene, config);
+    Body *planet = make_box(VEC_ZERO, M);
+    Body *moon = make_box((Vector) {R, 0}, 1);
+    body_set_velocity(moon, (Vector) {0, 0.3 * sqrt(G * M / R)});
+    scene_add_body(scene, planet);
+    scene_add_body(scene, moon);
+    create_newtonian_gravity(scene, G, planet, moon);
+
+    // Semi-major axis a = R / (2 - 0.3^2); one period is 2 pi sqrt(a^3 / GM)
+    double a = R / (2 - 0.09);
+    double period = 2 * M_PI * sqrt(a * a * a / (G * M));
+    const double dt = 0.5;
+    double initial = gravity_energy(planet, moon, G);
+    size_t fewest = SIZE_MAX, most = 0, total = 0;
+    double closest = INFINITY;
+    for (double t = 0; t < period; t += dt) {
+        scene_tick(scene, dt);
+        Adaptive_Stats stats = scene_get_adaptive_stats(scene);
+        assert(stats.steps >= 1);
+        assert(stats.smallest_dt >= config.min_dt);
+        assert(stats.next_dt >= config.min_dt && stats.next_dt <= config.max_dt);
+        fewest = stats.steps < fewest ? stats.steps : fewest;
+        most = stats.steps > most ? stats.steps : most;
+        total += stats.steps;
+        assert(stats.total_steps == total);
+        closest = fmin(closest, vec_magnitude(body_get_centroid(moon)));
+    }
+    assert(closest < 10);
+    assert(fewest <= 2);
+    assert(most >= 20 * fewest);
+    assert(fabs(gravity_energy(planet, moon, G) / initial - 1) < 1e-7);
+    scene_free(scene);
+}
+
+// With min_dt = max_dt the step size is fixed
+void test_adaptive_bounds() {
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, INTEGRATOR_ADAPTIVE_RK45);
+    scene_set_adaptive_config(scene, (Adaptive_Config) {0.01, 0.01, 1e-12});
+    Body *mass = make_box((Vector) {3, 0}, 10);
+    Body *anchor = make_box(VEC_ZERO, INFINITY);
+    scene_add_body(scene, mass);
+    scene_add_body(scene, anchor);
+    create_spring(scene, 2, mass, anchor);
+    for (int i = 0; i < 10; i++) {
+        scene_tick(scene, 0.1);
+        Adaptive_Stats stats = scene_get_adaptive_stats(scene);
+        assert(stats.steps == 10);
+        assert(stats.rejected == 0);
+        assert(within(1e-12, stats.smallest_dt, 0.01));
+    }
+    assert(scene_get_adaptive_stats(scene).total_steps == 100);
+    scene_free(scene);
+}
+
+// A loose tolerance still tracks the spring over large ticks
+void test_adaptive_spring() {
+    assert(spring_error(INTEGRATOR_ADAPTIVE_RK45, 0.5) < 1e-3);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_spring_accuracy)
+    DO_TEST(test_orbit_energy)
+    DO_TEST(test_kinematic_and_impulse)
+    DO_TEST(test_adaptive_eccentric_orbit)
+    DO_TEST(test_adaptive_bounds)
+    DO_TEST(test_adaptive_spring)
+
+    puts("integrator_test PASS");
+    return 0;
+}
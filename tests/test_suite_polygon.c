@@ -1,4 +1,100 @@
-int main(int argc, char const *argv[]) {
-  /* code */
-  return 0;
+#include "polygon.h"
+#include "allocator.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+List *make_polygon(Vector *points, size_t n) {
+    List *polygon = list_init(n, allocator_free);
+    for (size_t i = 0; i < n; i++) list_add(polygon, vec_init(points[i]));
+    return polygon;
+}
+
+double triangle_area(List *polygon, size_t *triangle) {
+    Vector a = *(Vector *) list_get(polygon, triangle[0]);
+    Vector b = *(Vector *) list_get(polygon, triangle[1]);
+    Vector c = *(Vector *) list_get(polygon, triangle[2]);
+    return vec_cross(vec_subtract(b, a), vec_subtract(c, a)) / 2;
+}
+
+// Checks that the triangles cover the polygon exactly, all wound its way
+void check_triangulation(List *polygon) {
+    size_t n = list_size(polygon);
+    size_t *triangles = malloc(sizeof(size_t) * 3 * (n - 2));
+    size_t *scratch = malloc(sizeof(size_t) * n);
+    assert(polygon_triangulate(polygon, triangles, scratch) == n - 2);
+    double area = polygon_area(polygon);
+    double total = 0;
+    for (size_t i = 0; i < n - 2; i++) {
+        for (size_t j = 0; j < 3; j++) assert(triangles[3 * i + j] < n);
+        double triangle = triangle_area(polygon, &triangles[3 * i]);
+        assert(triangle * area > 0);
+        total += triangle;
+    }
+    assert(within(1e-9, total, area));
+    free(triangles);
+    free(scratch);
+}
+
+void test_triangulate_convex() {
+    List *square = polygon_rectangle((Vector) {1, 2}, 4, 6);
+    size_t triangles[6], scratch[4];
+    assert(polygon_triangulate(square, triangles, scratch) == 2);
+    // Fanned out from the first vertex
+    size_t expected[] = {0, 1, 2, 0, 2, 3};
+    for (size_t i = 0; i < 6; i++) assert(triangles[i] == expected[i]);
+    list_free(square);
+
+    List *circle = polygon_circle(VEC_ZERO, 3, 40);
+    check_triangulation(circle);
+    // Clockwise
+    polygon_rotate(circle, M_PI / 7, (Vector) {1, 1});
+    List *reversed = list_init(40, NULL);
+    for (size_t i = 40; i > 0; i--) list_add(reversed, list_get(circle, i - 1));
+    check_triangulation(reversed);
+    list_free(reversed);
+    list_free(circle);
+}
+
+void test_triangulate_concave() {
+    // An L, whose fan from vertex 0 would cover the missing corner
+    Vector l[] = {{2, 2}, {0, 2}, {0, 0}, {4, 0}, {4, 1}, {2, 1}};
+    List *polygon = make_polygon(l, 6);
+    check_triangulation(polygon);
+    list_free(polygon);
+
+    // A star, wound clockwise
+    Vector star[10];
+    for (size_t i = 0; i < 10; i++) {
+        double radius = i % 2 == 0 ? 5 : 2;
+        double angle = -2 * M_PI * i / 10;
+        star[i] = (Vector) {radius * cos(angle), radius * sin(angle)};
+    }
+    polygon = make_polygon(star, 10);
+    check_triangulation(polygon);
+    list_free(polygon);
+
+    // A comb with collinear vertices along its back
+    Vector comb[] = {{0, 0}, {1, 0}, {2, 0}, {3, 0}, {3, 3}, {2.5, 1}, {2, 3},
+        {1.5, 1}, {1, 3}, {0.5, 1}, {0, 3}};
+    polygon = make_polygon(comb, 11);
+    check_triangulation(polygon);
+    list_free(polygon);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_triangulate_convex)
+    DO_TEST(test_triangulate_concave)
+
+    puts("polygon_test PASS");
+    return 0;
 }
@@ -0,0 +1,168 @@
+#include "profiler.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+void force_a(void *aux) {}
+void force_b(void *aux) {}
+
+// Times a force creator function as scene_apply_forces() does
+void run_force(ForceCreator creator) {
+    profiler_begin(PHASE_FORCE_TYPE);
+    creator(NULL);
+    profiler_end_force(creator);
+}
+
+void test_spans_and_ticks() {
+    profiler_start(16, 4);
+    profiler_begin(PHASE_TICK);
+    profiler_begin(PHASE_FORCES);
+    run_force(force_a);
+    run_force(force_b);
+    run_force(force_a);
+    profiler_end(PHASE_FORCES);
+    profiler_count_narrowphase();
+    profiler_count_narrowphase();
+    profiler_end(PHASE_TICK);
+
+    // One span per force creator function, then the phases as they end
+    Profile_Span span;
+    assert(profiler_read_span(&span));
+    assert(span.phase == PHASE_FORCE_TYPE && span.creator == force_a);
+    assert(span.calls == 2);
+    double forces_start = span.start;
+    assert(profiler_read_span(&span));
+    assert(span.phase == PHASE_FORCE_TYPE && span.creator == force_b);
+    assert(span.calls == 1);
+    assert(profiler_read_span(&span));
+    assert(span.phase == PHASE_FORCES && span.start == forces_start);
+    assert(profiler_read_span(&span));
+    assert(span.phase == PHASE_TICK && span.tick == 0);
+    double tick_duration = span.duration;
+    assert(!profiler_read_span(&span));
+
+    Profile_Tick tick;
+    assert(profiler_read_tick(&tick));
+    assert(tick.tick == 0);
+    assert(tick.duration == tick_duration);
+    assert(tick.narrowphase_tests == 2);
+    assert(tick.phase_time[PHASE_FORCES] <= tick.duration);
+    assert(tick.phase_time[PHASE_FORCE_TYPE] <= tick.phase_time[PHASE_FORCES]);
+    assert(tick.phase_time[PHASE_COLLISIONS] == 0);
+    assert(!profiler_read_tick(&tick));
+    assert(profiler_dropped() == 0);
+    profiler_stop();
+
+    // Nothing is recorded once stopped
+    profiler_begin(PHASE_TICK);
+    profiler_end(PHASE_TICK);
+    assert(!profiler_read_span(&span));
+}
+
+void test_full_buffer() {
+    profiler_start(2, 1);
+    for (size_t i = 0; i < 3; i++) {
+        profiler_begin(PHASE_RENDER);
+        profiler_end(PHASE_RENDER);
+    }
+    assert(profiler_dropped() == 1);
+    Profile_Span span;
+    assert(profiler_read_span(&span));
+    profiler_begin(PHASE_RENDER);
+    profiler_end(PHASE_RENDER);
+    assert(profiler_dropped() == 1);
+    profiler_stop();
+}
+
+void test_chrome_trace() {
+    profiler_start(16, 4);
+    profiler_begin(PHASE_TICK);
+    profiler_begin(PHASE_FORCES);
+    run_force(force_a);
+    profiler_end(PHASE_FORCES);
+    profiler_end(PHASE_TICK);
+
+    char buffer[2048];
+    FILE *out = fmemopen(buffer, sizeof(buffer), "w");
+    profiler_write_chrome_trace(out);
+    fclose(out);
+    assert(strncmp(buffer, "{\"traceEvents\": [", 17) == 0);
+    assert(strstr(buffer, "\"name\": \"tick\", \"cat\": \"tick\", \"ph\": \"X\"") != NULL);
+    assert(strstr(buffer, "\"name\": \"force 0x") != NULL);
+    assert(strstr(buffer, "\"name\": \"tick counts\", \"ph\": \"C\"") != NULL);
+    // Writing the trace empties the buffers
+    Profile_Span span;
+    assert(!profiler_read_span(&span));
+    profiler_stop();
+}
+
+// The scene's timers are only compiled in with PROFILE
+void test_scene_tick() {
+    Scene *scene = scene_init();
+    scene_add_body(scene, body_init(polygon_rectangle(VEC_ZERO, 1, 1), 1,
+        (RGBColor) {0, 0, 0}));
+    profiler_start(64, 4);
+    scene_tick(scene, 0.1);
+    Profile_Tick tick;
+#ifdef PROFILE
+    assert(profiler_read_tick(&tick));
+    assert(tick.phase_time[PHASE_INTEGRATION] > 0);
+#else
+    assert(!profiler_read_tick(&tick));
+#endif
+    profiler_stop();
+    scene_free(scene);
+}
+
+#define READER_SPANS 100000
+
+void *read_spans(void *aux) {
+    size_t *read = aux;
+    double last_start = 0;
+    Profile_Span span;
+    while (*read < READER_SPANS - profiler_dropped()) {
+        if (profiler_read_span(&span)) {
+            assert(span.phase == PHASE_RENDER && span.start >= last_start);
+            last_start = span.start;
+            (*read)++;
+        }
+    }
+    return NULL;
+}
+
+// Another thread can read while the spans are being written
+void test_concurrent_reader() {
+    profiler_start(64, 1);
+    size_t read = 0;
+    pthread_t reader;
+    assert(pthread_create(&reader, NULL, read_spans, &read) == 0);
+    for (size_t i = 0; i < READER_SPANS; i++) {
+        profiler_begin(PHASE_RENDER);
+        profiler_end(PHASE_RENDER);
+    }
+    pthread_join(reader, NULL);
+    assert(read + profiler_dropped() == READER_SPANS);
+    profiler_stop();
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_spans_and_ticks)
+    DO_TEST(test_full_buffer)
+    DO_TEST(test_chrome_trace)
+    DO_TEST(test_scene_tick)
+    DO_TEST(test_concurrent_reader)
+
+    puts("profiler_test PASS");
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "quadtree.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// The exact field at point i, summing every other point
+Vector direct_field(Vector *positions, double *masses, size_t n, size_t i) {
+    Vector field = VEC_ZERO;
+    for (size_t j = 0; j < n; j++) {
+        Vector offset = vec_subtract(positions[j], positions[i]);
+        double dist = vec_magnitude(offset);
+        if (j == i || dist < 1e-3) continue;
+        field = vec_add(field, vec_multiply(masses[j] / (dist * dist * dist), offset));
+    }
+    return field;
+}
+
+void random_points(Vector *positions, double *masses, size_t n) {
+    srand(24);
+    for (size_t i = 0; i < n; i++) {
+        positions[i] = (Vector) {
+            (double) rand() / RAND_MAX * 1000 - 500,
+            (double) rand() / RAND_MAX * 1000 - 500
+        };
+        masses[i] = 1 + (double) rand() / RAND_MAX * 9;
+    }
+}
+
+void test_two_points() {
+    Vector positions[] = {{0, 0}, {3, 4}};
+    double masses[] = {2, 5};
+    Quadtree *tree = quadtree_init();
+    quadtree_build(tree, positions, masses, 2);
+    // 5 / 5^2 along (3, 4) / 5
+    assert(vec_isclose(quadtree_field(tree, 0, 0.5, 1e-3), (Vector) {0.12, 0.16}));
+    assert(vec_isclose(quadtree_field(tree, 1, 0.5, 1e-3), (Vector) {-0.048, -0.064}));
+    // Too close to count
+    assert(vec_equal(quadtree_field(tree, 0, 0.5, 10), VEC_ZERO));
+    quadtree_free(tree);
+}
+
+void test_theta_zero_is_exact() {
+    const size_t N = 200;
+    Vector positions[N];
+    double masses[N];
+    random_points(positions, masses, N);
+    Quadtree *tree = quadtree_init();
+    quadtree_build(tree, positions, masses, N);
+    for (size_t i = 0; i < N; i++) {
+        Vector expected = direct_field(positions, masses, N, i);
+        Vector actual = quadtree_field(tree, i, 0, 1e-3);
+        assert(vec_magnitude(vec_subtract(expected, actual))
+            <= 1e-9 * vec_magnitude(expected));
+    }
+    quadtree_free(tree);
+}
+
+// A wide theta must not let a node count the point's own mass
+void test_wide_theta_ignores_self() {
+    Vector positions[] = {{0, 0}, {1, 1}, {-8, -8}};
+    double masses[] = {1, 100, 1e-9};
+    Quadtree *tree = quadtree_init();
+    quadtree_build(tree, positions, masses, 3);
+    Vector expected = direct_field(positions, masses, 3, 0);
+    assert(vec_isclose(quadtree_field(tree, 0, 0, 1e-3), expected));
+    assert(vec_isclose(quadtree_field(tree, 0, 1, 1e-3), expected));
+    assert(vec_isclose(quadtree_field(tree, 0, 2, 1e-3), expected));
+    quadtree_free(tree);
+}
+
+// Returns the mean relative error of the field at 2000 random points
+double mean_error(double theta) {
+    const size_t N = 2000;
+    Vector *positions = malloc(sizeof(Vector) * N);
+    double *masses = malloc(sizeof(double) * N);
+    random_points(positions, masses, N);
+    Quadtree *tree = quadtree_init();
+    quadtree_build(tree, positions, masses, N);
+    double total_error = 0;
+    for (size_t i = 0; i < N; i++) {
+        Vector expected = direct_field(positions, masses, N, i);
+        Vector actual = quadtree_field(tree, i, theta, 1e-3);
+        total_error += vec_magnitude(vec_subtract(expected, actual))
+            / vec_magnitude(expected);
+    }
+    quadtree_free(tree);
+    free(positions);
+    free(masses);
+    return total_error / N;
+}
+
+// Smaller opening angles trade speed for accuracy
+void test_theta_accuracy() {
+    assert(mean_error(0.5) < 5e-2);
+    assert(mean_error(0.25) < 1e-2);
+}
+
+// Points in the same place can't be separated, and must not split forever
+void test_coincident_points() {
+    Vector positions[] = {{1, 1}, {1, 1}, {1, 1}, {4, 5}};
+    double masses[] = {1, 1, 1, 3};
+    Quadtree *tree = quadtree_init();
+    quadtree_build(tree, positions, masses, 4);
+    // The far point sees all three stacked masses
+    Vector field = quadtree_field(tree, 3, 0.5, 1e-3);
+    assert(vec_isclose(field, vec_multiply(3.0 / 125, (Vector) {-3, -4})));
+    quadtree_free(tree);
+}
+
+// Rebuilding reuses the same nodes, and an empty tree has no field
+void test_rebuild() {
+    const size_t N = 100;
+    Vector positions[N];
+    double masses[N];
+    random_points(positions, masses, N);
+    Quadtree *tree = quadtree_init();
+    quadtree_build(tree, positions, masses, N);
+    size_t nodes = quadtree_nodes(tree);
+    assert(nodes >= N);
+    quadtree_build(tree, positions, masses, N);
+    assert(quadtree_nodes(tree) == nodes);
+    quadtree_build(tree, positions, masses, 0);
+    assert(quadtree_nodes(tree) == 0);
+    quadtree_build(tree, positions, masses, 1);
+    assert(vec_equal(quadtree_field(tree, 0, 0.5, 1e-3), VEC_ZERO));
+    quadtree_free(tree);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_two_points)
+    DO_TEST(test_theta_zero_is_exact)
+    DO_TEST(test_wide_theta_ignores_self)
+    DO_TEST(test_theta_accuracy)
+    DO_TEST(test_coincident_points)
+    DO_TEST(test_rebuild)
+
+    puts("quadtree_test PASS");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "recorder.h"
+#include "forces.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const double POSITION_QUANTUM = 1e-4;
+const double ANGLE_QUANTUM = 1e-3;
+const double DT = 1e-3;
+
+// Where every body really was after each tick, to compare the recording with
+typedef struct {
+    Vector positions[100][4];
+    double angles[100][4];
+    size_t num_bodies[100];
+    size_t ticks;
+} History;
+
+void remember(Scene *scene, History *history) {
+    size_t tick = history->ticks++;
+    history->num_bodies[tick] = scene_bodies(scene);
+    for (size_t i = 0; i < scene_bodies(scene); i++) {
+        history->positions[tick][i] = body_get_centroid(scene_get_body(scene, i));
+        history->angles[tick][i] = body_get_angle(scene_get_body(scene, i));
+    }
+}
+
+Body *add_mass(Scene *scene, Vector center) {
+    Body *body = body_init(polygon_rectangle(center, 1, 1), 1, (RGBColor) {0, 0, 0});
+    scene_add_body(scene, body);
+    return body;
+}
+
+// Records springs oscillating, a body spinning and the number of bodies
+// changing, and checks every frame reads back to within the quanta
+void test_round_trip() {
+    Scene *scene = scene_init();
+    Body *anchor = add_mass(scene, VEC_ZERO);
+    Body *mass = add_mass(scene, (Vector) {10, 0});
+    create_spring(scene, 5, anchor, mass);
+    body_set_velocity(anchor, (Vector) {-3, 1});
+    body_set_rotation(anchor, 0.5);
+    FILE *file = tmpfile();
+    // Small chunks, so there are many of them
+    Recorder *recorder = recorder_init(scene, file,
+        (Recorder_Config) {POSITION_QUANTUM, ANGLE_QUANTUM, 10, 64});
+    History *history = malloc(sizeof(History));
+    history->ticks = 0;
+    scene_add_tick_listener(scene, (TickListener) remember, history);
+
+    for (size_t tick = 0; tick < 100; tick++) {
+        if (tick == 30) add_mass(scene, (Vector) {-5, -5});
+        if (tick == 31) add_mass(scene, (Vector) {5, 5});
+        if (tick == 60) scene_remove_body(scene, 2);
+        scene_tick(scene, DT);
+    }
+    assert(recorder_free(recorder));
+    scene_free(scene);
+
+    rewind(file);
+    Trajectory *trajectory = trajectory_open(file);
+    assert(trajectory != NULL);
+    Trajectory_Frame frame;
+    for (size_t tick = 0; tick < history->ticks; tick++) {
+        assert(trajectory_next_frame(trajectory, &frame));
+        assert(frame.tick == tick);
+        assert(within(1e-9, frame.time, (tick + 1) * DT));
+        assert(frame.num_bodies == history->num_bodies[tick]);
+        for (size_t i = 0; i < frame.num_bodies; i++) {
+            Vector expected = history->positions[tick][i];
+            assert(fabs(frame.positions[i].x - expected.x) <= POSITION_QUANTUM / 2 + 1e-12);
+            assert(fabs(frame.positions[i].y - expected.y) <= POSITION_QUANTUM / 2 + 1e-12);
+            assert(fabs(frame.angles[i] - history->angles[tick][i]) <= ANGLE_QUANTUM / 2 + 1e-12);
+        }
+    }
+    assert(!trajectory_next_frame(trajectory, &frame));
+    trajectory_close(trajectory);
+    fclose(file);
+    free(history);
+}
+
+// Slow bodies move a few quanta a tick, so deltas take a byte or two
+void test_compression() {
+    Scene *scene = scene_init();
+    for (size_t i = 0; i < 50; i++) {
+        Body *body = add_mass(scene, (Vector) {i * 10, 0});
+        body_set_velocity(body, (Vector) {0.05, -0.02});
+    }
+    FILE *file = tmpfile();
+    Recorder *recorder = recorder_init(scene, file,
+        (Recorder_Config) {POSITION_QUANTUM, ANGLE_QUANTUM, 100, 4096});
+    for (size_t tick = 0; tick < 1000; tick++) scene_tick(scene, DT);
+    assert(recorder_free(recorder));
+    scene_free(scene);
+
+    // Three doubles per body per tick would be 1.2MB
+    long size = ftell(file);
+    assert(size < 1000 * 50 * 4);
+    rewind(file);
+    Trajectory *trajectory = trajectory_open(file);
+    Trajectory_Frame frame;
+    size_t frames = 0;
+    while (trajectory_next_frame(trajectory, &frame)) frames++;
+    assert(frames == 1000);
+    assert(within(1e-4, frame.positions[49].x, 490 + 0.05));
+    trajectory_close(trajectory);
+    fclose(file);
+}
+
+void test_invalid_recordings() {
+    Scene *scene = scene_init();
+    add_mass(scene, VEC_ZERO);
+    body_set_velocity(scene_get_body(scene, 0), (Vector) {1, 1});
+    FILE *file = tmpfile();
+    Recorder *recorder = recorder_init(scene, file,
+        (Recorder_Config) {POSITION_QUANTUM, ANGLE_QUANTUM, 5, 32});
+    for (size_t tick = 0; tick < 20; tick++) scene_tick(scene, DT);
+    assert(recorder_free(recorder));
+    scene_free(scene);
+    long size = ftell(file);
+    char *data = malloc(size);
+    rewind(file);
+    assert(fread(data, 1, size, file) == (size_t) size);
+    fclose(file);
+
+    // Cut short, the frames up to the cut still read
+    file = tmpfile();
+    fwrite(data, 1, size - 3, file);
+    rewind(file);
+    Trajectory *trajectory = trajectory_open(file);
+    Trajectory_Frame frame;
+    size_t frames = 0;
+    while (trajectory_next_frame(trajectory, &frame)) frames++;
+    assert(frames > 0 && frames < 20);
+    trajectory_close(trajectory);
+    fclose(file);
+
+    data[0] = 'X';
+    file = tmpfile();
+    fwrite(data, 1, size, file);
+    rewind(file);
+    assert(trajectory_open(file) == NULL);
+    fclose(file);
+    free(data);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_round_trip)
+    DO_TEST(test_compression)
+    DO_TEST(test_invalid_recordings)
+
+    puts("recorder_test PASS");
+    return 0;
+}
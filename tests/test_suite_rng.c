@@ -0,0 +1,59 @@
+#include "rng.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdbool.h>
+
+// The sequence is fixed by the seed alone, matching the reference SplitMix64
+void test_sequence() {
+    Rng rng = rng_init(0);
+    assert(rng_next(&rng) == 0xe220a8397b1dcdaf);
+    assert(rng_next(&rng) == 0x6e789e6aa1b965f4);
+    Rng copy = rng;
+    Rng other = rng_init(1);
+    for (size_t i = 0; i < 100; i++) {
+        uint64_t value = rng_next(&rng);
+        assert(rng_next(&copy) == value);
+        assert(rng_next(&other) != value);
+    }
+}
+
+void test_double() {
+    Rng rng = rng_init(44);
+    double sum = 0;
+    const size_t N = 10000;
+    for (size_t i = 0; i < N; i++) {
+        double value = rng_double(&rng, -2, 3);
+        assert(-2 <= value && value < 3);
+        sum += value;
+    }
+    assert(within(0.05, sum / N, 0.5));
+}
+
+void test_index() {
+    Rng rng = rng_init(45);
+    size_t counts[3] = {0};
+    for (size_t i = 0; i < 3000; i++) {
+        counts[rng_index(&rng, 3)]++;
+    }
+    for (size_t i = 0; i < 3; i++) {
+        assert(900 < counts[i] && counts[i] < 1100);
+    }
+    assert(rng_index(&rng, 1) == 0);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_sequence)
+    DO_TEST(test_double)
+    DO_TEST(test_index)
+
+    puts("rng_test PASS");
+    return 0;
+}
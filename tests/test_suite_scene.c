@@ -1,4 +1,371 @@
-int main(int argc, char const *argv[]) {
-  /* code */
-  return 0;
+#include "scene.h"
+#include "forces.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+Body *make_box(Scene *scene, Vector center, double size, size_t tag) {
+    Body *body = body_init(polygon_rectangle(center, size, size), 1,
+        (RGBColor) {0, 0, 0});
+    body_set_tag(body, tag);
+    scene_add_body(scene, body);
+    return body;
+}
+
+// A row of unit boxes along the x-axis at x = 0, 2, 4, ...,
+// alternating between tags 0 and 1
+Scene *make_row(size_t n) {
+    Scene *scene = scene_init();
+    for (size_t i = 0; i < n; i++) {
+        make_box(scene, (Vector) {2 * i, 0}, 1, i % 2);
+    }
+    return scene;
+}
+
+void test_raycast() {
+    Scene *scene = make_row(10);
+    Raycast_Hit hit;
+    assert(scene_raycast(scene, (Vector) {-5, 0}, (Vector) {3, 0}, INFINITY,
+        ALL_TAGS, &hit));
+    assert(hit.body == scene_get_body(scene, 0));
+    assert(within(1e-9, hit.distance, 4.5));
+    assert(vec_isclose(hit.point, (Vector) {-0.5, 0}));
+    assert(vec_isclose(hit.normal, (Vector) {-1, 0}));
+
+    // Only tag 1, and the ray starts inside body 2
+    assert(scene_raycast(scene, (Vector) {4, 0}, (Vector) {1, 0}, INFINITY,
+        TAG_MASK(1), &hit));
+    assert(hit.body == scene_get_body(scene, 3));
+    assert(within(1e-9, hit.distance, 1.5));
+
+    // Too short, pointing away, and passing above
+    assert(!scene_raycast(scene, (Vector) {-5, 0}, (Vector) {1, 0}, 4, ALL_TAGS, &hit));
+    assert(!scene_raycast(scene, (Vector) {-5, 0}, (Vector) {-1, 0}, INFINITY,
+        ALL_TAGS, &hit));
+    assert(!scene_raycast(scene, (Vector) {-5, 1}, (Vector) {1, 0}, INFINITY,
+        ALL_TAGS, &hit));
+
+    // Downwards onto body 4
+    assert(scene_raycast(scene, (Vector) {8.2, 10}, (Vector) {0, -2}, INFINITY,
+        ALL_TAGS, &hit));
+    assert(hit.body == scene_get_body(scene, 4));
+    assert(vec_isclose(hit.normal, (Vector) {0, 1}));
+    scene_free(scene);
+}
+
+void test_raycast_all() {
+    Scene *scene = make_row(10);
+    Raycast_Hit hits[4];
+    size_t found = scene_raycast_all(scene, (Vector) {-5, 0}, (Vector) {1, 0},
+        INFINITY, ALL_TAGS, hits, 4);
+    assert(found == 10);
+    for (size_t i = 0; i < 4; i++) {
+        assert(hits[i].body == scene_get_body(scene, i));
+        assert(within(1e-9, hits[i].distance, 4.5 + 2 * i));
+    }
+
+    // From the other end, nearest first
+    found = scene_raycast_all(scene, (Vector) {100, 0}, (Vector) {-1, 0},
+        INFINITY, TAG_MASK(0), hits, 4);
+    assert(found == 5);
+    assert(hits[0].body == scene_get_body(scene, 8));
+    assert(hits[3].body == scene_get_body(scene, 2));
+    assert(scene_raycast_all(scene, (Vector) {100, 0}, (Vector) {-1, 0},
+        INFINITY, ALL_TAGS, hits, 0) == 10);
+    scene_free(scene);
+}
+
+void test_query_point_and_box() {
+    Scene *scene = make_row(10);
+    // A big box over bodies 2 and 3
+    Body *big = make_box(scene, (Vector) {5, 0}, 3, 2);
+    Body *found[4];
+    assert(scene_query_point(scene, (Vector) {4.2, 0.3}, ALL_TAGS, found, 4) == 2);
+    assert((found[0] == big) != (found[1] == big));
+    assert(found[0] == scene_get_body(scene, 2) || found[1] == scene_get_body(scene, 2));
+    assert(scene_query_point(scene, (Vector) {4.2, 0.3}, TAG_MASK(2), found, 4) == 1);
+    assert(found[0] == big);
+    assert(scene_query_point(scene, (Vector) {1, 0}, ALL_TAGS, found, 4) == 0);
+
+    AABB box = {{3.2, -0.1}, {6.6, 0.1}};
+    assert(scene_query_box(scene, box, ALL_TAGS, found, 4) == 3);
+    assert(scene_query_box(scene, box, TAG_MASK(1), found, 1) == 1);
+    assert(found[0] == scene_get_body(scene, 3));
+    scene_free(scene);
+}
+
+void test_query_shape() {
+    Scene *scene = make_row(10);
+    // A diamond above the gap between bodies 2 and 3,
+    // whose box overlaps both but which touches neither
+    List *diamond = list_init(4, allocator_free);
+    Vector points[] = {{4, 1.2}, {5, 0.2}, {6, 1.2}, {5, 2.2}};
+    for (size_t i = 0; i < 4; i++) list_add(diamond, vec_init(points[i]));
+    Body *found[2];
+    assert(scene_query_box(scene, polygon_bounds(diamond), ALL_TAGS, found, 2) == 2);
+    assert(scene_query_shape(scene, diamond, ALL_TAGS, found, 2) == 0);
+    // Now over body 2
+    polygon_translate(diamond, (Vector) {-0.6, -0.7});
+    assert(scene_query_shape(scene, diamond, ALL_TAGS, found, 2) == 1);
+    assert(found[0] == scene_get_body(scene, 2));
+    list_free(diamond);
+    scene_free(scene);
+}
+
+// Queries see bodies where the last tick left them, and never removed ones
+void test_query_updates() {
+    Scene *scene = make_row(3);
+    Body *moving = scene_get_body(scene, 0);
+    body_set_velocity(moving, (Vector) {0, 10});
+    Body *found[3];
+    assert(scene_query_point(scene, VEC_ZERO, ALL_TAGS, found, 3) == 1);
+    scene_tick(scene, 1);
+    assert(scene_query_point(scene, VEC_ZERO, ALL_TAGS, found, 3) == 0);
+    assert(scene_query_point(scene, (Vector) {0, 10}, ALL_TAGS, found, 3) == 1);
+
+    body_remove(scene_get_body(scene, 1));
+    assert(scene_query_point(scene, (Vector) {2, 0}, ALL_TAGS, found, 3) == 0);
+    make_box(scene, (Vector) {2, 0}, 1, 0);
+    assert(scene_query_point(scene, (Vector) {2, 0}, ALL_TAGS, found, 3) == 1);
+
+    // Freeing a body shifts the ones after it into its place
+    scene_free_body(scene, 0);
+    assert(scene_query_point(scene, (Vector) {0, 10}, ALL_TAGS, found, 3) == 0);
+    assert(scene_query_point(scene, (Vector) {4, 0}, ALL_TAGS, found, 3) == 1);
+    assert(found[0] == scene_get_body(scene, 1));
+    scene_set_body(scene, 1, body_init(polygon_rectangle((Vector) {6, 0}, 1, 1), 1,
+        (RGBColor) {0, 0, 0}));
+    assert(scene_query_point(scene, (Vector) {4, 0}, ALL_TAGS, found, 3) == 0);
+    assert(scene_query_point(scene, (Vector) {6, 0}, ALL_TAGS, found, 3) == 1);
+    scene_free(scene);
+}
+
+// The tag index follows adds, removals, replacements and retagging
+void test_tagged_bodies() {
+    Scene *scene = make_row(5);
+    assert(scene_tagged_bodies(scene, 0) == 3);
+    assert(scene_tagged_bodies(scene, 1) == 2);
+    assert(scene_tagged_bodies(scene, 2) == 0);
+    assert(scene_get_tagged_body(scene, 0, 1) == scene_get_body(scene, 2));
+    assert(scene_get_tagged_body(scene, 1, 1) == scene_get_body(scene, 3));
+
+    // Retagging refiles a body right away, and the last body with
+    // its old tag takes its place
+    body_set_tag(scene_get_body(scene, 0), 2);
+    assert(scene_tagged_bodies(scene, 0) == 2);
+    assert(scene_get_tagged_body(scene, 0, 0) == scene_get_body(scene, 4));
+    assert(scene_get_tagged_body(scene, 2, 0) == scene_get_body(scene, 0));
+    body_set_tag(scene_get_body(scene, 0), 0);
+
+    body_remove(scene_get_body(scene, 0));
+    body_set_tag(scene_get_body(scene, 1), 2);
+    scene_tick(scene, 0.1);
+    assert(scene_tagged_bodies(scene, 0) == 2);
+    assert(scene_tagged_bodies(scene, 1) == 1);
+    assert(scene_tagged_bodies(scene, 2) == 1);
+    assert(scene_get_tagged_body(scene, 2, 0) == scene_get_body(scene, 0));
+
+    // Freeing a retagged body
+    body_set_tag(scene_get_body(scene, 1), 3);
+    scene_free_body(scene, 1);
+    assert(scene_tagged_bodies(scene, 0) == 1);
+
+    Body *replacement = body_init(polygon_rectangle(VEC_ZERO, 1, 1), 1,
+        (RGBColor) {0, 0, 0});
+    body_set_tag(replacement, 4);
+    Body *replaced = scene_get_body(scene, 0);
+    scene_set_body(scene, 0, replacement);
+    body_free(replaced);
+    assert(scene_tagged_bodies(scene, 2) == 0);
+    assert(scene_get_tagged_body(scene, 4, 0) == replacement);
+    scene_free(scene);
+}
+
+// A box slides through a stationary one, reported once per tick while
+// they touch, and events about a removed body are dropped
+void test_collision_events() {
+    Scene *scene = scene_init();
+    Body *still = make_box(scene, VEC_ZERO, 2, 2);
+    Body *moving = make_box(scene, (Vector) {-3.25, 0}, 2, 1);
+    body_set_velocity(moving, (Vector) {1, 0});
+    scene_add_collision_events(scene, TAG_MASK(2), TAG_MASK(1));
+
+    // The boxes touch at the start of ticks 3 to 10
+    Collision_Phase expected[] = {COLLISION_BEGIN, COLLISION_PERSIST, COLLISION_END};
+    for (size_t tick = 0; tick < 14; tick++) {
+        scene_tick(scene, 0.5);
+        if (tick < 3 || tick > 11) {
+            assert(scene_collision_events(scene) == 0);
+            continue;
+        }
+        assert(scene_collision_events(scene) == 1);
+        Collision_Event event = scene_get_collision_event(scene, 0);
+        assert(event.phase == expected[(tick > 3) + (tick > 10)]);
+        assert(event.body1 == still && event.body2 == moving);
+        // The axis points from still to moving as the tick began,
+        // so it turns round once moving has passed the middle
+        double side = body_get_previous_centroid(moving).x < 0 ? -1 : 1;
+        assert(vec_isclose(event.axis, (Vector) {side, 0}));
+        scene_clear_collision_events(scene);
+    }
+
+    // Events pile up until cleared, but not past the removal of a body
+    body_set_velocity(moving, (Vector) {-1, 0});
+    for (size_t tick = 0; tick < 6; tick++) scene_tick(scene, 0.5);
+    assert(scene_collision_events(scene) == 2);
+    body_remove(moving);
+    scene_tick(scene, 0.5);
+    assert(scene_collision_events(scene) == 0);
+    scene_free(scene);
+}
+
+typedef struct {
+    Scene *scene;
+    Body *replacement;
+    Body *spawned;
+    size_t calls;
+} Spawner;
+
+// Removes the first body, replaces the last, and adds another,
+// none of which may happen until the force creators are done
+void spawn_force(Spawner *spawner) {
+    spawner->calls++;
+    body_remove(scene_get_body(spawner->scene, 0));
+    scene_set_body(spawner->scene, 2, spawner->replacement);
+    scene_add_body(spawner->scene, spawner->spawned);
+    assert(scene_bodies(spawner->scene) == 3);
+    assert(scene_get_body(spawner->scene, 2) != spawner->replacement);
+}
+
+void test_deferred_commands() {
+    Scene *scene = scene_init();
+    make_box(scene, VEC_ZERO, 2, 1);
+    make_box(scene, (Vector) {1, 0}, 2, 2);
+    Body *last = make_box(scene, (Vector) {10, 0}, 2, 0);
+    Spawner spawner = {scene, NULL, NULL, 0};
+    spawner.replacement = body_init(polygon_rectangle((Vector) {20, 0}, 1, 1), 1,
+        (RGBColor) {0, 0, 0});
+    spawner.spawned = body_init(polygon_rectangle((Vector) {30, 0}, 1, 1), 1,
+        (RGBColor) {0, 0, 0});
+    scene_add_force_creator(scene, (ForceCreator) spawn_force, &spawner, NULL);
+
+    scene_tick(scene, 0.1);
+    assert(spawner.calls == 1);
+    // The first body is gone, so the replacement moved down an index
+    assert(scene_bodies(scene) == 3);
+    assert(scene_get_body(scene, 1) == spawner.replacement);
+    assert(scene_get_body(scene, 2) == spawner.spawned);
+    body_free(last);
+    scene_free(scene);
+}
+
+// Counts ticks, checking removed bodies are already gone
+void count_ticks(Scene *scene, size_t *ticks) {
+    (*ticks)++;
+    for (size_t i = 0; i < scene_bodies(scene); i++) {
+        assert(!body_is_removed(scene_get_body(scene, i)));
+    }
+}
+
+void test_tick_listeners() {
+    Scene *scene = scene_init();
+    make_box(scene, VEC_ZERO, 2, 0);
+    size_t ticks1 = 0, ticks2 = 0;
+    scene_add_tick_listener(scene, (TickListener) count_ticks, &ticks1);
+    scene_add_tick_listener(scene, (TickListener) count_ticks, &ticks2);
+    body_remove(scene_get_body(scene, 0));
+    scene_tick(scene, 0.1);
+    scene_remove_tick_listener(scene, (TickListener) count_ticks, &ticks1);
+    scene_tick(scene, 0.1);
+    assert(ticks1 == 1);
+    assert(ticks2 == 2);
+    scene_free(scene);
+}
+
+// A pile of boxes knocking into each other, with the bodies allocated
+// in index order or the reverse, so their addresses sort the other way
+Scene *make_pile(bool reverse, Body **bodies, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        size_t i = reverse ? n - 1 - k : k;
+        Vector center = {(i % 6) * 1.5, (i / 6) * 1.5};
+        bodies[i] = body_init(polygon_rectangle(center, 1, 1), 1 + i % 3,
+            (RGBColor) {0, 0, 0});
+        body_set_velocity(bodies[i], (Vector) {(i % 5) - 2.0, (i % 7) - 3.0});
+        body_set_tag(bodies[i], i % 2);
+    }
+    Scene *scene = scene_init();
+    for (size_t i = 0; i < n; i++) scene_add_body(scene, bodies[i]);
+    create_group_physics_collision(scene, 0.9, ALL_TAGS, ALL_TAGS);
+    scene_add_collision_events(scene, TAG_MASK(0), TAG_MASK(1));
+    return scene;
+}
+
+// Identical scenes tick to identical bits, and report the same events,
+// wherever their bodies were allocated
+void test_same_bits_any_allocation() {
+    const size_t N = 30;
+    Body *bodies1[N], *bodies2[N];
+    Scene *scene1 = make_pile(false, bodies1, N);
+    Scene *scene2 = make_pile(true, bodies2, N);
+    size_t events = 0;
+    for (size_t tick = 0; tick < 200; tick++) {
+        scene_tick(scene1, 0.01);
+        scene_tick(scene2, 0.01);
+        assert(scene_collision_events(scene1) == scene_collision_events(scene2));
+        for (size_t e = 0; e < scene_collision_events(scene1); e++) {
+            Collision_Event event1 = scene_get_collision_event(scene1, e);
+            Collision_Event event2 = scene_get_collision_event(scene2, e);
+            assert(event1.phase == event2.phase);
+            size_t first1 = 0, first2 = 0, second1 = 0, second2 = 0;
+            for (size_t i = 0; i < N; i++) {
+                if (bodies1[i] == event1.body1) first1 = i;
+                if (bodies1[i] == event1.body2) second1 = i;
+                if (bodies2[i] == event2.body1) first2 = i;
+                if (bodies2[i] == event2.body2) second2 = i;
+            }
+            assert(first1 == first2 && second1 == second2);
+            assert(memcmp(&event1.axis, &event2.axis, sizeof(Vector)) == 0);
+        }
+        events += scene_collision_events(scene1);
+        scene_clear_collision_events(scene1);
+        scene_clear_collision_events(scene2);
+    }
+    assert(events > 0);
+    for (size_t i = 0; i < N; i++) {
+        Vector centroid1 = body_get_centroid(bodies1[i]);
+        Vector centroid2 = body_get_centroid(bodies2[i]);
+        Vector velocity1 = body_get_velocity(bodies1[i]);
+        Vector velocity2 = body_get_velocity(bodies2[i]);
+        assert(memcmp(&centroid1, &centroid2, sizeof(Vector)) == 0);
+        assert(memcmp(&velocity1, &velocity2, sizeof(Vector)) == 0);
+    }
+    scene_free(scene1);
+    scene_free(scene2);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_raycast)
+    DO_TEST(test_raycast_all)
+    DO_TEST(test_query_point_and_box)
+    DO_TEST(test_query_shape)
+    DO_TEST(test_query_updates)
+    DO_TEST(test_tagged_bodies)
+    DO_TEST(test_collision_events)
+    DO_TEST(test_deferred_commands)
+    DO_TEST(test_tick_listeners)
+    DO_TEST(test_same_bits_any_allocation)
+
+    puts("scene_test PASS");
+    return 0;
 }
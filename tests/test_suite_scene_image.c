@@ -0,0 +1,198 @@
+#include "scene_image.h"
+#include "forces.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// A scratch file for the image, removed by the caller
+char *temp_path(char *path) {
+    strcpy(path, "/tmp/scene_image_XXXXXX");
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    return path;
+}
+
+Body *add_box(Scene *scene, Vector center, double mass, size_t tag, char *text) {
+    Body *body = body_init(polygon_rectangle(center, 2, 1), mass,
+        (RGBColor) {0.25, 0.5, 1});
+    body_set_tag(body, tag);
+    body_set_text(body, text);
+    scene_add_body(scene, body);
+    return body;
+}
+
+// A small level: a floor, falling blocks that bounce on it, and a spring
+Scene *make_level() {
+    Scene *scene = scene_init();
+    add_box(scene, (Vector) {0, -10}, INFINITY, 1, "floor");
+    for (size_t i = 0; i < 4; i++) {
+        Body *block = add_box(scene, (Vector) {3 * i, 2 * i}, 1 + i, 2, NULL);
+        body_set_velocity(block, (Vector) {1, i});
+        body_set_inertia(block, 1);
+    }
+    body_set_continuous(scene_get_body(scene, 1), true);
+    create_spring(scene, 3, scene_get_body(scene, 1), scene_get_body(scene, 2));
+    create_uniform_field(scene, (Uniform_Field) {{0, -9.8}, 0.1, 0, VEC_ZERO},
+        TAG_MASK(2));
+    create_group_physics_collision(scene, 0.5, TAG_MASK(2), TAG_MASK(1) | TAG_MASK(2));
+    scene_add_collision_events(scene, TAG_MASK(2), TAG_MASK(1));
+    return scene;
+}
+
+void assert_same_bodies(Scene *scene1, Scene *scene2) {
+    assert(scene_bodies(scene1) == scene_bodies(scene2));
+    for (size_t i = 0; i < scene_bodies(scene1); i++) {
+        Body *body1 = scene_get_body(scene1, i);
+        Body *body2 = scene_get_body(scene2, i);
+        Body_Kinematics k1 = body_get_kinematics(body1);
+        Body_Kinematics k2 = body_get_kinematics(body2);
+        assert(memcmp(&k1, &k2, sizeof(k1)) == 0);
+        List *shape1 = body_peek_shape(body1);
+        List *shape2 = body_peek_shape(body2);
+        assert(list_size(shape1) == list_size(shape2));
+        for (size_t j = 0; j < list_size(shape1); j++) {
+            assert(vec_equal(*(Vector *) list_get(shape1, j), *(Vector *) list_get(shape2, j)));
+        }
+        assert(body_get_mass(body1) == body_get_mass(body2));
+        assert(body_get_inertia(body1) == body_get_inertia(body2));
+        assert(body_get_tag(body1) == body_get_tag(body2));
+        assert(body_get_continuous(body1) == body_get_continuous(body2));
+        char *text1 = body_get_text(body1);
+        char *text2 = body_get_text(body2);
+        assert((text1 == NULL) == (text2 == NULL));
+        assert(text1 == NULL || strcmp(text1, text2) == 0);
+    }
+}
+
+// A loaded level matches the saved one, and keeps matching as both run
+void test_round_trip() {
+    Force_Registry *registry = force_registry_init();
+    forces_register_types(registry);
+    char path[32];
+    temp_path(path);
+    Scene *scene = make_level();
+    assert(scene_image_save(scene, path, registry));
+
+    Scene_Image *image = scene_image_map(path);
+    assert(image != NULL);
+    Scene *loaded = scene_image_load(image, registry);
+    assert(loaded != NULL);
+    assert_same_bodies(scene, loaded);
+    assert(scene_force_creators(loaded) == scene_force_creators(scene));
+    assert(scene_collision_entries(loaded) == scene_collision_entries(scene));
+    for (size_t i = 0; i < 200; i++) {
+        scene_tick(scene, 0.01);
+        scene_tick(loaded, 0.01);
+    }
+    assert_same_bodies(scene, loaded);
+    scene_free(loaded);
+    scene_image_unmap(image);
+    scene_free(scene);
+
+    // Moving the loaded bodies didn't change the file
+    Scene *fresh = make_level();
+    image = scene_image_map(path);
+    loaded = scene_image_load(image, registry);
+    assert_same_bodies(fresh, loaded);
+    scene_free(loaded);
+    scene_image_unmap(image);
+    scene_free(fresh);
+    remove(path);
+    force_registry_free(registry);
+}
+
+void test_unregistered_force() {
+    Force_Registry *registry = force_registry_init();
+    char path[32];
+    temp_path(path);
+    Scene *scene = make_level();
+    assert(!scene_image_save(scene, path, registry));
+
+    // Saved with the forces, but loaded without them
+    forces_register_types(registry);
+    assert(scene_image_save(scene, path, registry));
+    Force_Registry *empty = force_registry_init();
+    Scene_Image *image = scene_image_map(path);
+    assert(scene_image_load(image, empty) == NULL);
+    scene_image_unmap(image);
+    force_registry_free(empty);
+
+    scene_free(scene);
+    remove(path);
+    force_registry_free(registry);
+}
+
+// Writes part of a file, with one byte optionally changed
+void write_changed(const char *path, unsigned char *data, size_t size,
+    size_t offset, unsigned char value) {
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    unsigned char old = data[offset];
+    data[offset] = value;
+    fwrite(data, 1, size, file);
+    data[offset] = old;
+    fclose(file);
+}
+
+void test_invalid_images() {
+    Force_Registry *registry = force_registry_init();
+    forces_register_types(registry);
+    char path[32];
+    temp_path(path);
+    assert(scene_image_map("/nonexistent/level.img") == NULL);
+    Scene *scene = make_level();
+    assert(scene_image_save(scene, path, registry));
+    FILE *file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    unsigned char *data = malloc(size);
+    rewind(file);
+    assert(fread(data, 1, size, file) == size);
+    fclose(file);
+
+    // The magic number, then the version
+    write_changed(path, data, size, 0, 'X');
+    assert(scene_image_map(path) == NULL);
+    write_changed(path, data, size, 4, SCENE_IMAGE_VERSION + 1);
+    assert(scene_image_map(path) == NULL);
+    // Cut short, so the sections don't fit
+    write_changed(path, data, size - 1, 0, data[0]);
+    assert(scene_image_map(path) == NULL);
+    write_changed(path, data, 16, 0, data[0]);
+    assert(scene_image_map(path) == NULL);
+
+    // The last byte of the forces, which run into the text
+    write_changed(path, data, size, size - strlen("floor") - 2, 0xFF);
+    Scene_Image *image = scene_image_map(path);
+    assert(image != NULL);
+    assert(scene_image_load(image, registry) == NULL);
+    scene_image_unmap(image);
+
+    free(data);
+    scene_free(scene);
+    remove(path);
+    force_registry_free(registry);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_round_trip)
+    DO_TEST(test_unregistered_force)
+    DO_TEST(test_invalid_images)
+
+    puts("scene_image_test PASS");
+    return 0;
+}
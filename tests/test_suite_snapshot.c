@@ -0,0 +1,288 @@
+#include "snapshot.h"
+#include "forces.h"
+#include "polygon.h"
+#include "spring_network.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+Body *add_box(Scene *scene, Vector center, double mass, size_t tag) {
+    Body *body = body_init(polygon_rectangle(center, 1, 1), mass,
+        (RGBColor) {0.25, 0.5, 1});
+    body_set_tag(body, tag);
+    scene_add_body(scene, body);
+    return body;
+}
+
+// A scene using most of the built-in forces, spread out so nothing touches
+Scene *make_scene() {
+    Scene *scene = scene_init();
+    for (size_t i = 0; i < 6; i++) {
+        Body *body = add_box(scene, (Vector) {10 * i, 5 * (i % 2)}, 1 + i, i % 3);
+        body_set_velocity(body, (Vector) {i, -1});
+    }
+    Body *wall = add_box(scene, (Vector) {-100, 0}, INFINITY, 3);
+    body_set_continuous(wall, true);
+    body_set_collision_mask(wall, TAG_MASK(1));
+
+    create_spring(scene, 2, scene_get_body(scene, 0), scene_get_body(scene, 1));
+    create_newtonian_gravity(scene, 5, scene_get_body(scene, 1), scene_get_body(scene, 2));
+    create_drag(scene, 0.5, scene_get_body(scene, 3));
+    List *nbody = list_init(3, NULL);
+    for (size_t i = 2; i < 5; i++) list_add(nbody, scene_get_body(scene, i));
+    create_nbody_gravity(scene, 10, 0.5, nbody);
+    create_uniform_field(scene, (Uniform_Field) {{0, -9.8}, 0.1, 0.01, {1, 0}},
+        TAG_MASK(0) | TAG_MASK(2));
+    List *network = list_init(3, NULL);
+    for (size_t i = 3; i < 6; i++) list_add(network, scene_get_body(scene, i));
+    Spring springs[] = {{0, 1, 8, 3, 0.1}, {2, 1, 12, 4, 0}};
+    create_spring_network(scene, network, springs, 2, false);
+    create_destructive_collision(scene, scene_get_body(scene, 4), wall);
+    create_group_physics_collision(scene, 0.8, TAG_MASK(1), TAG_MASK(3));
+    create_group_destructive_collision(scene, TAG_MASK(0), TAG_MASK(2));
+    scene_add_collision_events(scene, TAG_MASK(1), TAG_MASK(2));
+    return scene;
+}
+
+Scene *round_trip(Scene *scene, Force_Registry *registry) {
+    FILE *file = tmpfile();
+    assert(file != NULL);
+    assert(scene_save(scene, file, registry));
+    rewind(file);
+    Scene *loaded = scene_load(file, registry);
+    fclose(file);
+    return loaded;
+}
+
+void assert_same_bodies(Scene *scene1, Scene *scene2) {
+    assert(scene_bodies(scene1) == scene_bodies(scene2));
+    for (size_t i = 0; i < scene_bodies(scene1); i++) {
+        Body *body1 = scene_get_body(scene1, i);
+        Body *body2 = scene_get_body(scene2, i);
+        Body_Kinematics k1 = body_get_kinematics(body1);
+        Body_Kinematics k2 = body_get_kinematics(body2);
+        assert(memcmp(&k1, &k2, sizeof(k1)) == 0);
+        List *shape1 = body_peek_shape(body1);
+        List *shape2 = body_peek_shape(body2);
+        assert(list_size(shape1) == list_size(shape2));
+        for (size_t j = 0; j < list_size(shape1); j++) {
+            assert(vec_equal(*(Vector *) list_get(shape1, j), *(Vector *) list_get(shape2, j)));
+        }
+        assert(body_get_mass(body1) == body_get_mass(body2));
+        assert(body_get_tag(body1) == body_get_tag(body2));
+        assert(body_get_collision_mask(body1) == body_get_collision_mask(body2));
+        assert(body_get_continuous(body1) == body_get_continuous(body2));
+        assert(body_get_color(body1).g == body_get_color(body2).g);
+    }
+}
+
+// A loaded scene matches the saved one and keeps matching as both run
+void test_round_trip() {
+    Force_Registry *registry = force_registry_init();
+    forces_register_types(registry);
+    Scene *scene = make_scene();
+    for (size_t i = 0; i < 10; i++) scene_tick(scene, 0.01);
+    Scene *loaded = round_trip(scene, registry);
+    assert(loaded != NULL);
+    assert_same_bodies(scene, loaded);
+    assert(scene_force_creators(loaded) == scene_force_creators(scene));
+    assert(scene_collision_entries(loaded) == scene_collision_entries(scene));
+
+    for (size_t i = 0; i < 50; i++) {
+        scene_tick(scene, 0.01);
+        scene_tick(loaded, 0.01);
+    }
+    assert_same_bodies(scene, loaded);
+    scene_free(scene);
+    scene_free(loaded);
+    force_registry_free(registry);
+}
+
+void test_integrator_settings() {
+    Force_Registry *registry = force_registry_init();
+    Scene *scene = scene_init();
+    scene_set_integrator(scene, INTEGRATOR_ADAPTIVE_RK45);
+    scene_set_adaptive_config(scene, (Adaptive_Config) {1e-6, 1e-3, 1e-8});
+    Scene *loaded = round_trip(scene, registry);
+    assert(scene_get_integrator(loaded) == INTEGRATOR_ADAPTIVE_RK45);
+    assert(scene_get_adaptive_config(loaded).max_dt == 1e-3);
+    assert(scene_get_adaptive_config(loaded).tolerance == 1e-8);
+    scene_free(scene);
+    scene_free(loaded);
+    force_registry_free(registry);
+}
+
+typedef struct {
+    Body *body;
+    double push;
+} Pusher;
+
+void push(Pusher *pusher) {
+    body_add_force(pusher->body, (Vector) {pusher->push, 0});
+}
+
+void pusher_save(Pusher *pusher, Snapshot *snapshot) {
+    snapshot_write_body(snapshot, pusher->body);
+    snapshot_write_double(snapshot, pusher->push);
+}
+
+Pusher *pusher_load(Snapshot *snapshot, Scene *scene, List **bodies) {
+    Pusher *pusher = malloc(sizeof(Pusher));
+    assert(pusher != NULL);
+    pusher->body = snapshot_read_body(snapshot);
+    pusher->push = snapshot_read_double(snapshot);
+    *bodies = list_init(1, NULL);
+    list_add(*bodies, pusher->body);
+    return pusher;
+}
+
+// An application's own force creator saves once it is registered
+void test_custom_type() {
+    Force_Registry *registry = force_registry_init();
+    Scene *scene = scene_init();
+    add_box(scene, VEC_ZERO, 1, 0);
+    Pusher *pusher = malloc(sizeof(Pusher));
+    *pusher = (Pusher) {add_box(scene, (Vector) {5, 5}, 2, 0), 3};
+    List *bodies = list_init(1, NULL);
+    list_add(bodies, pusher->body);
+    scene_add_bodies_force_creator(scene, (ForceCreator) push, pusher, bodies, free);
+
+    FILE *file = tmpfile();
+    assert(!scene_save(scene, file, registry));
+    fclose(file);
+
+    force_registry_add(registry, (Force_Type) {FORCE_TYPE_USER, (ForceCreator) push,
+        (Force_Saver) pusher_save, (Force_Loader) pusher_load, free});
+    Scene *loaded = round_trip(scene, registry);
+    assert(loaded != NULL);
+    scene_tick(loaded, 1);
+    assert(vec_equal(body_get_velocity(scene_get_body(loaded, 1)), (Vector) {1.5, 0}));
+    assert(vec_equal(body_get_velocity(scene_get_body(loaded, 0)), VEC_ZERO));
+    scene_free(scene);
+    scene_free(loaded);
+    force_registry_free(registry);
+}
+
+// Truncated, mismatched or unregistered snapshots don't load
+void test_invalid_snapshots() {
+    Force_Registry *registry = force_registry_init();
+    forces_register_types(registry);
+    Scene *scene = make_scene();
+    FILE *file = tmpfile();
+    assert(scene_save(scene, file, registry));
+    long size = ftell(file);
+    unsigned char *data = malloc(size);
+    rewind(file);
+    assert(fread(data, 1, size, file) == (size_t) size);
+    fclose(file);
+
+    long lengths[] = {0, 3, 8, size / 2, size - 1};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        file = tmpfile();
+        fwrite(data, 1, lengths[i], file);
+        rewind(file);
+        assert(scene_load(file, registry) == NULL);
+        fclose(file);
+    }
+
+    // The version follows the magic number
+    data[4]++;
+    file = tmpfile();
+    fwrite(data, 1, size, file);
+    rewind(file);
+    assert(scene_load(file, registry) == NULL);
+    fclose(file);
+    data[4]--;
+
+    Force_Registry *empty = force_registry_init();
+    file = tmpfile();
+    fwrite(data, 1, size, file);
+    rewind(file);
+    assert(scene_load(file, empty) == NULL);
+    fclose(file);
+
+    force_registry_free(empty);
+    free(data);
+    scene_free(scene);
+    force_registry_free(registry);
+}
+
+// Overwrites the little-endian value at an offset into encoded forces
+void patch(unsigned char *data, size_t offset, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) data[offset + i] = (unsigned char) (value >> (8 * i));
+}
+
+void patch_double(unsigned char *data, size_t offset, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    patch(data, offset, bits, sizeof(bits));
+}
+
+// Forces that name a missing body, or parameters their constructors
+// would refuse, fail to load and aren't added
+void test_corrupt_forces() {
+    Force_Registry *registry = force_registry_init();
+    forces_register_types(registry);
+    Scene *scene = scene_init();
+    Body *body1 = add_box(scene, VEC_ZERO, 1, 0);
+    Body *body2 = add_box(scene, (Vector) {5, 0}, 2, 0);
+    create_spring(scene, 2, body1, body2);
+    size_t size;
+    unsigned char *data = scene_save_forces(scene, registry, &size);
+    assert(data != NULL);
+    // The force count and type ID come before the spring's first body
+    patch(data, 8, UINT32_MAX, sizeof(uint32_t));
+    Scene *loaded = scene_init();
+    add_box(loaded, VEC_ZERO, 1, 0);
+    add_box(loaded, (Vector) {5, 0}, 2, 0);
+    assert(!scene_load_forces(loaded, data, size, registry));
+    assert(scene_force_creators(loaded) == 0);
+    scene_tick(loaded, 0.01);
+    scene_free(loaded);
+    free(data);
+    scene_free(scene);
+
+    // Each gravity's body list holds two indices, followed by G and its parameter
+    for (int direct = 0; direct <= 1; direct++) {
+        scene = scene_init();
+        List *bodies = list_init(2, NULL);
+        list_add(bodies, add_box(scene, VEC_ZERO, 1, 0));
+        list_add(bodies, add_box(scene, (Vector) {5, 0}, 2, 0));
+        if (direct) create_direct_gravity(scene, 1, 0.1, bodies);
+        else create_nbody_gravity(scene, 1, 0.5, bodies);
+        data = scene_save_forces(scene, registry, &size);
+        assert(data != NULL);
+        patch_double(data, 28, direct ? 0 : -1);
+        loaded = scene_init();
+        add_box(loaded, VEC_ZERO, 1, 0);
+        add_box(loaded, (Vector) {5, 0}, 2, 0);
+        assert(!scene_load_forces(loaded, data, size, registry));
+        assert(scene_force_creators(loaded) == 0);
+        scene_tick(loaded, 0.01);
+        scene_free(loaded);
+        free(data);
+        scene_free(scene);
+    }
+    force_registry_free(registry);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_round_trip)
+    DO_TEST(test_integrator_settings)
+    DO_TEST(test_custom_type)
+    DO_TEST(test_invalid_snapshots)
+    DO_TEST(test_corrupt_forces)
+
+    puts("snapshot_test PASS");
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "spring_network.h"
+#include "forces.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+Body *make_ball(Vector center, double mass) {
+    return body_init(polygon_rectangle(center, 1, 1), mass, (RGBColor) {0, 0, 0});
+}
+
+// With no rest length or damping, a network matches create_spring()
+void test_matches_create_spring() {
+    const size_t N = 6;
+    Scene *pairs = scene_init();
+    Scene *network = scene_init();
+    List *bodies = list_init(N, NULL);
+    Spring springs[N - 1];
+    for (size_t i = 0; i < N; i++) {
+        Vector center = {i * 3.0, i % 2 ? 1.0 : -1.0};
+        scene_add_body(pairs, make_ball(center, i + 1));
+        Body *body = make_ball(center, i + 1);
+        scene_add_body(network, body);
+        list_add(bodies, body);
+        if (i > 0) {
+            create_spring(pairs, 2, scene_get_body(pairs, i - 1), scene_get_body(pairs, i));
+            // Alternate which end is listed first
+            springs[i - 1] = (Spring) {i % 2 ? i - 1 : i, i % 2 ? i : i - 1, 0, 2, 0};
+        }
+    }
+    create_spring_network(network, bodies, springs, N - 1, false);
+    for (int step = 0; step < 100; step++) {
+        scene_tick(pairs, 0.01);
+        scene_tick(network, 0.01);
+    }
+    for (size_t i = 0; i < N; i++) {
+        assert(vec_isclose(body_get_centroid(scene_get_body(pairs, i)),
+            body_get_centroid(scene_get_body(network, i))));
+    }
+    scene_free(pairs);
+    scene_free(network);
+}
+
+// A damped spring from a fixed anchor settles at its rest length
+void test_rest_length_and_damping() {
+    for (int implicit = 0; implicit < 2; implicit++) {
+        Scene *scene = scene_init();
+        Body *anchor = make_ball(VEC_ZERO, INFINITY);
+        Body *ball = make_ball((Vector) {0, -10}, 2);
+        scene_add_body(scene, anchor);
+        scene_add_body(scene, ball);
+        List *bodies = list_init(2, NULL);
+        list_add(bodies, anchor);
+        list_add(bodies, ball);
+        Spring spring = {0, 1, 4, 50, 5};
+        create_spring_network(scene, bodies, &spring, 1, implicit);
+        for (int step = 0; step < 2000; step++) {
+            scene_tick(scene, 1e-2);
+        }
+        assert(vec_isclose(body_get_centroid(ball), (Vector) {0, -4}));
+        assert(vec_isclose(body_get_velocity(ball), VEC_ZERO));
+        assert(vec_equal(body_get_centroid(anchor), VEC_ZERO));
+        scene_free(scene);
+    }
+}
+
+// Returns the largest distance the ball reaches from the anchor
+// on a spring far too stiff for the timestep to resolve
+double stiff_spring_extent(bool implicit) {
+    Scene *scene = scene_init();
+    Body *anchor = make_ball(VEC_ZERO, INFINITY);
+    Body *ball = make_ball((Vector) {2, 0}, 1);
+    scene_add_body(scene, anchor);
+    scene_add_body(scene, ball);
+    List *bodies = list_init(2, NULL);
+    list_add(bodies, anchor);
+    list_add(bodies, ball);
+    // sqrt(k / m) dt = 10, where explicit Euler needs it below 2
+    Spring spring = {0, 1, 1, 1e6, 0};
+    create_spring_network(scene, bodies, &spring, 1, implicit);
+    double extent = 0;
+    for (int step = 0; step < 100; step++) {
+        scene_tick(scene, 1e-2);
+        extent = fmax(extent, vec_magnitude(body_get_centroid(ball)));
+    }
+    scene_free(scene);
+    return extent;
+}
+
+void test_implicit_stiff_spring() {
+    assert(stiff_spring_extent(false) > 1e6);
+    assert(stiff_spring_extent(true) <= 2);
+}
+
+// A stiff cloth hanging from its top row under gravity stays in one piece
+void test_implicit_cloth() {
+    const size_t SIDE = 20;
+    const double SPACING = 1;
+    Scene *scene = scene_init();
+    List *bodies = list_init(SIDE * SIDE, NULL);
+    for (size_t row = 0; row < SIDE; row++) {
+        for (size_t col = 0; col < SIDE; col++) {
+            Vector center = {col * SPACING, -(double) row * SPACING};
+            Body *body = make_ball(center, row == 0 ? INFINITY : 0.1);
+            scene_add_body(scene, body);
+            list_add(bodies, body);
+        }
+    }
+    Spring *springs = malloc(sizeof(Spring) * 2 * SIDE * SIDE);
+    size_t num_springs = 0;
+    for (size_t row = 0; row < SIDE; row++) {
+        for (size_t col = 0; col < SIDE; col++) {
+            size_t i = row * SIDE + col;
+            if (col + 1 < SIDE) {
+                springs[num_springs++] = (Spring) {i, i + 1, SPACING, 1e4, 1};
+            }
+            if (row + 1 < SIDE) {
+                springs[num_springs++] = (Spring) {i + SIDE, i, SPACING, 1e4, 1};
+            }
+        }
+    }
+    create_spring_network(scene, bodies, springs, num_springs, true);
+    free(springs);
+    Uniform_Field gravity = {.acceleration = {0, -10}};
+    create_uniform_field(scene, gravity, ALL_TAGS);
+
+    for (int step = 0; step < 200; step++) {
+        scene_tick(scene, 1.0 / 60);
+    }
+    // Neighbors stay close to their rest spacing
+    for (size_t row = 1; row < SIDE; row++) {
+        for (size_t col = 0; col < SIDE; col++) {
+            Vector above = body_get_centroid(scene_get_body(scene, (row - 1) * SIDE + col));
+            Vector here = body_get_centroid(scene_get_body(scene, row * SIDE + col));
+            double gap = vec_magnitude(vec_subtract(above, here));
+            assert(gap > 0.9 * SPACING && gap < 1.1 * SPACING);
+        }
+    }
+    scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_matches_create_spring)
+    DO_TEST(test_rest_length_and_damping)
+    DO_TEST(test_implicit_stiff_spring)
+    DO_TEST(test_implicit_cloth)
+
+    puts("spring_network_test PASS");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "stepper.h"
+#include "polygon.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+const double DT = 0.01;
+
+Scene *make_moving_scene() {
+    Scene *scene = scene_init();
+    Body *body = body_init(polygon_rectangle(VEC_ZERO, 2, 2), 1,
+        (RGBColor) {0, 0, 0});
+    body_set_velocity(body, (Vector) {10, 0});
+    scene_add_body(scene, body);
+    return scene;
+}
+
+void test_whole_steps() {
+    Scene *scene = make_moving_scene();
+    Stepper *stepper = stepper_init(DT, 10);
+    assert(stepper_advance(stepper, scene, 0.035) == 3);
+    assert(isclose(stepper_alpha(stepper), 0.5));
+    assert(stepper_advance(stepper, scene, 0.006) == 1);
+    assert(isclose(stepper_alpha(stepper), 0.1));
+    assert(stepper_advance(stepper, scene, 0) == 0);
+    assert(stepper_ticks(stepper) == 4);
+    // Every tick is exactly DT long
+    assert(vec_isclose(body_get_centroid(scene_get_body(scene, 0)),
+        (Vector) {4 * DT * 10, 0}));
+    stepper_free(stepper);
+    scene_free(scene);
+}
+
+// A huge frame shouldn't turn into a huge number of ticks
+void test_substep_clamp() {
+    Scene *scene = make_moving_scene();
+    Stepper *stepper = stepper_init(DT, 4);
+    assert(stepper_advance(stepper, scene, 10.005) == 4);
+    assert(stepper_alpha(stepper) < 1);
+    assert(isclose(stepper_alpha(stepper), 0.5));
+    // The dropped time doesn't carry over into the next frame
+    assert(stepper_advance(stepper, scene, DT) == 1);
+    stepper_free(stepper);
+    scene_free(scene);
+}
+
+void test_interpolation() {
+    Scene *scene = make_moving_scene();
+    Body *body = scene_get_body(scene, 0);
+    Stepper *stepper = stepper_init(DT, 10);
+    stepper_advance(stepper, scene, 0.0125);
+    assert(vec_isclose(body_get_previous_centroid(body), VEC_ZERO));
+    assert(vec_isclose(body_get_centroid(body), (Vector) {0.1, 0}));
+
+    List *shape = body_get_interpolated_shape(body, stepper_alpha(stepper));
+    assert(vec_isclose(polygon_centroid(shape), (Vector) {0.025, 0}));
+    list_free(shape);
+    shape = body_get_interpolated_shape(body, 1);
+    assert(vec_isclose(polygon_centroid(shape), body_get_centroid(body)));
+    list_free(shape);
+
+    // Teleporting isn't interpolated
+    body_set_centroid(body, (Vector) {50, 50});
+    shape = body_get_interpolated_shape(body, 0);
+    assert(vec_isclose(polygon_centroid(shape), (Vector) {49.9, 50}));
+    list_free(shape);
+
+    stepper_free(stepper);
+    scene_free(scene);
+}
+
+int main(int argc, char *argv[]) {
+    // Run all tests if there are no command-line arguments
+    bool all_tests = argc == 1;
+    // Read test name from file
+    char testname[100];
+    if (!all_tests) {
+        read_testname(argv[1], testname, sizeof(testname));
+    }
+
+    DO_TEST(test_whole_steps)
+    DO_TEST(test_substep_clamp)
+    DO_TEST(test_interpolation)
+
+    puts("stepper_test PASS");
+    return 0;
+}